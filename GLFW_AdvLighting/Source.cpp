@@ -7,6 +7,7 @@
 
 #include "Shader.h"
 #include "Camera.h"
+#include "Headless.h"
 
 #include <GLM/glm.hpp>
 #include <GLM/gtc/matrix_transform.hpp>
@@ -14,10 +15,12 @@
 
 #include <iostream>
 
-const unsigned int SCR_WIDTH = 1000;
-const unsigned int SCR_HEIGHT = 800;
+// window size, --width / --height replace it in headless mode
+unsigned int SCR_WIDTH = 1000;
+unsigned int SCR_HEIGHT = 800;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+Headless headless;
 float lastX = (float)SCR_WIDTH / 2.0;
 float lastY = (float)SCR_HEIGHT / 2.0;
 bool firstMouse = true;
@@ -39,8 +42,10 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 unsigned int loadTexture(char const* path, bool gammaCorrection);
 
-int main()
+int main(int argc, char** argv)
 {
+	headless.ParseArguments(argc, argv, SCR_WIDTH, SCR_HEIGHT);
+
 	GLFWwindow* window = InitWindow();
 	if (!window)
 		return -1;
@@ -105,17 +110,19 @@ int main()
 	// Game Loop
 	while (!glfwWindowShouldClose(window))
 	{
-		float currentFrame = glfwGetTime();
+		float currentFrame = headless.GetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		processInput(window);
+		headless.UpdateCamera(camera);
 
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		ImGui_ImplGlfwGL3_NewFrame();
 
+		headless.BeginPass("Scene");
 		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 		glm::mat4 view = camera.GetViewMatrix();
 		glm::mat4 model = glm::mat4(1.0f);
@@ -139,6 +146,7 @@ int main()
 		glBindTexture(GL_TEXTURE_2D, gammaEnabled ? floorTextureGammaCorrected : floorTexture);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 		glBindVertexArray(0);
+		headless.EndPass();
 
 		//std::cout << (blinn ? "Blinn-Phong" : "Phong") << std::endl;
 		//std::cout << (gammaEnabled ? "Gamma Enabled" : "Gamma Disabled") << std::endl;
@@ -184,7 +192,9 @@ int main()
 		}
 		ImGui::End();
 		ImGui::Render();
-		ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		if (!headless.IsEnabled())
+			ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		headless.EndFrame(window);
 
 		glfwPollEvents();
 		glfwSwapBuffers(window);
@@ -209,6 +219,7 @@ GLFWwindow* InitWindow()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	headless.ApplyWindowHints();
 
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Blinn-Phong Lighting", NULL, NULL);
 	if (window == NULL)
@@ -218,7 +229,7 @@ GLFWwindow* InitWindow()
 		return nullptr;
 	}
 	glfwMakeContextCurrent(window);
-	glfwSwapInterval(1);
+	glfwSwapInterval(headless.IsEnabled() ? 0 : 1);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetWindowPos(window, 100, 100);
 
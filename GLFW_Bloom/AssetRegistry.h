@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Mesh.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+
+class Model;
+class TextureBatch;
+
+// A GL texture shared by every mesh and model that loaded the same file with the same colour space
+struct TextureAsset
+{
+	unsigned int id;
+	std::string key;
+	std::string path;
+	size_t bytes = 0; // mip chain included, read back from GL the first time a report needs it
+};
+
+struct AssetRegistryStats
+{
+	unsigned int liveModels = 0;
+	unsigned int liveMeshes = 0;
+	unsigned int liveTextures = 0;
+	size_t meshBytes = 0;
+	size_t textureBytes = 0;
+	unsigned int hits = 0;   // acquisitions that returned an asset already loaded
+	unsigned int misses = 0; // acquisitions that loaded a new one
+};
+
+// Process-wide cache of loaded assets. Textures are keyed by canonical path
+// and colour space, meshes by a hash of their contents, textures, vertex
+// layout and quantization box (so identical meshes in different files share one set of buffers),
+// models by canonical path and import options. Handles are shared_ptrs; the
+// registry only holds weak references and an asset's GL objects are deleted
+// when its last handle goes, so every handle must be released while the GL
+// context is current. Single threaded, call from the GL thread only.
+class AssetRegistry
+{
+private:
+	std::unordered_map<std::string, std::weak_ptr<TextureAsset>> m_Textures;
+	std::unordered_map<std::string, std::weak_ptr<Mesh>> m_Meshes;
+	std::unordered_map<std::string, std::weak_ptr<Model>> m_Models;
+	unsigned int m_Hits;
+	unsigned int m_Misses;
+
+	AssetRegistry();
+
+public:
+	static AssetRegistry& Get();
+
+	AssetRegistry(const AssetRegistry&) = delete;
+	AssetRegistry& operator=(const AssetRegistry&) = delete;
+
+	// Absolute, with forward slashes (and lower case on Windows), so different spellings of a file share a key
+	static std::string CanonicalPath(const std::string& path);
+
+	// A new texture is queued on the batch, its name is valid at once and filled on the batch's Finish()
+	std::shared_ptr<TextureAsset> AcquireTexture(const std::string& path, bool gammaCorrection, TextureBatch& batch);
+	// Keeps the CPU copies of a new mesh, the pointer form uploads without them like the Mesh constructors;
+	// bounds is the shared quantization box, if any, and part of the key, as are the lods ranges
+	std::shared_ptr<Mesh> AcquireMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<Texture>& textures, VertexLayout layout, const VertexBounds* bounds = nullptr, const std::vector<MeshLod>* lods = nullptr);
+	std::shared_ptr<Mesh> AcquireMesh(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount, std::vector<Texture>& textures, VertexLayout layout, const VertexBounds* bounds = nullptr, const std::vector<MeshLod>* lods = nullptr);
+	std::shared_ptr<Model> AcquireModel(const std::string& path, bool gammaCorrection = false, VertexLayout layout = VERTEX_LAYOUT_QUANTIZED);
+
+	AssetRegistryStats GetStats();
+	// Live GPU memory of every asset, largest first
+	void PrintReport();
+
+private:
+	std::string MeshKey(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount, const std::vector<Texture>& textures, VertexLayout layout, const VertexBounds* bounds, const std::vector<MeshLod>* lods) const;
+	std::shared_ptr<Mesh> FindMesh(const std::string& key);
+	std::shared_ptr<Mesh> Register(const std::string& key, Mesh* mesh);
+	static size_t GetTextureBytes(unsigned int id);
+	static size_t GetMeshBytes(const Mesh& mesh);
+};
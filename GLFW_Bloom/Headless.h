@@ -0,0 +1,78 @@
+#pragma once
+
+#include <GLAD/glad.h>
+#include <GLFW/glfw3.h>
+#include <GLM/glm.hpp>
+#include "Camera.h"
+#include <string>
+#include <vector>
+
+// Deterministic offscreen runs for machines without a display or GPU:
+//   --headless [--width W] [--height H] [--frames N] [--context native|egl|osmesa]
+//              [--capture-every K] [--output prefix]
+// The window is hidden, vsync is off and time steps a fixed 1/60 s per frame
+// while the camera follows a fixed path, so two runs render the same frames.
+// The last frame (and every K-th one) is written to <prefix>_NNNN.png and the
+// GPU time of every pass wrapped in BeginPass/EndPass is printed at the end.
+// Without --headless every call is a no-op and the demo runs as before.
+class Headless
+{
+private:
+	struct Pass
+	{
+		std::string name;
+		unsigned int queries[2]; // timestamps at begin and end
+		bool active;
+		double totalMs, minMs, maxMs;
+		unsigned int samples;
+	};
+
+	bool m_Enabled;
+	unsigned int m_Width;
+	unsigned int m_Height;
+	unsigned int m_Frames;
+	unsigned int m_CaptureEvery;
+	int m_ContextAPI;
+	std::string m_OutputPrefix;
+
+	unsigned int m_Frame;
+	bool m_CameraStored;
+	glm::vec3 m_CameraPosition;
+	float m_CameraYaw;
+	float m_CameraPitch;
+
+	std::vector<Pass> m_Passes;
+	std::vector<unsigned int> m_OpenPasses;
+	double m_LastFrameEnd;
+	double m_FrameTotalMs;
+	unsigned int m_FrameSamples;
+
+public:
+	static const float FRAME_TIME;
+
+	Headless();
+
+	// Enables the mode if --headless is given. width/height come in as the demo's
+	// window size and are replaced by --width/--height.
+	void ParseArguments(int argc, char** argv, unsigned int& width, unsigned int& height);
+	// Call after the demo's own hints, before glfwCreateWindow
+	void ApplyWindowHints() const;
+
+	bool IsEnabled() const;
+	// glfwGetTime(), or the fixed frame clock when headless
+	float GetTime() const;
+	// Places the camera on the path for this frame, relative to where it started
+	void UpdateCamera(Camera& camera);
+
+	// GPU timestamps around a pass, once per pass per frame, passes may nest
+	void BeginPass(const std::string& name);
+	void EndPass();
+
+	// Call after the frame is drawn and before the swap. Collects the pass times,
+	// captures the frame and closes the window once the last frame is done.
+	void EndFrame(GLFWwindow* window);
+
+private:
+	void PrintReport() const;
+	bool WritePNG(const std::string& path, unsigned int width, unsigned int height, const std::vector<unsigned char>& rgb) const;
+};
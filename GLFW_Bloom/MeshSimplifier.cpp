@@ -0,0 +1,324 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <GLM/glm.hpp>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+#include <cstdint>
+
+// a collapse may tilt a surviving triangle's normal, but not past this cosine
+static const float SIMPLIFY_MIN_NORMAL_COSINE = 0.25f;
+
+// Symmetric 4x4 sum of weight * p p^T over planes p = (n, d), upper triangle only
+struct Quadric
+{
+	double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+	double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+	double a22 = 0.0, a23 = 0.0;
+	double a33 = 0.0;
+	double weight = 0.0;
+
+	void AddPlane(const glm::dvec3& n, double d, double w)
+	{
+		a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+		a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+		a22 += w * n.z * n.z; a23 += w * n.z * d;
+		a33 += w * d * d;
+		weight += w;
+	}
+
+	void Add(const Quadric& q)
+	{
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+		a11 += q.a11; a12 += q.a12; a13 += q.a13;
+		a22 += q.a22; a23 += q.a23;
+		a33 += q.a33;
+		weight += q.weight;
+	}
+
+	// weighted sum of squared distances from p to the planes
+	double Evaluate(const glm::vec3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		return a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+			+ a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+			+ a22 * z * z + 2.0 * a23 * z
+			+ a33;
+	}
+};
+
+struct Collapse
+{
+	unsigned int from;
+	unsigned int to;
+	double cost;
+};
+
+// Simplification state that carries over between targets, so the levels of a
+// chain are measured against the original surface rather than the level before
+class QuadricSimplifier
+{
+private:
+	const std::vector<Vertex>& m_Vertices;
+	std::vector<unsigned int> m_Indices;
+	std::vector<Quadric> m_Quadrics;
+	std::vector<unsigned char> m_Locked;
+	double m_MaxCost;
+
+public:
+	QuadricSimplifier(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+
+	// Collapses until at most targetIndexCount indices are left or nothing more can go
+	void Simplify(unsigned int targetIndexCount);
+
+	const std::vector<unsigned int>& GetIndices() const { return m_Indices; }
+	float GetError() const { return (float)std::sqrt(std::max(m_MaxCost, 0.0)); }
+
+private:
+	double CollapseCost(unsigned int from, unsigned int to) const;
+	bool FoldsSurface(unsigned int from, unsigned int to, const std::vector<unsigned int>& offsets, const std::vector<unsigned int>& adjacency) const;
+};
+
+QuadricSimplifier::QuadricSimplifier(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+	: m_Vertices(vertices), m_Indices(indices), m_Quadrics(vertices.size()), m_Locked(vertices.size(), 0), m_MaxCost(0.0)
+{
+	unsigned int vertexCount = (unsigned int)vertices.size();
+
+	// vertices sharing a position (seams) get one id, sorted so equal positions are adjacent
+	std::vector<unsigned int> order(vertexCount);
+	for (unsigned int i = 0; i < vertexCount; ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&vertices](unsigned int a, unsigned int b)
+	{
+		const glm::vec3& pa = vertices[a].Position;
+		const glm::vec3& pb = vertices[b].Position;
+		if (pa.x != pb.x)
+			return pa.x < pb.x;
+		if (pa.y != pb.y)
+			return pa.y < pb.y;
+		return pa.z < pb.z;
+	});
+	std::vector<unsigned int> canonical(vertexCount);
+	std::vector<unsigned int> copies(vertexCount, 0);
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		bool same = i > 0 && vertices[order[i]].Position == vertices[order[i - 1]].Position;
+		canonical[order[i]] = same ? canonical[order[i - 1]] : order[i];
+		++copies[canonical[order[i]]];
+	}
+
+	// an edge not shared by exactly two triangles is on a border (or non-manifold)
+	std::unordered_map<uint64_t, unsigned int> edgeTriangles;
+	edgeTriangles.reserve(indices.size());
+	std::vector<Quadric> positionQuadrics(vertexCount);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int c[3] = { canonical[indices[i]], canonical[indices[i + 1]], canonical[indices[i + 2]] };
+		for (int e = 0; e < 3; ++e)
+		{
+			unsigned int a = c[e], b = c[(e + 1) % 3];
+			if (a == b)
+				continue;
+			uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+			++edgeTriangles[key];
+		}
+
+		glm::dvec3 p0 = vertices[indices[i]].Position, p1 = vertices[indices[i + 1]].Position, p2 = vertices[indices[i + 2]].Position;
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double length = glm::length(normal);
+		if (length <= 0.0)
+			continue;
+		normal /= length;
+		double area = length * 0.5;
+		for (int k = 0; k < 3; ++k)
+			positionQuadrics[c[k]].AddPlane(normal, -glm::dot(normal, p0), area);
+	}
+
+	std::vector<unsigned char> lockedPosition(vertexCount, 0);
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		if (copies[canonical[i]] > 1)
+			lockedPosition[canonical[i]] = 1;
+	}
+	for (const auto& edge : edgeTriangles)
+	{
+		if (edge.second != 2)
+		{
+			lockedPosition[(unsigned int)(edge.first >> 32)] = 1;
+			lockedPosition[(unsigned int)(edge.first & 0xFFFFFFFFu)] = 1;
+		}
+	}
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		m_Quadrics[i] = positionQuadrics[canonical[i]];
+		m_Locked[i] = lockedPosition[canonical[i]];
+	}
+}
+
+double QuadricSimplifier::CollapseCost(unsigned int from, unsigned int to) const
+{
+	Quadric merged = m_Quadrics[from];
+	merged.Add(m_Quadrics[to]);
+	if (merged.weight <= 0.0)
+		return 0.0;
+	return std::max(merged.Evaluate(m_Vertices[to].Position) / merged.weight, 0.0);
+}
+
+bool QuadricSimplifier::FoldsSurface(unsigned int from, unsigned int to, const std::vector<unsigned int>& offsets, const std::vector<unsigned int>& adjacency) const
+{
+	const glm::vec3& target = m_Vertices[to].Position;
+	for (unsigned int i = offsets[from]; i < offsets[from + 1]; ++i)
+	{
+		const unsigned int* triangle = &m_Indices[adjacency[i] * 3];
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+			continue; // degenerates and goes away
+
+		glm::vec3 before[3], after[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			before[k] = m_Vertices[triangle[k]].Position;
+			after[k] = triangle[k] == from ? target : before[k];
+		}
+		glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+		float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+		if (glm::dot(normalBefore, normalAfter) <= SIMPLIFY_MIN_NORMAL_COSINE * lengths)
+			return true;
+	}
+	return false;
+}
+
+void QuadricSimplifier::Simplify(unsigned int targetIndexCount)
+{
+	unsigned int vertexCount = (unsigned int)m_Vertices.size();
+	std::vector<unsigned int> offsets(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<unsigned char> touched(vertexCount);
+
+	// each pass collapses the cheapest edges that don't share a neighbourhood, then rebuilds
+	while (m_Indices.size() > targetIndexCount)
+	{
+		unsigned int triangleCount = (unsigned int)(m_Indices.size() / 3);
+
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (unsigned int index : m_Indices)
+			++offsets[index + 1];
+		for (unsigned int i = 0; i < vertexCount; ++i)
+			offsets[i + 1] += offsets[i];
+		adjacency.resize(m_Indices.size());
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (unsigned int t = 0; t < triangleCount; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+				adjacency[fill[m_Indices[t * 3 + k]]++] = t;
+		}
+
+		collapses.clear();
+		for (unsigned int t = 0; t < triangleCount; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				unsigned int a = m_Indices[t * 3 + k], b = m_Indices[t * 3 + (k + 1) % 3];
+				if (!m_Locked[a])
+					collapses.push_back({ a, b, CollapseCost(a, b) });
+				if (!m_Locked[b])
+					collapses.push_back({ b, a, CollapseCost(b, a) });
+			}
+		}
+		if (collapses.empty())
+			break;
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (unsigned int i = 0; i < vertexCount; ++i)
+			remap[i] = i;
+		std::fill(touched.begin(), touched.end(), 0);
+		unsigned int goal = (unsigned int)((m_Indices.size() - targetIndexCount + 2) / 3);
+		unsigned int removed = 0, performed = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (removed >= goal)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+			if (FoldsSurface(collapse.from, collapse.to, offsets, adjacency))
+				continue;
+
+			remap[collapse.from] = collapse.to;
+			m_Quadrics[collapse.to].Add(m_Quadrics[collapse.from]);
+			m_MaxCost = std::max(m_MaxCost, collapse.cost);
+			++performed;
+
+			// every triangle around the removed vertex changes, its other corners wait for the next pass
+			for (unsigned int i = offsets[collapse.from]; i < offsets[collapse.from + 1]; ++i)
+			{
+				const unsigned int* triangle = &m_Indices[adjacency[i] * 3];
+				bool degenerates = false;
+				for (int k = 0; k < 3; ++k)
+				{
+					touched[triangle[k]] = 1;
+					degenerates = degenerates || triangle[k] == collapse.to;
+				}
+				if (degenerates)
+					++removed;
+			}
+		}
+		if (performed == 0)
+			break;
+
+		size_t write = 0;
+		for (size_t i = 0; i < m_Indices.size(); i += 3)
+		{
+			unsigned int a = remap[m_Indices[i]], b = remap[m_Indices[i + 1]], c = remap[m_Indices[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			m_Indices[write++] = a;
+			m_Indices[write++] = b;
+			m_Indices[write++] = c;
+		}
+		m_Indices.resize(write);
+	}
+}
+
+MeshSimplifyResult SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int targetIndexCount)
+{
+	QuadricSimplifier simplifier(vertices, indices);
+	simplifier.Simplify(targetIndexCount);
+
+	MeshSimplifyResult result;
+	result.indices = simplifier.GetIndices();
+	result.error = simplifier.GetError();
+	return result;
+}
+
+std::vector<MeshLod> BuildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, unsigned int levelCount)
+{
+	std::vector<MeshLod> lods;
+	MeshLod full;
+	full.firstIndex = 0;
+	full.indexCount = (unsigned int)indices.size();
+	full.error = 0.0f;
+	lods.push_back(full);
+
+	QuadricSimplifier simplifier(vertices, indices);
+	unsigned int previous = full.indexCount;
+	for (unsigned int level = 1; level < levelCount; ++level)
+	{
+		simplifier.Simplify(previous / 6 * 3);
+		std::vector<unsigned int> simplified = simplifier.GetIndices();
+		if (simplified.empty() || simplified.size() > (size_t)previous * 3 / 4)
+			break;
+		OptimizeVertexCache(simplified, (unsigned int)vertices.size());
+
+		MeshLod lod;
+		lod.firstIndex = (unsigned int)indices.size();
+		lod.indexCount = (unsigned int)simplified.size();
+		lod.error = std::max(simplifier.GetError(), lods.back().error);
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		lods.push_back(lod);
+		previous = lod.indexCount;
+	}
+	return lods;
+}
@@ -155,6 +155,17 @@ void Shader::SetUniformMatrix4fv(const std::string &name, const glm::mat4 &mat)
 	glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
 
+void Shader::BindUniformBlock(const std::string& name, unsigned int binding)
+{
+	unsigned int index = glGetUniformBlockIndex(m_RendererID, name.c_str());
+	if (index == GL_INVALID_INDEX)
+	{
+		std::cout << "Warning: uniform block " << name << " doesn't exist!" << std::endl;
+		return;
+	}
+	glUniformBlockBinding(m_RendererID, index, binding);
+}
+
 int Shader::GetUniformLocation(const std::string& name)
 {
 	if (m_UniformLocationCache.find(name) != m_UniformLocationCache.end())
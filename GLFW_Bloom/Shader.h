@@ -34,6 +34,7 @@ public:
 	void SetUniform1f(const std::string &name, float value);
 	void SetUniform1i(const std::string &name, int value);
 	void SetUniformMatrix4fv(const std::string& name, const glm::mat4& mat);
+	void BindUniformBlock(const std::string& name, unsigned int binding);
 
 private:
 	int GetUniformLocation(const std::string& name);
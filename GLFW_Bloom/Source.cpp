@@ -7,7 +7,9 @@
 
 #include "Shader.h"
 #include "Camera.h"
+#include "Headless.h"
 #include "Model.h"
+#include "UniformBuffer.h"
 
 #include <GLM/glm.hpp>
 #include <GLM/gtc/matrix_transform.hpp>
@@ -15,8 +17,9 @@
 
 #include <iostream>
 
-const unsigned int SCR_WIDTH = 800;
-const unsigned int SCR_HEIGHT = 600;
+// window size, --width / --height replace it in headless mode
+unsigned int SCR_WIDTH = 800;
+unsigned int SCR_HEIGHT = 600;
 
 bool bloom = true;
 bool bloomKeyPressed = false;
@@ -28,7 +31,28 @@ float exposure = 1.0f;
 float intensity = 1.0f;
 float threshold = 1.0f;
 
+// Uniform blocks, laid out std140 to match the shaders
+const unsigned int CAMERA_BINDING = 0;
+const unsigned int LIGHTS_BINDING = 1;
+
+struct CameraUniforms
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 viewPos;
+};
+
+struct LightUniform
+{
+	glm::vec3 position;
+	float padding0;
+	glm::vec3 color;
+	float padding1;
+};
+static_assert(sizeof(LightUniform) == 32, "LightUniform must match the std140 Light struct");
+
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+Headless headless;
 float lastX = (float)SCR_WIDTH / 2.0;
 float lastY = (float)SCR_HEIGHT / 2.0;
 bool firstMouse = true;
@@ -49,8 +73,10 @@ void renderQuad();
 unsigned int quadVAO = 0, quadVBO;
 unsigned int cubeVAO = 0, cubeVBO;
 
-int main()
+int main(int argc, char** argv)
 {
+	headless.ParseArguments(argc, argv, SCR_WIDTH, SCR_HEIGHT);
+
 	GLFWwindow* window = InitWindow();
 	if (!window)
 		return -1;
@@ -60,7 +86,8 @@ int main()
 	Shader shaderBlur("res/shaders/Blur.shader");
 	Shader shaderFinal("res/shaders/BloomFinal.shader");
 
-	Model backpack("res/models/backpack/backpack.obj");
+	std::shared_ptr<Model> backpack = AssetRegistry::Get().AcquireModel("res/models/backpack/backpack.obj");
+	AssetRegistry::Get().PrintReport();
 
 	unsigned int boxTexture = loadTexture("res/textures/CrashBox.png", true);
 	unsigned int stoneTexture = loadTexture("res/textures/StoneWall.png", true);
@@ -146,6 +173,21 @@ int main()
 	lightColors.push_back(glm::vec3(0.0f, 0.0f, 15.0f));
 	lightColors.push_back(glm::vec3(0.0f, 5.0f, 0.0f));
 
+	UniformBuffer cameraUniforms(sizeof(CameraUniforms), CAMERA_BINDING);
+	shader.BindUniformBlock("Camera", CAMERA_BINDING);
+	shaderLight.BindUniformBlock("Camera", CAMERA_BINDING);
+
+	// the lights are static, so their block is written once up front
+	std::vector<LightUniform> lights(lightPositions.size());
+	for (unsigned int i = 0; i < lightPositions.size(); i++)
+	{
+		lights[i].position = lightPositions[i];
+		lights[i].color = lightColors[i];
+	}
+	UniformBuffer lightUniforms((unsigned int)(lights.size() * sizeof(LightUniform)), LIGHTS_BINDING);
+	lightUniforms.SetData(&lights[0], (unsigned int)(lights.size() * sizeof(LightUniform)));
+	shader.BindUniformBlock("Lights", LIGHTS_BINDING);
+
 	ImGui::CreateContext();
 	ImGui_ImplGlfwGL3_Init(window, true);
 	ImGui::StyleColorsDark();
@@ -155,11 +197,12 @@ int main()
 	// Game Loop
 	while (!glfwWindowShouldClose(window))
 	{
-		float currentFrame = glfwGetTime();
+		float currentFrame = headless.GetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		processInput(window);
+		headless.UpdateCamera(camera);
 
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -167,6 +210,7 @@ int main()
 		//ImGui_ImplGlfwGL3_NewFrame();
 
 		// 1 - Render scene into floating point framebuffer
+		headless.BeginPass("Scene");
 		glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -174,20 +218,16 @@ int main()
 		glm::mat4 view = camera.GetViewMatrix();
 		glm::mat4 model = glm::mat4(1.0f);
 
+		CameraUniforms cameraData;
+		cameraData.projection = projection;
+		cameraData.view = view;
+		cameraData.viewPos = glm::vec4(camera.Position, 1.0f);
+		cameraUniforms.SetData(&cameraData, sizeof(cameraData));
+
 		shader.Bind();
-		shader.SetUniformMatrix4fv("projection", projection);
-		shader.SetUniformMatrix4fv("view", view);
-		
 		shader.SetUniform1f("intensity", intensity);
 		shader.SetUniform1f("threshold", threshold);
 		shader.SetUniform1i("disco", disco);
-		shader.SetUniform3f("viewPos", camera.Position);
-
-		for (unsigned int i = 0; i < lightPositions.size(); i++)
-		{
-			shader.SetUniform3f("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-			shader.SetUniform3f("lights[" + std::to_string(i) + "].Color", lightColors[i]);
-		}
 
 		// Floor
 		glActiveTexture(GL_TEXTURE0);
@@ -241,12 +281,10 @@ int main()
 		model = glm::translate(model, glm::vec3(2.0f, 1.5f, -3.0f));
 		shader.SetUniformMatrix4fv("model", model);
 
-		backpack.Draw(shader);
+		backpack->Draw(shader);
 
 		// Light Cubes
 		shaderLight.Bind();
-		shaderLight.SetUniformMatrix4fv("projection", projection);
-		shaderLight.SetUniformMatrix4fv("view", view);
 		shaderLight.SetUniform1f("threshold", threshold);
 
 		glBindTexture(GL_TEXTURE_2D, 0);
@@ -261,8 +299,10 @@ int main()
 		}
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		headless.EndPass();
 
 		// 2 - Blur bright fragments with two-pass Gaussian blur
+		headless.BeginPass("Blur");
 		bool horizontal = true, first_iteration = true;
 		unsigned int amount = 10;
 		
@@ -278,8 +318,10 @@ int main()
 				first_iteration = false;
 		}
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		headless.EndPass();
 
 		// 3 - Render floating point color buffer to 2D quad and tonemap HDR colors
+		headless.BeginPass("Tonemap");
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		shaderFinal.Bind();
 		glActiveTexture(GL_TEXTURE0);
@@ -289,6 +331,7 @@ int main()
 		shaderFinal.SetUniform1i("bloom", bloom);
 		shaderFinal.SetUniform1f("exposure", exposure);
 		renderQuad();
+		headless.EndPass();
 
 		std::cout << "Bloom: " << (bloom ? "on" : "off") << " | Exposure: " << exposure << std::endl;
 
@@ -327,6 +370,7 @@ int main()
 				ImGui::Text("Shader Version: %s", glGetString(GL_SHADING_LANGUAGE_VERSION));
 				ImGui::Text("Hardware: %s", glGetString(GL_RENDERER));
 				ImGui::NewLine();
+				ImGui::Text("Model Load: %.1f ms, %s (geometry %.1f ms, textures %.1f ms)", backpack->loadStats.totalMs, backpack->loadStats.fromCache ? "mesh cache" : "Assimp import", backpack->loadStats.geometryMs, backpack->loadStats.textureMs);
 				ImGui::Text("Frametime: %.3f / Framerate: (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 			}
 
@@ -342,6 +386,8 @@ int main()
 		ImGui::Render();
 		ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());*/
 
+		headless.EndFrame(window);
+
 		glfwPollEvents();
 		glfwSwapBuffers(window);
 	}
@@ -359,6 +405,10 @@ int main()
 	glDeleteTextures(1, &colorBuffers[0]);
 	glDeleteTextures(1, &colorBuffers[1]);
 
+	// last handle, the registry frees the model's meshes and textures while the context is alive, then the arenas go
+	backpack.reset();
+	MeshArena::ReleaseAll();
+
 	ImGui_ImplGlfwGL3_Shutdown();
 	ImGui::DestroyContext();
 	glfwTerminate();
@@ -376,6 +426,7 @@ GLFWwindow* InitWindow()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	headless.ApplyWindowHints();
 
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Bloom / Blur Framebuffer", NULL, NULL);
 	if (window == NULL)
@@ -385,7 +436,7 @@ GLFWwindow* InitWindow()
 		return nullptr;
 	}
 	glfwMakeContextCurrent(window);
-	glfwSwapInterval(1);
+	glfwSwapInterval(headless.IsEnabled() ? 0 : 1);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetWindowPos(window, 100, 100);
 
@@ -0,0 +1,172 @@
+#include "TextureBatch.h"
+#include "ThreadPool.h"
+#include "stb_image.h"
+
+#include <iostream>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <sys/stat.h>
+
+TextureBatch::TextureBatch(unsigned int threadCount) : m_ThreadCount(threadCount)
+{
+}
+
+unsigned int TextureBatch::Add(const std::string& path, bool gammaCorrection, int priority)
+{
+	Request request;
+	request.path = path;
+	request.gammaCorrection = gammaCorrection;
+	request.priority = priority;
+	request.fileSize = 0;
+
+	struct stat info;
+	if (stat(path.c_str(), &info) == 0)
+		request.fileSize = (uint64_t)info.st_size;
+
+	glGenTextures(1, &request.textureID);
+	m_Requests.push_back(request);
+	return request.textureID;
+}
+
+void TextureBatch::Finish()
+{
+	if (m_Requests.empty())
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<unsigned int> order(m_Requests.size());
+	for (unsigned int i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b)
+	{
+		if (m_Requests[a].priority != m_Requests[b].priority)
+			return m_Requests[a].priority > m_Requests[b].priority;
+		return m_Requests[a].fileSize > m_Requests[b].fileSize;
+	});
+
+	std::vector<unsigned int> queries(m_Requests.size());
+	glGenQueries((GLsizei)queries.size(), queries.data());
+
+	// declared before the pool so the workers are joined before these go away
+	std::mutex mutex;
+	std::condition_variable decoded;
+	std::deque<Image> images;
+	float decodeMs = 0.0f;
+	{
+		ThreadPool pool(m_ThreadCount);
+		m_Stats.threads = pool.GetThreadCount();
+
+		for (unsigned int index : order)
+		{
+			pool.Enqueue([this, index, &mutex, &decoded, &images, &decodeMs]
+			{
+				auto decodeStart = std::chrono::high_resolution_clock::now();
+				Image image;
+				image.request = index;
+				image.data = stbi_load(m_Requests[index].path.c_str(), &image.width, &image.height, &image.channels, 0);
+				auto decodeEnd = std::chrono::high_resolution_clock::now();
+
+				std::lock_guard<std::mutex> lock(mutex);
+				images.push_back(image);
+				decodeMs += std::chrono::duration<float, std::milli>(decodeEnd - decodeStart).count();
+				decoded.notify_one();
+			});
+		}
+
+		// GL calls stay on this thread, it uploads whatever finished decoding first
+		for (size_t uploaded = 0; uploaded < m_Requests.size(); ++uploaded)
+		{
+			Image image;
+			{
+				auto waitStart = std::chrono::high_resolution_clock::now();
+				std::unique_lock<std::mutex> lock(mutex);
+				decoded.wait(lock, [&images] { return !images.empty(); });
+				image = images.front();
+				images.pop_front();
+				auto waitEnd = std::chrono::high_resolution_clock::now();
+				m_Stats.waitMs += std::chrono::duration<float, std::milli>(waitEnd - waitStart).count();
+			}
+			Upload(m_Requests[image.request], image, queries[image.request]);
+		}
+	}
+
+	for (unsigned int i = 0; i < queries.size(); ++i)
+	{
+		GLuint64 elapsed = 0;
+		if (glIsQuery(queries[i]))
+			glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+		m_Stats.mipMs += elapsed / 1000000.0f;
+	}
+	glDeleteQueries((GLsizei)queries.size(), queries.data());
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_Stats.decodeMs += decodeMs;
+	m_Stats.totalMs += std::chrono::duration<float, std::milli>(end - start).count();
+	m_Requests.clear();
+}
+
+void TextureBatch::Upload(const Request& request, const Image& image, unsigned int query)
+{
+	++m_Stats.textures;
+	if (!image.data)
+	{
+		std::cout << "Failed to load texture: " << request.path << std::endl;
+		++m_Stats.failed;
+		return;
+	}
+
+	GLenum internalFormat = GL_RGBA;
+	GLenum dataFormat = GL_RGBA;
+	if (image.channels == 1)
+		internalFormat = dataFormat = GL_RED;
+	else if (image.channels == 2)
+		internalFormat = dataFormat = GL_RG;
+	else if (image.channels == 3)
+	{
+		internalFormat = request.gammaCorrection ? GL_SRGB : GL_RGB;
+		dataFormat = GL_RGB;
+	}
+	else if (image.channels == 4)
+	{
+		internalFormat = request.gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
+		dataFormat = GL_RGBA;
+	}
+
+	auto uploadStart = std::chrono::high_resolution_clock::now();
+	glBindTexture(GL_TEXTURE_2D, request.textureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, dataFormat, GL_UNSIGNED_BYTE, image.data);
+	auto uploadEnd = std::chrono::high_resolution_clock::now();
+	m_Stats.uploadMs += std::chrono::duration<float, std::milli>(uploadEnd - uploadStart).count();
+
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glEndQuery(GL_TIME_ELAPSED);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (dataFormat == GL_RED)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+	}
+
+	m_Stats.bytes += (size_t)image.width * image.height * image.channels;
+	stbi_image_free(image.data);
+}
+
+void TextureBatch::PrintReport() const
+{
+	std::cout << "Textures: " << m_Stats.textures << " loaded (" << m_Stats.failed << " failed, " << m_Stats.bytes / (1024 * 1024) << " MB) in "
+		<< m_Stats.totalMs << " ms on " << m_Stats.threads << " threads" << std::endl;
+	std::cout << "  decode " << m_Stats.decodeMs << " ms (summed over threads), upload " << m_Stats.uploadMs
+		<< " ms, mips " << m_Stats.mipMs << " ms (GPU), waiting for decode " << m_Stats.waitMs << " ms" << std::endl;
+}
+
+const TextureBatchStats& TextureBatch::GetStats() const
+{
+	return m_Stats;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <GLAD/glad.h>
+
+// std140 uniform block storage bound to a fixed binding point. Every program
+// that links its block to the same point (Shader::BindUniformBlock) reads the
+// one buffer, so shared data is written once instead of per program.
+class UniformBuffer
+{
+private:
+	unsigned int m_UBO;
+	unsigned int m_Size;
+	unsigned int m_Binding;
+
+public:
+	UniformBuffer(unsigned int size, unsigned int binding);
+	~UniformBuffer();
+
+	void SetData(const void* data, unsigned int size, unsigned int offset = 0);
+
+	unsigned int GetID() const;
+	unsigned int GetBinding() const;
+};
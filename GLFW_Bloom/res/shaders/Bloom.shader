@@ -11,16 +11,24 @@ out VS_OUT
 	vec2 TexCoords;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
 uniform mat4 model;
+uniform bool quantized; // VERTEX_LAYOUT_QUANTIZED mesh, positions are unorm16 within its bounds
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
 void main()
 {
-	vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+	vec3 position = quantized ? positionOffset + aPos * positionScale : aPos;
+	vs_out.FragPos = vec3(model * vec4(position, 1.0));
 	vs_out.Normal = mat3(transpose(inverse(model))) * aNormal;
 	vs_out.TexCoords = aTexCoords;
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	gl_Position = projection * view * model * vec4(position, 1.0);
 };
 
 #shader fragment
@@ -35,6 +43,7 @@ in VS_OUT
 	vec2 TexCoords;
 } fs_in;
 
+// std140, mirrored by LightUniform in Source.cpp
 struct Light
 {
 	vec3 Position;
@@ -43,9 +52,18 @@ struct Light
 
 uniform sampler2D diffuseMap;
 uniform sampler2D specularMap;
-uniform vec3 viewPos;
 
-uniform Light lights[4];
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
+
+layout(std140) uniform Lights
+{
+	Light lights[4];
+};
 uniform float intensity;
 uniform float threshold;
 uniform bool disco;
@@ -0,0 +1,113 @@
+#include "GBuffer.h"
+
+#include <iostream>
+
+GBuffer::GBuffer(unsigned int width, unsigned int height, bool packed)
+	: m_FBO(0), m_Position(0), m_Normal(0), m_AlbedoSpec(0), m_Depth(0), m_Width(width), m_Height(height), m_Packed(packed)
+{
+	Create();
+}
+
+GBuffer::~GBuffer()
+{
+	Destroy();
+}
+
+void GBuffer::Resize(unsigned int width, unsigned int height, bool packed)
+{
+	if (width == m_Width && height == m_Height && packed == m_Packed)
+		return;
+
+	Destroy();
+	m_Width = width;
+	m_Height = height;
+	m_Packed = packed;
+	Create();
+}
+
+void GBuffer::BindTextures(unsigned int firstUnit) const
+{
+	unsigned int textures[4] = { m_Position, m_Normal, m_AlbedoSpec, m_Depth };
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+	}
+}
+
+unsigned int GBuffer::GetID() const
+{
+	return m_FBO;
+}
+
+unsigned int GBuffer::GetWidth() const
+{
+	return m_Width;
+}
+
+unsigned int GBuffer::GetHeight() const
+{
+	return m_Height;
+}
+
+bool GBuffer::IsPacked() const
+{
+	return m_Packed;
+}
+
+unsigned int GBuffer::GetBytesPerPixel() const
+{
+	// depth is 24 bits + 8 stencil in both layouts
+	return m_Packed ? 4 + 4 + 4 : 8 + 8 + 4 + 4;
+}
+
+void GBuffer::Create()
+{
+	glGenFramebuffers(1, &m_FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+
+	if (m_Packed)
+	{
+		m_Normal = CreateTarget(GL_RG16, GL_RG, GL_UNSIGNED_SHORT, GL_COLOR_ATTACHMENT1);
+	}
+	else
+	{
+		m_Position = CreateTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_COLOR_ATTACHMENT0);
+		m_Normal = CreateTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_COLOR_ATTACHMENT1);
+	}
+	m_AlbedoSpec = CreateTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT2);
+
+	// a texture rather than a renderbuffer so the packed layout can sample it
+	m_Depth = CreateTarget(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_DEPTH_STENCIL_ATTACHMENT);
+
+	GLenum attachments[3] = { m_Packed ? (GLenum)GL_NONE : GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glDrawBuffers(3, attachments);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "G-Buffer framebuffer not complete!" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::Destroy()
+{
+	glDeleteFramebuffers(1, &m_FBO);
+	glDeleteTextures(1, &m_Position);
+	glDeleteTextures(1, &m_Normal);
+	glDeleteTextures(1, &m_AlbedoSpec);
+	glDeleteTextures(1, &m_Depth);
+	m_FBO = m_Position = m_Normal = m_AlbedoSpec = m_Depth = 0;
+}
+
+unsigned int GBuffer::CreateTarget(GLenum internalFormat, GLenum format, GLenum type, GLenum attachment)
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_Width, m_Height, 0, format, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+	return texture;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <GLAD/glad.h>
+
+// Geometry buffer render targets in one of two layouts, both written by the
+// same geometry shader and read through res/shaders/GBuffer.glsl:
+//  - full:   RGBA16F position, RGBA16F normal, RGBA8 albedo/spec, depth (24 bytes per pixel)
+//  - packed: RG16 octahedral normal, RGBA8 albedo/spec, depth (12 bytes per pixel),
+//            position is rebuilt from depth with the inverse projection
+// Attachments keep their indices in both layouts, the packed one leaves
+// attachment 0 unset and draws nothing to it.
+class GBuffer
+{
+private:
+	unsigned int m_FBO;
+	unsigned int m_Position;
+	unsigned int m_Normal;
+	unsigned int m_AlbedoSpec;
+	unsigned int m_Depth;
+	unsigned int m_Width;
+	unsigned int m_Height;
+	bool m_Packed;
+
+public:
+	GBuffer(unsigned int width, unsigned int height, bool packed);
+	~GBuffer();
+
+	// Recreates the targets if the size or layout differs from the current one
+	void Resize(unsigned int width, unsigned int height, bool packed);
+	// Binds position, normal, albedo/spec and depth to four units starting at firstUnit
+	void BindTextures(unsigned int firstUnit) const;
+
+	unsigned int GetID() const;
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+	bool IsPacked() const;
+	unsigned int GetBytesPerPixel() const;
+
+private:
+	void Create();
+	void Destroy();
+	unsigned int CreateTarget(GLenum internalFormat, GLenum format, GLenum type, GLenum attachment);
+};
@@ -0,0 +1,68 @@
+#include "InstanceBuffer.h"
+
+#include <cstddef>
+
+InstanceBuffer::InstanceBuffer() : m_Capacity(0), m_Count(0)
+{
+	glGenBuffers(1, &m_VBO);
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	glDeleteBuffers(1, &m_VBO);
+}
+
+void InstanceBuffer::Upload(const std::vector<InstanceData>& instances)
+{
+	m_Count = (unsigned int)instances.size();
+	if (m_Count == 0)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+	if (m_Count > m_Capacity)
+	{
+		m_Capacity = m_Count;
+		glBufferData(GL_ARRAY_BUFFER, m_Capacity * sizeof(InstanceData), &instances[0], GL_DYNAMIC_DRAW);
+	}
+	else
+	{
+		// orphan the old storage so the upload doesn't wait on draws still reading it
+		glBufferData(GL_ARRAY_BUFFER, m_Capacity * sizeof(InstanceData), NULL, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, m_Count * sizeof(InstanceData), &instances[0]);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::Attach(unsigned int VAO, unsigned int firstLocation) const
+{
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		glEnableVertexAttribArray(firstLocation + i);
+		glVertexAttribPointer(firstLocation + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, model) + i * sizeof(glm::vec4)));
+		glVertexAttribDivisor(firstLocation + i, 1);
+	}
+
+	glEnableVertexAttribArray(firstLocation + 4);
+	glVertexAttribPointer(firstLocation + 4, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, params));
+	glVertexAttribDivisor(firstLocation + 4, 1);
+
+	glEnableVertexAttribArray(firstLocation + 5);
+	glVertexAttribPointer(firstLocation + 5, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, color));
+	glVertexAttribDivisor(firstLocation + 5, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+unsigned int InstanceBuffer::GetID() const
+{
+	return m_VBO;
+}
+
+unsigned int InstanceBuffer::GetCount() const
+{
+	return m_Count;
+}
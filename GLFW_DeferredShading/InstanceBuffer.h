@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GLAD/glad.h>
+#include <GLM/glm.hpp>
+#include <vector>
+
+// Per-instance vertex data, advanced once per instance (divisor 1)
+struct InstanceData
+{
+	glm::mat4 model = glm::mat4(1.0f);
+	glm::vec4 params = glm::vec4(0.0f); // material scalars, e.g. metallic and roughness
+	glm::vec4 color = glm::vec4(1.0f);
+};
+
+// model takes four attribute locations, params and color one each
+const unsigned int INSTANCE_ATTRIBUTE_COUNT = 6;
+
+// Vertex buffer of InstanceData for glDraw*Instanced. Attach it to a VAO at a
+// location range the mesh's own attributes don't use; the VAO remembers the
+// binding so it only has to be attached once.
+class InstanceBuffer
+{
+private:
+	unsigned int m_VBO;
+	unsigned int m_Capacity;
+	unsigned int m_Count;
+
+public:
+	InstanceBuffer();
+	~InstanceBuffer();
+
+	void Upload(const std::vector<InstanceData>& instances);
+	void Attach(unsigned int VAO, unsigned int firstLocation) const;
+
+	unsigned int GetID() const;
+	unsigned int GetCount() const;
+};
@@ -0,0 +1,248 @@
+#include "LightClusters.h"
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <emmintrin.h>
+
+const unsigned int LightClusters::TILES_X;
+const unsigned int LightClusters::TILES_Y;
+const unsigned int LightClusters::SLICES;
+const unsigned int LightClusters::CLUSTER_COUNT;
+const unsigned int LightClusters::MAX_LIGHTS_PER_CLUSTER;
+
+static_assert(LightClusters::TILES_X % 4 == 0, "tiles are tested four at a time along a row");
+
+static void CreateBufferTexture(GLenum format, unsigned int& buffer, unsigned int& texture)
+{
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+static void UploadBuffer(unsigned int buffer, const void* data, size_t size)
+{
+	// orphan the old storage so the upload doesn't wait on last frame's lighting pass
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+LightClusters::LightClusters(float zNear, float zFar) : m_Near(zNear), m_Far(zFar), m_Projection(0.0f), m_LightCount(0)
+{
+	m_MinX.resize(CLUSTER_COUNT); m_MinY.resize(CLUSTER_COUNT); m_MinZ.resize(CLUSTER_COUNT);
+	m_MaxX.resize(CLUSTER_COUNT); m_MaxY.resize(CLUSTER_COUNT); m_MaxZ.resize(CLUSTER_COUNT);
+	m_Counts.resize(CLUSTER_COUNT);
+	m_Bins.resize(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER);
+	m_Grid.resize(CLUSTER_COUNT * 2);
+
+	CreateBufferTexture(GL_RGBA32F, m_LightBuffer, m_LightTexture);
+	CreateBufferTexture(GL_RG32UI, m_GridBuffer, m_GridTexture);
+	CreateBufferTexture(GL_R16UI, m_IndexBuffer, m_IndexTexture);
+}
+
+LightClusters::~LightClusters()
+{
+	glDeleteTextures(1, &m_LightTexture);
+	glDeleteTextures(1, &m_GridTexture);
+	glDeleteTextures(1, &m_IndexTexture);
+	glDeleteBuffers(1, &m_LightBuffer);
+	glDeleteBuffers(1, &m_GridBuffer);
+	glDeleteBuffers(1, &m_IndexBuffer);
+}
+
+void LightClusters::SetLights(const std::vector<LightData>& lights)
+{
+	if (lights.size() > 0xFFFF)
+		std::cout << "LightClusters: only the first 65535 of " << lights.size() << " lights can be indexed" << std::endl;
+
+	m_LightCount = (unsigned int)std::min(lights.size(), (size_t)0xFFFF);
+	if (m_LightCount > 0)
+		UploadBuffer(m_LightBuffer, &lights[0], m_LightCount * sizeof(LightData));
+}
+
+void LightClusters::Build(const glm::mat4& projection, const glm::mat4& view, const std::vector<LightData>& lights)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (projection != m_Projection)
+		BuildClusterBounds(projection);
+
+	std::fill(m_Counts.begin(), m_Counts.end(), 0);
+	unsigned int count = std::min(m_LightCount, (unsigned int)lights.size());
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		if (lights[i].radius > 0.0f)
+			BinLight((unsigned short)i, glm::vec3(view * glm::vec4(lights[i].position, 1.0f)), lights[i].radius);
+	}
+
+	// flatten the fixed size bins into one list
+	m_Stats = ClusterStats();
+	m_Indices.clear();
+	for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; ++cluster)
+	{
+		unsigned int binned = std::min(m_Counts[cluster], MAX_LIGHTS_PER_CLUSTER);
+		m_Grid[cluster * 2 + 0] = (unsigned int)m_Indices.size();
+		m_Grid[cluster * 2 + 1] = binned;
+		m_Indices.insert(m_Indices.end(), m_Bins.begin() + cluster * MAX_LIGHTS_PER_CLUSTER, m_Bins.begin() + cluster * MAX_LIGHTS_PER_CLUSTER + binned);
+
+		m_Stats.activeClusters += (binned > 0 ? 1 : 0);
+		m_Stats.maxLightsPerCluster = std::max(m_Stats.maxLightsPerCluster, m_Counts[cluster]);
+		m_Stats.overflow += m_Counts[cluster] - binned;
+	}
+	m_Stats.lightIndices = (unsigned int)m_Indices.size();
+	if (m_Indices.empty())
+		m_Indices.push_back(0);
+
+	m_Stats.binMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	UploadBuffer(m_GridBuffer, &m_Grid[0], m_Grid.size() * sizeof(unsigned int));
+	UploadBuffer(m_IndexBuffer, &m_Indices[0], m_Indices.size() * sizeof(unsigned short));
+	m_Stats.buildMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusters::Bind(unsigned int firstUnit) const
+{
+	glActiveTexture(GL_TEXTURE0 + firstUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, m_LightTexture);
+	glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+	glBindTexture(GL_TEXTURE_BUFFER, m_GridTexture);
+	glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+	glBindTexture(GL_TEXTURE_BUFFER, m_IndexTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+float LightClusters::GetNear() const
+{
+	return m_Near;
+}
+
+float LightClusters::GetFar() const
+{
+	return m_Far;
+}
+
+unsigned int LightClusters::GetLightCount() const
+{
+	return m_LightCount;
+}
+
+const ClusterStats& LightClusters::GetStats() const
+{
+	return m_Stats;
+}
+
+void LightClusters::BuildClusterBounds(const glm::mat4& projection)
+{
+	m_Projection = projection;
+
+	// a view-space point at distance d maps to ndc.x = x * p00 / d, so tile edges scale with depth
+	float p00 = projection[0][0];
+	float p11 = projection[1][1];
+	for (unsigned int s = 0; s < SLICES; ++s)
+	{
+		float d0 = m_Near * std::pow(m_Far / m_Near, (float)s / SLICES);
+		float d1 = m_Near * std::pow(m_Far / m_Near, (float)(s + 1) / SLICES);
+		for (unsigned int y = 0; y < TILES_Y; ++y)
+		{
+			float ndcY0 = (float)y / TILES_Y * 2.0f - 1.0f;
+			float ndcY1 = (float)(y + 1) / TILES_Y * 2.0f - 1.0f;
+			for (unsigned int x = 0; x < TILES_X; ++x)
+			{
+				float ndcX0 = (float)x / TILES_X * 2.0f - 1.0f;
+				float ndcX1 = (float)(x + 1) / TILES_X * 2.0f - 1.0f;
+
+				unsigned int cluster = (s * TILES_Y + y) * TILES_X + x;
+				m_MinX[cluster] = std::min(ndcX0 * d0, ndcX0 * d1) / p00;
+				m_MaxX[cluster] = std::max(ndcX1 * d0, ndcX1 * d1) / p00;
+				m_MinY[cluster] = std::min(ndcY0 * d0, ndcY0 * d1) / p11;
+				m_MaxY[cluster] = std::max(ndcY1 * d0, ndcY1 * d1) / p11;
+				m_MinZ[cluster] = -d1;
+				m_MaxZ[cluster] = -d0;
+			}
+		}
+	}
+}
+
+void LightClusters::BinLight(unsigned short index, const glm::vec3& position, float radius)
+{
+	float depth = -position.z;
+	if (depth + radius < m_Near || depth - radius > m_Far)
+		return;
+
+	int s0 = DepthToSlice(depth - radius);
+	int s1 = DepthToSlice(depth + radius);
+	int x0 = 0, x1 = TILES_X - 1;
+	int y0 = 0, y1 = TILES_Y - 1;
+
+	// narrow the tiles to the projected bounds of the sphere's box, unless it crosses the near plane
+	float nearDepth = depth - radius;
+	float farDepth = depth + radius;
+	if (nearDepth > m_Near)
+	{
+		float minX = std::min((position.x - radius) / nearDepth, (position.x - radius) / farDepth) * m_Projection[0][0];
+		float maxX = std::max((position.x + radius) / nearDepth, (position.x + radius) / farDepth) * m_Projection[0][0];
+		float minY = std::min((position.y - radius) / nearDepth, (position.y - radius) / farDepth) * m_Projection[1][1];
+		float maxY = std::max((position.y + radius) / nearDepth, (position.y + radius) / farDepth) * m_Projection[1][1];
+		if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+			return;
+
+		x0 = std::max(0, (int)std::floor((minX * 0.5f + 0.5f) * TILES_X));
+		x1 = std::min((int)TILES_X - 1, (int)std::floor((maxX * 0.5f + 0.5f) * TILES_X));
+		y0 = std::max(0, (int)std::floor((minY * 0.5f + 0.5f) * TILES_Y));
+		y1 = std::min((int)TILES_Y - 1, (int)std::floor((maxY * 0.5f + 0.5f) * TILES_Y));
+	}
+	x0 &= ~3;
+
+	// sphere against four cluster boxes at once, the squared distance to each box must be within r^2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 px = _mm_set1_ps(position.x);
+	const __m128 py = _mm_set1_ps(position.y);
+	const __m128 pz = _mm_set1_ps(position.z);
+	const __m128 r2 = _mm_set1_ps(radius * radius);
+	for (int s = s0; s <= s1; ++s)
+	{
+		for (int y = y0; y <= y1; ++y)
+		{
+			unsigned int row = (s * TILES_Y + y) * TILES_X;
+			for (int x = x0; x <= x1; x += 4)
+			{
+				unsigned int first = row + x;
+				__m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_MinX[first]), px), zero), _mm_max_ps(_mm_sub_ps(px, _mm_loadu_ps(&m_MaxX[first])), zero));
+				__m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_MinY[first]), py), zero), _mm_max_ps(_mm_sub_ps(py, _mm_loadu_ps(&m_MaxY[first])), zero));
+				__m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_MinZ[first]), pz), zero), _mm_max_ps(_mm_sub_ps(pz, _mm_loadu_ps(&m_MaxZ[first])), zero));
+				__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+				int hits = _mm_movemask_ps(_mm_cmple_ps(d2, r2));
+				for (unsigned int lane = 0; hits; ++lane, hits >>= 1)
+				{
+					if (!(hits & 1))
+						continue;
+
+					unsigned int cluster = first + lane;
+					unsigned int& count = m_Counts[cluster];
+					if (count < MAX_LIGHTS_PER_CLUSTER)
+						m_Bins[cluster * MAX_LIGHTS_PER_CLUSTER + count] = index;
+					++count;
+				}
+			}
+		}
+	}
+}
+
+int LightClusters::DepthToSlice(float depth) const
+{
+	// exponential slices, each one covers the same depth ratio
+	if (depth <= m_Near)
+		return 0;
+	int slice = (int)std::floor(std::log(depth / m_Near) / std::log(m_Far / m_Near) * SLICES);
+	return std::min(std::max(slice, 0), (int)SLICES - 1);
+}
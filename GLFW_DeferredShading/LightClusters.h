@@ -0,0 +1,87 @@
+#pragma once
+
+#include <GLAD/glad.h>
+#include <GLM/glm.hpp>
+#include <vector>
+
+// Point light as stored in the light buffer texture, three RGBA32F texels per
+// light. Matches the Light struct and fetchLight() in DeferredShading.shader.
+struct LightData
+{
+	glm::vec3 position = glm::vec3(0.0f);
+	float linear = 0.0f;
+	glm::vec3 color = glm::vec3(0.0f);
+	float quadratic = 0.0f;
+	float radius = 0.0f;
+	float padding[3] = { 0.0f, 0.0f, 0.0f };
+};
+static_assert(sizeof(LightData) == 3 * sizeof(glm::vec4), "LightData must be three vec4 texels");
+
+struct ClusterStats
+{
+	float binMs = 0.0f;
+	float buildMs = 0.0f; // binning and the buffer uploads
+	unsigned int lightIndices = 0;
+	unsigned int activeClusters = 0;
+	unsigned int maxLightsPerCluster = 0;
+	unsigned int overflow = 0;
+};
+
+// Clustered light culling. The view frustum is split into TILES_X * TILES_Y
+// screen tiles and SLICES exponential depth slices; every frame the lights are
+// binned into the clusters their sphere touches on the CPU (four clusters per
+// SSE test) and the result is uploaded as buffer textures:
+//  - lights:   LightData for every light
+//  - grid:     (offset, count) into the index list per cluster
+//  - indices:  light indices, grouped by cluster
+class LightClusters
+{
+public:
+	static const unsigned int TILES_X = 16;
+	static const unsigned int TILES_Y = 9;
+	static const unsigned int SLICES = 24;
+	static const unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+	static const unsigned int MAX_LIGHTS_PER_CLUSTER = 256;
+
+private:
+	float m_Near;
+	float m_Far;
+	glm::mat4 m_Projection;
+
+	// view-space cluster bounds, structure of arrays so four neighbouring tiles load at once
+	std::vector<float> m_MinX, m_MinY, m_MinZ;
+	std::vector<float> m_MaxX, m_MaxY, m_MaxZ;
+
+	std::vector<unsigned int> m_Counts;
+	std::vector<unsigned short> m_Bins; // MAX_LIGHTS_PER_CLUSTER slots per cluster
+	std::vector<unsigned int> m_Grid;
+	std::vector<unsigned short> m_Indices;
+
+	unsigned int m_LightBuffer, m_LightTexture;
+	unsigned int m_GridBuffer, m_GridTexture;
+	unsigned int m_IndexBuffer, m_IndexTexture;
+	unsigned int m_LightCount;
+
+	ClusterStats m_Stats;
+
+public:
+	LightClusters(float zNear, float zFar);
+	~LightClusters();
+
+	// Uploads the light data, only needed when lights are added, moved or changed
+	void SetLights(const std::vector<LightData>& lights);
+	// Bins the lights set last for this camera and uploads the cluster lists
+	void Build(const glm::mat4& projection, const glm::mat4& view, const std::vector<LightData>& lights);
+	// Binds lights, grid and indices to three texture units starting at firstUnit
+	void Bind(unsigned int firstUnit) const;
+
+	float GetNear() const;
+	float GetFar() const;
+	unsigned int GetLightCount() const;
+	const ClusterStats& GetStats() const;
+
+private:
+	void BuildClusterBounds(const glm::mat4& projection);
+	void BinLight(unsigned short index, const glm::vec3& position, float radius);
+	int DepthToSlice(float depth) const;
+};
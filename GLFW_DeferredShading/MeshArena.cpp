@@ -0,0 +1,226 @@
+#include "MeshArena.h"
+#include "Mesh.h"
+
+#include <GLAD/glad.h>
+#include <memory>
+#include <algorithm>
+
+// room for a few typical meshes before the first grow
+static const unsigned int INITIAL_VERTICES = 1 << 16;
+static const unsigned int INITIAL_INDICES = 1 << 18;
+
+static std::vector<std::unique_ptr<MeshArena>>& GetArenas()
+{
+	static std::vector<std::unique_ptr<MeshArena>> arenas;
+	return arenas;
+}
+
+MeshArena::MeshArena(VertexLayout layout, bool halfTexCoords, unsigned int indexType)
+	: m_Layout(layout), m_HalfTexCoords(halfTexCoords), m_IndexType(indexType), m_VBO(0), m_EBO(0), m_InstanceVBO(0), m_VertexCapacity(0), m_IndexCapacity(0),
+	m_Allocations(0), m_UsedVertices(0), m_UsedIndices(0), m_Grows(0)
+{
+	glGenVertexArrays(1, &m_VAO);
+}
+
+MeshArena::~MeshArena()
+{
+	glDeleteVertexArrays(1, &m_VAO);
+	glDeleteBuffers(1, &m_VBO);
+	glDeleteBuffers(1, &m_EBO);
+}
+
+MeshArena& MeshArena::Get(VertexLayout layout, bool halfTexCoords, unsigned int indexType)
+{
+	// only float meshes ignore the texture coordinate format
+	if (layout != VERTEX_LAYOUT_QUANTIZED)
+		halfTexCoords = false;
+
+	std::vector<std::unique_ptr<MeshArena>>& arenas = GetArenas();
+	for (const std::unique_ptr<MeshArena>& arena : arenas)
+	{
+		if (arena->m_Layout == layout && arena->m_HalfTexCoords == halfTexCoords && arena->m_IndexType == indexType)
+			return *arena;
+	}
+	arenas.push_back(std::unique_ptr<MeshArena>(new MeshArena(layout, halfTexCoords, indexType)));
+	return *arenas.back();
+}
+
+void MeshArena::ReleaseAll()
+{
+	GetArenas().clear();
+}
+
+MeshArenaStats MeshArena::GetStats()
+{
+	MeshArenaStats stats;
+	for (const std::unique_ptr<MeshArena>& arena : GetArenas())
+	{
+		unsigned int stride = GetVertexStride(arena->m_Layout);
+		++stats.arenas;
+		stats.allocations += arena->m_Allocations;
+		stats.usedBytes += arena->m_UsedVertices * stride + arena->m_UsedIndices * arena->GetIndexSize();
+		stats.capacityBytes += (size_t)arena->m_VertexCapacity * stride + (size_t)arena->m_IndexCapacity * arena->GetIndexSize();
+		stats.grows += arena->m_Grows;
+	}
+	return stats;
+}
+
+bool MeshArena::SupportsMultiDrawIndirect()
+{
+	return GLAD_GL_VERSION_4_3 != 0;
+}
+
+MeshAllocation MeshArena::Allocate(const void* vertexData, unsigned int vertexCount, const void* indexData, unsigned int indexCount)
+{
+	MeshAllocation allocation;
+	if (vertexCount == 0 || indexCount == 0)
+		return allocation;
+
+	unsigned int baseVertex = 0, firstIndex = 0;
+	bool verticesFit = TakeRange(m_FreeVertices, vertexCount, baseVertex);
+	bool indicesFit = TakeRange(m_FreeIndices, indexCount, firstIndex);
+	if (!verticesFit || !indicesFit)
+	{
+		// growing appends one range to the end that is always large enough
+		Grow(verticesFit ? 0 : vertexCount, indicesFit ? 0 : indexCount);
+		if (!verticesFit)
+			TakeRange(m_FreeVertices, vertexCount, baseVertex);
+		if (!indicesFit)
+			TakeRange(m_FreeIndices, indexCount, firstIndex);
+	}
+
+	unsigned int stride = GetVertexStride(m_Layout);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_VBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)baseVertex * stride, (GLsizeiptr)vertexCount * stride, vertexData);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_EBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * GetIndexSize(), (GLsizeiptr)indexCount * GetIndexSize(), indexData);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	allocation.baseVertex = baseVertex;
+	allocation.vertexCount = vertexCount;
+	allocation.firstIndex = firstIndex;
+	allocation.indexCount = indexCount;
+	++m_Allocations;
+	m_UsedVertices += vertexCount;
+	m_UsedIndices += indexCount;
+	return allocation;
+}
+
+void MeshArena::Free(const MeshAllocation& allocation)
+{
+	if (allocation.vertexCount == 0)
+		return;
+	ReturnRange(m_FreeVertices, allocation.baseVertex, allocation.vertexCount);
+	ReturnRange(m_FreeIndices, allocation.firstIndex, allocation.indexCount);
+	--m_Allocations;
+	m_UsedVertices -= allocation.vertexCount;
+	m_UsedIndices -= allocation.indexCount;
+}
+
+void MeshArena::AttachInstances(const InstanceBuffer& instances)
+{
+	if (m_InstanceVBO == instances.GetID())
+		return;
+	instances.Attach(m_VAO, MESH_INSTANCE_LOCATION);
+	m_InstanceVBO = instances.GetID();
+}
+
+unsigned int MeshArena::GetVAO() const
+{
+	return m_VAO;
+}
+
+unsigned int MeshArena::GetIndexType() const
+{
+	return m_IndexType;
+}
+
+unsigned int MeshArena::GetIndexSize() const
+{
+	return m_IndexType == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+static unsigned int GrowBuffer(unsigned int buffer, size_t usedBytes, size_t newBytes)
+{
+	unsigned int grown;
+	glGenBuffers(1, &grown);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+	glBufferData(GL_COPY_WRITE_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+	if (usedBytes > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &buffer);
+	return grown;
+}
+
+void MeshArena::Grow(unsigned int vertexCount, unsigned int indexCount)
+{
+	// a count of zero leaves that buffer as it is
+	if (vertexCount > 0)
+	{
+		unsigned int stride = GetVertexStride(m_Layout);
+		unsigned int capacity = std::max(m_VertexCapacity ? m_VertexCapacity * 2 : INITIAL_VERTICES, m_VertexCapacity + vertexCount);
+		m_VBO = GrowBuffer(m_VBO, (size_t)m_VertexCapacity * stride, (size_t)capacity * stride);
+		ReturnRange(m_FreeVertices, m_VertexCapacity, capacity - m_VertexCapacity);
+		m_VertexCapacity = capacity;
+	}
+	if (indexCount > 0)
+	{
+		unsigned int capacity = std::max(m_IndexCapacity ? m_IndexCapacity * 2 : INITIAL_INDICES, m_IndexCapacity + indexCount);
+		m_EBO = GrowBuffer(m_EBO, (size_t)m_IndexCapacity * GetIndexSize(), (size_t)capacity * GetIndexSize());
+		ReturnRange(m_FreeIndices, m_IndexCapacity, capacity - m_IndexCapacity);
+		m_IndexCapacity = capacity;
+	}
+	++m_Grows;
+
+	// only the buffer bindings change, attributes set on the VAO by others (instance data) stay
+	glBindVertexArray(m_VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+	SetVertexAttributes(m_Layout, m_HalfTexCoords);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool MeshArena::TakeRange(std::vector<Range>& ranges, unsigned int count, unsigned int& first)
+{
+	for (size_t i = 0; i < ranges.size(); ++i)
+	{
+		if (ranges[i].count < count)
+			continue;
+		first = ranges[i].first;
+		ranges[i].first += count;
+		ranges[i].count -= count;
+		if (ranges[i].count == 0)
+			ranges.erase(ranges.begin() + i);
+		return true;
+	}
+	return false;
+}
+
+void MeshArena::ReturnRange(std::vector<Range>& ranges, unsigned int first, unsigned int count)
+{
+	auto next = std::lower_bound(ranges.begin(), ranges.end(), first, [](const Range& range, unsigned int value) { return range.first < value; });
+	auto inserted = ranges.insert(next, Range{ first, count });
+
+	// merge with the range after, then the one before
+	auto after = inserted + 1;
+	if (after != ranges.end() && inserted->first + inserted->count == after->first)
+	{
+		inserted->count += after->count;
+		ranges.erase(after);
+	}
+	if (inserted != ranges.begin())
+	{
+		auto before = inserted - 1;
+		if (before->first + before->count == inserted->first)
+		{
+			before->count += inserted->count;
+			ranges.erase(inserted);
+		}
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "VertexFormat.h"
+#include <vector>
+#include <cstddef>
+
+class InstanceBuffer;
+
+// One glMultiDrawElementsIndirect record, laid out as GL 4.3 reads it
+struct DrawElementsIndirectCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int baseInstance;
+};
+
+// Where a mesh lives in its arena, counted in vertices and indices rather than bytes
+struct MeshAllocation
+{
+	unsigned int baseVertex = 0;
+	unsigned int vertexCount = 0;
+	unsigned int firstIndex = 0;
+	unsigned int indexCount = 0;
+};
+
+struct MeshArenaStats
+{
+	unsigned int arenas = 0;
+	unsigned int allocations = 0;
+	size_t usedBytes = 0;     // vertices and indices of live meshes
+	size_t capacityBytes = 0; // buffer storage, free ranges and headroom included
+	unsigned int grows = 0;
+};
+
+// A megabuffer: one vertex buffer, one index buffer and one VAO that every mesh
+// of the same vertex format and index type is suballocated from, so meshes draw
+// back to back without rebinding and can be batched into a single
+// glMultiDrawElementsIndirect. Freed ranges are reused first fit and merged with
+// their neighbours; when nothing fits, the buffers double and the old contents
+// are copied on the GPU, so allocations never move. Call ReleaseAll after the
+// last mesh is released and before the context goes.
+class MeshArena
+{
+private:
+	struct Range
+	{
+		unsigned int first;
+		unsigned int count;
+	};
+
+	VertexLayout m_Layout;
+	bool m_HalfTexCoords;
+	unsigned int m_IndexType;
+	unsigned int m_VAO, m_VBO, m_EBO;
+	unsigned int m_InstanceVBO; // instance buffer the VAO's instance attributes read, 0 before the first
+	unsigned int m_VertexCapacity;
+	unsigned int m_IndexCapacity;
+	std::vector<Range> m_FreeVertices; // sorted by first, never adjacent
+	std::vector<Range> m_FreeIndices;
+	unsigned int m_Allocations;
+	size_t m_UsedVertices;
+	size_t m_UsedIndices;
+	unsigned int m_Grows;
+
+	MeshArena(VertexLayout layout, bool halfTexCoords, unsigned int indexType);
+
+public:
+	~MeshArena();
+
+	MeshArena(const MeshArena&) = delete;
+	MeshArena& operator=(const MeshArena&) = delete;
+
+	// The arena for a format, created on first use; indexType is GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	static MeshArena& Get(VertexLayout layout, bool halfTexCoords, unsigned int indexType);
+	static void ReleaseAll();
+	static MeshArenaStats GetStats();
+	// GL 4.3 context; without it batches fall back to one glDrawElementsBaseVertex per mesh
+	static bool SupportsMultiDrawIndirect();
+
+	// Vertices in the arena's GPU layout and indices of its index type, relative to the mesh
+	MeshAllocation Allocate(const void* vertexData, unsigned int vertexCount, const void* indexData, unsigned int indexCount);
+	void Free(const MeshAllocation& allocation);
+	// Every mesh of every model in the arena shares its VAO, so the instance
+	// attributes are only pointed at a buffer when a different one was attached
+	void AttachInstances(const InstanceBuffer& instances);
+
+	unsigned int GetVAO() const;
+	unsigned int GetIndexType() const;
+	unsigned int GetIndexSize() const;
+
+private:
+	void Grow(unsigned int vertexCount, unsigned int indexCount);
+	static bool TakeRange(std::vector<Range>& ranges, unsigned int count, unsigned int& first);
+	static void ReturnRange(std::vector<Range>& ranges, unsigned int first, unsigned int count);
+};
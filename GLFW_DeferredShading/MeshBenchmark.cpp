@@ -0,0 +1,197 @@
+#include "MeshBenchmark.h"
+#include "MeshOptimizer.h"
+#include "Model.h"
+
+#include <GLAD/glad.h>
+#include <GLM/glm.hpp>
+#include <iostream>
+#include <cstring>
+
+static const int BENCHMARK_DRAWS = 50;
+static const int BENCHMARK_TARGET_SIZE = 512;
+
+// GPU copy of one mesh in one index order
+struct BenchmarkMesh
+{
+	unsigned int VAO, VBO, EBO;
+	unsigned int indexCount;
+	unsigned int indexType;
+};
+
+static bool SupportsPipelineStatistics()
+{
+	if (GLAD_GL_VERSION_4_6)
+		return true;
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && std::strcmp(extension, "GL_ARB_pipeline_statistics_query") == 0)
+			return true;
+	}
+	return false;
+}
+
+// Same layout and index width rule as Mesh::SetUpMesh, only the position is read
+static BenchmarkMesh Upload(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t& indexBytes)
+{
+	BenchmarkMesh mesh;
+	mesh.indexCount = (unsigned int)indices.size();
+	glGenVertexArrays(1, &mesh.VAO);
+	glGenBuffers(1, &mesh.VBO);
+	glGenBuffers(1, &mesh.EBO);
+
+	glBindVertexArray(mesh.VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+	if (vertices.size() <= 65536)
+	{
+		std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+		mesh.indexType = GL_UNSIGNED_SHORT;
+		indexBytes += shortIndices.size() * sizeof(unsigned short);
+	}
+	else
+	{
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+		mesh.indexType = GL_UNSIGNED_INT;
+		indexBytes += indices.size() * sizeof(unsigned int);
+	}
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	glBindVertexArray(0);
+	return mesh;
+}
+
+static void DrawAll(const std::vector<BenchmarkMesh>& meshes)
+{
+	for (const BenchmarkMesh& mesh : meshes)
+	{
+		glBindVertexArray(mesh.VAO);
+		glDrawElements(GL_TRIANGLES, mesh.indexCount, mesh.indexType, 0);
+	}
+	glBindVertexArray(0);
+}
+
+std::vector<VertexBenchmarkResult> RunVertexBenchmark(const std::string& path, Shader& shader)
+{
+	std::vector<VertexBenchmarkResult> results;
+
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_CalcTangentSpace);
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	{
+		std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+		return results;
+	}
+
+	bool pipelineStatistics = SupportsPipelineStatistics();
+	unsigned int queries[3];
+	glGenQueries(3, queries);
+
+	// the benchmark runs from the middle of a frame, so it draws off screen and puts the frame's target back
+	GLint previousFramebuffer = 0;
+	GLint previousViewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+	unsigned int fbo, color, depth;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, BENCHMARK_TARGET_SIZE, BENCHMARK_TARGET_SIZE);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, BENCHMARK_TARGET_SIZE, BENCHMARK_TARGET_SIZE);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glViewport(0, 0, BENCHMARK_TARGET_SIZE, BENCHMARK_TARGET_SIZE);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	shader.Bind();
+	shader.SetUniform1i("instanced", 0);
+	shader.SetUniformMatrix4fv("model", glm::mat4(1.0f));
+
+	const char* orders[] = { "Assimp order", "Vertex cache", "Full optimizer" };
+	for (unsigned int order = 0; order < 3; ++order)
+	{
+		VertexBenchmarkResult result;
+		result.order = orders[order];
+
+		std::vector<BenchmarkMesh> meshes;
+		float weightedAcmr = 0.0f;
+		size_t triangles = 0;
+		for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+		{
+			std::vector<Vertex> vertices;
+			std::vector<unsigned int> indices;
+			Model::ReadGeometry(scene->mMeshes[i], vertices, indices);
+			if (order == 1)
+			{
+				WeldVertices(vertices, indices);
+				OptimizeVertexCache(indices, (unsigned int)vertices.size());
+			}
+			else if (order == 2)
+				OptimizeMesh(vertices, indices);
+
+			VertexCacheStats stats = AnalyzeVertexCache(indices.data(), indices.size(), (unsigned int)vertices.size());
+			weightedAcmr += stats.acmr * (indices.size() / 3);
+			triangles += indices.size() / 3;
+			result.vertices += (unsigned int)vertices.size();
+			meshes.push_back(Upload(vertices, indices, result.indexBytes));
+		}
+		result.acmr = triangles ? weightedAcmr / triangles : 0.0f;
+
+		// one untimed draw so buffer uploads are not counted
+		DrawAll(meshes);
+
+		if (pipelineStatistics)
+		{
+			glBeginQuery(GL_VERTICES_SUBMITTED, queries[0]);
+			glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS, queries[1]);
+			DrawAll(meshes);
+			glEndQuery(GL_VERTEX_SHADER_INVOCATIONS);
+			glEndQuery(GL_VERTICES_SUBMITTED);
+			glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &result.verticesSubmitted);
+			glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &result.shaderInvocations);
+		}
+
+		glBeginQuery(GL_TIME_ELAPSED, queries[2]);
+		for (int draw = 0; draw < BENCHMARK_DRAWS; ++draw)
+			DrawAll(meshes);
+		glEndQuery(GL_TIME_ELAPSED);
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[2], GL_QUERY_RESULT, &elapsed);
+		result.gpuMs = elapsed / 1000000.0f / BENCHMARK_DRAWS;
+
+		for (const BenchmarkMesh& mesh : meshes)
+		{
+			glDeleteVertexArrays(1, &mesh.VAO);
+			glDeleteBuffers(1, &mesh.VBO);
+			glDeleteBuffers(1, &mesh.EBO);
+		}
+		results.push_back(result);
+	}
+	glDeleteQueries(3, queries);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteRenderbuffers(1, &color);
+	glDeleteRenderbuffers(1, &depth);
+
+	// the orders side by side, Assimp's first
+	std::cout << "Vertex benchmark: " << path;
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		std::cout << (i == 0 ? ": " : "; ") << results[i].order << " ACMR " << results[i].acmr << ", " << results[i].gpuMs << " ms";
+		if (pipelineStatistics)
+			std::cout << ", " << results[i].shaderInvocations << " VS invocations";
+	}
+	std::cout << (pipelineStatistics ? "" : " (no pipeline statistics)") << std::endl;
+	return results;
+}
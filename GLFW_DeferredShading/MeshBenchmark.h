@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Shader.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// One index order of a model, drawn through the given shader
+struct VertexBenchmarkResult
+{
+	std::string order;
+	unsigned int vertices = 0;
+	size_t indexBytes = 0;
+	float acmr = 0.0f;               // simulated, see MeshOptimizer.h
+	uint64_t verticesSubmitted = 0;  // from the pipeline statistics query, 0 when unsupported
+	uint64_t shaderInvocations = 0;
+	float gpuMs = 0.0f;              // one draw of every mesh, averaged
+};
+
+// Imports the model and draws it in Assimp's order, after vertex cache
+// optimization only and after the full MeshOptimizer pass, counting vertex
+// shader invocations with GL_ARB_pipeline_statistics_query (core in 4.6).
+// Draws into a target of its own, leaving the caller's framebuffer and
+// viewport as they were, and prints one summary line.
+std::vector<VertexBenchmarkResult> RunVertexBenchmark(const std::string& path, Shader& shader);
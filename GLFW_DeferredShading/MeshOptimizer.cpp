@@ -0,0 +1,357 @@
+#include "MeshOptimizer.h"
+
+#include <GLM/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+// Forsyth's tuning: an LRU of 32 entries, the last triangle's vertices score flat
+// and vertices with few triangles left get a boost so they are finished off
+static const unsigned int FORSYTH_CACHE_SIZE = 32;
+static const unsigned int FORSYTH_MAX_VALENCE = 32;
+static const float FORSYTH_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_POWER = 0.5f;
+
+static const unsigned int INVALID_INDEX = ~0u;
+
+static uint32_t HashVertex(const Vertex& vertex)
+{
+	// FNV-1a over the bytes, the welding compares bitwise too
+	const uint8_t* bytes = (const uint8_t*)&vertex;
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < sizeof(Vertex); ++i)
+		hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
+
+unsigned int WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	size_t tableSize = 1;
+	while (tableSize < vertices.size() * 2)
+		tableSize *= 2;
+	std::vector<unsigned int> table(tableSize, INVALID_INDEX);
+	std::vector<unsigned int> remap(vertices.size());
+
+	for (unsigned int i = 0; i < vertices.size(); ++i)
+	{
+		size_t slot = HashVertex(vertices[i]) & (tableSize - 1);
+		while (table[slot] != INVALID_INDEX && std::memcmp(&vertices[table[slot]], &vertices[i], sizeof(Vertex)) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+		if (table[slot] == INVALID_INDEX)
+			table[slot] = i;
+		remap[i] = table[slot];
+	}
+
+	// keep the first copy of every vertex that is still referenced, in the original order
+	std::vector<unsigned int> compact(vertices.size(), INVALID_INDEX);
+	for (unsigned int& index : indices)
+	{
+		index = remap[index];
+		compact[index] = 0;
+	}
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < vertices.size(); ++i)
+	{
+		if (compact[i] == INVALID_INDEX)
+			continue;
+		compact[i] = count;
+		vertices[count++] = vertices[i];
+	}
+	vertices.resize(count);
+	for (unsigned int& index : indices)
+		index = compact[index];
+	return count;
+}
+
+void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// scores by cache position (the last entry is "not cached") and by triangles left
+	float cacheScores[FORSYTH_CACHE_SIZE + 1];
+	for (unsigned int i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+	{
+		if (i < 3)
+			cacheScores[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+		else
+			cacheScores[i] = std::pow(1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_DECAY_POWER);
+	}
+	cacheScores[FORSYTH_CACHE_SIZE] = 0.0f;
+	float valenceScores[FORSYTH_MAX_VALENCE + 1];
+	valenceScores[0] = 0.0f;
+	for (unsigned int i = 1; i <= FORSYTH_MAX_VALENCE; ++i)
+		valenceScores[i] = FORSYTH_VALENCE_SCALE * std::pow((float)i, -FORSYTH_VALENCE_POWER);
+
+	// triangles of every vertex, the live ones are kept at the front of each range
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (unsigned int index : indices)
+		++remaining[index];
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; ++v)
+		offsets[v + 1] = offsets[v] + remaining[v];
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+	for (unsigned int t = 0; t < triangleCount; ++t)
+		for (unsigned int k = 0; k < 3; ++k)
+			adjacency[filled[indices[t * 3 + k]]++] = t;
+
+	std::vector<unsigned int> cachePosition(vertexCount, FORSYTH_CACHE_SIZE);
+	std::vector<float> vertexScores(vertexCount);
+	auto scoreVertex = [&](unsigned int v)
+	{
+		if (remaining[v] == 0)
+			return -1.0f;
+		return cacheScores[cachePosition[v]] + valenceScores[std::min(remaining[v], FORSYTH_MAX_VALENCE)];
+	};
+	for (unsigned int v = 0; v < vertexCount; ++v)
+		vertexScores[v] = scoreVertex(v);
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (unsigned int t = 0; t < triangleCount; ++t)
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+	std::vector<unsigned int> cache, nextCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	unsigned int best = (unsigned int)(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+	unsigned int cursor = 0;
+	for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+	{
+		if (best == INVALID_INDEX)
+		{
+			// nothing in the cache has triangles left, start over at the next unused one
+			while (emitted[cursor])
+				++cursor;
+			best = cursor;
+		}
+
+		emitted[best] = true;
+		const unsigned int* triangle = &indices[best * 3];
+		nextCache.assign(triangle, triangle + 3);
+		for (unsigned int k = 0; k < 3; ++k)
+		{
+			unsigned int v = triangle[k];
+			output.push_back(v);
+
+			unsigned int* begin = &adjacency[offsets[v]];
+			unsigned int* end = begin + remaining[v];
+			*std::find(begin, end, best) = *(end - 1);
+			--remaining[v];
+		}
+		for (unsigned int v : cache)
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				nextCache.push_back(v);
+		cache.swap(nextCache);
+
+		// rescore the cached vertices and the ones pushed out, then their live triangles
+		for (unsigned int i = 0; i < cache.size(); ++i)
+		{
+			unsigned int v = cache[i];
+			cachePosition[v] = std::min(i, FORSYTH_CACHE_SIZE);
+			vertexScores[v] = scoreVertex(v);
+		}
+
+		best = INVALID_INDEX;
+		float bestScore = -1.0f;
+		for (unsigned int v : cache)
+		{
+			for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; ++a)
+			{
+				unsigned int t = adjacency[a];
+				const unsigned int* corners = &indices[t * 3];
+				triangleScores[t] = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+				if (cachePosition[v] < FORSYTH_CACHE_SIZE && triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					best = t;
+				}
+			}
+		}
+		if (cache.size() > FORSYTH_CACHE_SIZE)
+			cache.resize(FORSYTH_CACHE_SIZE);
+	}
+
+	indices.swap(output);
+}
+
+// Vertex shader runs of each triangle under a FIFO cache
+static std::vector<unsigned char> SimulateCacheMisses(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, unsigned int cacheSize)
+{
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	std::vector<unsigned char> misses(indexCount / 3, 0);
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		unsigned int v = indices[i];
+		if (time - timestamps[v] > cacheSize)
+		{
+			timestamps[v] = time++;
+			++misses[i / 3];
+		}
+	}
+	return misses;
+}
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	if (indexCount < 3 || vertexCount == 0)
+		return stats;
+
+	std::vector<unsigned char> misses = SimulateCacheMisses(indices, indexCount, vertexCount, cacheSize);
+	size_t total = 0;
+	for (unsigned char count : misses)
+		total += count;
+	stats.acmr = (float)total / misses.size();
+	stats.atvr = (float)total / vertexCount;
+	return stats;
+}
+
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2)
+		return;
+	unsigned int vertexCount = (unsigned int)vertices.size();
+
+	// hard boundaries are where the cache starts from nothing anyway, all three corners missed
+	std::vector<unsigned char> misses = SimulateCacheMisses(indices.data(), indices.size(), vertexCount, MESH_ANALYZE_CACHE_SIZE);
+	size_t totalMisses = 0;
+	for (unsigned char count : misses)
+		totalMisses += count;
+	float targetAcmr = (float)totalMisses / triangleCount * threshold;
+
+	std::vector<size_t> hardBoundaries;
+	for (size_t t = 0; t < triangleCount; ++t)
+		if (t == 0 || misses[t] == 3)
+			hardBoundaries.push_back(t);
+	hardBoundaries.push_back(triangleCount);
+
+	// soft boundaries split a hard cluster wherever the part so far, drawn from a cold cache, is within the target
+	std::vector<size_t> clusters;
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = MESH_ANALYZE_CACHE_SIZE + 1;
+	for (size_t h = 0; h + 1 < hardBoundaries.size(); ++h)
+	{
+		size_t end = hardBoundaries[h + 1];
+		size_t clusterStart = hardBoundaries[h];
+		size_t clusterMisses = 0;
+		clusters.push_back(clusterStart);
+		time += MESH_ANALYZE_CACHE_SIZE + 1;
+		for (size_t t = clusterStart; t < end; ++t)
+		{
+			for (unsigned int k = 0; k < 3; ++k)
+			{
+				unsigned int v = indices[t * 3 + k];
+				if (time - timestamps[v] > MESH_ANALYZE_CACHE_SIZE)
+				{
+					timestamps[v] = time++;
+					++clusterMisses;
+				}
+			}
+			if ((float)clusterMisses / (t + 1 - clusterStart) <= targetAcmr && t + 1 < end)
+			{
+				clusterStart = t + 1;
+				clusterMisses = 0;
+				clusters.push_back(clusterStart);
+				time += MESH_ANALYZE_CACHE_SIZE + 1;
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// area weighted centroid of the mesh, and of every cluster with its average normal
+	glm::dvec3 meshCentroid(0.0);
+	double meshArea = 0.0;
+	size_t clusterCount = clusters.size() - 1;
+	std::vector<glm::dvec3> centroids(clusterCount, glm::dvec3(0.0));
+	std::vector<glm::dvec3> normals(clusterCount, glm::dvec3(0.0));
+	for (size_t c = 0; c < clusterCount; ++c)
+	{
+		double clusterArea = 0.0;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+		{
+			glm::dvec3 p0 = glm::dvec3(vertices[indices[t * 3]].Position);
+			glm::dvec3 p1 = glm::dvec3(vertices[indices[t * 3 + 1]].Position);
+			glm::dvec3 p2 = glm::dvec3(vertices[indices[t * 3 + 2]].Position);
+			glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+			double area = glm::length(normal) * 0.5;
+			glm::dvec3 centre = (p0 + p1 + p2) / 3.0;
+
+			centroids[c] += centre * area;
+			normals[c] += normal;
+			clusterArea += area;
+			meshCentroid += centre * area;
+			meshArea += area;
+		}
+		if (clusterArea > 0.0)
+			centroids[c] /= clusterArea;
+	}
+	if (meshArea > 0.0)
+		meshCentroid /= meshArea;
+
+	// clusters facing away from the middle occlude the rest, so they go first
+	std::vector<double> keys(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c)
+	{
+		double length = glm::length(normals[c]);
+		keys[c] = length > 0.0 ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0;
+	}
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+	for (size_t c : order)
+		output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	indices.swap(output);
+}
+
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	std::vector<unsigned int> remap(vertices.size(), INVALID_INDEX);
+	std::vector<Vertex> ordered;
+	ordered.reserve(vertices.size());
+	for (unsigned int& index : indices)
+	{
+		if (remap[index] == INVALID_INDEX)
+		{
+			remap[index] = (unsigned int)ordered.size();
+			ordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(ordered);
+}
+
+MeshOptimizeStats OptimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	MeshOptimizeStats stats;
+	stats.triangles = (unsigned int)(indices.size() / 3);
+	stats.verticesBefore = (unsigned int)vertices.size();
+	stats.before = AnalyzeVertexCache(indices.data(), indices.size(), (unsigned int)vertices.size());
+
+	WeldVertices(vertices, indices);
+	OptimizeVertexCache(indices, (unsigned int)vertices.size());
+	OptimizeOverdraw(indices, vertices);
+	OptimizeVertexFetch(vertices, indices);
+
+	stats.verticesAfter = (unsigned int)vertices.size();
+	stats.after = AnalyzeVertexCache(indices.data(), indices.size(), (unsigned int)vertices.size());
+	stats.ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return stats;
+}
@@ -1,28 +1,101 @@
 #pragma once
 
 #include "Mesh.h"
+#include "TextureBatch.h"
+#include "AssetRegistry.h"
 #include <ASSIMP/Importer.hpp>
 #include <ASSIMP/scene.h>
 #include <ASSIMP/postprocess.h>
 
+class MeshCache;
+
+// Timings of LoadModel, geometry is the Assimp import on a cold load and the
+// cache mapping and upload on a warm one; textures is the parallel TextureBatch.
+// The optimizer and simplifier figures come from the import, a cached mesh
+// was optimized and had its levels of detail built then.
+struct ModelLoadStats
+{
+	bool fromCache = false;
+	float totalMs = 0.0f;
+	float geometryMs = 0.0f;
+	float textureMs = 0.0f;
+	size_t cacheBytes = 0;
+	float optimizeMs = 0.0f;
+	unsigned int triangles = 0;
+	unsigned int verticesBefore = 0;
+	unsigned int verticesAfter = 0;
+	float acmrBefore = 0.0f; // over the whole model, see MeshOptimizer.h
+	float acmrAfter = 0.0f;
+	float lodMs = 0.0f;
+	size_t vertexBytes = 0;      // vertex buffers in the model's layout
+	size_t floatVertexBytes = 0; // the same vertices as float Vertex
+	VertexQuantizationError quantization;
+};
+
+// Meshes submitted together: same arena (so VAO and index type), textures and
+// quantization box. One glMultiDrawElementsIndirect per batch when the context
+// has it, otherwise one glDrawElementsBaseVertex per command. Every level of
+// detail has its own run of commands, laid out the same way.
+struct ModelDrawBatch
+{
+	Mesh* mesh; // any mesh of the batch, binds the textures and layout uniforms for all of them
+	unsigned int firstCommand; // within a level
+	unsigned int commandCount;
+};
+
 class Model
 {
 public:
-	std::vector<Texture> textures_loaded;
-	std::vector<Mesh> meshes;
+	// handles into the AssetRegistry, keyed by the path the material names
+	std::unordered_map<std::string, std::shared_ptr<TextureAsset>> textures_loaded;
+	std::vector<std::shared_ptr<Mesh>> meshes;
 	std::string directory;
 	bool gammaCorrection;
+	VertexLayout vertexLayout;
+	ModelLoadStats loadStats;
+	bool multiDraw = true; // batched submission out of the mesh arenas, false draws mesh by mesh
+	// per level of detail over all meshes: the largest error, in model units, and the triangles drawn
+	std::vector<float> lodErrors;
+	std::vector<unsigned int> lodTriangles;
+	// the largest full detail triangles of every mesh as bare positions, what the CPU occlusion rasterizer draws
+	std::vector<glm::vec3> occluderPositions;
+	std::vector<unsigned int> occluderIndices;
 	
-	Model(std::string const &path, bool gamma = false) : gammaCorrection(gamma)
+	Model(std::string const &path, bool gamma = false, VertexLayout layout = VERTEX_LAYOUT_QUANTIZED) : gammaCorrection(gamma), vertexLayout(layout)
 	{
 		LoadModel(path);
 	}
-	void Draw(Shader &shader);
+	~Model();
+	// A mesh with fewer levels draws its coarsest for any lod past it
+	void Draw(Shader &shader, unsigned int lod = 0);
+	// instanceCount 0 draws every instance from firstInstance on; a firstInstance needs GL 4.2
+	void DrawInstanced(Shader &shader, const InstanceBuffer &instances, unsigned int lod = 0, unsigned int firstInstance = 0, unsigned int instanceCount = 0);
+
+	unsigned int GetDrawBatchCount() const;
+	unsigned int GetLodCount() const;
+	// Box of every vertex position in model space
+	const VertexBounds& GetBounds() const;
+
+	// Vertices and indices of an imported mesh in Assimp's order, before any optimization
+	static void ReadGeometry(const aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
 
 private:
 	void LoadModel(std::string const &path);
+	void LoadFromCache(const MeshCache &cache);
 	void ProcessNode(aiNode *node, const aiScene *scene);
-	Mesh ProcessMesh(aiMesh *mesh, const aiScene *scene);
+	std::shared_ptr<Mesh> ProcessMesh(aiMesh *mesh, const aiScene *scene);
 	std::vector<Texture> LoadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName);
-	unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma = false);
+	Texture LoadTexture(const std::string &path, const std::string &typeName);
+	void AddOccluder(const Vertex* vertexData, const unsigned int* indexData, const MeshLod& full, unsigned int triangleBudget);
+	void BuildDrawBatches();
+	void DrawBatches(Shader &shader, unsigned int lod, unsigned int instanceCount, unsigned int baseInstance);
+
+	// material textures are queued while the meshes load and decoded together at the end
+	TextureBatch textureBatch;
+	// quantized meshes share the model's box so they can share a batch
+	VertexBounds quantizationBounds;
+	std::vector<ModelDrawBatch> drawBatches;
+	std::vector<DrawElementsIndirectCommand> drawCommands; // level after level, as the indirect buffer holds them
+	unsigned int commandsPerLod = 0;
+	unsigned int indirectBuffer = 0;
 };
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <GLM/glm.hpp>
+#include <vector>
+#include <functional>
+
+class ThreadPool;
+
+struct OcclusionStats
+{
+	unsigned int occluders = 0;
+	unsigned int triangles = 0; // rasterized, after near plane clipping
+	unsigned int tested = 0;
+	unsigned int occluded = 0;
+	float rasterizeMs = 0.0f;   // transform, clipping and rasterization on the workers
+	float mipMs = 0.0f;
+	float testMs = 0.0f;
+};
+
+// Software occlusion culling against a small CPU depth buffer. A few large
+// occluders are drawn into it each frame: their triangles are transformed and
+// clipped against the near plane a mesh per job, then rasterized a band of rows
+// per job, four pixels at a time with SSE, keeping the nearest depth. Every mip
+// above it holds the farthest depth of the 2x2 texels below, so a candidate
+// is hidden when the nearest corner of its box lies behind the farthest
+// occluder depth over the few texels its screen rectangle covers at one level.
+// Occluders are sampled at pixel centers, so at this resolution an occluder
+// edge can hide up to half a pixel more than it covers; feed it occluders that
+// lie inside what they stand for.
+class OcclusionCuller
+{
+private:
+	struct Occluder
+	{
+		const glm::vec3* positions;
+		const unsigned int* indices;
+		unsigned int indexCount;
+		glm::mat4 model;
+	};
+
+	// set up once, rasterized by every band it overlaps: edge functions
+	// a * x + b * y + c positive inside, depth in [0, 1] as a plane in x and y
+	struct ScreenTriangle
+	{
+		float a[3], b[3], c[3];
+		float depthX, depthY, depth;
+		int x0, y0, x1, y1; // pixels whose centers lie in the bounding box
+	};
+
+	unsigned int m_Width, m_Height;
+	std::vector<std::vector<float>> m_Mips; // level 0 is the depth buffer
+	std::vector<Occluder> m_Occluders;
+	std::vector<std::vector<ScreenTriangle>> m_Triangles; // per occluder
+	glm::mat4 m_ViewProjection;
+	ThreadPool* m_Pool;
+	OcclusionStats m_Stats;
+
+public:
+	// Width and height are rounded up to powers of two, no pool rasterizes on the calling thread
+	OcclusionCuller(unsigned int width = 256, unsigned int height = 128, ThreadPool* pool = nullptr);
+
+	// Clears the depth buffer and the occluders of the last frame
+	void Begin(const glm::mat4& viewProjection);
+	// The positions and indices are read in Rasterize, they have to live until then
+	void AddOccluder(const glm::vec3* positions, const unsigned int* indices, unsigned int indexCount, const glm::mat4& model);
+	void Rasterize();
+
+	// False when the world space box is behind the occluders everywhere it covers;
+	// boxes crossing the near plane or off screen count as visible
+	bool IsVisible(const glm::vec3& minimum, const glm::vec3& maximum);
+	// Drops every id whose box, filled in by getBox, is hidden; timed as the test
+	void RemoveOccluded(std::vector<unsigned int>& ids, const std::function<void(unsigned int, glm::vec3&, glm::vec3&)>& getBox);
+
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+	const OcclusionStats& GetStats() const;
+
+private:
+	void SetUpTriangles(unsigned int occluder);
+	void RasterizeRows(unsigned int firstRow, unsigned int rowCount);
+	void BuildMips();
+};
@@ -0,0 +1,338 @@
+#include "SceneBVH.h"
+
+#include <GLM/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <emmintrin.h>
+
+static float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static BoundingBox Union(const BoundingBox& a, const BoundingBox& b)
+{
+	BoundingBox box;
+	box.minimum = glm::min(a.minimum, b.minimum);
+	box.maximum = glm::max(a.maximum, b.maximum);
+	return box;
+}
+
+BoundingBox TransformBoundingBox(const BoundingBox& box, const glm::mat4& transform)
+{
+	// each axis of the matrix moves the box by its smallest and largest product (Arvo)
+	BoundingBox result;
+	result.minimum = result.maximum = glm::vec3(transform[3]);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		glm::vec3 a = glm::vec3(transform[axis]) * box.minimum[axis];
+		glm::vec3 b = glm::vec3(transform[axis]) * box.maximum[axis];
+		result.minimum += glm::min(a, b);
+		result.maximum += glm::max(a, b);
+	}
+	return result;
+}
+
+Frustum ExtractFrustum(const glm::mat4& viewProjection)
+{
+	// Gribb and Hartmann: each plane is the last row of the matrix plus or minus one of the others
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0]; // left
+	frustum.planes[1] = rows[3] - rows[0]; // right
+	frustum.planes[2] = rows[3] + rows[1]; // bottom
+	frustum.planes[3] = rows[3] - rows[1]; // top
+	frustum.planes[4] = rows[3] + rows[2]; // near
+	frustum.planes[5] = rows[3] - rows[2]; // far
+	for (glm::vec4& plane : frustum.planes)
+		plane /= glm::length(glm::vec3(plane));
+	return frustum;
+}
+
+bool IntersectsFrustum(const Frustum& frustum, const BoundingBox& box)
+{
+	// the corner furthest along the plane's normal decides whether the box is all outside
+	for (const glm::vec4& plane : frustum.planes)
+	{
+		glm::vec3 corner(plane.x >= 0.0f ? box.maximum.x : box.minimum.x, plane.y >= 0.0f ? box.maximum.y : box.minimum.y, plane.z >= 0.0f ? box.maximum.z : box.minimum.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+SceneBVH::SceneBVH()
+{
+}
+
+void SceneBVH::Build(const std::vector<BoundingBox>& boxes)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	m_Nodes.clear();
+	m_Objects.resize(boxes.size());
+	for (unsigned int i = 0; i < boxes.size(); ++i)
+		m_Objects[i] = i;
+
+	std::vector<glm::vec3> centers(boxes.size());
+	for (unsigned int i = 0; i < boxes.size(); ++i)
+		centers[i] = (boxes[i].minimum + boxes[i].maximum) * 0.5f;
+
+	if (!boxes.empty())
+		BuildNode(boxes, centers, 0, (unsigned int)boxes.size());
+
+	m_Stats.objects = (unsigned int)boxes.size();
+	m_Stats.nodes = (unsigned int)m_Nodes.size();
+	m_Stats.buildMs = ElapsedMs(start);
+}
+
+unsigned int SceneBVH::BuildNode(const std::vector<BoundingBox>& boxes, const std::vector<glm::vec3>& centers, unsigned int first, unsigned int count)
+{
+	unsigned int index = (unsigned int)m_Nodes.size();
+	m_Nodes.push_back(Node());
+	for (unsigned int slot = 0; slot < 4; ++slot)
+	{
+		SetSlot(m_Nodes[index], slot, BoundingBox());
+		m_Nodes[index].child[slot] = -1;
+		m_Nodes[index].first[slot] = 0;
+		m_Nodes[index].count[slot] = 0;
+	}
+
+	// median split along the widest axis of the centers, returns how many go left
+	auto split = [this, &centers](unsigned int begin, unsigned int size)
+	{
+		glm::vec3 low = centers[m_Objects[begin]], high = low;
+		for (unsigned int i = begin + 1; i < begin + size; ++i)
+		{
+			low = glm::min(low, centers[m_Objects[i]]);
+			high = glm::max(high, centers[m_Objects[i]]);
+		}
+		glm::vec3 extent = high - low;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		unsigned int half = size / 2;
+		std::nth_element(m_Objects.begin() + begin, m_Objects.begin() + begin + half, m_Objects.begin() + begin + size,
+			[&centers, axis](unsigned int a, unsigned int b) { return centers[a][axis] < centers[b][axis]; });
+		return half;
+	};
+
+	// four children: every object its own when they fit, otherwise the range halved twice
+	unsigned int groupFirst[4], groupCount[4], groups = 0;
+	if (count <= 4)
+	{
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			groupFirst[groups] = first + i;
+			groupCount[groups++] = 1;
+		}
+	}
+	else
+	{
+		unsigned int left = split(first, count);
+		unsigned int leftLeft = split(first, left);
+		unsigned int rightLeft = split(first + left, count - left);
+		groupFirst[0] = first;
+		groupCount[0] = leftLeft;
+		groupFirst[1] = first + leftLeft;
+		groupCount[1] = left - leftLeft;
+		groupFirst[2] = first + left;
+		groupCount[2] = rightLeft;
+		groupFirst[3] = first + left + rightLeft;
+		groupCount[3] = count - left - rightLeft;
+		groups = 4;
+	}
+
+	for (unsigned int slot = 0; slot < groups; ++slot)
+	{
+		BoundingBox box = boxes[m_Objects[groupFirst[slot]]];
+		for (unsigned int i = groupFirst[slot] + 1; i < groupFirst[slot] + groupCount[slot]; ++i)
+			box = Union(box, boxes[m_Objects[i]]);
+
+		// m_Nodes may grow during the recursion, the node is looked up again afterwards
+		int child = groupCount[slot] > 1 ? (int)BuildNode(boxes, centers, groupFirst[slot], groupCount[slot]) : -1;
+		Node& node = m_Nodes[index];
+		SetSlot(node, slot, box);
+		node.child[slot] = child;
+		node.first[slot] = groupFirst[slot];
+		node.count[slot] = groupCount[slot];
+	}
+	return index;
+}
+
+void SceneBVH::SetSlot(Node& node, unsigned int slot, const BoundingBox& box)
+{
+	node.minX[slot] = box.minimum.x;
+	node.minY[slot] = box.minimum.y;
+	node.minZ[slot] = box.minimum.z;
+	node.maxX[slot] = box.maximum.x;
+	node.maxY[slot] = box.maximum.y;
+	node.maxZ[slot] = box.maximum.z;
+}
+
+void SceneBVH::Refit(const std::vector<BoundingBox>& boxes)
+{
+	if (boxes.size() != m_Objects.size())
+	{
+		Build(boxes);
+		return;
+	}
+
+	// children come after their parents, so walking backwards finishes every child first
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t index = m_Nodes.size(); index-- > 0;)
+	{
+		Node& node = m_Nodes[index];
+		for (unsigned int slot = 0; slot < 4; ++slot)
+		{
+			if (node.count[slot] == 0)
+				continue;
+			if (node.child[slot] < 0)
+			{
+				SetSlot(node, slot, boxes[m_Objects[node.first[slot]]]);
+				continue;
+			}
+
+			const Node& child = m_Nodes[node.child[slot]];
+			BoundingBox box;
+			box.minimum = glm::vec3(child.minX[0], child.minY[0], child.minZ[0]);
+			box.maximum = glm::vec3(child.maxX[0], child.maxY[0], child.maxZ[0]);
+			for (unsigned int i = 1; i < 4 && child.count[i] > 0; ++i)
+			{
+				box.minimum = glm::min(box.minimum, glm::vec3(child.minX[i], child.minY[i], child.minZ[i]));
+				box.maximum = glm::max(box.maximum, glm::vec3(child.maxX[i], child.maxY[i], child.maxZ[i]));
+			}
+			SetSlot(node, slot, box);
+		}
+	}
+	m_Stats.refitMs = ElapsedMs(start);
+}
+
+void SceneBVH::Cull(const Frustum& frustum, std::vector<unsigned int>& visible)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	visible.clear();
+	m_Stats.nodesVisited = 0;
+	m_Stats.fullyInside = 0;
+	if (!m_Nodes.empty())
+		m_Stack.assign(1, 0);
+
+	const __m128 zero = _mm_setzero_ps();
+	while (!m_Stack.empty())
+	{
+		const Node& node = m_Nodes[m_Stack.back()];
+		m_Stack.pop_back();
+		++m_Stats.nodesVisited;
+
+		__m128 minX = _mm_loadu_ps(node.minX), minY = _mm_loadu_ps(node.minY), minZ = _mm_loadu_ps(node.minZ);
+		__m128 maxX = _mm_loadu_ps(node.maxX), maxY = _mm_loadu_ps(node.maxY), maxZ = _mm_loadu_ps(node.maxZ);
+
+		// four boxes against each plane: outside when the nearest-to-inside corner is behind it,
+		// straddling when the opposite corner is
+		__m128 outside = zero, straddling = zero;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			__m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z), w = _mm_set1_ps(plane.w);
+			__m128 farX = plane.x >= 0.0f ? maxX : minX, nearX = plane.x >= 0.0f ? minX : maxX;
+			__m128 farY = plane.y >= 0.0f ? maxY : minY, nearY = plane.y >= 0.0f ? minY : maxY;
+			__m128 farZ = plane.z >= 0.0f ? maxZ : minZ, nearZ = plane.z >= 0.0f ? minZ : maxZ;
+			__m128 farDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, farX), _mm_mul_ps(ny, farY)), _mm_add_ps(_mm_mul_ps(nz, farZ), w));
+			__m128 nearDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nearX), _mm_mul_ps(ny, nearY)), _mm_add_ps(_mm_mul_ps(nz, nearZ), w));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(farDistance, zero));
+			straddling = _mm_or_ps(straddling, _mm_cmplt_ps(nearDistance, zero));
+		}
+
+		int outsideMask = _mm_movemask_ps(outside);
+		int straddlingMask = _mm_movemask_ps(straddling);
+		for (unsigned int slot = 0; slot < 4; ++slot)
+		{
+			if (node.count[slot] == 0 || (outsideMask & (1 << slot)))
+				continue;
+			if (node.child[slot] < 0)
+				visible.push_back(m_Objects[node.first[slot]]);
+			else if (!(straddlingMask & (1 << slot)))
+			{
+				visible.insert(visible.end(), m_Objects.begin() + node.first[slot], m_Objects.begin() + node.first[slot] + node.count[slot]);
+				++m_Stats.fullyInside;
+			}
+			else
+				m_Stack.push_back((unsigned int)node.child[slot]);
+		}
+	}
+
+	m_Stats.visible = (unsigned int)visible.size();
+	m_Stats.cullMs = ElapsedMs(start);
+}
+
+unsigned int SceneBVH::GetObjectCount() const
+{
+	return (unsigned int)m_Objects.size();
+}
+
+const CullStats& SceneBVH::GetStats() const
+{
+	return m_Stats;
+}
+
+int RunCullBenchmark(unsigned int objectCount)
+{
+	// boxes of 0.5 to 2.5 units scattered through a cube with the camera turning in its middle
+	const float SCENE_SIZE = 400.0f;
+	const unsigned int FRAMES = 64;
+	std::vector<BoundingBox> boxes(objectCount);
+	srand(20);
+	for (BoundingBox& box : boxes)
+	{
+		glm::vec3 center = (glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX - 0.5f) * SCENE_SIZE;
+		glm::vec3 extent = glm::vec3(0.25f) + glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX;
+		box.minimum = center - extent;
+		box.maximum = center + extent;
+	}
+
+	SceneBVH bvh;
+	bvh.Build(boxes);
+	float buildMs = bvh.GetStats().buildMs;
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, SCENE_SIZE);
+	std::vector<unsigned int> visible;
+	float bvhMs = 0.0f, linearMs = 0.0f, refitMs = 0.0f;
+	unsigned long long visibleTotal = 0, nodesTotal = 0;
+	unsigned int mismatches = 0;
+	for (unsigned int frame = 0; frame < FRAMES; ++frame)
+	{
+		float angle = glm::radians(360.0f * frame / FRAMES);
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(std::cos(angle), 0.2f, std::sin(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+		Frustum frustum = ExtractFrustum(projection * view);
+
+		bvh.Cull(frustum, visible);
+		bvhMs += bvh.GetStats().cullMs;
+		nodesTotal += bvh.GetStats().nodesVisited;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		unsigned int linearVisible = 0;
+		for (const BoundingBox& box : boxes)
+			linearVisible += IntersectsFrustum(frustum, box) ? 1 : 0;
+		linearMs += ElapsedMs(start);
+
+		visibleTotal += visible.size();
+		mismatches += visible.size() != linearVisible ? 1 : 0;
+
+		// every object drifts a little, the tree follows by refitting
+		for (unsigned int i = 0; i < boxes.size(); ++i)
+		{
+			glm::vec3 offset(std::sin(frame * 0.1f + i) * 0.05f, std::cos(frame * 0.1f + i) * 0.05f, 0.0f);
+			boxes[i].minimum += offset;
+			boxes[i].maximum += offset;
+		}
+		bvh.Refit(boxes);
+		refitMs += bvh.GetStats().refitMs;
+	}
+
+	std::cout << "Cull benchmark: " << objectCount << " objects, " << bvh.GetStats().nodes << " nodes, " << FRAMES << " frames" << std::endl;
+	std::cout << "  build " << buildMs << " ms, refit " << refitMs / FRAMES << " ms" << std::endl;
+	std::cout << "  BVH cull " << bvhMs / FRAMES << " ms (" << nodesTotal / FRAMES << " nodes visited), linear cull " << linearMs / FRAMES << " ms, "
+		<< visibleTotal / FRAMES << " visible on average" << (mismatches ? ", RESULTS DIFFER" : "") << std::endl;
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <GLM/glm.hpp>
+#include <vector>
+
+struct BoundingBox
+{
+	glm::vec3 minimum = glm::vec3(0.0f);
+	glm::vec3 maximum = glm::vec3(0.0f);
+};
+
+// Box around the eight corners of box after transform
+BoundingBox TransformBoundingBox(const BoundingBox& box, const glm::mat4& transform);
+
+// Six normalized planes, inside where dot(plane.xyz, p) + plane.w >= 0
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+Frustum ExtractFrustum(const glm::mat4& viewProjection);
+// Scalar test, what every object would go through without the hierarchy
+bool IntersectsFrustum(const Frustum& frustum, const BoundingBox& box);
+
+struct CullStats
+{
+	unsigned int objects = 0;
+	unsigned int visible = 0;
+	unsigned int nodes = 0;
+	unsigned int nodesVisited = 0;
+	unsigned int fullyInside = 0; // subtrees accepted without testing their objects
+	float buildMs = 0.0f;
+	float refitMs = 0.0f;
+	float cullMs = 0.0f;
+};
+
+// Bounding volume hierarchy over the boxes of a scene's objects, four children
+// per node. A node keeps its children's boxes as a structure of arrays so one
+// SSE test checks all four against a frustum plane. Subtrees entirely inside
+// the frustum are accepted without looking further. Objects that move keep
+// their place in the tree: Refit only grows or shrinks the boxes bottom up,
+// which is far cheaper than a Build but loosens the tree as objects drift, so
+// rebuild when the scene changes a lot.
+class SceneBVH
+{
+private:
+	struct Node
+	{
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+		int child[4];          // node index, -1 for a single object or an empty slot
+		unsigned int first[4]; // objects under the slot in m_Objects
+		unsigned int count[4]; // 0 for an empty slot
+	};
+
+	std::vector<Node> m_Nodes; // a child always comes after its parent
+	std::vector<unsigned int> m_Objects; // object ids, every subtree's contiguous
+	std::vector<unsigned int> m_Stack;
+	CullStats m_Stats;
+
+public:
+	SceneBVH();
+
+	// Object ids are indices into boxes
+	void Build(const std::vector<BoundingBox>& boxes);
+	// Same objects as the last Build, with new boxes
+	void Refit(const std::vector<BoundingBox>& boxes);
+	// Replaces visible with the ids of every object whose box touches the frustum, in tree order
+	void Cull(const Frustum& frustum, std::vector<unsigned int>& visible);
+
+	unsigned int GetObjectCount() const;
+	const CullStats& GetStats() const;
+
+private:
+	unsigned int BuildNode(const std::vector<BoundingBox>& boxes, const std::vector<glm::vec3>& centers, unsigned int first, unsigned int count);
+	void SetSlot(Node& node, unsigned int slot, const BoundingBox& box);
+};
+
+// Builds, refits and culls objectCount random boxes from a camera sweeping
+// around the scene, against a linear scalar test of every box, and prints the
+// timings. Returns non-zero when the two disagree on what is visible.
+int RunCullBenchmark(unsigned int objectCount);
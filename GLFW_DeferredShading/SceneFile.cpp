@@ -0,0 +1,692 @@
+#include "SceneFile.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <sys/stat.h>
+
+static const uint32_t SCENE_FILE_MAGIC = 0x454E4353; // "SCNE"
+static const uint32_t SCENE_FILE_VERSION = 1;
+static const uint32_t SCENE_FILE_HAS_CAMERA = 1;
+
+struct SceneFileString
+{
+	uint32_t offset;
+	uint32_t length;
+};
+
+struct SceneFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t flags;
+	uint32_t meshCount;
+	uint32_t materialCount;
+	uint32_t entityCount;
+	uint32_t lightCount;
+	uint32_t stringBytes;
+	float camera[6]; // position, yaw, pitch, zoom
+};
+
+struct SceneFileMesh
+{
+	SceneFileString name;
+	SceneFileString path;
+};
+
+struct SceneFileMaterial
+{
+	SceneFileString name;
+	float color[3];
+	float specular;
+};
+
+struct SceneFileEntity
+{
+	SceneFileString name;
+	uint32_t mesh;
+	uint32_t material;
+	uint32_t parent;
+	float position[3];
+	float rotation[4]; // x, y, z, w
+	float scale[3];
+};
+
+struct SceneFileLight
+{
+	float position[3];
+	float color[3];
+	float linear;
+	float quadratic;
+	float radius;
+};
+
+static float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static bool ReadFile(const std::string& path, std::string& contents)
+{
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream)
+		return false;
+	std::ostringstream buffer;
+	buffer << stream.rdbuf();
+	contents = buffer.str();
+	return true;
+}
+
+// Text form
+
+static bool ParseText(const std::string& path, const std::string& text, SceneDescription& scene, unsigned int& errors)
+{
+	std::unordered_map<std::string, unsigned int> meshes, materials, entities;
+	std::istringstream lines(text);
+	std::string raw;
+	unsigned int lineNumber = 0;
+	auto fail = [&](const std::string& message)
+	{
+		std::cout << path << ":" << lineNumber << ": " << message << std::endl;
+		++errors;
+	};
+
+	while (std::getline(lines, raw))
+	{
+		++lineNumber;
+		size_t comment = raw.find('#');
+		if (comment != std::string::npos)
+			raw.erase(comment);
+		std::istringstream line(raw);
+		std::string type;
+		if (!(line >> type))
+			continue;
+
+		if (type == "camera")
+		{
+			SceneCamera camera;
+			if (!(line >> camera.position.x >> camera.position.y >> camera.position.z))
+			{
+				fail("camera needs a position");
+				continue;
+			}
+			float angle;
+			if (line >> angle)
+			{
+				camera.yaw = angle;
+				if (line >> angle)
+				{
+					camera.pitch = angle;
+					if (line >> angle)
+						camera.zoom = angle;
+				}
+			}
+			scene.camera = camera;
+			scene.hasCamera = true;
+		}
+		else if (type == "mesh")
+		{
+			SceneMesh mesh;
+			if (!(line >> mesh.name >> mesh.path))
+			{
+				fail("mesh needs a name and a path");
+				continue;
+			}
+			if (meshes.count(mesh.name))
+			{
+				fail("mesh " + mesh.name + " is already declared");
+				continue;
+			}
+			meshes[mesh.name] = (unsigned int)scene.meshes.size();
+			scene.meshes.push_back(mesh);
+		}
+		else if (type == "material")
+		{
+			SceneMaterial material;
+			if (!(line >> material.name >> material.color.r >> material.color.g >> material.color.b))
+			{
+				fail("material needs a name and a color");
+				continue;
+			}
+			float specular;
+			if (line >> specular)
+				material.specular = specular;
+			if (materials.count(material.name))
+			{
+				fail("material " + material.name + " is already declared");
+				continue;
+			}
+			materials[material.name] = (unsigned int)scene.materials.size();
+			scene.materials.push_back(material);
+		}
+		else if (type == "entity")
+		{
+			SceneEntity entity;
+			std::string meshName;
+			if (!(line >> entity.name >> meshName >> entity.position.x >> entity.position.y >> entity.position.z))
+			{
+				fail("entity needs a name, a mesh and a position");
+				continue;
+			}
+			auto mesh = meshes.find(meshName);
+			if (mesh == meshes.end())
+			{
+				fail("unknown mesh " + meshName);
+				continue;
+			}
+			entity.mesh = mesh->second;
+			if (entities.count(entity.name))
+			{
+				fail("entity " + entity.name + " is already declared");
+				continue;
+			}
+
+			bool valid = true;
+			std::string key;
+			while (valid && line >> key)
+			{
+				if (key == "rotate")
+				{
+					glm::vec3 degrees;
+					valid = (bool)(line >> degrees.x >> degrees.y >> degrees.z);
+					entity.rotation = glm::quat(glm::radians(degrees));
+				}
+				else if (key == "scale")
+				{
+					valid = (bool)(line >> entity.scale.x >> entity.scale.y >> entity.scale.z);
+				}
+				else if (key == "material" || key == "parent")
+				{
+					std::string name;
+					const std::unordered_map<std::string, unsigned int>& names = key == "material" ? materials : entities;
+					auto found = (line >> name) ? names.find(name) : names.end();
+					valid = found != names.end();
+					if (valid && key == "material")
+						entity.material = found->second;
+					else if (valid)
+						entity.parent = found->second;
+				}
+				else
+				{
+					valid = false;
+				}
+				if (!valid)
+					fail("bad entity option " + key);
+			}
+			if (!valid)
+				continue;
+			entities[entity.name] = (unsigned int)scene.entities.size();
+			scene.entities.push_back(entity);
+		}
+		else if (type == "light")
+		{
+			SceneLight light;
+			if (!(line >> light.position.x >> light.position.y >> light.position.z >> light.color.r >> light.color.g >> light.color.b))
+			{
+				fail("light needs a position and a color");
+				continue;
+			}
+			bool valid = true;
+			std::string key;
+			while (valid && line >> key)
+			{
+				if (key == "attenuation")
+					valid = (bool)(line >> light.linear >> light.quadratic) && HasFalloff(light.linear, light.quadratic);
+				else if (key == "radius")
+					valid = (bool)(line >> light.radius);
+				else
+					valid = false;
+				if (!valid)
+					fail("bad light option " + key);
+			}
+			if (valid)
+				scene.lights.push_back(light);
+		}
+		else
+		{
+			fail("unknown record " + type);
+		}
+	}
+	return true;
+}
+
+bool SaveSceneText(const std::string& path, const SceneDescription& scene)
+{
+	std::ofstream stream(path, std::ios::trunc);
+	if (!stream)
+	{
+		std::cout << "Scene: unable to write " << path << std::endl;
+		return false;
+	}
+	stream << std::setprecision(std::numeric_limits<float>::max_digits10);
+
+	stream << "# " << scene.entities.size() << " entities, " << scene.lights.size() << " lights" << std::endl;
+	if (scene.hasCamera)
+	{
+		const SceneCamera& camera = scene.camera;
+		stream << "camera " << camera.position.x << " " << camera.position.y << " " << camera.position.z << " "
+			<< camera.yaw << " " << camera.pitch << " " << camera.zoom << std::endl;
+	}
+	for (const SceneMesh& mesh : scene.meshes)
+		stream << "mesh " << mesh.name << " " << mesh.path << std::endl;
+	for (const SceneMaterial& material : scene.materials)
+		stream << "material " << material.name << " " << material.color.r << " " << material.color.g << " " << material.color.b << " " << material.specular << std::endl;
+	for (const SceneEntity& entity : scene.entities)
+	{
+		stream << "entity " << entity.name << " " << scene.meshes[entity.mesh].name << " "
+			<< entity.position.x << " " << entity.position.y << " " << entity.position.z;
+		if (entity.rotation != glm::quat(1.0f, 0.0f, 0.0f, 0.0f))
+		{
+			glm::vec3 degrees = glm::degrees(glm::eulerAngles(entity.rotation));
+			stream << " rotate " << degrees.x << " " << degrees.y << " " << degrees.z;
+		}
+		if (entity.scale != glm::vec3(1.0f))
+			stream << " scale " << entity.scale.x << " " << entity.scale.y << " " << entity.scale.z;
+		if (entity.material != SCENE_NONE)
+			stream << " material " << scene.materials[entity.material].name;
+		if (entity.parent != SCENE_NONE)
+			stream << " parent " << scene.entities[entity.parent].name;
+		stream << "\n";
+	}
+	for (const SceneLight& light : scene.lights)
+	{
+		stream << "light " << light.position.x << " " << light.position.y << " " << light.position.z << " "
+			<< light.color.r << " " << light.color.g << " " << light.color.b
+			<< " attenuation " << light.linear << " " << light.quadratic;
+		if (light.radius > 0.0f)
+			stream << " radius " << light.radius;
+		stream << "\n";
+	}
+
+	if (!stream)
+	{
+		std::cout << "Scene: write failed " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Binary form
+
+static bool ParseBinary(const std::string& path, const std::string& data, SceneDescription& scene)
+{
+	SceneFileHeader header;
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (header.version != SCENE_FILE_VERSION)
+	{
+		std::cout << "Scene: " << path << " is version " << header.version << ", expected " << SCENE_FILE_VERSION << std::endl;
+		return false;
+	}
+
+	uint64_t meshTable = sizeof(SceneFileHeader);
+	uint64_t materialTable = meshTable + (uint64_t)header.meshCount * sizeof(SceneFileMesh);
+	uint64_t entityTable = materialTable + (uint64_t)header.materialCount * sizeof(SceneFileMaterial);
+	uint64_t lightTable = entityTable + (uint64_t)header.entityCount * sizeof(SceneFileEntity);
+	uint64_t stringTable = lightTable + (uint64_t)header.lightCount * sizeof(SceneFileLight);
+	if (stringTable + header.stringBytes > data.size())
+	{
+		std::cout << "Scene: " << path << " is truncated" << std::endl;
+		return false;
+	}
+
+	// a damaged file must not index past the tables
+	bool valid = true;
+	auto readString = [&](const SceneFileString& string)
+	{
+		if ((uint64_t)string.offset + string.length > header.stringBytes)
+		{
+			valid = false;
+			return std::string();
+		}
+		return std::string(data.data() + stringTable + string.offset, string.length);
+	};
+
+	SceneDescription loaded;
+	loaded.hasCamera = (header.flags & SCENE_FILE_HAS_CAMERA) != 0;
+	loaded.camera.position = glm::vec3(header.camera[0], header.camera[1], header.camera[2]);
+	loaded.camera.yaw = header.camera[3];
+	loaded.camera.pitch = header.camera[4];
+	loaded.camera.zoom = header.camera[5];
+
+	loaded.meshes.resize(header.meshCount);
+	for (uint32_t i = 0; i < header.meshCount; ++i)
+	{
+		SceneFileMesh record;
+		std::memcpy(&record, data.data() + meshTable + i * sizeof(SceneFileMesh), sizeof(record));
+		loaded.meshes[i].name = readString(record.name);
+		loaded.meshes[i].path = readString(record.path);
+	}
+
+	loaded.materials.resize(header.materialCount);
+	for (uint32_t i = 0; i < header.materialCount; ++i)
+	{
+		SceneFileMaterial record;
+		std::memcpy(&record, data.data() + materialTable + i * sizeof(SceneFileMaterial), sizeof(record));
+		loaded.materials[i].name = readString(record.name);
+		loaded.materials[i].color = glm::vec3(record.color[0], record.color[1], record.color[2]);
+		loaded.materials[i].specular = record.specular;
+	}
+
+	loaded.entities.resize(header.entityCount);
+	for (uint32_t i = 0; i < header.entityCount && valid; ++i)
+	{
+		SceneFileEntity record;
+		std::memcpy(&record, data.data() + entityTable + i * sizeof(SceneFileEntity), sizeof(record));
+		if (record.mesh >= header.meshCount)
+			valid = false;
+		if (record.material != SCENE_NONE && record.material >= header.materialCount)
+			valid = false;
+		if (record.parent != SCENE_NONE && record.parent >= i)
+			valid = false;
+
+		SceneEntity& entity = loaded.entities[i];
+		entity.name = readString(record.name);
+		entity.mesh = record.mesh;
+		entity.material = record.material;
+		entity.parent = record.parent;
+		entity.position = glm::vec3(record.position[0], record.position[1], record.position[2]);
+		entity.rotation = glm::quat(record.rotation[3], record.rotation[0], record.rotation[1], record.rotation[2]);
+		entity.scale = glm::vec3(record.scale[0], record.scale[1], record.scale[2]);
+	}
+
+	loaded.lights.resize(header.lightCount);
+	for (uint32_t i = 0; i < header.lightCount; ++i)
+	{
+		SceneFileLight record;
+		std::memcpy(&record, data.data() + lightTable + i * sizeof(SceneFileLight), sizeof(record));
+		SceneLight& light = loaded.lights[i];
+		light.position = glm::vec3(record.position[0], record.position[1], record.position[2]);
+		light.color = glm::vec3(record.color[0], record.color[1], record.color[2]);
+		light.linear = record.linear;
+		light.quadratic = record.quadratic;
+		light.radius = record.radius;
+		if (!HasFalloff(light.linear, light.quadratic) || !(light.radius >= 0.0f))
+			valid = false;
+	}
+
+	if (!valid)
+	{
+		std::cout << "Scene: " << path << " is damaged" << std::endl;
+		return false;
+	}
+	scene = std::move(loaded);
+	return true;
+}
+
+bool SaveSceneBinary(const std::string& path, const SceneDescription& scene)
+{
+	std::string strings;
+	auto addString = [&strings](const std::string& string)
+	{
+		SceneFileString record = { (uint32_t)strings.size(), (uint32_t)string.size() };
+		strings += string;
+		return record;
+	};
+
+	SceneFileHeader header = {};
+	header.magic = SCENE_FILE_MAGIC;
+	header.version = SCENE_FILE_VERSION;
+	header.flags = scene.hasCamera ? SCENE_FILE_HAS_CAMERA : 0;
+	header.meshCount = (uint32_t)scene.meshes.size();
+	header.materialCount = (uint32_t)scene.materials.size();
+	header.entityCount = (uint32_t)scene.entities.size();
+	header.lightCount = (uint32_t)scene.lights.size();
+	header.camera[0] = scene.camera.position.x;
+	header.camera[1] = scene.camera.position.y;
+	header.camera[2] = scene.camera.position.z;
+	header.camera[3] = scene.camera.yaw;
+	header.camera[4] = scene.camera.pitch;
+	header.camera[5] = scene.camera.zoom;
+
+	std::vector<SceneFileMesh> meshTable;
+	for (const SceneMesh& mesh : scene.meshes)
+	{
+		SceneFileMesh record;
+		record.name = addString(mesh.name);
+		record.path = addString(mesh.path);
+		meshTable.push_back(record);
+	}
+
+	std::vector<SceneFileMaterial> materialTable;
+	for (const SceneMaterial& material : scene.materials)
+	{
+		SceneFileMaterial record;
+		record.name = addString(material.name);
+		record.color[0] = material.color.r;
+		record.color[1] = material.color.g;
+		record.color[2] = material.color.b;
+		record.specular = material.specular;
+		materialTable.push_back(record);
+	}
+
+	std::vector<SceneFileEntity> entityTable;
+	for (const SceneEntity& entity : scene.entities)
+	{
+		SceneFileEntity record;
+		record.name = addString(entity.name);
+		record.mesh = entity.mesh;
+		record.material = entity.material;
+		record.parent = entity.parent;
+		for (int i = 0; i < 3; ++i)
+		{
+			record.position[i] = entity.position[i];
+			record.scale[i] = entity.scale[i];
+		}
+		record.rotation[0] = entity.rotation.x;
+		record.rotation[1] = entity.rotation.y;
+		record.rotation[2] = entity.rotation.z;
+		record.rotation[3] = entity.rotation.w;
+		entityTable.push_back(record);
+	}
+
+	std::vector<SceneFileLight> lightTable;
+	for (const SceneLight& light : scene.lights)
+	{
+		SceneFileLight record;
+		for (int i = 0; i < 3; ++i)
+		{
+			record.position[i] = light.position[i];
+			record.color[i] = light.color[i];
+		}
+		record.linear = light.linear;
+		record.quadratic = light.quadratic;
+		record.radius = light.radius;
+		lightTable.push_back(record);
+	}
+	header.stringBytes = (uint32_t)strings.size();
+
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		std::cout << "Scene: unable to write " << path << std::endl;
+		return false;
+	}
+	stream.write((const char*)&header, sizeof(header));
+	stream.write((const char*)meshTable.data(), meshTable.size() * sizeof(SceneFileMesh));
+	stream.write((const char*)materialTable.data(), materialTable.size() * sizeof(SceneFileMaterial));
+	stream.write((const char*)entityTable.data(), entityTable.size() * sizeof(SceneFileEntity));
+	stream.write((const char*)lightTable.data(), lightTable.size() * sizeof(SceneFileLight));
+	stream.write(strings.data(), strings.size());
+	if (!stream)
+	{
+		std::cout << "Scene: write failed " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool SaveScene(const std::string& path, const SceneDescription& scene)
+{
+	const std::string extension = ".sceneb";
+	bool binary = path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+	return binary ? SaveSceneBinary(path, scene) : SaveSceneText(path, scene);
+}
+
+// SceneFile
+
+SceneFile::SceneFile(const std::string& path)
+	: m_Path(path), m_Size(0), m_Time(0)
+{
+}
+
+bool SceneFile::Load(SceneDescription& scene)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// taken before reading, a file rewritten while it is parsed shows up as changed again
+	struct stat info;
+	if (stat(m_Path.c_str(), &info) == 0)
+	{
+		m_Size = (uint64_t)info.st_size;
+		m_Time = (int64_t)info.st_mtime;
+	}
+
+	std::string data;
+	if (!ReadFile(m_Path, data))
+	{
+		std::cout << "Scene: unable to read " << m_Path << std::endl;
+		return false;
+	}
+
+	SceneLoadStats stats;
+	stats.bytes = data.size();
+	uint32_t magic = 0;
+	if (data.size() >= sizeof(SceneFileHeader))
+		std::memcpy(&magic, data.data(), sizeof(magic));
+	stats.binary = magic == SCENE_FILE_MAGIC;
+
+	SceneDescription loaded;
+	bool parsed = stats.binary ? ParseBinary(m_Path, data, loaded) : ParseText(m_Path, data, loaded, stats.errors);
+	if (!parsed)
+		return false;
+	scene = std::move(loaded);
+
+	stats.loadMs = ElapsedMs(start);
+	m_Stats = stats;
+	std::cout << "Scene: " << m_Path << " (" << (stats.binary ? "binary" : "text") << ", " << stats.bytes / 1024 << " KB), "
+		<< scene.entities.size() << " entities, " << scene.lights.size() << " lights in " << stats.loadMs << " ms";
+	if (stats.errors > 0)
+		std::cout << ", " << stats.errors << " lines skipped";
+	std::cout << std::endl;
+	return true;
+}
+
+bool SceneFile::HasChanged() const
+{
+	struct stat info;
+	if (stat(m_Path.c_str(), &info) != 0)
+		return false;
+	return (uint64_t)info.st_size != m_Size || (int64_t)info.st_mtime != m_Time;
+}
+
+const std::string& SceneFile::GetPath() const
+{
+	return m_Path;
+}
+
+const SceneLoadStats& SceneFile::GetStats() const
+{
+	return m_Stats;
+}
+
+bool SameSceneStructure(const SceneDescription& a, const SceneDescription& b)
+{
+	if (a.entities.size() != b.entities.size() || a.meshes.size() != b.meshes.size())
+		return false;
+	for (size_t i = 0; i < a.meshes.size(); ++i)
+	{
+		if (a.meshes[i].path != b.meshes[i].path)
+			return false;
+	}
+	for (size_t i = 0; i < a.entities.size(); ++i)
+	{
+		const SceneEntity& entityA = a.entities[i];
+		const SceneEntity& entityB = b.entities[i];
+		if (entityA.name != entityB.name || entityA.mesh != entityB.mesh || entityA.parent != entityB.parent)
+			return false;
+	}
+	return true;
+}
+
+float LightVolumeRadius(const glm::vec3& color, float linear, float quadratic)
+{
+	const float constant = 1.0f;
+	const float maxBrightness = std::fmaxf(std::fmaxf(color.r, color.g), color.b);
+	// a light that starts out below the threshold, or never falls off, has no finite volume
+	if (!HasFalloff(linear, quadratic) || (256.0f / 5.0f) * maxBrightness <= constant)
+		return 0.0f;
+	// without the quadratic term constant + linear * d = 256 / 5 * brightness is solved directly
+	if (quadratic <= 0.0f)
+		return std::fmaxf(((256.0f / 5.0f) * maxBrightness - constant) / linear, 0.0f);
+	return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * (constant - (256.0f / 5.0f) * maxBrightness))) / (2.0f * quadratic);
+}
+
+bool HasFalloff(float linear, float quadratic)
+{
+	return linear >= 0.0f && quadratic >= 0.0f && (linear > 0.0f || quadratic > 0.0f);
+}
+
+SceneDescription CreateStressScene(unsigned int entityCount, const std::string& meshPath)
+{
+	const unsigned int STACK_HEIGHT = 4;
+	const float spacing = 3.0f;
+	const glm::vec3 palette[] = {
+		glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(1.0f, 0.6f, 0.6f), glm::vec3(0.6f, 1.0f, 0.6f), glm::vec3(0.6f, 0.6f, 1.0f),
+		glm::vec3(1.0f, 1.0f, 0.5f), glm::vec3(0.5f, 1.0f, 1.0f), glm::vec3(1.0f, 0.5f, 1.0f), glm::vec3(0.7f, 0.7f, 0.7f)
+	};
+	const unsigned int paletteSize = sizeof(palette) / sizeof(palette[0]);
+
+	SceneDescription scene;
+	unsigned int stacks = (entityCount + STACK_HEIGHT - 1) / STACK_HEIGHT;
+	int side = std::max(1, (int)std::ceil(std::sqrt((float)stacks)));
+	float extent = (side - 1) * spacing * 0.5f;
+	scene.hasCamera = true;
+	scene.camera.position = glm::vec3(0.0f, 6.0f, extent + 8.0f);
+	scene.camera.pitch = -20.0f;
+	scene.meshes.push_back(SceneMesh{ "model", meshPath });
+	for (unsigned int i = 0; i < paletteSize; ++i)
+		scene.materials.push_back(SceneMaterial{ "tint" + std::to_string(i), palette[i], i == paletteSize - 1 ? 0.25f : 1.0f });
+
+	// every stack is a root turned about y with the rest stacked on it, in its space
+	srand(7);
+	scene.entities.resize(entityCount);
+	for (unsigned int i = 0; i < entityCount; ++i)
+	{
+		unsigned int stack = i / STACK_HEIGHT, level = i % STACK_HEIGHT;
+		SceneEntity& entity = scene.entities[i];
+		entity.name = "entity" + std::to_string(i);
+		entity.mesh = 0;
+		entity.material = rand() % paletteSize;
+		if (level == 0)
+		{
+			entity.position = glm::vec3((stack % side) * spacing - extent, -0.5f, (stack / side) * spacing - extent);
+			entity.rotation = glm::quat(glm::vec3(0.0f, glm::radians((float)(rand() % 360)), 0.0f));
+			entity.scale = glm::vec3(0.5f);
+		}
+		else
+		{
+			entity.parent = i - level;
+			entity.position = glm::vec3(0.0f, 3.5f * level, 0.0f);
+			entity.rotation = glm::quat(glm::vec3(0.0f, glm::radians(15.0f * level), 0.0f));
+		}
+	}
+
+	unsigned int lightCount = std::min(std::max(entityCount / 10, 1u), 1024u);
+	scene.lights.resize(lightCount);
+	for (SceneLight& light : scene.lights)
+	{
+		light.position.x = ((rand() % 1000) / 1000.0f * 2.0f - 1.0f) * (extent + spacing);
+		light.position.y = (rand() % 1000) / 1000.0f * 4.5f - 0.5f;
+		light.position.z = ((rand() % 1000) / 1000.0f * 2.0f - 1.0f) * (extent + spacing);
+		light.color = glm::vec3((rand() % 100) / 200.0f + 0.5f, (rand() % 100) / 200.0f + 0.5f, (rand() % 100) / 200.0f + 0.5f);
+	}
+	return scene;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <GLM/glm.hpp>
+#include <GLM/gtc/quaternion.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+const unsigned int SCENE_NONE = 0xffffffff;
+
+struct SceneCamera
+{
+	glm::vec3 position = glm::vec3(0.0f, 0.0f, 3.0f);
+	float yaw = -90.0f;
+	float pitch = 0.0f;
+	float zoom = 45.0f;
+};
+
+struct SceneMesh
+{
+	std::string name;
+	std::string path;
+};
+
+// Tints the mesh's own textures, specular scales its specular map
+struct SceneMaterial
+{
+	std::string name;
+	glm::vec3 color = glm::vec3(1.0f);
+	float specular = 1.0f;
+};
+
+// Transform relative to the parent, which always comes earlier in the list
+struct SceneEntity
+{
+	std::string name;
+	unsigned int mesh = 0;
+	unsigned int material = SCENE_NONE;
+	unsigned int parent = SCENE_NONE;
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// A radius of zero is worked out from the color and attenuation, see LightVolumeRadius
+struct SceneLight
+{
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 color = glm::vec3(1.0f);
+	float linear = 0.7f;
+	float quadratic = 1.8f;
+	float radius = 0.0f;
+};
+
+struct SceneDescription
+{
+	bool hasCamera = false;
+	SceneCamera camera;
+	std::vector<SceneMesh> meshes;
+	std::vector<SceneMaterial> materials;
+	std::vector<SceneEntity> entities;
+	std::vector<SceneLight> lights;
+};
+
+struct SceneLoadStats
+{
+	bool binary = false;
+	size_t bytes = 0;
+	unsigned int errors = 0; // text lines skipped
+	float loadMs = 0.0f;
+};
+
+// A scene on disk, in either form:
+//  - text, one record per line and # starts a comment; names and paths have no spaces
+//      camera   <x> <y> <z> [yaw] [pitch] [zoom]
+//      mesh     <name> <path>
+//      material <name> <r> <g> <b> [specular]
+//      entity   <name> <mesh> <x> <y> <z> [rotate <x> <y> <z>] [scale <x> <y> <z>] [material <name>] [parent <name>]
+//      light    <x> <y> <z> <r> <g> <b> [attenuation <linear> <quadratic>] [radius <r>]
+//    rotations are Euler angles in degrees, a record may only name what is declared above it;
+//  - binary, the same records as fixed size tables followed by a string table,
+//    read in one go and told apart from text by its magic.
+// The file's size and modification time are kept from the last Load so a
+// caller can poll HasChanged and reload it while running.
+class SceneFile
+{
+private:
+	std::string m_Path;
+	uint64_t m_Size;
+	int64_t m_Time;
+	SceneLoadStats m_Stats;
+
+public:
+	SceneFile(const std::string& path);
+
+	// Parses the file into scene, which is left alone when the file cannot be read
+	bool Load(SceneDescription& scene);
+	// The file was written since the last Load
+	bool HasChanged() const;
+
+	const std::string& GetPath() const;
+	const SceneLoadStats& GetStats() const;
+};
+
+// Binary for a .sceneb path, text otherwise
+bool SaveScene(const std::string& path, const SceneDescription& scene);
+bool SaveSceneText(const std::string& path, const SceneDescription& scene);
+bool SaveSceneBinary(const std::string& path, const SceneDescription& scene);
+
+// Same entities, in the same order, with the same meshes and parents; a reload
+// between two such scenes only has to move, retint and relight
+bool SameSceneStructure(const SceneDescription& a, const SceneDescription& b);
+
+// Distance at which a light of this color and attenuation falls below 5/256,
+// 0 for attenuation without falloff or a light dimmer than that to begin with
+float LightVolumeRadius(const glm::vec3& color, float linear, float quadratic);
+// Neither term negative and at least one positive, what scene files accept
+bool HasFalloff(float linear, float quadratic);
+
+// entityCount copies of meshPath in stacks of four on a square grid, with a few
+// materials and a light for every ten entities, at most 1024
+SceneDescription CreateStressScene(unsigned int entityCount, const std::string& meshPath);
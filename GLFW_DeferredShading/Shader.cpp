@@ -4,6 +4,27 @@
 #include <fstream>
 #include <sstream>
 
+static const unsigned int MAX_INCLUDE_DEPTH = 16;
+
+// True for an #include "file" line, files are resolved relative to the including file
+static bool IsInclude(const std::string& line)
+{
+	size_t start = line.find_first_not_of(" \t");
+	return start != std::string::npos && line.compare(start, 8, "#include") == 0;
+}
+
+static std::string IncludePath(const std::string& filepath, const std::string& line)
+{
+	size_t first = line.find('"');
+	size_t last = line.find('"', first + 1);
+	if (first == std::string::npos || last == std::string::npos)
+		return "";
+
+	size_t slash = filepath.find_last_of("/\\");
+	std::string directory = (slash == std::string::npos) ? "" : filepath.substr(0, slash + 1);
+	return directory + line.substr(first + 1, last - first - 1);
+}
+
 Shader::Shader(const std::string& filepath) : m_FilePath(filepath), m_RendererID(0)
 {
 	ShaderProgramSource source = ParseShader(filepath);
@@ -41,6 +62,10 @@ struct ShaderProgramSource Shader::ParseShader(const std::string& filepath)
 			else if (line.find("fragment") != std::string::npos)
 				type = ShaderType::FRAGMENT;
 		}
+		else if (IsInclude(line))
+		{
+			ss[(int)type] << ParseInclude(IncludePath(filepath, line), 1);
+		}
 		else
 		{
 			ss[(int)type] << line << '\n';
@@ -49,6 +74,33 @@ struct ShaderProgramSource Shader::ParseShader(const std::string& filepath)
 	return { ss[0].str(), ss[1].str() };
 }
 
+std::string Shader::ParseInclude(const std::string& filepath, unsigned int depth)
+{
+	if (depth > MAX_INCLUDE_DEPTH)
+	{
+		std::cout << "Shader include depth exceeded at " << filepath << ", check for an include cycle!" << std::endl;
+		return "";
+	}
+
+	std::ifstream stream(filepath);
+	if (!stream)
+	{
+		std::cout << "Failed to open shader include " << filepath << "!" << std::endl;
+		return "";
+	}
+
+	std::string line;
+	std::stringstream ss;
+	while (getline(stream, line))
+	{
+		if (IsInclude(line))
+			ss << ParseInclude(IncludePath(filepath, line), depth + 1);
+		else
+			ss << line << '\n';
+	}
+	return ss.str();
+}
+
 unsigned int Shader::CompileShader(unsigned int type, const std::string& source)
 {
 	unsigned int id = glCreateShader(type);
@@ -150,11 +202,27 @@ void Shader::SetUniform1i(const std::string& name, int value)
 	glUniform1i(GetUniformLocation(name), value);
 }
 
+void Shader::SetUniform3i(const std::string& name, glm::ivec3 value)
+{
+	glUniform3i(GetUniformLocation(name), value.x, value.y, value.z);
+}
+
 void Shader::SetUniformMatrix4fv(const std::string &name, const glm::mat4 &mat)
 {
 	glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
 
+void Shader::BindUniformBlock(const std::string& name, unsigned int binding)
+{
+	unsigned int index = glGetUniformBlockIndex(m_RendererID, name.c_str());
+	if (index == GL_INVALID_INDEX)
+	{
+		std::cout << "Warning: uniform block " << name << " doesn't exist!" << std::endl;
+		return;
+	}
+	glUniformBlockBinding(m_RendererID, index, binding);
+}
+
 int Shader::GetUniformLocation(const std::string& name)
 {
 	if (m_UniformLocationCache.find(name) != m_UniformLocationCache.end())
@@ -33,11 +33,15 @@ public:
 	void SetUniform2f(const std::string& name, glm::vec2 value);
 	void SetUniform1f(const std::string &name, float value);
 	void SetUniform1i(const std::string &name, int value);
+	void SetUniform3i(const std::string& name, glm::ivec3 value);
 	void SetUniformMatrix4fv(const std::string& name, const glm::mat4& mat);
+	void BindUniformBlock(const std::string& name, unsigned int binding);
 
 private:
 	int GetUniformLocation(const std::string& name);
 	struct ShaderProgramSource ParseShader(const std::string& filepath);
+	// Reads a file of shared GLSL, expanding any #include "file" lines it has in turn
+	std::string ParseInclude(const std::string& filepath, unsigned int depth);
 	unsigned int CompileShader(unsigned int type, const std::string& source);
 	unsigned int CreateShader(const std::string& vertexShader, const std::string& fragmentShader);
 };
\ No newline at end of file
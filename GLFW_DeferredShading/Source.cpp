@@ -7,19 +7,98 @@
 
 #include "Shader.h"
 #include "Camera.h"
+#include "Headless.h"
 #include "Model.h"
+#include "UniformBuffer.h"
+#include "LightClusters.h"
+#include "GBuffer.h"
+#include "MeshBenchmark.h"
+#include "LodSelector.h"
+#include "SceneBVH.h"
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
+#include "TransformSystem.h"
+#include "SceneFile.h"
 
 #include <GLM/glm.hpp>
 #include <GLM/gtc/matrix_transform.hpp>
 #include <GLM/gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <chrono>
 
-const unsigned int SCR_WIDTH = 1200;
-const unsigned int SCR_HEIGHT = 695;
+// window size, --width / --height replace it in headless mode
+unsigned int SCR_WIDTH = 1200;
+unsigned int SCR_HEIGHT = 695;
 float offset = 1.0f;
 
+// Instancing
+int objectCount = 9;
+bool useInstancing = true;
+
+// Level of detail, a backpack draws the coarsest level whose error stays under lodThreshold pixels;
+// --no-lod draws every one at full detail
+bool useLod = true;
+float lodThreshold = 1.0f;
+float lodHysteresis = 0.25f;
+
+// Culling, only backpacks whose box touches the view frustum are drawn; animateObjects bobs them
+// up and down so the BVH has to refit every frame; --cull-benchmark [count] times the BVH alone
+bool useCulling = true;
+bool animateObjects = false;
+
+// Occlusion culling, the largest triangles of the occluderCount nearest backpacks in the frustum are rasterized
+// into a small CPU depth buffer and every other backpack in the frustum is tested against it before it is drawn
+bool useOcclusion = true;
+int occluderCount = 8;
+
+// Scene file, --scene <file> takes the backpacks, their materials, the lights and the camera from a text or
+// binary scene and reloads it when the file changes; --scene-generate <file> [count] writes a stress scene
+// and --scene-convert <in> <out> rewrites one in the other form, binary for a .sceneb path
+std::string scenePath;
+const float SCENE_POLL_INTERVAL = 0.5f; // seconds between checks of the file
+
+// Lights
+enum LightingMode
+{
+	LIGHTING_FULLSCREEN = 0, // every pixel loops over every light
+	LIGHTING_CLUSTERED,      // every pixel loops over its cluster's lights
+	LIGHTING_VOLUMES,        // one instanced draw of back faces, depth tested against the scene
+	LIGHTING_VOLUMES_STENCIL, // stencil pass then lighting pass per light
+	LIGHTING_MODE_COUNT
+};
+const char* LIGHTING_MODE_NAMES[] = { "Full-screen", "Clustered", "Light Volumes", "Light Volumes (Stencil)" };
+int lightCount = 32;
+int lightingMode = LIGHTING_CLUSTERED;
+
+// Light benchmark, lighting pass time for every count in every mode
+const int BENCHMARK_LIGHT_COUNTS[] = { 32, 128, 512, 1024, 2048, 4096 };
+const int BENCHMARK_STEPS = LIGHTING_MODE_COUNT * sizeof(BENCHMARK_LIGHT_COUNTS) / sizeof(BENCHMARK_LIGHT_COUNTS[0]);
+const int BENCHMARK_WARMUP_FRAMES = 10;
+const int BENCHMARK_FRAMES = 100;
+
+// G-Buffer layout, packed rebuilds position from depth and stores octahedral normals
+bool packedGBuffer = false;
+
+// Vertex layout of the model, --float-vertices uploads the full float Vertex instead of the quantized one
+VertexLayout vertexLayout = VERTEX_LAYOUT_QUANTIZED;
+
+// G-Buffer report, geometry and lighting pass time for both layouts at each size
+const glm::uvec2 REPORT_SIZES[] = { glm::uvec2(1920, 1080), glm::uvec2(3840, 2160) };
+const int REPORT_STEPS = 2 * sizeof(REPORT_SIZES) / sizeof(REPORT_SIZES[0]);
+
+// Uniform blocks, laid out std140 to match the shaders
+const unsigned int CAMERA_BINDING = 0;
+
+struct CameraUniforms
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 viewPos;
+};
+
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+Headless headless;
 float lastX = (float)SCR_WIDTH / 2.0;
 float lastY = (float)SCR_HEIGHT / 2.0;
 bool firstMouse = true;
@@ -34,14 +113,50 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 unsigned int loadTexture(char const* path, bool gammaCorrection);
+void createCube();
 void renderCube();
+void renderCubeInstanced(const InstanceBuffer& instances);
+std::vector<glm::vec3> CreateObjectPositions(int count);
+std::vector<LightData> CreateLights(int count, float radiusScale);
+std::vector<LightData> CreateSceneLights(const SceneDescription& scene, float radiusScale);
 void renderQuad();
+void createSphere();
+void renderSphere();
+void renderSphereInstanced(const InstanceBuffer& instances);
+void createReportTarget(unsigned int& fbo, unsigned int& color, unsigned int& depth, unsigned int width, unsigned int height);
 
 unsigned int quadVAO = 0, quadVBO;
 unsigned int cubeVAO = 0, cubeVBO;
+unsigned int sphereVAO = 0, sphereIndexCount;
 
-int main()
+int main(int argc, char** argv)
 {
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--float-vertices")
+			vertexLayout = VERTEX_LAYOUT_FLOAT;
+		else if (std::string(argv[i]) == "--no-lod")
+			useLod = false;
+		else if (std::string(argv[i]) == "--cull-benchmark")
+			return RunCullBenchmark(i + 1 < argc ? (unsigned int)std::max(1, std::atoi(argv[i + 1])) : 100000);
+		else if (std::string(argv[i]) == "--transform-benchmark")
+			return RunTransformBenchmark(i + 1 < argc ? (unsigned int)std::max(1, std::atoi(argv[i + 1])) : 1000000);
+		else if (std::string(argv[i]) == "--scene" && i + 1 < argc)
+			scenePath = argv[++i];
+		else if (std::string(argv[i]) == "--scene-generate" && i + 1 < argc)
+		{
+			unsigned int count = i + 2 < argc ? (unsigned int)std::max(1, std::atoi(argv[i + 2])) : 10000;
+			return SaveScene(argv[i + 1], CreateStressScene(count, "res/models/backpack/backpack.obj")) ? 0 : 1;
+		}
+		else if (std::string(argv[i]) == "--scene-convert" && i + 2 < argc)
+		{
+			SceneDescription scene;
+			SceneFile input(argv[i + 1]);
+			return input.Load(scene) && SaveScene(argv[i + 2], scene) ? 0 : 1;
+		}
+	}
+	headless.ParseArguments(argc, argv, SCR_WIDTH, SCR_HEIGHT);
+
 	GLFWwindow* window = InitWindow();
 	if (!window)
 		return -1;
@@ -49,180 +164,668 @@ int main()
 	Shader shaderGeometryPass("res/shaders/GeometryBuffer.shader");
 	Shader shaderLightingPass("res/shaders/DeferredShading.shader");
 	Shader shaderLightBox("res/shaders/LightBox.shader");
-
-	Model backpack("res/models/backpack/backpack.obj");
-	std::vector<glm::vec3> objectPositions;
-	objectPositions.push_back(glm::vec3(-3.0, -0.5, -3.0));
-	objectPositions.push_back(glm::vec3( 0.0, -0.5, -3.0));
-	objectPositions.push_back(glm::vec3( 3.0, -0.5, -3.0));
-	objectPositions.push_back(glm::vec3(-3.0, -0.5,  0.0));
-	objectPositions.push_back(glm::vec3( 0.0, -0.5,  0.0));
-	objectPositions.push_back(glm::vec3( 3.0, -0.5,  0.0));
-	objectPositions.push_back(glm::vec3(-3.0, -0.5,  3.0));
-	objectPositions.push_back(glm::vec3( 0.0, -0.5,  3.0));
-	objectPositions.push_back(glm::vec3( 3.0, -0.5,  3.0));
-
-	unsigned int gBuffer;
-	glGenFramebuffers(1, &gBuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-
-	unsigned int gPosition, gNormal, gAlbedoSpec;
-
-	// position color buffer
-	glGenTextures(1, &gPosition);
-	glBindTexture(GL_TEXTURE_2D, gPosition);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
-
-	// normal color buffer
-	glGenTextures(1, &gNormal);
-	glBindTexture(GL_TEXTURE_2D, gNormal);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
-
-	// color + specular color buffer
-	glGenTextures(1, &gAlbedoSpec);
-	glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedoSpec, 0);
-
-	unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-	glDrawBuffers(3, attachments);
-
-	// create and attach render buffer
-	unsigned int rboDepth;
-	glGenRenderbuffers(1, &rboDepth);
-	glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "Framebuffer not complete!" << std::endl;
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// Lighting setup
-	const unsigned int NR_LIGHTS = 32;
-	std::vector<glm::vec3> lightPositions;
-	std::vector<glm::vec3> lightColors;
-	srand(13);
-	for (unsigned int i = 0; i < NR_LIGHTS; i++)
+	Shader shaderLightVolume("res/shaders/LightVolume.shader");
+
+	UniformBuffer cameraUniforms(sizeof(CameraUniforms), CAMERA_BINDING);
+	shaderGeometryPass.BindUniformBlock("Camera", CAMERA_BINDING);
+	shaderLightingPass.BindUniformBlock("Camera", CAMERA_BINDING);
+	shaderLightBox.BindUniformBlock("Camera", CAMERA_BINDING);
+	shaderLightVolume.BindUniformBlock("Camera", CAMERA_BINDING);
+
+	// the demo draws one model, a scene picks it with its first mesh and every entity is drawn with it
+	SceneFile sceneFile(scenePath);
+	SceneDescription scene;
+	bool useScene = !scenePath.empty() && sceneFile.Load(scene);
+	bool sceneStructureChanged = useScene, sceneValuesChanged = useScene;
+	float sceneCheckTime = 0.0f;
+	std::string modelPath = "res/models/backpack/backpack.obj";
+	if (useScene)
 	{
-		// calculate slightly random offsets
-		float xPos = ((rand() % 100) / 100.0) * 6.0 - 3.0;
-		float yPos = ((rand() % 100) / 100.0) * 6.0 - 4.0;
-		float zPos = ((rand() % 100) / 100.0) * 6.0 - 3.0;
-		lightPositions.push_back(glm::vec3(xPos, yPos, zPos));
-
-		// calculate random color
-		float rColor = ((rand() & 100) / 200.0f) + 0.5;
-		float gColor = ((rand() & 100) / 200.0f) + 0.5;
-		float bColor = ((rand() & 100) / 200.0f) + 0.5;
-		lightColors.push_back(glm::vec3(rColor, gColor, bColor));
+		if (!scene.meshes.empty())
+			modelPath = scene.meshes[0].path;
+		if (scene.meshes.size() > 1)
+			std::cout << "Scene: " << scene.meshes.size() << " meshes, every entity is drawn with " << modelPath << std::endl;
+		if (scene.hasCamera)
+		{
+			camera = Camera(scene.camera.position, glm::vec3(0.0f, 1.0f, 0.0f), scene.camera.yaw, scene.camera.pitch);
+			camera.Zoom = scene.camera.zoom;
+		}
 	}
 
+	std::shared_ptr<Model> backpack = AssetRegistry::Get().AcquireModel(modelPath, false, vertexLayout);
+	AssetRegistry::Get().PrintReport();
+	// the backpacks' transforms, and their world matrices as instances
+	ThreadPool workerPool;
+	TransformSystem objectTransforms(&workerPool);
+	std::vector<glm::vec3> objectPositions; // where the backpacks stand when not animated
+	std::vector<InstanceData> objectInstances;
+	InstanceBuffer objectInstanceBuffer;
+	bool objectsMoved = false;
+
+	// levels are picked per backpack against its bounding sphere; instanced, the backpacks are
+	// regrouped by level into one buffer and each level drawn from its own base instance
+	LodSelector lodSelector;
+	lodSelector.SetErrors(backpack->lodErrors);
+	const VertexBounds& modelBounds = backpack->GetBounds();
+	glm::vec3 modelCenter = (modelBounds.minimum + modelBounds.maximum) * 0.5f;
+	float modelRadius = glm::length(modelBounds.maximum - modelBounds.minimum) * 0.5f;
+	std::vector<unsigned int> objectLods;
+	std::vector<unsigned int> lodCounts;
+	float lodSelectMs = 0.0f;
+
+	// a backpack's box is the model's, the union of its meshes' boxes from import, moved by its
+	// transform; instanced, the visible backpacks sorted by level are the draw list
+	BoundingBox modelBox;
+	modelBox.minimum = modelBounds.minimum;
+	modelBox.maximum = modelBounds.maximum;
+	SceneBVH sceneBVH;
+	std::vector<BoundingBox> objectBoxes;
+	std::vector<unsigned int> visibleObjects;
+	std::vector<unsigned int> drawOrder, previousDrawOrder;
+	std::vector<InstanceData> drawInstances;
+	InstanceBuffer drawInstanceBuffer;
+	unsigned int frustumVisibleCount = 0;
+
+	OcclusionCuller occlusionCuller(256, 128, &workerPool);
+	std::vector<unsigned int> occluderObjects;
+	std::vector<unsigned int> occludeeObjects;
+	std::vector<bool> objectIsOccluder;
+
+	GBuffer gBuffer(SCR_WIDTH, SCR_HEIGHT, packedGBuffer);
+
+	// Lighting setup, lights are rebuilt whenever the count or radius changes
+	const float Z_NEAR = 0.1f;
+	const float Z_FAR = 100.0f;
+	LightClusters clusters(Z_NEAR, Z_FAR);
+	std::vector<LightData> lights;
+	std::vector<InstanceData> lightInstances;
+	InstanceBuffer lightInstanceBuffer;
+	std::vector<InstanceData> volumeInstances;
+	InstanceBuffer volumeInstanceBuffer;
+	int lightsCount = -1;
+	float lightsOffset = -1.0f;
+	bool lightsFromScene = false;
+	float submitMs = 0.0f;
+	float uniformMs = 0.0f;
+
+	// geometry and lighting pass GPU time, read back a frame late so it never stalls
+	unsigned int geometryQueries[2], lightingQueries[2];
+	glGenQueries(2, geometryQueries);
+	glGenQueries(2, lightingQueries);
+	unsigned int frameIndex = 0;
+	float geometryMs = 0.0f;
+	float lightingMs = 0.0f;
+	// the geometry pass time as last measured without and with occlusion culling
+	bool geometryQueryOcclusion[2] = { false, false };
+	float geometryMsByOcclusion[2] = { 0.0f, 0.0f };
+
+	int benchmarkStep = -1, benchmarkFrame = 0;
+	float benchmarkLightingMs = 0.0f, benchmarkBinMs = 0.0f, benchmarkFrameMs = 0.0f;
+	std::vector<glm::vec3> benchmarkResults; // lighting ms, binning ms, frame ms per step
+	std::vector<VertexBenchmarkResult> vertexBenchmarkResults;
+
+	// the report renders offscreen at its own sizes and shows the result scaled to the window
+	int reportStep = -1, reportFrame = 0;
+	float reportGeometryMs = 0.0f, reportLightingMs = 0.0f;
+	std::vector<glm::vec3> reportResults; // geometry ms, lighting ms, bytes per pixel per step
+	unsigned int reportFBO = 0, reportColor = 0, reportDepth = 0;
+	glm::uvec2 reportTargetSize = glm::uvec2(0);
+
 	shaderLightingPass.Bind();
 	shaderLightingPass.SetUniform1i("gPosition", 0);
 	shaderLightingPass.SetUniform1i("gNormal", 1);
 	shaderLightingPass.SetUniform1i("gAlbedoSpec", 2);
+	shaderLightingPass.SetUniform1i("gDepth", 3);
+	shaderLightingPass.SetUniform1i("lightData", 4);
+	shaderLightingPass.SetUniform1i("clusterGrid", 5);
+	shaderLightingPass.SetUniform1i("clusterLights", 6);
+	shaderLightingPass.SetUniform3i("clusterDims", glm::ivec3(LightClusters::TILES_X, LightClusters::TILES_Y, LightClusters::SLICES));
+	shaderLightingPass.SetUniform2f("clusterDepth", glm::vec2(Z_NEAR, std::log(Z_FAR / Z_NEAR)));
+
+	shaderLightVolume.Bind();
+	shaderLightVolume.SetUniform1i("gPosition", 0);
+	shaderLightVolume.SetUniform1i("gNormal", 1);
+	shaderLightVolume.SetUniform1i("gAlbedoSpec", 2);
+	shaderLightVolume.SetUniform1i("gDepth", 3);
 
 	ImGui::CreateContext();
 	ImGui_ImplGlfwGL3_Init(window, true);
 	ImGui::StyleColorsDark();
 
+	// untinted unless a scene material says otherwise
+	shaderGeometryPass.Bind();
+	shaderGeometryPass.SetUniform4f("tint", glm::vec4(1.0f));
+
 	glUseProgram(0);
 
 	// Game Loop
 	while (!glfwWindowShouldClose(window))
 	{
-		float currentFrame = glfwGetTime();
+		float currentFrame = headless.GetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		processInput(window);
+		headless.UpdateCamera(camera);
+
+		// a reload that keeps the entities only moves, retints and relights them, anything else starts over
+		if (useScene && currentFrame - sceneCheckTime >= SCENE_POLL_INTERVAL)
+		{
+			sceneCheckTime = currentFrame;
+			SceneDescription reloaded;
+			if (sceneFile.HasChanged() && sceneFile.Load(reloaded))
+			{
+				if (!reloaded.meshes.empty() && reloaded.meshes[0].path != modelPath)
+					std::cout << "Scene: the model cannot change while running, still drawing " << modelPath << std::endl;
+				sceneStructureChanged = !SameSceneStructure(scene, reloaded);
+				sceneValuesChanged = true;
+				if (!sceneStructureChanged)
+				{
+					for (unsigned int i = 0; i < scene.entities.size(); i++)
+					{
+						const SceneEntity& before = scene.entities[i];
+						const SceneEntity& after = reloaded.entities[i];
+						if (before.position != after.position)
+							objectTransforms.SetPosition(i, after.position);
+						if (before.rotation != after.rotation)
+							objectTransforms.SetRotation(i, after.rotation);
+						if (before.scale != after.scale)
+							objectTransforms.SetScale(i, after.scale);
+					}
+				}
+				scene = std::move(reloaded);
+			}
+		}
 
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		ImGui_ImplGlfwGL3_NewFrame();
 
+		// Benchmark, each step runs one light count in one mode then records the averages
+		if (benchmarkStep >= 0)
+		{
+			lightCount = BENCHMARK_LIGHT_COUNTS[benchmarkStep / LIGHTING_MODE_COUNT];
+			lightingMode = benchmarkStep % LIGHTING_MODE_COUNT;
+			if (benchmarkFrame >= BENCHMARK_WARMUP_FRAMES)
+			{
+				benchmarkLightingMs += lightingMs;
+				benchmarkBinMs += (lightingMode == LIGHTING_CLUSTERED) ? clusters.GetStats().binMs : 0.0f;
+				benchmarkFrameMs += deltaTime * 1000.0f;
+			}
+
+			if (++benchmarkFrame == BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES)
+			{
+				benchmarkResults.push_back(glm::vec3(benchmarkLightingMs, benchmarkBinMs, benchmarkFrameMs) / (float)BENCHMARK_FRAMES);
+				benchmarkLightingMs = benchmarkBinMs = benchmarkFrameMs = 0.0f;
+				benchmarkFrame = 0;
+				if (++benchmarkStep == BENCHMARK_STEPS)
+				{
+					std::cout << "Lights\tLighting Pass (ms)\tBinning (ms)\tFrame (ms)\tMode" << std::endl;
+					for (int i = 0; i < BENCHMARK_STEPS; ++i)
+					{
+						std::cout << BENCHMARK_LIGHT_COUNTS[i / LIGHTING_MODE_COUNT] << "\t" << benchmarkResults[i].x << "\t\t\t"
+							<< benchmarkResults[i].y << "\t\t" << benchmarkResults[i].z << "\t\t" << LIGHTING_MODE_NAMES[i % LIGHTING_MODE_COUNT] << std::endl;
+					}
+					benchmarkStep = -1;
+					glfwSwapInterval(1);
+				}
+			}
+		}
+
+		// G-Buffer report, each step runs one size in one layout then records the averages
+		if (reportStep >= 0)
+		{
+			if (reportFrame >= BENCHMARK_WARMUP_FRAMES)
+			{
+				reportGeometryMs += geometryMs;
+				reportLightingMs += lightingMs;
+			}
+
+			if (++reportFrame == BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES)
+			{
+				reportResults.push_back(glm::vec3(reportGeometryMs / BENCHMARK_FRAMES, reportLightingMs / BENCHMARK_FRAMES, gBuffer.GetBytesPerPixel()));
+				reportGeometryMs = reportLightingMs = 0.0f;
+				reportFrame = 0;
+				if (++reportStep == REPORT_STEPS)
+				{
+					// traffic counts every G-buffer byte written once by the geometry pass and read once by the
+					// lighting pass; light volumes and overdraw add to it, so it is a lower bound
+					std::cout << "Resolution\tLayout\tBytes/Pixel\tTraffic (MB/frame)\tGeometry (ms)\tLighting (ms)\tGPU FPS\tBandwidth (GB/s)" << std::endl;
+					for (int i = 0; i < REPORT_STEPS; ++i)
+					{
+						glm::uvec2 size = REPORT_SIZES[i / 2];
+						float trafficMB = 2.0f * reportResults[i].z * size.x * size.y / (1024.0f * 1024.0f);
+						float gpuFPS = 1000.0f / (reportResults[i].x + reportResults[i].y);
+						std::cout << size.x << "x" << size.y << "\t" << (i % 2 ? "Packed" : "Full") << "\t" << reportResults[i].z << "\t\t"
+							<< trafficMB << "\t\t\t" << reportResults[i].x << "\t\t" << reportResults[i].y << "\t\t"
+							<< gpuFPS << "\t" << trafficMB * gpuFPS / 1024.0f << std::endl;
+					}
+					reportStep = -1;
+					glfwSwapInterval(1);
+					createReportTarget(reportFBO, reportColor, reportDepth, 0, 0);
+					reportTargetSize = glm::uvec2(0);
+				}
+			}
+		}
+
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+
+		glm::uvec2 renderSize = (reportStep >= 0) ? REPORT_SIZES[reportStep / 2] : glm::uvec2(SCR_WIDTH, SCR_HEIGHT);
+		gBuffer.Resize(renderSize.x, renderSize.y, (reportStep >= 0) ? (reportStep % 2 == 1) : packedGBuffer);
+
+		// lighting goes straight to the window unless the report is rendering at its own size
+		unsigned int outputFBO = 0;
+		glm::vec2 outputSize = glm::vec2(framebufferWidth, framebufferHeight);
+		if (reportStep >= 0)
+		{
+			if (reportTargetSize != renderSize)
+			{
+				createReportTarget(reportFBO, reportColor, reportDepth, renderSize.x, renderSize.y);
+				reportTargetSize = renderSize;
+			}
+			outputFBO = reportFBO;
+			outputSize = glm::vec2(renderSize);
+			glViewport(0, 0, renderSize.x, renderSize.y);
+		}
+
 		// 1 - Geometry Pass
-		glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.GetID());
 			
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glBeginQuery(GL_TIME_ELAPSED, geometryQueries[frameIndex % 2]);
+			geometryQueryOcclusion[frameIndex % 2] = useOcclusion;
+			headless.BeginPass("Geometry");
 		
-			glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+			glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)renderSize.x / (float)renderSize.y, Z_NEAR, Z_FAR);
 			glm::mat4 view = camera.GetViewMatrix();
-			glm::mat4 model;
+
+			auto uniformStart = std::chrono::high_resolution_clock::now();
+			CameraUniforms cameraData;
+			cameraData.projection = projection;
+			cameraData.view = view;
+			cameraData.viewPos = glm::vec4(camera.Position, 1.0f);
+			cameraUniforms.SetData(&cameraData, sizeof(cameraData));
+
+			// the light benchmark sets its own counts, scene or not
+			bool sceneLights = useScene && benchmarkStep < 0;
+			if (sceneLights)
+				lightCount = (int)scene.lights.size();
+			if (lightsCount != lightCount || lightsOffset != offset || lightsFromScene != sceneLights || (sceneLights && sceneValuesChanged))
+			{
+				lights = sceneLights ? CreateSceneLights(scene, offset) : CreateLights(lightCount, offset);
+				clusters.SetLights(lights);
+
+				lightInstances.resize(lights.size());
+				for (unsigned int i = 0; i < lights.size(); i++)
+				{
+					lightInstances[i].model = glm::translate(glm::mat4(1.0f), lights[i].position);
+					lightInstances[i].model = glm::scale(lightInstances[i].model, glm::vec3(0.125f));
+					lightInstances[i].color = glm::vec4(lights[i].color, 1.0f);
+				}
+				lightInstanceBuffer.Upload(lightInstances);
+
+				// volumes are unit spheres scaled to the light radius, attenuation in params
+				volumeInstances.resize(lights.size());
+				for (unsigned int i = 0; i < lights.size(); i++)
+				{
+					volumeInstances[i].model = glm::translate(glm::mat4(1.0f), lights[i].position);
+					volumeInstances[i].model = glm::scale(volumeInstances[i].model, glm::vec3(lights[i].radius));
+					volumeInstances[i].params = glm::vec4(lights[i].linear, lights[i].quadratic, lights[i].radius, 0.0f);
+					volumeInstances[i].color = glm::vec4(lights[i].color, 1.0f);
+				}
+				volumeInstanceBuffer.Upload(volumeInstances);
+
+				lightsCount = lightCount;
+				lightsOffset = offset;
+				lightsFromScene = sceneLights;
+			}
+			uniformMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - uniformStart).count();
+
+			bool objectsChanged = useScene ? sceneStructureChanged : objectInstances.size() != (size_t)objectCount;
+			bool objectsRetinted = false;
+			if (objectsChanged && useScene)
+			{
+				objectPositions.clear();
+				objectTransforms.Clear();
+				for (const SceneEntity& entity : scene.entities)
+				{
+					objectPositions.push_back(entity.position);
+					objectTransforms.Create(entity.position, entity.rotation, entity.scale, entity.parent);
+				}
+				objectCount = (int)scene.entities.size();
+				objectInstances.assign(objectCount, InstanceData());
+				objectsMoved = false;
+			}
+			else if (objectsChanged)
+			{
+				objectPositions = CreateObjectPositions(objectCount);
+				objectTransforms.Clear();
+				for (const glm::vec3& position : objectPositions)
+					objectTransforms.Create(position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+				objectInstances.assign(objectCount, InstanceData());
+				objectsMoved = false;
+			}
+			if (useScene && sceneValuesChanged)
+			{
+				for (unsigned int i = 0; i < scene.entities.size(); i++)
+				{
+					const SceneEntity& entity = scene.entities[i];
+					objectPositions[i] = entity.position;
+					if (entity.material != SCENE_NONE)
+						objectInstances[i].color = glm::vec4(scene.materials[entity.material].color, scene.materials[entity.material].specular);
+					else
+						objectInstances[i].color = glm::vec4(1.0f);
+				}
+				objectsRetinted = true;
+			}
+			sceneStructureChanged = sceneValuesChanged = false;
+			if (animateObjects || objectsMoved)
+			{
+				for (unsigned int i = 0; i < objectPositions.size(); i++)
+				{
+					glm::vec3 bob(0.0f, animateObjects ? std::sin(currentFrame * 2.0f + i) * 0.5f : 0.0f, 0.0f);
+					objectTransforms.SetPosition(i, objectPositions[i] + bob);
+				}
+			}
+			objectsMoved = animateObjects;
+
+			// only the transforms that changed are recomputed, the instances, boxes and tree follow only then
+			objectTransforms.Update();
+			bool moving = objectTransforms.GetStats().updated > 0;
+			if (moving)
+			{
+				const std::vector<glm::mat4>& worlds = objectTransforms.GetWorldMatrices();
+				for (unsigned int i = 0; i < objectInstances.size(); i++)
+					objectInstances[i].model = worlds[i];
+			}
+			if (moving || objectsRetinted)
+				objectInstanceBuffer.Upload(objectInstances);
+
+			auto submitStart = std::chrono::high_resolution_clock::now();
+
+			// moved backpacks keep their place in the tree, only a new count needs a build
+			if (moving)
+			{
+				objectBoxes.resize(objectInstances.size());
+				for (unsigned int i = 0; i < objectInstances.size(); i++)
+					objectBoxes[i] = TransformBoundingBox(modelBox, objectInstances[i].model);
+				if (objectsChanged)
+					sceneBVH.Build(objectBoxes);
+				else
+					sceneBVH.Refit(objectBoxes);
+			}
+			if (useCulling)
+			{
+				sceneBVH.Cull(ExtractFrustum(projection * view), visibleObjects);
+			}
+			else
+			{
+				visibleObjects.resize(objectInstances.size());
+				for (unsigned int i = 0; i < objectInstances.size(); i++)
+					visibleObjects[i] = i;
+			}
+
+			// the nearest backpacks hide the most, they are the occluders
+			frustumVisibleCount = (unsigned int)visibleObjects.size();
+			if (useOcclusion)
+			{
+				unsigned int occluders = std::min((unsigned int)occluderCount, frustumVisibleCount);
+				auto distance = [&objectInstances](unsigned int i) { return glm::distance(glm::vec3(objectInstances[i].model[3]), camera.Position); };
+				occluderObjects = visibleObjects;
+				std::partial_sort(occluderObjects.begin(), occluderObjects.begin() + occluders, occluderObjects.end(),
+					[&distance](unsigned int a, unsigned int b) { return distance(a) < distance(b); });
+
+				occlusionCuller.Begin(projection * view);
+				for (unsigned int i = 0; i < occluders; i++)
+				{
+					occlusionCuller.AddOccluder(backpack->occluderPositions.data(), backpack->occluderIndices.data(), (unsigned int)backpack->occluderIndices.size(),
+						objectInstances[occluderObjects[i]].model);
+				}
+				occlusionCuller.Rasterize();
+
+				// the occluders are drawn whatever happens, none is tested against its own triangles
+				objectIsOccluder.assign(objectInstances.size(), false);
+				for (unsigned int i = 0; i < occluders; i++)
+					objectIsOccluder[occluderObjects[i]] = true;
+				occludeeObjects.clear();
+				for (unsigned int i : visibleObjects)
+				{
+					if (!objectIsOccluder[i])
+						occludeeObjects.push_back(i);
+				}
+				occlusionCuller.RemoveOccluded(occludeeObjects, [&objectBoxes](unsigned int i, glm::vec3& minimum, glm::vec3& maximum)
+				{
+					minimum = objectBoxes[i].minimum;
+					maximum = objectBoxes[i].maximum;
+				});
+
+				// both lists keep the frustum order, so they merge back into it
+				unsigned int kept = 0, next = 0;
+				for (unsigned int i : visibleObjects)
+				{
+					if (objectIsOccluder[i])
+						visibleObjects[kept++] = i;
+					else if (next < occludeeObjects.size() && occludeeObjects[next] == i)
+						visibleObjects[kept++] = occludeeObjects[next++];
+				}
+				visibleObjects.resize(kept);
+			}
+
+			// instanced levels need a base instance (GL 4.2), without it everything stays at full detail
+			unsigned int lodCount = backpack->GetLodCount();
+			bool selectLods = useLod && lodCount > 1 && (!useInstancing || GLAD_GL_VERSION_4_2);
+			if (objectLods.size() != objectInstances.size())
+				objectLods.assign(objectInstances.size(), 0);
+			lodCounts.assign(lodCount, 0);
+			auto lodStart = std::chrono::high_resolution_clock::now();
+			if (selectLods)
+			{
+				lodSelector.SetProjection(glm::radians(camera.Zoom), (float)renderSize.y, Z_NEAR);
+				lodSelector.SetThreshold(lodThreshold, lodHysteresis);
+				for (unsigned int i : visibleObjects)
+				{
+					const glm::mat4& transform = objectInstances[i].model;
+					glm::vec3 center = glm::vec3(transform * glm::vec4(modelCenter, 1.0f));
+					float scale = glm::length(glm::vec3(transform[0]));
+					objectLods[i] = lodSelector.Select(glm::distance(center, camera.Position), modelRadius, scale, objectLods[i]);
+					++lodCounts[objectLods[i]];
+				}
+			}
+			else
+			{
+				for (unsigned int i : visibleObjects)
+					objectLods[i] = 0;
+				lodCounts[0] = (unsigned int)visibleObjects.size();
+			}
+
+			// a counting sort by level, uploaded again only when the list changed or the backpacks moved
+			bool useDrawList = useInstancing && (selectLods || useCulling);
+			if (useDrawList)
+			{
+				std::vector<unsigned int> lodFirst(lodCount, 0);
+				for (unsigned int lod = 1; lod < lodCount; lod++)
+					lodFirst[lod] = lodFirst[lod - 1] + lodCounts[lod - 1];
+				drawOrder.resize(visibleObjects.size());
+				for (unsigned int i : visibleObjects)
+					drawOrder[lodFirst[objectLods[i]]++] = i;
+				if (moving || objectsRetinted || drawOrder != previousDrawOrder || drawInstances.size() != drawOrder.size())
+				{
+					drawInstances.resize(drawOrder.size());
+					for (unsigned int i = 0; i < drawOrder.size(); i++)
+						drawInstances[i] = objectInstances[drawOrder[i]];
+					drawInstanceBuffer.Upload(drawInstances);
+					previousDrawOrder = drawOrder;
+				}
+			}
+			else
+			{
+				previousDrawOrder.clear();
+			}
+			lodSelectMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - lodStart).count();
 
 			shaderGeometryPass.Bind();
-			shaderGeometryPass.SetUniformMatrix4fv("projection", projection);
-			shaderGeometryPass.SetUniformMatrix4fv("view", view);
-			for (unsigned int i = 0; i < objectPositions.size(); i++)
+			shaderGeometryPass.SetUniform1i("instanced", useInstancing);
+			shaderGeometryPass.SetUniform1i("packedGBuffer", gBuffer.IsPacked());
+			if (useDrawList)
+			{
+				unsigned int firstInstance = 0;
+				for (unsigned int lod = 0; lod < lodCount; lod++)
+				{
+					if (lodCounts[lod] > 0)
+						backpack->DrawInstanced(shaderGeometryPass, drawInstanceBuffer, lod, firstInstance, lodCounts[lod]);
+					firstInstance += lodCounts[lod];
+				}
+			}
+			else if (useInstancing)
 			{
-				model = glm::mat4(1.0f);
-				model = glm::translate(model, objectPositions[i]);
-				model = glm::scale(model, glm::vec3(0.5f));
-				shaderGeometryPass.SetUniformMatrix4fv("model", model);
-				backpack.Draw(shaderGeometryPass);
+				backpack->DrawInstanced(shaderGeometryPass, objectInstanceBuffer);
 			}
+			else
+			{
+				for (unsigned int i : visibleObjects)
+				{
+					shaderGeometryPass.SetUniformMatrix4fv("model", objectInstances[i].model);
+					shaderGeometryPass.SetUniform4f("tint", objectInstances[i].color);
+					backpack->Draw(shaderGeometryPass, objectLods[i]);
+				}
+				shaderGeometryPass.SetUniform4f("tint", glm::vec4(1.0f));
+			}
+			submitMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - submitStart).count();
+			headless.EndPass();
+			glEndQuery(GL_TIME_ELAPSED);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
 
-		// 2 - Lighting Pass
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// 2 - Lighting Pass, only ambient when the light volumes add the lights afterwards
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 		
+		bool volumeLighting = (lightingMode == LIGHTING_VOLUMES || lightingMode == LIGHTING_VOLUMES_STENCIL);
+		glm::mat4 gBufferInverse = glm::inverse(projection * view); // clip space back to world space
+		// binned and uploaded on the CPU before the pass so neither lands in the GPU lighting time
+		if (lightingMode == LIGHTING_CLUSTERED)
+			clusters.Build(projection, view, lights);
+		glBeginQuery(GL_TIME_ELAPSED, lightingQueries[frameIndex % 2]);
+		headless.BeginPass("Lighting");
+
 		shaderLightingPass.Bind();
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, gPosition);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, gNormal);
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-
-		for (unsigned int i = 0; i < lightPositions.size(); i++)
+		shaderLightingPass.SetUniform1i("clustered", lightingMode == LIGHTING_CLUSTERED);
+		shaderLightingPass.SetUniform1i("lightCount", volumeLighting ? 0 : (int)clusters.GetLightCount());
+		shaderLightingPass.SetUniform1i("packedGBuffer", gBuffer.IsPacked());
+		shaderLightingPass.SetUniformMatrix4fv("gBufferInverse", gBufferInverse);
+		gBuffer.BindTextures(0);
+		clusters.Bind(4);
+
+		renderQuad();
+
+		// 2.5 - Copy content of geometry's depth buffer to default framebuffer's depth buffer; both are
+		// single sampled D24S8 (see InitWindow), the light volumes below depend on this copy
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer.GetID());
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFBO); // write to default framebuffer, or the report target
+		glBlitFramebuffer(0, 0, gBuffer.GetWidth(), gBuffer.GetHeight(), 0, 0, gBuffer.GetWidth(), gBuffer.GetHeight(), GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+
+		// 2.75 - Light volumes, each light adds itself only where its sphere covers scene geometry
+		if (volumeLighting)
 		{
-			shaderLightingPass.SetUniform3f("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-			shaderLightingPass.SetUniform3f("lights[" + std::to_string(i) + "].Color", lightColors[i]);
-
-			// update attenuation parameters
-			const float constant = 1.0;
-			const float linear = 0.7;
-			const float quadratic = 1.8;
-			shaderLightingPass.SetUniform1f("lights[" + std::to_string(i) + "].Linear", linear);
-			shaderLightingPass.SetUniform1f("lights[" + std::to_string(i) + "].Quadratic", quadratic);
-
-			// calculate radius of light volume
-			const float maxBrightness = std::fmaxf(std::fmaxf(lightColors[i].r, lightColors[i].g), lightColors[i].b);
-			float radius = (-linear + std::sqrt(linear * linear - 4 * quadratic * (constant - (256.0f / 5.0f) * maxBrightness))) / (2.0f * quadratic);
-			radius *= offset;
-			shaderLightingPass.SetUniform1f("lights[" + std::to_string(i) + "].Radius", radius);
+			shaderLightVolume.Bind();
+			shaderLightVolume.SetUniform2f("screenSize", outputSize);
+			shaderLightVolume.SetUniform1i("packedGBuffer", gBuffer.IsPacked());
+			shaderLightVolume.SetUniformMatrix4fv("gBufferInverse", gBufferInverse);
+			gBuffer.BindTextures(0);
+
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_ONE, GL_ONE);
+			glDepthMask(GL_FALSE);
+			glEnable(GL_CULL_FACE);
+
+			if (lightingMode == LIGHTING_VOLUMES)
+			{
+				// back faces pass wherever the scene is in front of them, the shader rejects what lies in front of the light
+				shaderLightVolume.SetUniform1i("instanced", 1);
+				glCullFace(GL_FRONT);
+				glDepthFunc(GL_GEQUAL);
+				renderSphereInstanced(volumeInstanceBuffer);
+			}
+			else
+			{
+				// stencil counts back faces behind the scene minus front faces behind it, non-zero means
+				// the scene is inside the volume; the lighting draw then resets the stencil it touches
+				shaderLightVolume.SetUniform1i("instanced", 0);
+				glEnable(GL_STENCIL_TEST);
+				for (unsigned int i = 0; i < volumeInstances.size(); i++)
+				{
+					shaderLightVolume.SetUniformMatrix4fv("model", volumeInstances[i].model);
+					shaderLightVolume.SetUniform4f("lightParams", volumeInstances[i].params);
+					shaderLightVolume.SetUniform3f("lightColor", lights[i].color);
+
+					glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+					glDisable(GL_CULL_FACE);
+					glDepthFunc(GL_LESS);
+					glStencilFunc(GL_ALWAYS, 0, 0xFF);
+					glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+					glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+					renderSphere();
+
+					glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+					glEnable(GL_CULL_FACE);
+					glCullFace(GL_FRONT);
+					glDepthFunc(GL_ALWAYS);
+					glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+					glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+					renderSphere();
+				}
+				glDisable(GL_STENCIL_TEST);
+			}
+
+			glCullFace(GL_BACK);
+			glDisable(GL_CULL_FACE);
+			glDepthFunc(GL_LESS);
+			glDepthMask(GL_TRUE);
+			glDisable(GL_BLEND);
 		}
-		shaderLightingPass.SetUniform3f("viewPos", camera.Position);
-		renderQuad();
+		headless.EndPass();
+		glEndQuery(GL_TIME_ELAPSED);
 
-		// 2.5 - Copy content of geometry's depth buffer to default framebuffer's depth buffer
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); // write to default framebuffer
-		glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (frameIndex > 0)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(geometryQueries[(frameIndex + 1) % 2], GL_QUERY_RESULT, &elapsed);
+			geometryMs = elapsed / 1000000.0f;
+			geometryMsByOcclusion[geometryQueryOcclusion[(frameIndex + 1) % 2]] = geometryMs;
+			glGetQueryObjectui64v(lightingQueries[(frameIndex + 1) % 2], GL_QUERY_RESULT, &elapsed);
+			lightingMs = elapsed / 1000000.0f;
+		}
+		++frameIndex;
 
 		// 3 - Render Lights
+		headless.BeginPass("Light Boxes");
 		shaderLightBox.Bind();
-		shaderLightBox.SetUniformMatrix4fv("projection", projection);
-		shaderLightBox.SetUniformMatrix4fv("view", view);
-		for (unsigned int i = 0; i < lightPositions.size(); i++)
+		shaderLightBox.SetUniform1i("instanced", useInstancing);
+		if (useInstancing)
+		{
+			renderCubeInstanced(lightInstanceBuffer);
+		}
+		else
 		{
-			model = glm::mat4(1.0f);
-			model = glm::translate(model, lightPositions[i]);
-			model = glm::scale(model, glm::vec3(0.125f));
-			shaderLightBox.SetUniformMatrix4fv("model", model);
-			shaderLightBox.SetUniform3f("lightColor", lightColors[i]);
-			renderCube();
+			for (unsigned int i = 0; i < lights.size(); i++)
+			{
+				shaderLightBox.SetUniformMatrix4fv("model", lightInstances[i].model);
+				shaderLightBox.SetUniform3f("lightColor", lights[i].color);
+				renderCube();
+			}
+		}
+		headless.EndPass();
+
+		// a scaled color blit needs single sampled framebuffers at both ends, which the report target and window are
+		if (outputFBO != 0)
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, outputFBO);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			glBlitFramebuffer(0, 0, renderSize.x, renderSize.y, 0, 0, framebufferWidth, framebufferHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, framebufferWidth, framebufferHeight);
 		}
 
 		// ImGui Window
@@ -231,6 +834,159 @@ int main()
 			if (ImGui::CollapsingHeader("Lighting"))
 			{
 				ImGui::SliderFloat("Radius", &offset, 0.0f, 1.5f, "%.1f");
+				if (lightsFromScene)
+					ImGui::Text("Lights: %d from the scene", lightCount);
+				else
+					ImGui::SliderInt("Lights", &lightCount, 1, 4096);
+				ImGui::Combo("Mode", &lightingMode, LIGHTING_MODE_NAMES, LIGHTING_MODE_COUNT);
+				ImGui::Text("CPU Uniform Update: %.3f ms", uniformMs);
+				ImGui::Text("Lighting Pass (GPU): %.3f ms", lightingMs);
+				if (lightingMode == LIGHTING_CLUSTERED)
+				{
+					const ClusterStats& stats = clusters.GetStats();
+					ImGui::Text("Light Binning (CPU): %.3f ms, %.3f ms with uploads", stats.binMs, stats.buildMs);
+					ImGui::Text("Active Clusters: %u / %u", stats.activeClusters, LightClusters::CLUSTER_COUNT);
+					ImGui::Text("Light Indices: %u (max %u per cluster)", stats.lightIndices, stats.maxLightsPerCluster);
+					if (stats.overflow > 0)
+						ImGui::Text("Dropped: %u (cluster limit %u)", stats.overflow, LightClusters::MAX_LIGHTS_PER_CLUSTER);
+				}
+
+				if (benchmarkStep < 0 && reportStep < 0 && ImGui::Button("Run Benchmark"))
+				{
+					// uncapped so frame times aren't rounded up to the refresh rate
+					glfwSwapInterval(0);
+					benchmarkResults.clear();
+					benchmarkStep = 0;
+					benchmarkFrame = 0;
+				}
+				else if (benchmarkStep >= 0)
+				{
+					ImGui::Text("Benchmarking %d lights (%s)...", lightCount, LIGHTING_MODE_NAMES[lightingMode]);
+				}
+			}
+
+			if (ImGui::CollapsingHeader("G-Buffer"))
+			{
+				ImGui::Checkbox("Packed", &packedGBuffer);
+				ImGui::Text("Layout: %u bytes/pixel (%.1f MB)", gBuffer.GetBytesPerPixel(), gBuffer.GetBytesPerPixel() * gBuffer.GetWidth() * gBuffer.GetHeight() / (1024.0f * 1024.0f));
+				ImGui::Text("Geometry Pass (GPU): %.3f ms", geometryMs);
+
+				if (reportStep < 0 && benchmarkStep < 0 && ImGui::Button("Run Report"))
+				{
+					glfwSwapInterval(0);
+					reportResults.clear();
+					reportStep = 0;
+					reportFrame = 0;
+				}
+				else if (reportStep >= 0)
+				{
+					ImGui::Text("Reporting %ux%u (%s)...", renderSize.x, renderSize.y, gBuffer.IsPacked() ? "Packed" : "Full");
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Mesh"))
+			{
+				const ModelLoadStats& load = backpack->loadStats;
+				if (load.fromCache)
+					ImGui::Text("Optimized at import, loaded from the mesh cache");
+				else
+				{
+					ImGui::Text("Vertices: %u -> %u (%u triangles)", load.verticesBefore, load.verticesAfter, load.triangles);
+					ImGui::Text("ACMR: %.3f -> %.3f, optimized in %.1f ms", load.acmrBefore, load.acmrAfter, load.optimizeMs);
+				}
+
+				ImGui::Text("Vertex Memory: %.1f KB %s (%.1f KB as floats)", load.vertexBytes / 1024.0f, GetVertexLayoutName(backpack->vertexLayout), load.floatVertexBytes / 1024.0f);
+				if (backpack->vertexLayout == VERTEX_LAYOUT_QUANTIZED)
+				{
+					ImGui::Text("Position Error: max %.6f, mean %.6f", load.quantization.positionMax, load.quantization.positionMean);
+					ImGui::Text("Normal Error: max %.3f deg, mean %.3f deg", load.quantization.normalMaxDegrees, load.quantization.normalMeanDegrees);
+				}
+
+				AssetRegistryStats assets = AssetRegistry::Get().GetStats();
+				ImGui::Text("Assets: %u models, %u meshes (%.1f KB), %u textures (%.1f MB)", assets.liveModels, assets.liveMeshes, assets.meshBytes / 1024.0f, assets.liveTextures, assets.textureBytes / (1024.0f * 1024.0f));
+				ImGui::Text("Asset Requests: %u shared, %u loaded", assets.hits, assets.misses);
+				MeshArenaStats arenas = MeshArena::GetStats();
+				ImGui::Text("Mesh Arenas: %u, %u meshes, %.1f KB used of %.1f KB, %u grows", arenas.arenas, arenas.allocations, arenas.usedBytes / 1024.0f, arenas.capacityBytes / 1024.0f, arenas.grows);
+				if (ImGui::Button("Print Asset Report"))
+					AssetRegistry::Get().PrintReport();
+
+				if (benchmarkStep < 0 && reportStep < 0 && ImGui::Button("Run Vertex Benchmark"))
+					vertexBenchmarkResults = RunVertexBenchmark("res/models/backpack/backpack.obj", shaderGeometryPass);
+				for (const VertexBenchmarkResult& result : vertexBenchmarkResults)
+				{
+					ImGui::Text("%s: %u vertices, ACMR %.3f, %llu VS invocations, %.3f ms", result.order.c_str(), result.vertices, result.acmr,
+						(unsigned long long)result.shaderInvocations, result.gpuMs);
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Instancing"))
+			{
+				// a multi-draw batch is one call however many meshes it holds
+				bool indirect = backpack->multiDraw && MeshArena::SupportsMultiDrawIndirect();
+				unsigned int modelCalls = indirect ? backpack->GetDrawBatchCount() : (unsigned int)backpack->meshes.size();
+				unsigned int drawCalls = modelCalls * (useInstancing ? 1 : (unsigned int)visibleObjects.size()) + (useInstancing ? 1 : lightCount);
+				ImGui::Checkbox("Instanced", &useInstancing);
+				ImGui::Checkbox("Multi-Draw Indirect", &backpack->multiDraw);
+				if (!MeshArena::SupportsMultiDrawIndirect())
+					ImGui::Text("No GL 4.3, batches use glDrawElementsBaseVertex");
+				ImGui::Text("Meshes: %u in %u batches", (unsigned int)backpack->meshes.size(), backpack->GetDrawBatchCount());
+				if (useScene)
+				{
+					const SceneLoadStats& sceneStats = sceneFile.GetStats();
+					ImGui::Text("Backpacks: %d from %s", objectCount, sceneFile.GetPath().c_str());
+					ImGui::Text("Scene: %s, %u KB, loaded in %.3f ms", sceneStats.binary ? "binary" : "text", (unsigned int)(sceneStats.bytes / 1024), sceneStats.loadMs);
+				}
+				else
+				{
+					ImGui::SliderInt("Backpacks", &objectCount, 1, 100000);
+				}
+				ImGui::Text("Draw Calls: %u", drawCalls);
+				ImGui::Text("CPU Submit (Geometry Pass): %.3f ms", submitMs);
+				const TransformStats& transformStats = objectTransforms.GetStats();
+				ImGui::Text("Transforms: %u of %u updated in %.3f ms", transformStats.updated, transformStats.transforms, transformStats.updateMs);
+			}
+
+			if (ImGui::CollapsingHeader("Level of Detail"))
+			{
+				ImGui::Checkbox("Enabled", &useLod);
+				if (useInstancing && !GLAD_GL_VERSION_4_2)
+					ImGui::Text("No GL 4.2 base instance, instanced backpacks stay at full detail");
+				ImGui::SliderFloat("Threshold (px)", &lodThreshold, 0.25f, 16.0f);
+				ImGui::SliderFloat("Hysteresis", &lodHysteresis, 0.0f, 0.9f);
+
+				unsigned long long triangles = 0, fullTriangles = 0;
+				for (unsigned int lod = 0; lod < lodCounts.size() && lod < backpack->lodTriangles.size(); lod++)
+				{
+					triangles += (unsigned long long)lodCounts[lod] * backpack->lodTriangles[lod];
+					fullTriangles += (unsigned long long)lodCounts[lod] * backpack->lodTriangles[0];
+					ImGui::Text("LOD %u: %u triangles, error %.4f, %u backpacks", lod, backpack->lodTriangles[lod], backpack->lodErrors[lod], lodCounts[lod]);
+				}
+				ImGui::Text("Triangles: %.2f M of %.2f M at full detail", triangles / 1000000.0, fullTriangles / 1000000.0);
+				ImGui::Text("Selection: %.3f ms, Geometry Pass GPU: %.3f ms", lodSelectMs, geometryMs);
+			}
+
+			if (ImGui::CollapsingHeader("Culling"))
+			{
+				const CullStats& cullStats = sceneBVH.GetStats();
+				ImGui::Checkbox("Frustum Culling", &useCulling);
+				ImGui::Checkbox("Animate Backpacks", &animateObjects);
+				ImGui::Text("In Frustum: %u of %u backpacks, %u drawn", frustumVisibleCount, (unsigned int)objectInstances.size(), (unsigned int)visibleObjects.size());
+				if (useCulling)
+					ImGui::Text("Nodes: %u visited of %u, %u subtrees fully inside", cullStats.nodesVisited, cullStats.nodes, cullStats.fullyInside);
+				ImGui::Text("Build: %.3f ms, Refit: %.3f ms, Cull: %.3f ms", cullStats.buildMs, cullStats.refitMs, useCulling ? cullStats.cullMs : 0.0f);
+
+				ImGui::NewLine();
+				ImGui::Checkbox("Occlusion Culling", &useOcclusion);
+				ImGui::SliderInt("Occluders", &occluderCount, 1, 64);
+				if (useOcclusion)
+				{
+					const OcclusionStats& occlusionStats = occlusionCuller.GetStats();
+					ImGui::Text("Occluded: %u of %u backpacks", occlusionStats.occluded, occlusionStats.tested);
+					ImGui::Text("Depth Buffer: %ux%u, %u occluders, %u triangles", occlusionCuller.GetWidth(), occlusionCuller.GetHeight(), occlusionStats.occluders, occlusionStats.triangles);
+					ImGui::Text("CPU: rasterize %.3f ms (%u threads), mips %.3f ms, test %.3f ms", occlusionStats.rasterizeMs, workerPool.GetThreadCount(),
+						occlusionStats.mipMs, occlusionStats.testMs);
+				}
+				ImGui::Text("Geometry Pass GPU: %.3f ms with occlusion culling, %.3f ms without", geometryMsByOcclusion[1], geometryMsByOcclusion[0]);
 			}
 
 			if (ImGui::CollapsingHeader("Application Info"))
@@ -239,6 +995,7 @@ int main()
 				ImGui::Text("Shader Version: %s", glGetString(GL_SHADING_LANGUAGE_VERSION));
 				ImGui::Text("Hardware: %s", glGetString(GL_RENDERER));
 				ImGui::NewLine();
+				ImGui::Text("Model Load: %.1f ms, %s (geometry %.1f ms, textures %.1f ms)", backpack->loadStats.totalMs, backpack->loadStats.fromCache ? "mesh cache" : "Assimp import", backpack->loadStats.geometryMs, backpack->loadStats.textureMs);
 				ImGui::Text("Frametime: %.3f / Framerate: (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 			}
 
@@ -252,24 +1009,28 @@ int main()
 		}
 		ImGui::End();
 		ImGui::Render();
-		ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		if (!headless.IsEnabled())
+			ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		headless.EndFrame(window);
 
 		glfwPollEvents();
 		glfwSwapBuffers(window);
 	}
-	glDeleteFramebuffers(1, &gBuffer);
-	glDeleteRenderbuffers(1, &rboDepth);
-
-	glDeleteTextures(1, &gPosition);
-	glDeleteTextures(1, &gNormal);
-	glDeleteTextures(1, &gAlbedoSpec);
+	glDeleteQueries(2, geometryQueries);
+	glDeleteQueries(2, lightingQueries);
+	createReportTarget(reportFBO, reportColor, reportDepth, 0, 0);
 
 	glDeleteVertexArrays(1, &quadVAO);
 	glDeleteVertexArrays(1, &cubeVAO);
+	glDeleteVertexArrays(1, &sphereVAO);
 
 	glDeleteBuffers(1, &quadVBO);
 	glDeleteBuffers(1, &cubeVBO);
 
+	// last handle, the registry frees the model's meshes and textures while the context is alive, then the arenas go
+	backpack.reset();
+	MeshArena::ReleaseAll();
+
 	ImGui_ImplGlfwGL3_Shutdown();
 	ImGui::DestroyContext();
 	glfwTerminate();
@@ -283,10 +1044,15 @@ GLFWwindow* InitWindow()
 		std::cout << "Failed to initialise GLFW!" << std::endl;
 		return nullptr;
 	}
-	glfwWindowHint(GLFW_SAMPLES, 4);
+	// the G-buffer depth is blitted into the back buffer and the light volumes test against it; a blit
+	// into a multisampled framebuffer is invalid, so the window is single sampled with the G-buffer's D24S8
+	glfwWindowHint(GLFW_SAMPLES, 0);
+	glfwWindowHint(GLFW_DEPTH_BITS, 24);
+	glfwWindowHint(GLFW_STENCIL_BITS, 8);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	headless.ApplyWindowHints();
 
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Deferred Shading", NULL, NULL);
 	if (window == NULL)
@@ -296,7 +1062,7 @@ GLFWwindow* InitWindow()
 		return nullptr;
 	}
 	glfwMakeContextCurrent(window);
-	glfwSwapInterval(1);
+	glfwSwapInterval(headless.IsEnabled() ? 0 : 1);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetWindowPos(window, 100, 100);
 
@@ -427,77 +1193,183 @@ unsigned int loadTexture(char const* path, bool gammaCorrection)
 	return textureID;
 }
 
+void createCube()
+{
+	if (cubeVAO != 0)
+		return;
+
+	float vertices[] = {
+		// back face
+		-1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
+		 1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
+		 1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
+		 1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
+		-1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
+		-1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
+		// front face
+		-1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
+		 1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
+		 1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
+		 1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
+		-1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
+		-1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
+		// left face
+		-1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
+		-1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
+		-1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
+		-1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
+		-1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
+		-1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
+		// right face
+		 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
+		 1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
+		 1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
+		 1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
+		 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
+		 1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
+		// bottom face
+		-1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
+		 1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
+		 1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
+		 1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
+		-1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
+		-1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
+		// top face
+		-1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
+		 1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
+		 1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
+		 1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
+		-1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
+		-1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
+	};
+
+	glGenVertexArrays(1, &cubeVAO);
+	glGenBuffers(1, &cubeVBO);
+
+	glBindVertexArray(cubeVAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices, GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+
+	glBindVertexArray(0);
+}
+
 void renderCube()
 {
-	if (cubeVAO == 0)
+	createCube();
+
+	glBindVertexArray(cubeVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 36);
+	glBindVertexArray(0);
+}
+
+void renderCubeInstanced(const InstanceBuffer& instances)
+{
+	static unsigned int attachedInstances = 0;
+	createCube();
+	if (attachedInstances != instances.GetID())
 	{
-		float vertices[] = {
-			// back face
-			-1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-			 1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-			 1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
-			 1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-			-1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-			-1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
-			// front face
-			-1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-			 1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
-			 1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-			 1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-			-1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
-			-1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-			// left face
-			-1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-			-1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
-			-1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-			-1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-			-1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-			-1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-			// right face
-			 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-			 1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-			 1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
-			 1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-			 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-			 1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
-			// bottom face
-			-1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-			 1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
-			 1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-			 1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-			-1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-			-1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-			// top face
-			-1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-			 1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-			 1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
-			 1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-			-1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-			-1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
-		};
+		instances.Attach(cubeVAO, MESH_INSTANCE_LOCATION);
+		attachedInstances = instances.GetID();
+	}
 
-		glGenVertexArrays(1, &cubeVAO);
-		glGenBuffers(1, &cubeVBO);
+	glBindVertexArray(cubeVAO);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, 36, instances.GetCount());
+	glBindVertexArray(0);
+}
 
-		glBindVertexArray(cubeVAO);
+void createSphere()
+{
+	if (sphereVAO != 0)
+		return;
 
-		glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices, GL_STATIC_DRAW);
+	// low poly light volume, pushed out so its faces enclose the unit sphere rather than cut into it
+	const unsigned int X_SEGMENTS = 16;
+	const unsigned int Y_SEGMENTS = 12;
+	const float PI = 3.14159265359;
+	const float scale = 1.0f / (std::cos(PI / X_SEGMENTS) * std::cos(PI / (2.0f * Y_SEGMENTS)));
 
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	std::vector<glm::vec3> positions;
+	for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
+	{
+		for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
+		{
+			float xSegment = (float)x / (float)X_SEGMENTS;
+			float ySegment = (float)y / (float)Y_SEGMENTS;
+			float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+			float yPos = std::cos(ySegment * PI);
+			float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+			positions.push_back(glm::vec3(xPos, yPos, zPos) * scale);
+		}
+	}
 
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	// counter-clockwise from outside so face culling can pick front or back faces
+	std::vector<unsigned int> indices;
+	for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
+	{
+		for (unsigned int x = 0; x < X_SEGMENTS; ++x)
+		{
+			unsigned int current = y * (X_SEGMENTS + 1) + x;
+			unsigned int below = (y + 1) * (X_SEGMENTS + 1) + x;
+			indices.push_back(current);
+			indices.push_back(current + 1);
+			indices.push_back(below);
+			indices.push_back(below);
+			indices.push_back(current + 1);
+			indices.push_back(below + 1);
+		}
+	}
+	sphereIndexCount = indices.size();
 
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+	unsigned int vbo, ebo;
+	glGenVertexArrays(1, &sphereVAO);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
 
-		glBindVertexArray(0);
+	glBindVertexArray(sphereVAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+	glBindVertexArray(0);
+}
+
+void renderSphere()
+{
+	createSphere();
+
+	glBindVertexArray(sphereVAO);
+	glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+}
+
+void renderSphereInstanced(const InstanceBuffer& instances)
+{
+	static unsigned int attachedInstances = 0;
+	createSphere();
+	if (attachedInstances != instances.GetID())
+	{
+		instances.Attach(sphereVAO, MESH_INSTANCE_LOCATION);
+		attachedInstances = instances.GetID();
 	}
 
-	glBindVertexArray(cubeVAO);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
+	glBindVertexArray(sphereVAO);
+	glDrawElementsInstanced(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0, instances.GetCount());
 	glBindVertexArray(0);
 }
 
@@ -533,4 +1405,102 @@ void renderQuad()
 	glBindVertexArray(quadVAO);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 	glBindVertexArray(0);
+}
+
+std::vector<glm::vec3> CreateObjectPositions(int count)
+{
+	// square grid 3 units apart, a count of 9 gives the original 3x3 layout
+	std::vector<glm::vec3> positions(count);
+	int side = (int)std::ceil(std::sqrt((float)count));
+	for (int i = 0; i < count; ++i)
+	{
+		float x = (i % side - (side - 1) * 0.5f) * 3.0f;
+		float z = (i / side - (side - 1) * 0.5f) * 3.0f;
+		positions[i] = glm::vec3(x, -0.5f, z);
+	}
+	return positions;
+}
+
+std::vector<LightData> CreateLights(int count, float radiusScale)
+{
+	// the first 32 lights are the original set, the ones past them spread out over x and z
+	std::vector<LightData> lights(count);
+	float spread = std::sqrt(std::max(count / 32.0f, 1.0f));
+	srand(13);
+	for (int i = 0; i < count; i++)
+	{
+		// calculate slightly random offsets
+		float scale = (i < 32) ? 1.0f : spread;
+		float xPos = (((rand() % 100) / 100.0) * 6.0 - 3.0) * scale;
+		float yPos = ((rand() % 100) / 100.0) * 6.0 - 4.0;
+		float zPos = (((rand() % 100) / 100.0) * 6.0 - 3.0) * scale;
+
+		// calculate random color
+		float rColor = ((rand() & 100) / 200.0f) + 0.5;
+		float gColor = ((rand() & 100) / 200.0f) + 0.5;
+		float bColor = ((rand() & 100) / 200.0f) + 0.5;
+
+		// update attenuation parameters
+		const float linear = 0.7;
+		const float quadratic = 1.8;
+
+		// calculate radius of light volume
+		float radius = LightVolumeRadius(glm::vec3(rColor, gColor, bColor), linear, quadratic);
+
+		lights[i].position = glm::vec3(xPos, yPos, zPos);
+		lights[i].color = glm::vec3(rColor, gColor, bColor);
+		lights[i].linear = linear;
+		lights[i].quadratic = quadratic;
+		lights[i].radius = radius * radiusScale;
+	}
+	return lights;
+}
+
+std::vector<LightData> CreateSceneLights(const SceneDescription& scene, float radiusScale)
+{
+	std::vector<LightData> lights(scene.lights.size());
+	for (unsigned int i = 0; i < lights.size(); i++)
+	{
+		const SceneLight& light = scene.lights[i];
+		float radius = light.radius > 0.0f ? light.radius : LightVolumeRadius(light.color, light.linear, light.quadratic);
+		lights[i].position = light.position;
+		lights[i].color = light.color;
+		lights[i].linear = light.linear;
+		lights[i].quadratic = light.quadratic;
+		lights[i].radius = radius * radiusScale;
+	}
+	return lights;
+}
+
+// (Re)creates the offscreen report target, a size of zero only frees it
+void createReportTarget(unsigned int& fbo, unsigned int& color, unsigned int& depth, unsigned int width, unsigned int height)
+{
+	if (fbo != 0)
+	{
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteTextures(1, &color);
+		glDeleteRenderbuffers(1, &depth);
+		fbo = color = depth = 0;
+	}
+	if (width == 0 || height == 0)
+		return;
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+	glGenTextures(1, &color);
+	glBindTexture(GL_TEXTURE_2D, color);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+
+	// same format as the G-buffer depth so it can be blitted across, stencil for the light volumes
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Report framebuffer not complete!" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Fixed set of worker threads consuming a shared job queue
+class ThreadPool
+{
+private:
+	std::vector<std::thread> m_Workers;
+	std::queue<std::function<void()>> m_Jobs;
+	std::mutex m_Mutex;
+	std::condition_variable m_JobAvailable;
+	std::condition_variable m_JobsFinished;
+	unsigned int m_ActiveJobs;
+	bool m_Stop;
+
+public:
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	void Enqueue(std::function<void()> job);
+	void Wait();
+
+	// Runs func(i) for every i in [0, count) across the workers and blocks until all are done
+	void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& func);
+
+	unsigned int GetThreadCount() const;
+
+private:
+	void WorkerLoop();
+};
@@ -0,0 +1,41 @@
+#include "UniformBuffer.h"
+
+#include <iostream>
+
+UniformBuffer::UniformBuffer(unsigned int size, unsigned int binding) : m_Size(size), m_Binding(binding)
+{
+	glGenBuffers(1, &m_UBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+	glBufferData(GL_UNIFORM_BUFFER, m_Size, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, m_Binding, m_UBO);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	glDeleteBuffers(1, &m_UBO);
+}
+
+void UniformBuffer::SetData(const void* data, unsigned int size, unsigned int offset)
+{
+	if (offset + size > m_Size)
+	{
+		std::cout << "Uniform buffer write of " << size << " bytes at " << offset << " exceeds its size of " << m_Size << std::endl;
+		return;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+unsigned int UniformBuffer::GetID() const
+{
+	return m_UBO;
+}
+
+unsigned int UniformBuffer::GetBinding() const
+{
+	return m_Binding;
+}
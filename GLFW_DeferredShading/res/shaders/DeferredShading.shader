@@ -17,53 +17,87 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
-uniform sampler2D gAlbedoSpec;
+#include "GBuffer.glsl"
 
 struct Light
 {
 	vec3 Position;
-	vec3 Color;
-
 	float Linear;
+	vec3 Color;
 	float Quadratic;
 	float Radius;
 };
 
-const int NR_LIGHTS = 32;
-uniform Light lights[NR_LIGHTS];
-uniform vec3 viewPos;
+// Lights, three RGBA32F texels each (see LightData)
+uniform samplerBuffer lightData;
+uniform int lightCount;
+
+// Clustered mode, (offset, count) per cluster into the light index list
+uniform bool clustered;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLights;
+uniform ivec3 clusterDims; // tiles x, tiles y, depth slices
+uniform vec2 clusterDepth; // near plane, log(far / near)
+
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
+
+Light fetchLight(int index)
+{
+	vec4 a = texelFetch(lightData, index * 3);
+	vec4 b = texelFetch(lightData, index * 3 + 1);
+	vec4 c = texelFetch(lightData, index * 3 + 2);
+	return Light(a.xyz, a.w, b.rgb, b.w, c.x);
+}
+
+vec3 shade(Light light, vec3 FragPos, vec3 Normal, vec3 Albedo, float Specular, vec3 viewDir)
+{
+	float distance = length(light.Position - FragPos);
+	if (distance >= light.Radius)
+		return vec3(0.0);
+
+	vec3 lightDir = normalize(light.Position - FragPos);
+	vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Albedo * light.Color;
+
+	vec3 halfwayDir = normalize(lightDir + viewDir);
+	float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
+	vec3 specular = light.Color * spec * Specular;
+
+	float attenuation = 1.0 / (1.0 + light.Linear * distance + light.Quadratic * distance * distance);
+	return (diffuse + specular) * attenuation;
+}
 
 void main()
 {
 	// Get data from gBuffer
-	vec3 FragPos = texture(gPosition, TexCoords).rgb;
-	vec3 Normal = texture(gNormal, TexCoords).rgb;
-	vec3 Albedo = texture(gAlbedoSpec, TexCoords).rgb;
-	float Specular = texture(gAlbedoSpec, TexCoords).a;
+	vec3 FragPos = gBufferPosition(TexCoords);
+	vec3 Normal = gBufferNormal(TexCoords);
+	vec3 Albedo = gBufferAlbedo(TexCoords);
+	float Specular = gBufferSpecular(TexCoords);
 
 	// calculate lighting as usual
 	vec3 lighting = Albedo * 0.1;
 	vec3 viewDir = normalize(viewPos - FragPos);
-	for (int i = 0; i < NR_LIGHTS; ++i)
+	if (clustered)
+	{
+		// same tile and exponential slice mapping as LightClusters on the CPU
+		float depth = -(view * vec4(FragPos, 1.0)).z;
+		int slice = clamp(int(floor(log(max(depth, clusterDepth.x) / clusterDepth.x) / clusterDepth.y * float(clusterDims.z))), 0, clusterDims.z - 1);
+		ivec2 tile = min(ivec2(TexCoords * vec2(clusterDims.xy)), clusterDims.xy - 1);
+		int cluster = (slice * clusterDims.y + tile.y) * clusterDims.x + tile.x;
+
+		uvec2 range = texelFetch(clusterGrid, cluster).rg;
+		for (uint i = 0u; i < range.y; ++i)
+			lighting += shade(fetchLight(int(texelFetch(clusterLights, int(range.x + i)).r)), FragPos, Normal, Albedo, Specular, viewDir);
+	}
+	else
 	{
-		float distance = length(lights[i].Position - FragPos);
-		if (distance < lights[i].Radius)
-		{
-			vec3 lightDir = normalize(lights[i].Position - FragPos);
-			vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Albedo * lights[i].Color;
-
-			vec3 halfwayDir = normalize(lightDir + viewDir);
-			float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
-			vec3 specular = lights[i].Color * spec * Specular;
-
-			float attenuation = 1.0 / (1.0 + lights[i].Linear * distance + lights[i].Quadratic * distance * distance);
-			diffuse *= attenuation;
-			specular *= attenuation;
-			
-			lighting += diffuse + specular;
-		}
+		for (int i = 0; i < lightCount; ++i)
+			lighting += shade(fetchLight(i), FragPos, Normal, Albedo, Specular, viewDir);
 	}
 
 	FragColor = vec4(lighting, 1.0);
@@ -0,0 +1,65 @@
+// Shared G-buffer encoding, see GBuffer.h for the two layouts.
+// Geometry shaders write encodeNormal(), lighting shaders read through
+// gBufferPosition() / gBufferNormal() and don't care which layout is bound.
+uniform bool packedGBuffer;
+
+uniform sampler2D gPosition;   // full layout only
+uniform sampler2D gNormal;     // RGBA16F normal, or RG16 octahedral when packed
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gDepth;      // packed layout only
+
+// clip space back to the space positions are stored in
+uniform mat4 gBufferInverse;
+
+vec2 octahedralWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// unit normal onto the octahedron, unfolded into [0, 1]
+vec2 encodeOctahedral(vec3 n)
+{
+	n /= (abs(n.x) + abs(n.y) + abs(n.z));
+	n.xy = (n.z >= 0.0 ? n.xy : octahedralWrap(n.xy));
+	return n.xy * 0.5 + 0.5;
+}
+
+vec3 decodeOctahedral(vec2 f)
+{
+	f = f * 2.0 - 1.0;
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+// what a geometry shader writes to the normal target
+vec3 encodeNormal(vec3 n)
+{
+	return (packedGBuffer ? vec3(encodeOctahedral(n), 0.0) : n);
+}
+
+vec3 gBufferNormal(vec2 uv)
+{
+	return (packedGBuffer ? decodeOctahedral(texture(gNormal, uv).rg) : texture(gNormal, uv).rgb);
+}
+
+vec3 gBufferPosition(vec2 uv)
+{
+	if (!packedGBuffer)
+		return texture(gPosition, uv).rgb;
+
+	vec4 clip = vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+	vec4 position = gBufferInverse * clip;
+	return position.xyz / position.w;
+}
+
+vec3 gBufferAlbedo(vec2 uv)
+{
+	return texture(gAlbedoSpec, uv).rgb;
+}
+
+float gBufferSpecular(vec2 uv)
+{
+	return texture(gAlbedoSpec, uv).a;
+}
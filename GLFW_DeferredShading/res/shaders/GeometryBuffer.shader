@@ -3,46 +3,64 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
+layout(location = 5) in mat4 aInstanceModel; // InstanceData, see MESH_INSTANCE_LOCATION
+layout(location = 10) in vec4 aInstanceColor; // material tint in rgb, specular scale in a
 
 out VS_OUT
 {
 	vec3 FragPos;
 	vec3 Normal;
 	vec2 TexCoords;
+	vec4 Tint;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
 uniform mat4 model;
+uniform bool quantized; // VERTEX_LAYOUT_QUANTIZED mesh, positions are unorm16 within its bounds
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform bool instanced;
+uniform vec4 tint;
 
 void main()
 {
-	vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
-	vs_out.Normal = mat3(transpose(inverse(model))) * aNormal;
+	vec3 position = quantized ? positionOffset + aPos * positionScale : aPos;
+	mat4 world = (instanced ? aInstanceModel : model);
+	vs_out.FragPos = vec3(world * vec4(position, 1.0));
+	vs_out.Normal = mat3(transpose(inverse(world))) * aNormal;
 	vs_out.TexCoords = aTexCoords;
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	vs_out.Tint = (instanced ? aInstanceColor : tint);
+	gl_Position = projection * view * world * vec4(position, 1.0);
 };
 
 #shader fragment
 #version 330 core
-layout(location = 0) out vec3 gPosition;
-layout(location = 1) out vec3 gNormal;
-layout(location = 2) out vec4 gAlbedoSpec;
+layout(location = 0) out vec3 outPosition;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec4 outAlbedoSpec;
 
 in VS_OUT
 {
 	vec3 FragPos;
 	vec3 Normal;
 	vec2 TexCoords;
+	vec4 Tint;
 } fs_in;
 
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
 
+#include "GBuffer.glsl"
+
 void main()
 {
-	gPosition = fs_in.FragPos;
-	gNormal = normalize(fs_in.Normal);
-	gAlbedoSpec.rgb = texture(texture_diffuse1, fs_in.TexCoords).rgb;
-	gAlbedoSpec.a = texture(texture_specular1, fs_in.TexCoords).r;
+	outPosition = fs_in.FragPos;
+	outNormal = encodeNormal(normalize(fs_in.Normal));
+	outAlbedoSpec.rgb = texture(texture_diffuse1, fs_in.TexCoords).rgb * fs_in.Tint.rgb;
+	outAlbedoSpec.a = texture(texture_specular1, fs_in.TexCoords).r * fs_in.Tint.a;
 };
\ No newline at end of file
@@ -3,23 +3,34 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
+layout(location = 5) in mat4 aInstanceModel; // InstanceData, see MESH_INSTANCE_LOCATION
+layout(location = 10) in vec4 aInstanceColor;
 
-uniform mat4 projection;
-uniform mat4 view;
+out vec3 Color;
+
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
 uniform mat4 model;
+uniform vec3 lightColor;
+uniform bool instanced;
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	Color = (instanced ? aInstanceColor.rgb : lightColor);
+	gl_Position = projection * view * (instanced ? aInstanceModel : model) * vec4(aPos, 1.0);
 };
 
 #shader fragment
 #version 330 core
 layout(location = 0) out vec4 FragColor;
 
-uniform vec3 lightColor;
+in vec3 Color;
 
 void main()
 {
-	FragColor = vec4(lightColor, 1.0);
+	FragColor = vec4(Color, 1.0);
 };
\ No newline at end of file
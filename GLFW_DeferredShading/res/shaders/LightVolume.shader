@@ -0,0 +1,76 @@
+#shader vertex
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 5) in mat4 aInstanceModel; // InstanceData, see MESH_INSTANCE_LOCATION
+layout(location = 9) in vec4 aInstanceParams; // linear, quadratic, radius
+layout(location = 10) in vec4 aInstanceColor;
+
+flat out vec3 LightPosition;
+flat out vec3 LightColor;
+flat out vec3 LightParams;
+
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
+
+uniform mat4 model;
+uniform vec4 lightParams;
+uniform vec3 lightColor;
+uniform bool instanced;
+
+void main()
+{
+	mat4 world = (instanced ? aInstanceModel : model);
+	LightPosition = world[3].xyz;
+	LightColor = (instanced ? aInstanceColor.rgb : lightColor);
+	LightParams = (instanced ? aInstanceParams.xyz : lightParams.xyz);
+	gl_Position = projection * view * world * vec4(aPos, 1.0);
+};
+
+#shader fragment
+#version 330 core
+out vec4 FragColor;
+
+flat in vec3 LightPosition;
+flat in vec3 LightColor;
+flat in vec3 LightParams;
+
+uniform vec2 screenSize;
+
+#include "GBuffer.glsl"
+
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
+
+void main()
+{
+	// Get data from gBuffer under this fragment of the light's volume
+	vec2 TexCoords = gl_FragCoord.xy / screenSize;
+	vec3 FragPos = gBufferPosition(TexCoords);
+	vec3 Normal = gBufferNormal(TexCoords);
+	vec3 Albedo = gBufferAlbedo(TexCoords);
+	float Specular = gBufferSpecular(TexCoords);
+
+	// the volume is only a bound, pixels outside the radius still add nothing
+	float distance = length(LightPosition - FragPos);
+	if (distance >= LightParams.z)
+		discard;
+
+	vec3 viewDir = normalize(viewPos - FragPos);
+	vec3 lightDir = normalize(LightPosition - FragPos);
+	vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Albedo * LightColor;
+
+	vec3 halfwayDir = normalize(lightDir + viewDir);
+	float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
+	vec3 specular = LightColor * spec * Specular;
+
+	float attenuation = 1.0 / (1.0 + LightParams.x * distance + LightParams.y * distance * distance);
+	FragColor = vec4((diffuse + specular) * attenuation, 1.0);
+};
\ No newline at end of file
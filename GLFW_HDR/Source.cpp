@@ -7,6 +7,7 @@
 
 #include "Shader.h"
 #include "Camera.h"
+#include "Headless.h"
 
 #include <GLM/glm.hpp>
 #include <GLM/gtc/matrix_transform.hpp>
@@ -14,13 +15,15 @@
 
 #include <iostream>
 
-const unsigned int SCR_WIDTH = 1000;
-const unsigned int SCR_HEIGHT = 800;
+// window size, --width / --height replace it in headless mode
+unsigned int SCR_WIDTH = 1000;
+unsigned int SCR_HEIGHT = 800;
 bool hdr = true;
 bool hdrKeyPressed = false;
 float exposure = 1.0f;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+Headless headless;
 float lastX = (float)SCR_WIDTH / 2.0;
 float lastY = (float)SCR_HEIGHT / 2.0;
 bool firstMouse = true;
@@ -41,8 +44,10 @@ void renderQuad();
 unsigned int quadVAO = 0, quadVBO;
 unsigned int cubeVAO = 0, cubeVBO;
 
-int main()
+int main(int argc, char** argv)
 {
+	headless.ParseArguments(argc, argv, SCR_WIDTH, SCR_HEIGHT);
+
 	GLFWwindow* window = InitWindow();
 	if (!window)
 		return -1;
@@ -105,11 +110,12 @@ int main()
 	// Game Loop
 	while (!glfwWindowShouldClose(window))
 	{
-		float currentFrame = glfwGetTime();
+		float currentFrame = headless.GetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		processInput(window);
+		headless.UpdateCamera(camera);
 
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -117,6 +123,7 @@ int main()
 		ImGui_ImplGlfwGL3_NewFrame();
 
 		// 1 - Render scene into floating point framebuffer
+		headless.BeginPass("Scene");
 		glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -159,14 +166,17 @@ int main()
 		shader.SetUniform1i("lightCube", false);
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		headless.EndPass();
 
 		// 2 - Render floating point color buffer to 2D quad
+		headless.BeginPass("Tonemap");
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		shaderHDR.Bind();
 		shaderHDR.SetUniform1i("hdr", hdr);
 		shaderHDR.SetUniform1f("exposure", exposure);
 		glBindTexture(GL_TEXTURE_2D, colorBuffer);
 		renderQuad();
+		headless.EndPass();
 
 		std::cout << "hdr: " << (hdr ? "on" : "off") << " | exposure: " << exposure << std::endl;
 
@@ -187,7 +197,9 @@ int main()
 		}
 		ImGui::End();
 		ImGui::Render();
-		ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		if (!headless.IsEnabled())
+			ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		headless.EndFrame(window);
 
 		glfwPollEvents();
 		glfwSwapBuffers(window);
@@ -221,6 +233,7 @@ GLFWwindow* InitWindow()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	headless.ApplyWindowHints();
 
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "GLFW Project", NULL, NULL);
 	if (window == NULL)
@@ -230,7 +243,7 @@ GLFWwindow* InitWindow()
 		return nullptr;
 	}
 	glfwMakeContextCurrent(window);
-	glfwSwapInterval(1);
+	glfwSwapInterval(headless.IsEnabled() ? 0 : 1);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetWindowPos(window, 100, 100);
 
@@ -0,0 +1,341 @@
+#include "MeshCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+static const uint32_t MESH_CACHE_MAGIC = 0x4853454D; // "MESH"
+static const uint32_t MESH_CACHE_VERSION = 3;
+static const uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+struct MeshCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexStride;
+	uint32_t meshCount;
+	uint32_t textureCount;
+	uint32_t stringBytes;
+	uint32_t lodCount;
+	uint32_t reserved;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+};
+
+static uint64_t AlignOffset(uint64_t offset)
+{
+	return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+}
+
+MeshCache::MeshCache(const std::string& sourcePath)
+	: m_FilePath(sourcePath + ".meshcache"), m_SourceSize(0), m_SourceTime(0),
+	m_Data(nullptr), m_Size(0), m_Meshes(nullptr), m_Textures(nullptr), m_Lods(nullptr), m_Strings(nullptr), m_MeshCount(0), m_TextureCount(0), m_LodCount(0)
+{
+	// hashing the whole model would cost as much as parsing it, size and time catch an edited file
+	struct stat info;
+	if (stat(sourcePath.c_str(), &info) == 0)
+	{
+		m_SourceSize = (uint64_t)info.st_size;
+		m_SourceTime = (int64_t)info.st_mtime;
+	}
+}
+
+MeshCache::~MeshCache()
+{
+	Close();
+}
+
+bool MeshCache::Open()
+{
+	Close();
+	if (!Map())
+		return false;
+
+	if (!Validate())
+	{
+		std::cout << "Mesh cache is stale, importing: " << m_FilePath << std::endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool MeshCache::Map()
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(m_FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart < sizeof(MeshCacheHeader))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// the view keeps the file and the mapping object alive, both handles can be closed now
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!view)
+		return false;
+
+	m_Data = (const unsigned char*)view;
+	m_Size = (size_t)size.QuadPart;
+#else
+	int file = open(m_FilePath.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || (uint64_t)info.st_size < sizeof(MeshCacheHeader))
+	{
+		close(file);
+		return false;
+	}
+
+	// the mapping holds its own reference to the file
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (view == MAP_FAILED)
+		return false;
+	madvise(view, (size_t)info.st_size, MADV_WILLNEED);
+
+	m_Data = (const unsigned char*)view;
+	m_Size = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+void MeshCache::Close()
+{
+	if (m_Data)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m_Data);
+#else
+		munmap((void*)m_Data, m_Size);
+#endif
+	}
+
+	m_Data = nullptr;
+	m_Size = 0;
+	m_Meshes = nullptr;
+	m_Textures = nullptr;
+	m_Lods = nullptr;
+	m_Strings = nullptr;
+	m_MeshCount = 0;
+	m_TextureCount = 0;
+	m_LodCount = 0;
+}
+
+bool MeshCache::Validate()
+{
+	MeshCacheHeader header;
+	std::memcpy(&header, m_Data, sizeof(header));
+	if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.vertexStride != sizeof(Vertex))
+		return false;
+	if (header.sourceSize != m_SourceSize || header.sourceTime != m_SourceTime)
+		return false;
+
+	uint64_t meshTable = sizeof(MeshCacheHeader);
+	uint64_t textureTable = meshTable + (uint64_t)header.meshCount * sizeof(MeshCacheMesh);
+	uint64_t lodTable = textureTable + (uint64_t)header.textureCount * sizeof(MeshCacheTexture);
+	uint64_t stringTable = lodTable + (uint64_t)header.lodCount * sizeof(MeshCacheLod);
+	if (stringTable + header.stringBytes > m_Size)
+		return false;
+
+	m_Meshes = (const MeshCacheMesh*)(m_Data + meshTable);
+	m_Textures = (const MeshCacheTexture*)(m_Data + textureTable);
+	m_Lods = (const MeshCacheLod*)(m_Data + lodTable);
+	m_Strings = (const char*)(m_Data + stringTable);
+	m_MeshCount = header.meshCount;
+	m_TextureCount = header.textureCount;
+	m_LodCount = header.lodCount;
+
+	// a truncated or hand-edited file must not send reads past the mapping
+	for (uint32_t i = 0; i < m_MeshCount; ++i)
+	{
+		const MeshCacheMesh& mesh = m_Meshes[i];
+		if (mesh.vertexOffset % MESH_CACHE_ALIGNMENT != 0 || mesh.indexOffset % MESH_CACHE_ALIGNMENT != 0)
+			return false;
+		if (mesh.vertexOffset + (uint64_t)mesh.vertexCount * sizeof(Vertex) > m_Size)
+			return false;
+		if (mesh.indexOffset + (uint64_t)mesh.indexCount * sizeof(unsigned int) > m_Size)
+			return false;
+		if ((uint64_t)mesh.firstTexture + mesh.textureCount > m_TextureCount)
+			return false;
+		if ((uint64_t)mesh.firstLod + mesh.lodCount > m_LodCount)
+			return false;
+		for (uint32_t j = mesh.firstLod; j < mesh.firstLod + mesh.lodCount; ++j)
+		{
+			if ((uint64_t)m_Lods[j].firstIndex + m_Lods[j].indexCount > mesh.indexCount)
+				return false;
+		}
+	}
+	for (uint32_t i = 0; i < m_TextureCount; ++i)
+	{
+		const MeshCacheTexture& texture = m_Textures[i];
+		if ((uint64_t)texture.typeOffset + texture.typeLength > header.stringBytes)
+			return false;
+		if ((uint64_t)texture.pathOffset + texture.pathLength > header.stringBytes)
+			return false;
+	}
+	return true;
+}
+
+bool MeshCache::Save(const std::vector<std::shared_ptr<Mesh>>& meshes)
+{
+	// Windows refuses to truncate a mapped file
+	Close();
+
+	MeshCacheHeader header = {};
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.vertexStride = sizeof(Vertex);
+	header.meshCount = (uint32_t)meshes.size();
+	header.sourceSize = m_SourceSize;
+	header.sourceTime = m_SourceTime;
+
+	std::vector<MeshCacheMesh> meshTable;
+	std::vector<MeshCacheTexture> textureTable;
+	std::vector<MeshCacheLod> lodTable;
+	std::string strings;
+	for (const std::shared_ptr<Mesh>& mesh : meshes)
+	{
+		MeshCacheMesh entry = {};
+		entry.vertexCount = (uint32_t)mesh->vertices.size();
+		entry.indexCount = (uint32_t)mesh->indices.size();
+		entry.firstTexture = (uint32_t)textureTable.size();
+		entry.textureCount = (uint32_t)mesh->textures.size();
+		entry.firstLod = (uint32_t)lodTable.size();
+		entry.lodCount = (uint32_t)mesh->lods.size();
+		meshTable.push_back(entry);
+
+		for (const MeshLod& lod : mesh->lods)
+			lodTable.push_back(MeshCacheLod{ lod.firstIndex, lod.indexCount, lod.error, 0 });
+
+		for (const Texture& texture : mesh->textures)
+		{
+			MeshCacheTexture record;
+			record.typeOffset = (uint32_t)strings.size();
+			record.typeLength = (uint32_t)texture.type.size();
+			strings += texture.type;
+			record.pathOffset = (uint32_t)strings.size();
+			record.pathLength = (uint32_t)texture.path.size();
+			strings += texture.path;
+			textureTable.push_back(record);
+		}
+	}
+	header.textureCount = (uint32_t)textureTable.size();
+	header.stringBytes = (uint32_t)strings.size();
+	header.lodCount = (uint32_t)lodTable.size();
+
+	// blobs follow the tables, each one aligned so it can be read in place
+	uint64_t offset = sizeof(MeshCacheHeader) + meshTable.size() * sizeof(MeshCacheMesh) + textureTable.size() * sizeof(MeshCacheTexture) + lodTable.size() * sizeof(MeshCacheLod) + strings.size();
+	for (MeshCacheMesh& entry : meshTable)
+	{
+		entry.vertexOffset = AlignOffset(offset);
+		entry.indexOffset = AlignOffset(entry.vertexOffset + (uint64_t)entry.vertexCount * sizeof(Vertex));
+		offset = entry.indexOffset + (uint64_t)entry.indexCount * sizeof(unsigned int);
+	}
+
+	std::ofstream stream(m_FilePath, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		std::cout << "Mesh cache: unable to write " << m_FilePath << std::endl;
+		return false;
+	}
+
+	stream.write((const char*)&header, sizeof(header));
+	stream.write((const char*)meshTable.data(), meshTable.size() * sizeof(MeshCacheMesh));
+	stream.write((const char*)textureTable.data(), textureTable.size() * sizeof(MeshCacheTexture));
+	stream.write((const char*)lodTable.data(), lodTable.size() * sizeof(MeshCacheLod));
+	stream.write(strings.data(), strings.size());
+
+	const char padding[MESH_CACHE_ALIGNMENT] = {};
+	uint64_t written = sizeof(MeshCacheHeader) + meshTable.size() * sizeof(MeshCacheMesh) + textureTable.size() * sizeof(MeshCacheTexture) + lodTable.size() * sizeof(MeshCacheLod) + strings.size();
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+	{
+		const MeshCacheMesh& entry = meshTable[i];
+		stream.write(padding, entry.vertexOffset - written);
+		stream.write((const char*)meshes[i]->vertices.data(), entry.vertexCount * sizeof(Vertex));
+		written = entry.vertexOffset + (uint64_t)entry.vertexCount * sizeof(Vertex);
+
+		stream.write(padding, entry.indexOffset - written);
+		stream.write((const char*)meshes[i]->indices.data(), entry.indexCount * sizeof(unsigned int));
+		written = entry.indexOffset + (uint64_t)entry.indexCount * sizeof(unsigned int);
+	}
+
+	if (!stream)
+	{
+		std::cout << "Mesh cache: write failed " << m_FilePath << std::endl;
+		return false;
+	}
+	std::cout << "Mesh cache written: " << m_FilePath << " (" << written / 1024 << " KB)" << std::endl;
+	return true;
+}
+
+const std::string& MeshCache::GetFilePath() const
+{
+	return m_FilePath;
+}
+
+size_t MeshCache::GetSize() const
+{
+	return m_Size;
+}
+
+unsigned int MeshCache::GetMeshCount() const
+{
+	return m_MeshCount;
+}
+
+const MeshCacheMesh& MeshCache::GetMesh(unsigned int index) const
+{
+	return m_Meshes[index];
+}
+
+const Vertex* MeshCache::GetVertices(const MeshCacheMesh& mesh) const
+{
+	return (const Vertex*)(m_Data + mesh.vertexOffset);
+}
+
+const unsigned int* MeshCache::GetIndices(const MeshCacheMesh& mesh) const
+{
+	return (const unsigned int*)(m_Data + mesh.indexOffset);
+}
+
+std::vector<MeshLod> MeshCache::GetLods(const MeshCacheMesh& mesh) const
+{
+	std::vector<MeshLod> lods;
+	for (uint32_t i = mesh.firstLod; i < mesh.firstLod + mesh.lodCount; ++i)
+		lods.push_back(MeshLod{ m_Lods[i].firstIndex, m_Lods[i].indexCount, m_Lods[i].error });
+	return lods;
+}
+
+std::string MeshCache::GetTextureType(unsigned int index) const
+{
+	return std::string(m_Strings + m_Textures[index].typeOffset, m_Textures[index].typeLength);
+}
+
+std::string MeshCache::GetTexturePath(unsigned int index) const
+{
+	return std::string(m_Strings + m_Textures[index].pathOffset, m_Textures[index].pathLength);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Mesh.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+// Per mesh record of the cache, offsets are in bytes from the start of the file
+struct MeshCacheMesh
+{
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t firstTexture;
+	uint32_t textureCount;
+	uint32_t firstLod;
+	uint32_t lodCount;
+};
+
+// Material texture of a mesh, type and path are stored in the string table
+struct MeshCacheTexture
+{
+	uint32_t typeOffset;
+	uint32_t typeLength;
+	uint32_t pathOffset;
+	uint32_t pathLength;
+};
+
+// Level of detail of a mesh, as in MeshLod
+struct MeshCacheLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+	uint32_t reserved;
+};
+
+// Binary copy of an imported model, written next to it as <model>.meshcache.
+// Vertex and index blobs are stored in the exact Vertex / GL_UNSIGNED_INT
+// layout the meshes upload, so a warm load maps the file and hands the blobs
+// straight to glBufferData (indices are only narrowed to 16 bits when they
+// fit). Meshes are saved after MeshOptimizer has run, with their simplified
+// levels of detail appended to the indices. The file is keyed by the format version, the
+// Vertex stride and the size and modification time of the source model; any
+// mismatch rejects the cache and the model is imported again.
+class MeshCache
+{
+private:
+	std::string m_FilePath;
+	uint64_t m_SourceSize;
+	int64_t m_SourceTime;
+
+	// read-only mapping of the file, see Map()
+	const unsigned char* m_Data;
+	size_t m_Size;
+
+	const MeshCacheMesh* m_Meshes;
+	const MeshCacheTexture* m_Textures;
+	const MeshCacheLod* m_Lods;
+	const char* m_Strings;
+	uint32_t m_MeshCount;
+	uint32_t m_TextureCount;
+	uint32_t m_LodCount;
+
+public:
+	MeshCache(const std::string& sourcePath);
+	~MeshCache();
+
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	// Maps the cache and validates it against the source model
+	bool Open();
+	void Close();
+	bool Save(const std::vector<std::shared_ptr<Mesh>>& meshes);
+
+	const std::string& GetFilePath() const;
+	size_t GetSize() const;
+	unsigned int GetMeshCount() const;
+	const MeshCacheMesh& GetMesh(unsigned int index) const;
+	const Vertex* GetVertices(const MeshCacheMesh& mesh) const;
+	const unsigned int* GetIndices(const MeshCacheMesh& mesh) const;
+	std::vector<MeshLod> GetLods(const MeshCacheMesh& mesh) const;
+	std::string GetTextureType(unsigned int index) const;
+	std::string GetTexturePath(unsigned int index) const;
+
+private:
+	bool Map();
+	bool Validate();
+};
@@ -1,26 +1,144 @@
 #include "Model.h"
-#include "stb_image.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
 #include <iostream>
+#include <chrono>
+#include <algorithm>
 
-void Model::Draw(Shader &shader)
+Model::~Model()
 {
+	if (indirectBuffer)
+		glDeleteBuffers(1, &indirectBuffer);
+}
+
+void Model::Draw(Shader &shader, unsigned int lod)
+{
+	if (multiDraw)
+	{
+		DrawBatches(shader, lod, 1, 0);
+		return;
+	}
+
 	for (unsigned int i = 0; i < meshes.size(); i++)
-		meshes[i].Draw(shader);
+		meshes[i]->Draw(shader, lod);
 }
 
 void Model::LoadModel(std::string const &path)
 {
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_CalcTangentSpace);
+	auto start = std::chrono::high_resolution_clock::now();
+	loadStats = ModelLoadStats();
+	directory = path.substr(0, path.find_last_of('/'));
 
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	MeshCache cache(path);
+	if (cache.Open())
 	{
-		std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-		return;
+		LoadFromCache(cache);
+		loadStats.fromCache = true;
+		loadStats.cacheBytes = cache.GetSize();
 	}
+	else
+	{
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_CalcTangentSpace);
 
-	directory = path.substr(0, path.find_last_of('/'));
-	ProcessNode(scene->mRootNode, scene);
+		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+		{
+			std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+			return;
+		}
+
+		// the box of every imported position, welding and reordering don't move any
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+		{
+			const aiMesh* mesh = scene->mMeshes[i];
+			for (unsigned int j = 0; j < mesh->mNumVertices; j++)
+				quantizationBounds.Add(glm::vec3(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z));
+		}
+		ProcessNode(scene->mRootNode, scene);
+		cache.Save(meshes);
+
+		if (loadStats.triangles > 0)
+		{
+			loadStats.acmrBefore /= loadStats.triangles;
+			loadStats.acmrAfter /= loadStats.triangles;
+		}
+		std::cout << "Mesh optimization: " << loadStats.verticesBefore << " -> " << loadStats.verticesAfter << " vertices, ACMR "
+			<< loadStats.acmrBefore << " -> " << loadStats.acmrAfter << " over " << loadStats.triangles << " triangles in " << loadStats.optimizeMs << " ms" << std::endl;
+	}
+
+	lodErrors.clear();
+	lodTriangles.clear();
+	for (const std::shared_ptr<Mesh>& mesh : meshes)
+	{
+		if (mesh->lods.size() > lodErrors.size())
+		{
+			lodErrors.resize(mesh->lods.size(), 0.0f);
+			lodTriangles.resize(mesh->lods.size(), 0);
+		}
+	}
+	for (const std::shared_ptr<Mesh>& mesh : meshes)
+	{
+		for (unsigned int i = 0; i < lodErrors.size(); i++)
+		{
+			lodErrors[i] = std::max(lodErrors[i], mesh->GetLod(i).error);
+			lodTriangles[i] += mesh->GetLod(i).indexCount / 3;
+		}
+	}
+	std::cout << "Levels of detail:";
+	for (unsigned int i = 0; i < lodErrors.size(); i++)
+		std::cout << " " << lodTriangles[i] << " (error " << lodErrors[i] << ")";
+	if (!loadStats.fromCache)
+		std::cout << " built in " << loadStats.lodMs << " ms";
+	std::cout << std::endl;
+
+	for (const std::shared_ptr<Mesh>& mesh : meshes)
+	{
+		loadStats.vertexBytes += (size_t)mesh->vertexCount * GetVertexStride(mesh->layout);
+		loadStats.floatVertexBytes += (size_t)mesh->vertexCount * sizeof(Vertex);
+		loadStats.quantization.Merge(mesh->quantizationError);
+	}
+	if (vertexLayout == VERTEX_LAYOUT_QUANTIZED)
+	{
+		const VertexQuantizationError& error = loadStats.quantization;
+		std::cout << "Vertex layout: " << GetVertexLayoutName(vertexLayout) << ", " << loadStats.vertexBytes / 1024 << " KB (" << loadStats.floatVertexBytes / 1024 << " KB as floats, "
+			<< (loadStats.vertexBytes ? (float)loadStats.floatVertexBytes / loadStats.vertexBytes : 0.0f) << "x smaller)" << std::endl;
+		std::cout << "  error: position max " << error.positionMax << " mean " << error.positionMean << ", normal max " << error.normalMaxDegrees << " deg mean "
+			<< error.normalMeanDegrees << " deg, tangent max " << error.tangentMaxDegrees << " deg, uv max " << error.texCoordMax
+			<< (error.halfTexCoords ? " (half)" : " (unorm16)") << ", bitangent flips " << error.bitangentFlips << std::endl;
+	}
+
+	BuildDrawBatches();
+
+	auto texturesStart = std::chrono::high_resolution_clock::now();
+	textureBatch.Finish();
+	textureBatch.PrintReport();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	loadStats.textureMs = std::chrono::duration<float, std::milli>(end - texturesStart).count();
+	loadStats.totalMs = std::chrono::duration<float, std::milli>(end - start).count();
+	loadStats.geometryMs = loadStats.totalMs - loadStats.textureMs;
+	std::cout << "Model " << path << " loaded " << (loadStats.fromCache ? "warm (mesh cache)" : "cold (Assimp import)")
+		<< " in " << loadStats.totalMs << " ms: geometry " << loadStats.geometryMs << " ms, textures " << loadStats.textureMs << " ms" << std::endl;
+}
+
+void Model::LoadFromCache(const MeshCache& cache)
+{
+	for (unsigned int i = 0; i < cache.GetMeshCount(); i++)
+		quantizationBounds.Add(cache.GetVertices(cache.GetMesh(i)), cache.GetMesh(i).vertexCount);
+
+	for (unsigned int i = 0; i < cache.GetMeshCount(); i++)
+	{
+		const MeshCacheMesh& entry = cache.GetMesh(i);
+
+		std::vector<Texture> textures;
+		for (unsigned int j = 0; j < entry.textureCount; j++)
+			textures.push_back(LoadTexture(cache.GetTexturePath(entry.firstTexture + j), cache.GetTextureType(entry.firstTexture + j)));
+
+		// the blobs are already in the GPU layout, they go to glBufferData straight from the mapping
+		std::vector<MeshLod> lods = cache.GetLods(entry);
+		meshes.push_back(AssetRegistry::Get().AcquireMesh(cache.GetVertices(entry), entry.vertexCount, cache.GetIndices(entry), entry.indexCount, textures, vertexLayout, &quantizationBounds, &lods));
+	}
 }
 
 void Model::ProcessNode(aiNode* node, const aiScene* scene)
@@ -37,12 +155,52 @@ void Model::ProcessNode(aiNode* node, const aiScene* scene)
 	}
 }
 
-Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
+std::shared_ptr<Mesh> Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
 {
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
 
+	ReadGeometry(mesh, vertices, indices);
+
+	// process material
+	if (mesh->mMaterialIndex >= 0)
+	{
+		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+		std::vector<Texture> diffuseMaps = LoadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+		std::vector<Texture> specularMaps = LoadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+		std::vector<Texture> normalMaps = LoadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+		std::vector<Texture> heightMaps = LoadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+	}
+
+	// weld, then reorder for the vertex cache, overdraw and vertex fetch; the cache stores the result
+	MeshOptimizeStats optimized = OptimizeMesh(vertices, indices);
+	loadStats.optimizeMs += optimized.ms;
+	loadStats.triangles += optimized.triangles;
+	loadStats.verticesBefore += optimized.verticesBefore;
+	loadStats.verticesAfter += optimized.verticesAfter;
+	loadStats.acmrBefore += optimized.before.acmr * optimized.triangles;
+	loadStats.acmrAfter += optimized.after.acmr * optimized.triangles;
+
+	// coarser levels are appended to the indices and index the same vertices
+	auto lodStart = std::chrono::high_resolution_clock::now();
+	std::vector<MeshLod> lods = BuildLodChain(vertices, indices);
+	loadStats.lodMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - lodStart).count();
+	std::cout << "    levels:";
+	for (const MeshLod& lod : lods)
+		std::cout << " " << lod.indexCount / 3 << " (" << lod.error << ")";
+	std::cout << std::endl;
+
+	// an identical mesh already loaded by another model is shared instead of uploaded again
+	return AssetRegistry::Get().AcquireMesh(vertices, indices, textures, vertexLayout, &quantizationBounds, &lods);
+}
+
+void Model::ReadGeometry(const aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
 	// process vertices
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 	{
@@ -89,22 +247,6 @@ Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
 		for (unsigned int j = 0; j < face.mNumIndices; j++)
 			indices.push_back(face.mIndices[j]);
 	}
-
-	// process material
-	if (mesh->mMaterialIndex >= 0)
-	{
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		std::vector<Texture> diffuseMaps = LoadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-		std::vector<Texture> specularMaps = LoadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-		std::vector<Texture> normalMaps = LoadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-		std::vector<Texture> heightMaps = LoadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-	}
-
-	return Mesh(vertices, indices, textures);
 }
 
 std::vector<Texture> Model::LoadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName)
@@ -114,81 +256,161 @@ std::vector<Texture> Model::LoadMaterialTextures(aiMaterial* mat, aiTextureType
 	{
 		aiString str;
 		mat->GetTexture(type, i, &str);
-		bool skip = false;
-		for (unsigned int j = 0; j < textures_loaded.size(); j++)
-		{
-			if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-			{
-				textures.push_back(textures_loaded[j]);
-				skip = true;
-				break;
-			}
-		}
-		if (!skip)
-		{
-			Texture texture;
-			texture.id = TextureFromFile(str.C_Str(), directory);
-			texture.type = typeName;
-			texture.path = str.C_Str();
-			textures.push_back(texture);
-			textures_loaded.push_back(texture);
-		}
+		textures.push_back(LoadTexture(str.C_Str(), typeName));
 	}
 	return textures;
 }
 
-unsigned int Model::TextureFromFile(const char* path, const std::string &directory, bool gamma)
+Texture Model::LoadTexture(const std::string& path, const std::string& typeName)
 {
-	std::string filename = std::string(path);
-	filename = directory + '/' + filename;
+	std::shared_ptr<TextureAsset>& asset = textures_loaded[path];
+	if (!asset)
+		asset = AssetRegistry::Get().AcquireTexture(directory + '/' + path, gammaCorrection, textureBatch);
 
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
+	Texture texture;
+	texture.id = asset->id;
+	texture.type = typeName;
+	texture.path = path;
+	return texture;
+}
 
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-	if (data)
+unsigned int Model::GetDrawBatchCount() const
+{
+	return (unsigned int)drawBatches.size();
+}
+
+unsigned int Model::GetLodCount() const
+{
+	return std::max((unsigned int)lodErrors.size(), 1u);
+}
+
+const VertexBounds& Model::GetBounds() const
+{
+	return quantizationBounds;
+}
+
+static bool SharesDrawState(const Mesh& a, const Mesh& b)
+{
+	if (a.arena != b.arena || a.positionOffset != b.positionOffset || a.positionScale != b.positionScale || a.textures.size() != b.textures.size())
+		return false;
+	for (unsigned int i = 0; i < a.textures.size(); i++)
 	{
-		GLenum format;
-		if (nrComponents == 1)
-		{
-			std::cout << "Format is RED." << std::endl;
-			format = GL_RED;
-		}
-		else if (nrComponents == 3)
-		{
-			std::cout << "Format is RGB." << std::endl;
-			format = GL_RGB;
-		}
-		else if (nrComponents == 4)
+		if (a.textures[i].id != b.textures[i].id || a.textures[i].type != b.textures[i].type)
+			return false;
+	}
+	return true;
+}
+
+void Model::BuildDrawBatches()
+{
+	std::vector<std::vector<Mesh*>> groups;
+	for (const std::shared_ptr<Mesh>& mesh : meshes)
+	{
+		if (!mesh->arena || mesh->indexCount == 0)
+			continue;
+		auto group = std::find_if(groups.begin(), groups.end(), [&mesh](const std::vector<Mesh*>& members) { return SharesDrawState(*members[0], *mesh); });
+		if (group == groups.end())
+			groups.push_back(std::vector<Mesh*>(1, mesh.get()));
+		else
+			group->push_back(mesh.get());
+	}
+
+	drawBatches.clear();
+	commandsPerLod = 0;
+	for (const std::vector<Mesh*>& members : groups)
+	{
+		ModelDrawBatch batch;
+		batch.mesh = members[0];
+		batch.firstCommand = commandsPerLod;
+		batch.commandCount = (unsigned int)members.size();
+		drawBatches.push_back(batch);
+		commandsPerLod += batch.commandCount;
+	}
+
+	drawCommands.clear();
+	for (unsigned int lod = 0; lod < GetLodCount(); lod++)
+	{
+		for (const std::vector<Mesh*>& members : groups)
 		{
-			std::cout << "Format is RGBA." << std::endl;
-			format = GL_RGBA;
+			for (const Mesh* mesh : members)
+			{
+				const MeshLod& level = mesh->GetLod(lod);
+				DrawElementsIndirectCommand command;
+				command.count = level.indexCount;
+				command.instanceCount = 1;
+				command.firstIndex = mesh->allocation.firstIndex + level.firstIndex;
+				command.baseVertex = (int)mesh->allocation.baseVertex;
+				command.baseInstance = 0;
+				drawCommands.push_back(command);
+			}
 		}
+	}
 
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	if (MeshArena::SupportsMultiDrawIndirect() && !drawCommands.empty())
+	{
+		if (!indirectBuffer)
+			glGenBuffers(1, &indirectBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, drawCommands.size() * sizeof(DrawElementsIndirectCommand), drawCommands.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+void Model::DrawBatches(Shader &shader, unsigned int lod, unsigned int instanceCount, unsigned int baseInstance)
+{
+	if (drawBatches.empty())
+		BuildDrawBatches();
+	if (drawBatches.empty())
+		return;
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		if (format == GL_RED)
+	// a level's commands share their instance range, only rewritten when it changes
+	lod = std::min(lod, GetLodCount() - 1);
+	DrawElementsIndirectCommand* commands = &drawCommands[(size_t)lod * commandsPerLod];
+	bool changed = commands[0].instanceCount != instanceCount || commands[0].baseInstance != baseInstance;
+	if (changed)
+	{
+		for (unsigned int i = 0; i < commandsPerLod; i++)
 		{
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+			commands[i].instanceCount = instanceCount;
+			commands[i].baseInstance = baseInstance;
 		}
-
-		std::cout << "Width: " << width << " Height: " << height << " Format: " << format << std::endl;
-		
-		stbi_image_free(data);
 	}
-	else
+
+	bool indirect = indirectBuffer != 0;
+	if (indirect)
 	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		if (changed)
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, (size_t)lod * commandsPerLod * sizeof(DrawElementsIndirectCommand), commandsPerLod * sizeof(DrawElementsIndirectCommand), commands);
 	}
 
-	return textureID;
+	for (const ModelDrawBatch& batch : drawBatches)
+	{
+		Mesh& mesh = *batch.mesh;
+		mesh.BindTextures(shader);
+		mesh.SetLayoutUniforms(shader, true);
+		glBindVertexArray(mesh.VAO);
+		if (indirect)
+			glMultiDrawElementsIndirect(GL_TRIANGLES, mesh.indexType, (void*)(((size_t)lod * commandsPerLod + batch.firstCommand) * sizeof(DrawElementsIndirectCommand)), batch.commandCount, 0);
+		else
+		{
+			unsigned int indexSize = mesh.arena->GetIndexSize();
+			for (unsigned int i = batch.firstCommand; i < batch.firstCommand + batch.commandCount; i++)
+			{
+				const DrawElementsIndirectCommand& command = commands[i];
+				const void* offset = (void*)((size_t)command.firstIndex * indexSize);
+				if (instanceCount == 1 && baseInstance == 0)
+					glDrawElementsBaseVertex(GL_TRIANGLES, command.count, mesh.indexType, offset, command.baseVertex);
+				else if (baseInstance == 0)
+					glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, mesh.indexType, offset, instanceCount, command.baseVertex);
+				else
+					glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.count, mesh.indexType, offset, instanceCount, command.baseVertex, baseInstance);
+			}
+		}
+		mesh.SetLayoutUniforms(shader, false);
+	}
+	glBindVertexArray(0);
+	if (indirect)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glActiveTexture(GL_TEXTURE0);
 }
\ No newline at end of file
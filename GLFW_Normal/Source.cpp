@@ -7,6 +7,7 @@
 
 #include "Shader.h"
 #include "Camera.h"
+#include "Headless.h"
 #include "Model.h"
 
 #include <GLM/glm.hpp>
@@ -15,10 +16,12 @@
 
 #include <iostream>
 
-const unsigned int SCR_WIDTH = 1920;
-const unsigned int SCR_HEIGHT = 1080;
+// window size, --width / --height replace it in headless mode
+unsigned int SCR_WIDTH = 1920;
+unsigned int SCR_HEIGHT = 1080;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+Headless headless;
 float lastX = (float)SCR_WIDTH / 2.0;
 float lastY = (float)SCR_HEIGHT / 2.0;
 bool firstMouse = true;
@@ -37,15 +40,18 @@ void renderQuad();
 
 unsigned int quadVAO = 0, quadVBO;
 
-int main()
+int main(int argc, char** argv)
 {
+	headless.ParseArguments(argc, argv, SCR_WIDTH, SCR_HEIGHT);
+
 	GLFWwindow* window = InitWindow();
 	if (!window)
 		return -1;
 
 	Shader basic("res/shaders/Basic.shader");
 	Shader shader("res/shaders/Normal.shader");
-	Model backpack("res/models/backpack/backpack.obj");
+	std::shared_ptr<Model> backpack = AssetRegistry::Get().AcquireModel("res/models/backpack/backpack.obj");
+	AssetRegistry::Get().PrintReport();
 
 	//unsigned int diffuseMap = loadTexture("res/textures/brickwall.jpg");
 	//unsigned int normalMap = loadTexture("res/textures/brickwall_normal.jpg");
@@ -67,11 +73,12 @@ int main()
 	// Game Loop
 	while (!glfwWindowShouldClose(window))
 	{
-		float currentFrame = glfwGetTime();
+		float currentFrame = headless.GetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		processInput(window);
+		headless.UpdateCamera(camera);
 
 		//lightPos.x = sin(glfwGetTime() * 0.5f);
 
@@ -86,6 +93,7 @@ int main()
 		glm::mat4 model = glm::mat4(1.0f);
 
 		// With Normal Mapping
+		headless.BeginPass("Normal Mapped");
 		shader.Bind();
 		shader.SetUniformMatrix4fv("projection", projection);
 		shader.SetUniformMatrix4fv("view", view);
@@ -97,9 +105,11 @@ int main()
 		shader.SetUniform3f("lightPos", lightPos);
 		shader.SetUniform3f("viewPos", camera.Position);
 		
-		backpack.Draw(shader);
+		backpack->Draw(shader);
+		headless.EndPass();
 
 		// Without Normal Mapping
+		headless.BeginPass("Basic");
 		basic.Bind();
 		basic.SetUniformMatrix4fv("projection", projection);
 		basic.SetUniformMatrix4fv("view", view);
@@ -109,7 +119,8 @@ int main()
 		model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
 		basic.SetUniformMatrix4fv("model", model);
 
-		backpack.Draw(basic);
+		backpack->Draw(basic);
+		headless.EndPass();
 		
 		// Plane with Normal Mapping
 		//glActiveTexture(GL_TEXTURE0);
@@ -121,16 +132,23 @@ int main()
 		// ImGui Window
 		ImGui::Begin("Main Window");
 		{
+			ImGui::Text("Model Load: %.1f ms, %s (geometry %.1f ms, textures %.1f ms)", backpack->loadStats.totalMs, backpack->loadStats.fromCache ? "mesh cache" : "Assimp import", backpack->loadStats.geometryMs, backpack->loadStats.textureMs);
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 		}
 		ImGui::End();
 		ImGui::Render();
-		ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		if (!headless.IsEnabled())
+			ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		headless.EndFrame(window);
 
 		glfwPollEvents();
 		glfwSwapBuffers(window);
 	}
 
+	// last handle, the registry frees the model's meshes and textures while the context is alive, then the arenas go
+	backpack.reset();
+	MeshArena::ReleaseAll();
+
 	ImGui_ImplGlfwGL3_Shutdown();
 	ImGui::DestroyContext();
 	glfwTerminate();
@@ -148,8 +166,9 @@ GLFWwindow* InitWindow()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	headless.ApplyWindowHints();
 
-	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "GLFW Project", glfwGetPrimaryMonitor(), NULL);
+	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "GLFW Project", (headless.IsEnabled() ? NULL : glfwGetPrimaryMonitor()), NULL);
 	if (window == NULL)
 	{
 		std::cout << "Failed to create GLFW window." << std::endl;
@@ -157,7 +176,7 @@ GLFWwindow* InitWindow()
 		return nullptr;
 	}
 	glfwMakeContextCurrent(window);
-	glfwSwapInterval(1);
+	glfwSwapInterval(headless.IsEnabled() ? 0 : 1);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetWindowPos(window, 100, 100);
 
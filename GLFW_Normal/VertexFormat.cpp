@@ -0,0 +1,213 @@
+#include "VertexFormat.h"
+#include "Mesh.h"
+
+#include <GLAD/glad.h>
+#include <GLM/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+static const float RADIANS_TO_DEGREES = 57.2957795f;
+
+void VertexQuantizationError::Merge(const VertexQuantizationError& other)
+{
+	unsigned int total = vertices + other.vertices;
+	if (total == 0)
+		return;
+	positionMean = (positionMean * vertices + other.positionMean * other.vertices) / total;
+	normalMeanDegrees = (normalMeanDegrees * vertices + other.normalMeanDegrees * other.vertices) / total;
+	positionMax = std::max(positionMax, other.positionMax);
+	normalMaxDegrees = std::max(normalMaxDegrees, other.normalMaxDegrees);
+	tangentMaxDegrees = std::max(tangentMaxDegrees, other.tangentMaxDegrees);
+	texCoordMax = std::max(texCoordMax, other.texCoordMax);
+	bitangentFlips += other.bitangentFlips;
+	halfTexCoords = halfTexCoords || other.halfTexCoords;
+	vertices = total;
+}
+
+void VertexBounds::Add(const glm::vec3& position)
+{
+	if (empty)
+	{
+		minimum = maximum = position;
+		empty = false;
+		return;
+	}
+	minimum = glm::min(minimum, position);
+	maximum = glm::max(maximum, position);
+}
+
+void VertexBounds::Add(const Vertex* vertices, unsigned int vertexCount)
+{
+	for (unsigned int i = 0; i < vertexCount; ++i)
+		Add(vertices[i].Position);
+}
+
+unsigned int GetVertexStride(VertexLayout layout)
+{
+	return layout == VERTEX_LAYOUT_QUANTIZED ? sizeof(QuantizedVertex) : sizeof(Vertex);
+}
+
+const char* GetVertexLayoutName(VertexLayout layout)
+{
+	return layout == VERTEX_LAYOUT_QUANTIZED ? "quantized" : "float";
+}
+
+// GL_INT_2_10_10_10_REV, x in the low bits; decoded as max(c / 511, -1) for xyz and the sign of w
+static uint32_t PackSnorm10(const glm::vec3& v, float w)
+{
+	uint32_t packed = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		int value = (int)std::round(std::min(std::max(v[i], -1.0f), 1.0f) * 511.0f);
+		packed |= ((uint32_t)value & 0x3FF) << (i * 10);
+	}
+	packed |= ((uint32_t)(w < 0.0f ? -1 : 1) & 0x3) << 30;
+	return packed;
+}
+
+static glm::vec4 UnpackSnorm10(uint32_t packed)
+{
+	glm::vec4 v;
+	for (int i = 0; i < 3; ++i)
+	{
+		int value = (int)((packed >> (i * 10)) & 0x3FF);
+		if (value & 0x200)
+			value -= 0x400;
+		v[i] = std::max(value / 511.0f, -1.0f);
+	}
+	int w = (int)(packed >> 30);
+	v.w = (w & 0x2) ? -1.0f : 1.0f;
+	return v;
+}
+
+static glm::vec3 SafeNormalize(const glm::vec3& v, const glm::vec3& fallback)
+{
+	float length = glm::length(v);
+	return length > 1e-12f ? v / length : fallback;
+}
+
+static float AngleDegrees(const glm::vec3& a, const glm::vec3& b)
+{
+	float cosine = glm::dot(SafeNormalize(a, glm::vec3(0.0f, 0.0f, 1.0f)), SafeNormalize(b, glm::vec3(0.0f, 0.0f, 1.0f)));
+	return std::acos(std::min(std::max(cosine, -1.0f), 1.0f)) * RADIANS_TO_DEGREES;
+}
+
+QuantizedMesh QuantizeVertices(const Vertex* vertices, unsigned int vertexCount)
+{
+	VertexBounds bounds;
+	bounds.Add(vertices, vertexCount);
+	return QuantizeVertices(vertices, vertexCount, bounds);
+}
+
+QuantizedMesh QuantizeVertices(const Vertex* vertices, unsigned int vertexCount, const VertexBounds& bounds)
+{
+	QuantizedMesh mesh;
+	mesh.vertices.resize(vertexCount);
+	mesh.halfTexCoords = false;
+
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		const glm::vec2& uv = vertices[i].TexCoords;
+		if (uv.x < 0.0f || uv.x > 1.0f || uv.y < 0.0f || uv.y > 1.0f)
+			mesh.halfTexCoords = true;
+	}
+	mesh.positionOffset = bounds.minimum;
+	mesh.positionScale = bounds.maximum - bounds.minimum;
+	for (int axis = 0; axis < 3; ++axis)
+		if (mesh.positionScale[axis] <= 0.0f)
+			mesh.positionScale[axis] = 1.0f;
+
+	VertexQuantizationError& error = mesh.error;
+	error.vertices = vertexCount;
+	error.halfTexCoords = mesh.halfTexCoords;
+	double positionSum = 0.0, normalSum = 0.0;
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		const Vertex& source = vertices[i];
+		QuantizedVertex& target = mesh.vertices[i];
+
+		glm::vec3 unit = (source.Position - mesh.positionOffset) / mesh.positionScale;
+		for (int axis = 0; axis < 3; ++axis)
+			target.position[axis] = glm::packUnorm1x16(unit[axis]);
+		target.position[3] = 0;
+
+		glm::vec3 normal = SafeNormalize(source.Normal, glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::vec3 tangent = SafeNormalize(source.Tangent, glm::vec3(1.0f, 0.0f, 0.0f));
+		float handedness = glm::dot(glm::cross(normal, tangent), source.Bitangent) < 0.0f ? -1.0f : 1.0f;
+		target.normal = PackSnorm10(normal, 1.0f);
+		target.tangent = PackSnorm10(tangent, handedness);
+
+		for (int c = 0; c < 2; ++c)
+			target.texCoords[c] = mesh.halfTexCoords ? glm::packHalf1x16(source.TexCoords[c]) : glm::packUnorm1x16(source.TexCoords[c]);
+
+		// read it back the way the vertex shader will
+		glm::vec3 position;
+		for (int axis = 0; axis < 3; ++axis)
+			position[axis] = mesh.positionOffset[axis] + glm::unpackUnorm1x16(target.position[axis]) * mesh.positionScale[axis];
+		glm::vec3 decodedNormal = glm::vec3(UnpackSnorm10(target.normal));
+		glm::vec4 decodedTangent = UnpackSnorm10(target.tangent);
+		glm::vec2 texCoords;
+		for (int c = 0; c < 2; ++c)
+			texCoords[c] = mesh.halfTexCoords ? glm::unpackHalf1x16(target.texCoords[c]) : glm::unpackUnorm1x16(target.texCoords[c]);
+		glm::vec3 bitangent = glm::cross(decodedNormal, glm::vec3(decodedTangent)) * decodedTangent.w;
+
+		float positionError = glm::length(position - source.Position);
+		float normalError = AngleDegrees(decodedNormal, normal);
+		positionSum += positionError;
+		normalSum += normalError;
+		error.positionMax = std::max(error.positionMax, positionError);
+		error.normalMaxDegrees = std::max(error.normalMaxDegrees, normalError);
+		error.tangentMaxDegrees = std::max(error.tangentMaxDegrees, AngleDegrees(glm::vec3(decodedTangent), tangent));
+		error.texCoordMax = std::max(error.texCoordMax, std::max(std::abs(texCoords.x - source.TexCoords.x), std::abs(texCoords.y - source.TexCoords.y)));
+		if (glm::dot(bitangent, source.Bitangent) < 0.0f)
+			++error.bitangentFlips;
+	}
+	if (vertexCount > 0)
+	{
+		error.positionMean = (float)(positionSum / vertexCount);
+		error.normalMeanDegrees = (float)(normalSum / vertexCount);
+	}
+	return mesh;
+}
+
+void SetVertexAttributes(VertexLayout layout, bool halfTexCoords)
+{
+	if (layout == VERTEX_LAYOUT_QUANTIZED)
+	{
+		GLsizei stride = sizeof(QuantizedVertex);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, position));
+
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, normal));
+
+		glEnableVertexAttribArray(2);
+		if (halfTexCoords)
+			glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(QuantizedVertex, texCoords));
+		else
+			glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, texCoords));
+
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, tangent));
+
+		// no bitangent, the shaders derive it from the normal, tangent and sign
+		glDisableVertexAttribArray(4);
+		return;
+	}
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+}
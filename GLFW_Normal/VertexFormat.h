@@ -0,0 +1,77 @@
+#pragma once
+
+#include <GLM/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+struct Vertex;
+
+// GPU layouts a Mesh can upload its vertices in. Meshes and the mesh cache
+// always hold the float Vertex, the layout only changes what goes to the VBO.
+enum VertexLayout
+{
+	VERTEX_LAYOUT_FLOAT = 0, // Vertex as is, 56 bytes
+	VERTEX_LAYOUT_QUANTIZED  // QuantizedVertex, 20 bytes
+};
+
+// Positions are unorm16 within the mesh bounds (or a box shared by the whole
+// model, see VertexBounds), the shaders rebuild them from
+// the positionOffset / positionScale uniforms Mesh::Draw sets. Normal and
+// tangent are GL_INT_2_10_10_10_REV with the bitangent sign in the tangent's w,
+// the bitangent itself is cross(N, T) * w in the shader. Texture coordinates
+// are unorm16 when they stay within [0, 1] and half floats otherwise.
+struct QuantizedVertex
+{
+	uint16_t position[4]; // w unused, keeps the next attribute 4-byte aligned
+	uint32_t normal;
+	uint32_t tangent;
+	uint16_t texCoords[2];
+};
+
+// Largest and mean difference between the float vertices and what the GPU
+// reads back from the quantized ones
+struct VertexQuantizationError
+{
+	unsigned int vertices = 0;
+	float positionMax = 0.0f;    // in model units
+	float positionMean = 0.0f;
+	float normalMaxDegrees = 0.0f;
+	float normalMeanDegrees = 0.0f;
+	float tangentMaxDegrees = 0.0f;
+	float texCoordMax = 0.0f;
+	unsigned int bitangentFlips = 0; // derived bitangent points away from the imported one
+	bool halfTexCoords = false;
+
+	void Merge(const VertexQuantizationError& other);
+};
+
+// Box the quantized positions are stored in. Meshes quantized against one
+// shared box need the same positionOffset / positionScale, so a Model can draw
+// all of them in one batch instead of setting the uniforms per mesh.
+struct VertexBounds
+{
+	glm::vec3 minimum = glm::vec3(0.0f);
+	glm::vec3 maximum = glm::vec3(0.0f);
+	bool empty = true;
+
+	void Add(const glm::vec3& position);
+	void Add(const Vertex* vertices, unsigned int vertexCount);
+};
+
+struct QuantizedMesh
+{
+	std::vector<QuantizedVertex> vertices;
+	glm::vec3 positionOffset;
+	glm::vec3 positionScale;
+	bool halfTexCoords;
+	VertexQuantizationError error;
+};
+
+unsigned int GetVertexStride(VertexLayout layout);
+const char* GetVertexLayoutName(VertexLayout layout);
+
+// Quantized within the vertices' own bounds, or within a shared box that contains them
+QuantizedMesh QuantizeVertices(const Vertex* vertices, unsigned int vertexCount);
+QuantizedMesh QuantizeVertices(const Vertex* vertices, unsigned int vertexCount, const VertexBounds& bounds);
+// Attribute pointers 0-4 for the bound VAO and VBO
+void SetVertexAttributes(VertexLayout layout, bool halfTexCoords);
@@ -14,13 +14,17 @@ out VS_OUT
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
+uniform bool quantized; // VERTEX_LAYOUT_QUANTIZED mesh, positions are unorm16 within its bounds
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
 void main()
 {
-	vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+	vec3 position = quantized ? positionOffset + aPos * positionScale : aPos;
+	vs_out.FragPos = vec3(model * vec4(position, 1.0));
 	vs_out.Normal = mat3(transpose(inverse(model))) * aNormal;
 	vs_out.TexCoords = aTexCoords;
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	gl_Position = projection * view * model * vec4(position, 1.0);
 };
 
 #shader fragment
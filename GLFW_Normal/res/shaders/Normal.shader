@@ -3,8 +3,7 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
-layout(location = 3) in vec3 aTangent;
-layout(location = 4) in vec3 aBitangent;
+layout(location = 3) in vec4 aTangent; // w is the bitangent sign, 1 for float meshes
 
 out VS_OUT
 {
@@ -18,26 +17,30 @@ out VS_OUT
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
+uniform bool quantized; // VERTEX_LAYOUT_QUANTIZED mesh, positions are unorm16 within its bounds
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
 uniform vec3 lightPos;
 uniform vec3 viewPos;
 
 void main()
 {
-	vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+	vec3 position = quantized ? positionOffset + aPos * positionScale : aPos;
+	vs_out.FragPos = vec3(model * vec4(position, 1.0));
 	vs_out.TexCoords = aTexCoords;
 
-	vec3 T = normalize(vec3(model * vec4(aTangent, 0.0))); // Gram-Schmidt Process
+	vec3 T = normalize(vec3(model * vec4(aTangent.xyz, 0.0))); // Gram-Schmidt Process
 	vec3 N = normalize(vec3(model * vec4(aNormal, 0.0)));
 	T = normalize(T - dot(T, N) * N);
-	vec3 B = cross(N, T);
+	vec3 B = cross(N, T) * (aTangent.w < 0.0 ? -1.0 : 1.0);
 
 	mat3 TBN = transpose(mat3(T, B, N));
 	vs_out.TangentLightPos = TBN * lightPos;
 	vs_out.TangentViewPos = TBN * viewPos;
 	vs_out.TangentFragPos = TBN * vs_out.FragPos;
 
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	gl_Position = projection * view * model * vec4(position, 1.0);
 };
 
 #shader fragment
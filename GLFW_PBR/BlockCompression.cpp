@@ -0,0 +1,597 @@
+#include "BlockCompression.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// BC7 interpolation weights for 4-bit indices, out of 64
+static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Fraction towards the second endpoint for each BC1 index in four colour mode
+static const float BC1_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+unsigned int GetBlockBytes(BlockFormat format)
+{
+	return (format == BLOCK_BC1 || format == BLOCK_BC4) ? 8 : 16;
+}
+
+size_t GetCompressedSize(BlockFormat format, unsigned int width, unsigned int height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * GetBlockBytes(format);
+}
+
+const char* GetBlockFormatName(BlockFormat format)
+{
+	switch (format)
+	{
+	case BLOCK_BC1: return "BC1";
+	case BLOCK_BC3: return "BC3";
+	case BLOCK_BC4: return "BC4";
+	case BLOCK_BC5: return "BC5";
+	default: return "BC7";
+	}
+}
+
+// Principal axis of the block through power iteration, endpoints are the extreme projections
+static void FitEndpoints(const uint8_t* pixels, unsigned int channels, float* first, float* second)
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (unsigned int i = 0; i < 16; ++i)
+		for (unsigned int c = 0; c < channels; ++c)
+			mean[c] += pixels[i * 4 + c] / 16.0f;
+
+	float covariance[4][4] = {};
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		float d[4];
+		for (unsigned int c = 0; c < channels; ++c)
+			d[c] = pixels[i * 4 + c] - mean[c];
+		for (unsigned int a = 0; a < channels; ++a)
+			for (unsigned int b = 0; b < channels; ++b)
+				covariance[a][b] += d[a] * d[b];
+	}
+
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (unsigned int iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float length = 0.0f;
+		for (unsigned int a = 0; a < channels; ++a)
+		{
+			for (unsigned int b = 0; b < channels; ++b)
+				next[a] += covariance[a][b] * axis[b];
+			length += next[a] * next[a];
+		}
+		if (length < 1e-8f)
+			break;
+		length = std::sqrt(length);
+		for (unsigned int c = 0; c < channels; ++c)
+			axis[c] = next[c] / length;
+	}
+
+	float minT = 0.0f, maxT = 0.0f;
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		float t = 0.0f;
+		for (unsigned int c = 0; c < channels; ++c)
+			t += (pixels[i * 4 + c] - mean[c]) * axis[c];
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+
+	for (unsigned int c = 0; c < channels; ++c)
+	{
+		first[c] = std::min(std::max(mean[c] + axis[c] * maxT, 0.0f), 255.0f);
+		second[c] = std::min(std::max(mean[c] + axis[c] * minT, 0.0f), 255.0f);
+	}
+}
+
+// Least-squares endpoints for fixed weights (fraction towards the second endpoint per pixel)
+static bool RefineEndpoints(const uint8_t* pixels, unsigned int channels, const float* weights, float* first, float* second)
+{
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+	float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		float b = weights[i];
+		float a = 1.0f - b;
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+		for (unsigned int c = 0; c < channels; ++c)
+		{
+			ax[c] += a * pixels[i * 4 + c];
+			bx[c] += b * pixels[i * 4 + c];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (std::fabs(determinant) < 1e-6f)
+		return false;
+
+	for (unsigned int c = 0; c < channels; ++c)
+	{
+		first[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+		second[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+static uint16_t PackColor565(const float* color)
+{
+	unsigned int r = (unsigned int)(color[0] * 31.0f / 255.0f + 0.5f);
+	unsigned int g = (unsigned int)(color[1] * 63.0f / 255.0f + 0.5f);
+	unsigned int b = (unsigned int)(color[2] * 31.0f / 255.0f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void UnpackColor565(uint16_t packed, int* color)
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+static void BuildColorPalette(uint16_t color0, uint16_t color1, bool allowThreeColor, int palette[4][3])
+{
+	UnpackColor565(color0, palette[0]);
+	UnpackColor565(color1, palette[1]);
+	for (unsigned int c = 0; c < 3; ++c)
+	{
+		if (color0 > color1 || !allowThreeColor)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+}
+
+// BC1 colour block in four colour mode, also used by BC3 where three colour mode does not exist
+static void EncodeColorBlock(const uint8_t* pixels, uint8_t* block)
+{
+	float first[3], second[3];
+	FitEndpoints(pixels, 3, first, second);
+
+	uint32_t bestError = ~0u;
+	for (unsigned int iteration = 0; iteration < 3; ++iteration)
+	{
+		uint16_t color0 = PackColor565(first);
+		uint16_t color1 = PackColor565(second);
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		int palette[4][3];
+		BuildColorPalette(color0, color1, false, palette);
+
+		uint32_t indices = 0, error = 0;
+		float weights[16];
+		for (unsigned int i = 0; i < 16; ++i)
+		{
+			uint32_t bestPixel = ~0u;
+			unsigned int bestIndex = 0;
+			// equal endpoints decode in three colour mode, only index 0 is safe then
+			unsigned int candidates = color0 == color1 ? 1 : 4;
+			for (unsigned int index = 0; index < candidates; ++index)
+			{
+				int dr = pixels[i * 4 + 0] - palette[index][0];
+				int dg = pixels[i * 4 + 1] - palette[index][1];
+				int db = pixels[i * 4 + 2] - palette[index][2];
+				uint32_t distance = (uint32_t)(dr * dr + dg * dg + db * db);
+				if (distance < bestPixel)
+				{
+					bestPixel = distance;
+					bestIndex = index;
+				}
+			}
+			indices |= bestIndex << (2 * i);
+			error += bestPixel;
+			weights[i] = BC1_WEIGHTS[bestIndex];
+		}
+
+		if (error < bestError)
+		{
+			bestError = error;
+			std::memcpy(block, &color0, 2);
+			std::memcpy(block + 2, &color1, 2);
+			std::memcpy(block + 4, &indices, 4);
+		}
+		if (error == 0 || color0 == color1)
+			break;
+
+		// weights are relative to the packed order, which may have swapped the endpoints
+		if (!RefineEndpoints(pixels, 3, weights, first, second))
+			break;
+	}
+}
+
+void EncodeBC1Block(const uint8_t* pixels, uint8_t* block)
+{
+	EncodeColorBlock(pixels, block);
+}
+
+void EncodeBC4Block(const uint8_t* pixels, unsigned int channel, uint8_t* block)
+{
+	int minValue = 255, maxValue = 0;
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		minValue = std::min(minValue, (int)pixels[i * 4 + channel]);
+		maxValue = std::max(maxValue, (int)pixels[i * 4 + channel]);
+	}
+
+	block[0] = (uint8_t)maxValue;
+	block[1] = (uint8_t)minValue;
+	uint64_t indices = 0;
+	if (maxValue != minValue)
+	{
+		// eight value mode: index 0 and 1 are the endpoints, 2..7 step from the first to the second
+		int palette[8];
+		palette[0] = maxValue;
+		palette[1] = minValue;
+		for (int k = 2; k < 8; ++k)
+			palette[k] = ((8 - k) * maxValue + (k - 1) * minValue + 3) / 7;
+
+		for (unsigned int i = 0; i < 16; ++i)
+		{
+			int value = pixels[i * 4 + channel];
+			unsigned int bestIndex = 0;
+			int bestDistance = 256;
+			for (unsigned int index = 0; index < 8; ++index)
+			{
+				int distance = std::abs(value - palette[index]);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestIndex = index;
+				}
+			}
+			indices |= (uint64_t)bestIndex << (3 * i);
+		}
+	}
+	for (unsigned int i = 0; i < 6; ++i)
+		block[2 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+void EncodeBC3Block(const uint8_t* pixels, uint8_t* block)
+{
+	EncodeBC4Block(pixels, 3, block);
+	EncodeColorBlock(pixels, block + 8);
+}
+
+void EncodeBC5Block(const uint8_t* pixels, uint8_t* block)
+{
+	EncodeBC4Block(pixels, 0, block);
+	EncodeBC4Block(pixels, 1, block + 8);
+}
+
+// LSB-first bit packing for BC7 blocks
+struct BlockBits
+{
+	uint8_t* data;
+	unsigned int position;
+
+	void Write(uint32_t value, unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; ++i, ++position)
+			if (value & (1u << i))
+				data[position >> 3] |= (uint8_t)(1u << (position & 7));
+	}
+
+	uint32_t Read(unsigned int count)
+	{
+		uint32_t value = 0;
+		for (unsigned int i = 0; i < count; ++i, ++position)
+			value |= (uint32_t)((data[position >> 3] >> (position & 7)) & 1) << i;
+		return value;
+	}
+};
+
+// 7-bit endpoint plus the p-bit shared by its four channels, whichever p-bit fits better
+static void QuantizeBC7Endpoint(const float* endpoint, int* quantized, unsigned int& pbit)
+{
+	float bestError = 1e30f;
+	for (unsigned int p = 0; p < 2; ++p)
+	{
+		int candidate[4];
+		float error = 0.0f;
+		for (unsigned int c = 0; c < 4; ++c)
+		{
+			int q = (int)std::floor((endpoint[c] - p) / 2.0f + 0.5f);
+			q = std::min(std::max(q, 0), 127);
+			candidate[c] = q;
+			float difference = (float)((q << 1) | p) - endpoint[c];
+			error += difference * difference;
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			pbit = p;
+			std::memcpy(quantized, candidate, sizeof(candidate));
+		}
+	}
+}
+
+void EncodeBC7Block(const uint8_t* pixels, uint8_t* block)
+{
+	float first[4], second[4];
+	FitEndpoints(pixels, 4, first, second);
+
+	uint64_t bestError = ~0ull;
+	int bestEndpoints[2][4] = {};
+	unsigned int bestPBits[2] = { 0, 0 };
+	unsigned int bestIndices[16] = {};
+	for (unsigned int iteration = 0; iteration < 3; ++iteration)
+	{
+		int quantized[2][4];
+		unsigned int pbits[2];
+		QuantizeBC7Endpoint(first, quantized[0], pbits[0]);
+		QuantizeBC7Endpoint(second, quantized[1], pbits[1]);
+
+		int endpoints[2][4];
+		for (unsigned int c = 0; c < 4; ++c)
+		{
+			endpoints[0][c] = (quantized[0][c] << 1) | (int)pbits[0];
+			endpoints[1][c] = (quantized[1][c] << 1) | (int)pbits[1];
+		}
+
+		int palette[16][4];
+		for (unsigned int index = 0; index < 16; ++index)
+			for (unsigned int c = 0; c < 4; ++c)
+				palette[index][c] = ((64 - BC7_WEIGHTS[index]) * endpoints[0][c] + BC7_WEIGHTS[index] * endpoints[1][c] + 32) >> 6;
+
+		uint64_t error = 0;
+		unsigned int indices[16];
+		float weights[16];
+		for (unsigned int i = 0; i < 16; ++i)
+		{
+			uint32_t bestPixel = ~0u;
+			for (unsigned int index = 0; index < 16; ++index)
+			{
+				uint32_t distance = 0;
+				for (unsigned int c = 0; c < 4; ++c)
+				{
+					int difference = pixels[i * 4 + c] - palette[index][c];
+					distance += (uint32_t)(difference * difference);
+				}
+				if (distance < bestPixel)
+				{
+					bestPixel = distance;
+					indices[i] = index;
+				}
+			}
+			error += bestPixel;
+			weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+		}
+
+		if (error < bestError)
+		{
+			bestError = error;
+			std::memcpy(bestEndpoints, quantized, sizeof(quantized));
+			std::memcpy(bestPBits, pbits, sizeof(pbits));
+			std::memcpy(bestIndices, indices, sizeof(indices));
+		}
+		if (error == 0 || !RefineEndpoints(pixels, 4, weights, first, second))
+			break;
+	}
+
+	// the anchor (first) index drops its top bit, swapping the endpoints mirrors the weights
+	if (bestIndices[0] & 8)
+	{
+		for (unsigned int c = 0; c < 4; ++c)
+			std::swap(bestEndpoints[0][c], bestEndpoints[1][c]);
+		std::swap(bestPBits[0], bestPBits[1]);
+		for (unsigned int i = 0; i < 16; ++i)
+			bestIndices[i] = 15 - bestIndices[i];
+	}
+
+	std::memset(block, 0, 16);
+	BlockBits bits = { block, 0 };
+	bits.Write(1u << 6, 7);
+	for (unsigned int c = 0; c < 4; ++c)
+	{
+		bits.Write(bestEndpoints[0][c], 7);
+		bits.Write(bestEndpoints[1][c], 7);
+	}
+	bits.Write(bestPBits[0], 1);
+	bits.Write(bestPBits[1], 1);
+	bits.Write(bestIndices[0], 3);
+	for (unsigned int i = 1; i < 16; ++i)
+		bits.Write(bestIndices[i], 4);
+}
+
+void DecodeBC1Block(const uint8_t* block, uint8_t* pixels)
+{
+	uint16_t color0, color1;
+	uint32_t indices;
+	std::memcpy(&color0, block, 2);
+	std::memcpy(&color1, block + 2, 2);
+	std::memcpy(&indices, block + 4, 4);
+
+	int palette[4][3];
+	BuildColorPalette(color0, color1, true, palette);
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		unsigned int index = (indices >> (2 * i)) & 3;
+		for (unsigned int c = 0; c < 3; ++c)
+			pixels[i * 4 + c] = (uint8_t)palette[index][c];
+		pixels[i * 4 + 3] = (color0 <= color1 && index == 3) ? 0 : 255;
+	}
+}
+
+void DecodeBC4Block(const uint8_t* block, unsigned int channel, uint8_t* pixels)
+{
+	int palette[8];
+	palette[0] = block[0];
+	palette[1] = block[1];
+	if (palette[0] > palette[1])
+	{
+		for (int k = 2; k < 8; ++k)
+			palette[k] = ((8 - k) * palette[0] + (k - 1) * palette[1] + 3) / 7;
+	}
+	else
+	{
+		for (int k = 2; k < 6; ++k)
+			palette[k] = ((6 - k) * palette[0] + (k - 1) * palette[1] + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	uint64_t indices = 0;
+	for (unsigned int i = 0; i < 6; ++i)
+		indices |= (uint64_t)block[2 + i] << (8 * i);
+	for (unsigned int i = 0; i < 16; ++i)
+		pixels[i * 4 + channel] = (uint8_t)palette[(indices >> (3 * i)) & 7];
+}
+
+void DecodeBC3Block(const uint8_t* block, uint8_t* pixels)
+{
+	uint16_t color0, color1;
+	uint32_t indices;
+	std::memcpy(&color0, block + 8, 2);
+	std::memcpy(&color1, block + 10, 2);
+	std::memcpy(&indices, block + 12, 4);
+
+	int palette[4][3];
+	BuildColorPalette(color0, color1, false, palette);
+	for (unsigned int i = 0; i < 16; ++i)
+		for (unsigned int c = 0; c < 3; ++c)
+			pixels[i * 4 + c] = (uint8_t)palette[(indices >> (2 * i)) & 3][c];
+	DecodeBC4Block(block, 3, pixels);
+}
+
+void DecodeBC5Block(const uint8_t* block, uint8_t* pixels)
+{
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		pixels[i * 4 + 2] = 0;
+		pixels[i * 4 + 3] = 255;
+	}
+	DecodeBC4Block(block, 0, pixels);
+	DecodeBC4Block(block + 8, 1, pixels);
+}
+
+void DecodeBC7Block(const uint8_t* block, uint8_t* pixels)
+{
+	BlockBits bits = { (uint8_t*)block, 0 };
+	if (bits.Read(7) != (1u << 6))
+	{
+		// only mode 6 is written by EncodeBC7Block
+		std::memset(pixels, 0, 64);
+		return;
+	}
+
+	int endpoints[2][4];
+	for (unsigned int c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] = (int)bits.Read(7) << 1;
+		endpoints[1][c] = (int)bits.Read(7) << 1;
+	}
+	unsigned int pbit0 = bits.Read(1);
+	unsigned int pbit1 = bits.Read(1);
+	for (unsigned int c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] |= (int)pbit0;
+		endpoints[1][c] |= (int)pbit1;
+	}
+
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		unsigned int index = bits.Read(i == 0 ? 3 : 4);
+		for (unsigned int c = 0; c < 4; ++c)
+			pixels[i * 4 + c] = (uint8_t)(((64 - BC7_WEIGHTS[index]) * endpoints[0][c] + BC7_WEIGHTS[index] * endpoints[1][c] + 32) >> 6);
+	}
+}
+
+static void EncodeBlock(BlockFormat format, const uint8_t* pixels, uint8_t* block)
+{
+	switch (format)
+	{
+	case BLOCK_BC1: EncodeBC1Block(pixels, block); break;
+	case BLOCK_BC3: EncodeBC3Block(pixels, block); break;
+	case BLOCK_BC4: EncodeBC4Block(pixels, 0, block); break;
+	case BLOCK_BC5: EncodeBC5Block(pixels, block); break;
+	default: EncodeBC7Block(pixels, block); break;
+	}
+}
+
+static void DecodeBlock(BlockFormat format, const uint8_t* block, uint8_t* pixels)
+{
+	switch (format)
+	{
+	case BLOCK_BC1: DecodeBC1Block(block, pixels); break;
+	case BLOCK_BC3: DecodeBC3Block(block, pixels); break;
+	case BLOCK_BC4:
+		DecodeBC4Block(block, 0, pixels);
+		for (unsigned int i = 0; i < 16; ++i)
+		{
+			pixels[i * 4 + 1] = pixels[i * 4 + 2] = pixels[i * 4];
+			pixels[i * 4 + 3] = 255;
+		}
+		break;
+	case BLOCK_BC5: DecodeBC5Block(block, pixels); break;
+	default: DecodeBC7Block(block, pixels); break;
+	}
+}
+
+std::vector<uint8_t> CompressImage(BlockFormat format, const uint8_t* rgba, unsigned int width, unsigned int height, ThreadPool* pool)
+{
+	unsigned int blocksX = (width + 3) / 4;
+	unsigned int blocksY = (height + 3) / 4;
+	unsigned int blockBytes = GetBlockBytes(format);
+	std::vector<uint8_t> blocks((size_t)blocksX * blocksY * blockBytes);
+
+	auto compressRow = [&](unsigned int by)
+	{
+		uint8_t pixels[64];
+		for (unsigned int bx = 0; bx < blocksX; ++bx)
+		{
+			for (unsigned int y = 0; y < 4; ++y)
+			{
+				unsigned int sy = std::min(by * 4 + y, height - 1);
+				for (unsigned int x = 0; x < 4; ++x)
+				{
+					unsigned int sx = std::min(bx * 4 + x, width - 1);
+					std::memcpy(&pixels[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+				}
+			}
+			EncodeBlock(format, pixels, &blocks[((size_t)by * blocksX + bx) * blockBytes]);
+		}
+	};
+
+	if (pool)
+		pool->ParallelFor(blocksY, compressRow);
+	else
+		for (unsigned int by = 0; by < blocksY; ++by)
+			compressRow(by);
+	return blocks;
+}
+
+std::vector<uint8_t> DecompressImage(BlockFormat format, const uint8_t* blocks, unsigned int width, unsigned int height)
+{
+	unsigned int blocksX = (width + 3) / 4;
+	unsigned int blocksY = (height + 3) / 4;
+	unsigned int blockBytes = GetBlockBytes(format);
+	std::vector<uint8_t> rgba((size_t)width * height * 4);
+
+	uint8_t pixels[64];
+	for (unsigned int by = 0; by < blocksY; ++by)
+	{
+		for (unsigned int bx = 0; bx < blocksX; ++bx)
+		{
+			DecodeBlock(format, &blocks[((size_t)by * blocksX + bx) * blockBytes], pixels);
+			for (unsigned int y = 0; y < 4 && by * 4 + y < height; ++y)
+				for (unsigned int x = 0; x < 4 && bx * 4 + x < width; ++x)
+					std::memcpy(&rgba[((size_t)(by * 4 + y) * width + bx * 4 + x) * 4], &pixels[(y * 4 + x) * 4], 4);
+		}
+	}
+	return rgba;
+}
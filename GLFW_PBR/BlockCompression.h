@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class ThreadPool;
+
+// Block-compressed formats written by the texture compressor. Every format
+// stores 4x4 pixel blocks of 8 (BC1, BC4) or 16 bytes.
+//  - BC1: RGB, two 565 endpoints and 2-bit indices
+//  - BC3: BC1 colour plus a BC4 alpha block
+//  - BC4: one channel, two 8-bit endpoints and 3-bit indices
+//  - BC5: two BC4 blocks, red and green
+//  - BC7: RGBA, encoded with mode 6 only (one subset, 7-bit endpoints plus a
+//         p-bit, 4-bit indices), which covers smooth albedo maps well
+enum BlockFormat
+{
+	BLOCK_BC1,
+	BLOCK_BC3,
+	BLOCK_BC4,
+	BLOCK_BC5,
+	BLOCK_BC7
+};
+
+unsigned int GetBlockBytes(BlockFormat format);
+size_t GetCompressedSize(BlockFormat format, unsigned int width, unsigned int height);
+const char* GetBlockFormatName(BlockFormat format);
+
+// One 4x4 block, pixels are RGBA8 in row order
+void EncodeBC1Block(const uint8_t* pixels, uint8_t* block);
+void EncodeBC3Block(const uint8_t* pixels, uint8_t* block);
+void EncodeBC4Block(const uint8_t* pixels, unsigned int channel, uint8_t* block);
+void EncodeBC5Block(const uint8_t* pixels, uint8_t* block);
+void EncodeBC7Block(const uint8_t* pixels, uint8_t* block);
+
+void DecodeBC1Block(const uint8_t* block, uint8_t* pixels);
+void DecodeBC3Block(const uint8_t* block, uint8_t* pixels);
+void DecodeBC4Block(const uint8_t* block, unsigned int channel, uint8_t* pixels);
+void DecodeBC5Block(const uint8_t* block, uint8_t* pixels);
+void DecodeBC7Block(const uint8_t* block, uint8_t* pixels);
+
+// Whole RGBA8 image, edge blocks repeat the last row and column. Rows of blocks
+// are spread over the pool when one is given.
+std::vector<uint8_t> CompressImage(BlockFormat format, const uint8_t* rgba, unsigned int width, unsigned int height, ThreadPool* pool = nullptr);
+std::vector<uint8_t> DecompressImage(BlockFormat format, const uint8_t* blocks, unsigned int width, unsigned int height);
@@ -0,0 +1,245 @@
+#include "DDSFile.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <sys/stat.h>
+
+static uint32_t FourCC(char a, char b, char c, char d)
+{
+	return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) | ((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+}
+
+static const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+static const uint32_t DDS_SOURCE_TAG = 0x4B525253; // "SRRK", marks the source stamp in reserved1
+static const uint32_t DDS_SOURCE_VERSION = 1;
+
+static const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000;
+static const uint32_t DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+static const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+// Files are read on worker threads, which cannot ask GL for GL_MAX_TEXTURE_SIZE; 16384 is
+// what current drivers allow and anything past it can only come from a corrupt header
+static const unsigned int DDS_MAX_DIMENSION = 16384;
+static const unsigned int DDS_MAX_LEVELS = 16;
+
+struct DDSPixelFormat
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t masks[4];
+};
+
+struct DDSHeader
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	uint32_t reserved1[11];
+	DDSPixelFormat pixelFormat;
+	uint32_t caps[4];
+	uint32_t reserved2;
+};
+
+struct DDSHeaderDX10
+{
+	uint32_t dxgiFormat;
+	uint32_t resourceDimension;
+	uint32_t miscFlag;
+	uint32_t arraySize;
+	uint32_t miscFlags2;
+};
+static_assert(sizeof(DDSHeader) == 124, "DDS header must be 124 bytes");
+
+// DXGI_FORMAT_BCn_UNORM, the typeless and sRGB variants are one below and one above
+static uint32_t GetDXGIFormat(BlockFormat format)
+{
+	switch (format)
+	{
+	case BLOCK_BC1: return 71;
+	case BLOCK_BC3: return 77;
+	case BLOCK_BC4: return 80;
+	case BLOCK_BC5: return 83;
+	default: return 98;
+	}
+}
+
+static bool FromDXGIFormat(uint32_t dxgiFormat, BlockFormat& format)
+{
+	if (dxgiFormat >= 70 && dxgiFormat <= 72) format = BLOCK_BC1;
+	else if (dxgiFormat >= 76 && dxgiFormat <= 78) format = BLOCK_BC3;
+	else if (dxgiFormat >= 79 && dxgiFormat <= 80) format = BLOCK_BC4;
+	else if (dxgiFormat >= 82 && dxgiFormat <= 83) format = BLOCK_BC5;
+	else if (dxgiFormat >= 97 && dxgiFormat <= 99) format = BLOCK_BC7;
+	else return false;
+	return true;
+}
+
+static bool FromFourCC(uint32_t fourCC, BlockFormat& format)
+{
+	if (fourCC == FourCC('D', 'X', 'T', '1')) format = BLOCK_BC1;
+	else if (fourCC == FourCC('D', 'X', 'T', '5')) format = BLOCK_BC3;
+	else if (fourCC == FourCC('A', 'T', 'I', '1') || fourCC == FourCC('B', 'C', '4', 'U')) format = BLOCK_BC4;
+	else if (fourCC == FourCC('A', 'T', 'I', '2') || fourCC == FourCC('B', 'C', '5', 'U')) format = BLOCK_BC5;
+	else return false;
+	return true;
+}
+
+static bool GetSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time)
+{
+	struct stat info;
+	if (stat(sourcePath.c_str(), &info) != 0)
+		return false;
+	size = (uint64_t)info.st_size;
+	time = (int64_t)info.st_mtime;
+	return true;
+}
+
+std::string GetCompressedTexturePath(const std::string& sourcePath)
+{
+	return sourcePath + ".dds";
+}
+
+bool LoadCompressedTexture(const std::string& sourcePath, DDSTexture& texture)
+{
+	std::ifstream stream(GetCompressedTexturePath(sourcePath), std::ios::binary);
+	if (!stream)
+		return false;
+
+	uint32_t magic = 0;
+	DDSHeader header;
+	stream.read((char*)&magic, sizeof(magic));
+	stream.read((char*)&header, sizeof(header));
+	if (!stream || magic != DDS_MAGIC || header.size != sizeof(DDSHeader) || header.width == 0 || header.height == 0)
+		return false;
+	if (header.width > DDS_MAX_DIMENSION || header.height > DDS_MAX_DIMENSION)
+	{
+		std::cout << "Compressed texture is " << header.width << "x" << header.height << ", loading the source image: " << sourcePath << std::endl;
+		return false;
+	}
+
+	// a stamped file has to match its source; an unstamped one was authored elsewhere and is taken as is
+	if (header.reserved1[0] == DDS_SOURCE_TAG)
+	{
+		uint64_t size = 0;
+		int64_t time = 0;
+		GetSourceStamp(sourcePath, size, time);
+		uint64_t storedSize = header.reserved1[2] | ((uint64_t)header.reserved1[3] << 32);
+		int64_t storedTime = (int64_t)(header.reserved1[4] | ((uint64_t)header.reserved1[5] << 32));
+		if (header.reserved1[1] != DDS_SOURCE_VERSION || storedSize != size || storedTime != time)
+		{
+			std::cout << "Compressed texture is stale, loading the source image: " << sourcePath << std::endl;
+			return false;
+		}
+	}
+
+	if (!(header.pixelFormat.flags & DDPF_FOURCC))
+		return false;
+	if (header.pixelFormat.fourCC == FourCC('D', 'X', '1', '0'))
+	{
+		DDSHeaderDX10 extended;
+		stream.read((char*)&extended, sizeof(extended));
+		if (!stream || extended.resourceDimension != DDS_DIMENSION_TEXTURE2D || extended.arraySize > 1 || !FromDXGIFormat(extended.dxgiFormat, texture.format))
+			return false;
+	}
+	else if (!FromFourCC(header.pixelFormat.fourCC, texture.format))
+		return false;
+
+	texture.width = header.width;
+	texture.height = header.height;
+	// levels past the 1x1 one do not exist, a count claiming more is cut to the full chain
+	unsigned int fullChain = 1;
+	while ((std::max(texture.width, texture.height) >> fullChain) > 0)
+		++fullChain;
+	unsigned int levelCount = (header.flags & DDSD_MIPMAPCOUNT) ? std::max(header.mipMapCount, 1u) : 1;
+	levelCount = std::min(levelCount, std::min(fullChain, DDS_MAX_LEVELS));
+
+	// a truncated file is turned down before anything is allocated for it
+	size_t expected = 0;
+	for (unsigned int level = 0; level < levelCount; ++level)
+		expected += GetCompressedSize(texture.format, std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u));
+	std::streamoff dataStart = stream.tellg();
+	stream.seekg(0, std::ios::end);
+	std::streamoff available = stream.tellg() - dataStart;
+	stream.seekg(dataStart);
+	if (!stream || available < (std::streamoff)expected)
+	{
+		std::cout << "Compressed texture is truncated, loading the source image: " << sourcePath << std::endl;
+		return false;
+	}
+
+	texture.levels.resize(levelCount);
+	for (unsigned int level = 0; level < levelCount; ++level)
+	{
+		unsigned int width = std::max(texture.width >> level, 1u);
+		unsigned int height = std::max(texture.height >> level, 1u);
+		texture.levels[level].resize(GetCompressedSize(texture.format, width, height));
+		stream.read((char*)texture.levels[level].data(), texture.levels[level].size());
+	}
+	return (bool)stream;
+}
+
+bool SaveCompressedTexture(const std::string& sourcePath, const DDSTexture& texture)
+{
+	std::string filepath = GetCompressedTexturePath(sourcePath);
+	std::ofstream stream(filepath, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		std::cout << "Unable to write compressed texture: " << filepath << std::endl;
+		return false;
+	}
+
+	uint64_t sourceSize = 0;
+	int64_t sourceTime = 0;
+	GetSourceStamp(sourcePath, sourceSize, sourceTime);
+
+	DDSHeader header = {};
+	header.size = sizeof(DDSHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.height = texture.height;
+	header.width = texture.width;
+	header.pitchOrLinearSize = texture.levels.empty() ? 0 : (uint32_t)texture.levels[0].size();
+	header.mipMapCount = (uint32_t)texture.levels.size();
+	header.reserved1[0] = DDS_SOURCE_TAG;
+	header.reserved1[1] = DDS_SOURCE_VERSION;
+	header.reserved1[2] = (uint32_t)sourceSize;
+	header.reserved1[3] = (uint32_t)(sourceSize >> 32);
+	header.reserved1[4] = (uint32_t)(uint64_t)sourceTime;
+	header.reserved1[5] = (uint32_t)((uint64_t)sourceTime >> 32);
+	header.pixelFormat.size = sizeof(DDSPixelFormat);
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.pixelFormat.fourCC = FourCC('D', 'X', '1', '0');
+	header.caps[0] = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+
+	DDSHeaderDX10 extended = {};
+	extended.dxgiFormat = GetDXGIFormat(texture.format);
+	extended.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+	extended.arraySize = 1;
+
+	stream.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+	stream.write((const char*)&header, sizeof(header));
+	stream.write((const char*)&extended, sizeof(extended));
+	for (const std::vector<uint8_t>& level : texture.levels)
+		stream.write((const char*)level.data(), level.size());
+	return (bool)stream;
+}
+
+GLenum GetCompressedFormat(BlockFormat format, bool gammaCorrection)
+{
+	switch (format)
+	{
+	case BLOCK_BC1: return gammaCorrection ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case BLOCK_BC3: return gammaCorrection ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BLOCK_BC4: return GL_COMPRESSED_RED_RGTC1;
+	case BLOCK_BC5: return GL_COMPRESSED_RG_RGTC2;
+	default: return gammaCorrection ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "BlockCompression.h"
+#include <GLAD/glad.h>
+#include <string>
+#include <vector>
+
+// EXT_texture_compression_s3tc / EXT_texture_sRGB tokens, the GLAD build only carries core enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// Block-compressed 2D texture with its full mip chain, level 0 first
+struct DDSTexture
+{
+	BlockFormat format = BLOCK_BC1;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	std::vector<std::vector<uint8_t>> levels;
+};
+
+// Compressed copy of an image file is stored next to it as <image>.dds, with a
+// DX10 header so every BC format uses the same layout. The size and time of the
+// source image are kept in the reserved header words; a copy that no longer
+// matches its source is treated as missing. Legacy DXT1/DXT5/ATI1/ATI2 files
+// are read as well.
+std::string GetCompressedTexturePath(const std::string& sourcePath);
+bool LoadCompressedTexture(const std::string& sourcePath, DDSTexture& texture);
+bool SaveCompressedTexture(const std::string& sourcePath, const DDSTexture& texture);
+
+// GL internal format for glCompressedTexImage2D, BC4 and BC5 have no sRGB variant
+GLenum GetCompressedFormat(BlockFormat format, bool gammaCorrection);
@@ -0,0 +1,297 @@
+#include "Headless.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+const float Headless::FRAME_TIME = 1.0f / 60.0f;
+
+Headless::Headless()
+	: m_Enabled(false), m_Width(0), m_Height(0), m_Frames(120), m_CaptureEvery(0), m_ContextAPI(GLFW_NATIVE_CONTEXT_API), m_OutputPrefix("frame"),
+	m_Frame(0), m_CameraStored(false), m_CameraPosition(0.0f), m_CameraYaw(0.0f), m_CameraPitch(0.0f), m_LastFrameEnd(-1.0), m_FrameTotalMs(0.0), m_FrameSamples(0)
+{
+}
+
+void Headless::ParseArguments(int argc, char** argv, unsigned int& width, unsigned int& height)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		std::string value = (i + 1 < argc) ? argv[i + 1] : "";
+		if (arg == "--headless")
+		{
+			m_Enabled = true;
+			continue;
+		}
+
+		if (arg == "--width")
+			width = std::max(1, std::atoi(value.c_str()));
+		else if (arg == "--height")
+			height = std::max(1, std::atoi(value.c_str()));
+		else if (arg == "--frames")
+			m_Frames = std::max(1, std::atoi(value.c_str()));
+		else if (arg == "--capture-every")
+			m_CaptureEvery = std::max(0, std::atoi(value.c_str()));
+		else if (arg == "--output")
+			m_OutputPrefix = value;
+		else if (arg == "--context")
+			m_ContextAPI = (value == "egl") ? GLFW_EGL_CONTEXT_API : (value == "osmesa") ? GLFW_OSMESA_CONTEXT_API : GLFW_NATIVE_CONTEXT_API;
+		else
+			continue;
+		++i;
+	}
+
+	m_Width = width;
+	m_Height = height;
+	if (m_Enabled)
+		std::cout << "Headless: " << m_Frames << " frames at " << m_Width << "x" << m_Height << std::endl;
+}
+
+void Headless::ApplyWindowHints() const
+{
+	if (!m_Enabled)
+		return;
+
+	// single sampled so the back buffer can be read straight back
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_SAMPLES, 0);
+	glfwWindowHint(GLFW_CONTEXT_CREATION_API, m_ContextAPI);
+}
+
+bool Headless::IsEnabled() const
+{
+	return m_Enabled;
+}
+
+float Headless::GetTime() const
+{
+	return m_Enabled ? m_Frame * FRAME_TIME : (float)glfwGetTime();
+}
+
+void Headless::UpdateCamera(Camera& camera)
+{
+	if (!m_Enabled)
+		return;
+
+	if (!m_CameraStored)
+	{
+		m_CameraPosition = camera.Position;
+		m_CameraYaw = camera.Yaw;
+		m_CameraPitch = camera.Pitch;
+		m_CameraStored = true;
+	}
+
+	// one slow sway across the scene over the whole run, looking back towards the middle
+	float angle = 2.0f * 3.14159265359f * m_Frame / m_Frames;
+	glm::vec3 right = glm::normalize(glm::cross(glm::vec3(std::cos(glm::radians(m_CameraYaw)), 0.0f, std::sin(glm::radians(m_CameraYaw))), glm::vec3(0.0f, 1.0f, 0.0f)));
+	camera.Position = m_CameraPosition + right * std::sin(angle) * 1.5f + glm::vec3(0.0f, 0.5f, 0.0f) * std::sin(2.0f * angle);
+	camera.Yaw = m_CameraYaw - std::sin(angle) * 10.0f;
+	camera.Pitch = m_CameraPitch - std::sin(2.0f * angle) * 5.0f;
+	camera.ProcessMouseMovement(0.0f, 0.0f); // rebuilds the camera vectors from yaw and pitch
+}
+
+void Headless::BeginPass(const std::string& name)
+{
+	if (!m_Enabled)
+		return;
+
+	unsigned int index = 0;
+	while (index < m_Passes.size() && m_Passes[index].name != name)
+		++index;
+	if (index == m_Passes.size())
+	{
+		Pass pass;
+		pass.name = name;
+		glGenQueries(2, pass.queries);
+		pass.active = false;
+		pass.totalMs = 0.0;
+		pass.minMs = 1e9;
+		pass.maxMs = 0.0;
+		pass.samples = 0;
+		m_Passes.push_back(pass);
+	}
+
+	// timestamps rather than GL_TIME_ELAPSED so they can nest and run alongside a demo's own timer queries
+	glQueryCounter(m_Passes[index].queries[0], GL_TIMESTAMP);
+	m_Passes[index].active = true;
+	m_OpenPasses.push_back(index);
+}
+
+void Headless::EndPass()
+{
+	if (!m_Enabled || m_OpenPasses.empty())
+		return;
+
+	glQueryCounter(m_Passes[m_OpenPasses.back()].queries[1], GL_TIMESTAMP);
+	m_OpenPasses.pop_back();
+}
+
+void Headless::EndFrame(GLFWwindow* window)
+{
+	if (!m_Enabled)
+		return;
+
+	// waits for the GPU, which is fine here; frame rate isn't what is measured headless
+	for (Pass& pass : m_Passes)
+	{
+		if (!pass.active)
+			continue;
+
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(pass.queries[0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(pass.queries[1], GL_QUERY_RESULT, &end);
+		double ms = (end - begin) / 1000000.0;
+		pass.totalMs += ms;
+		pass.minMs = std::min(pass.minMs, ms);
+		pass.maxMs = std::max(pass.maxMs, ms);
+		++pass.samples;
+		pass.active = false;
+	}
+
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	bool last = (m_Frame + 1 == m_Frames);
+	if (last || (m_CaptureEvery > 0 && m_Frame % m_CaptureEvery == 0))
+	{
+		std::vector<unsigned char> pixels(width * height * 3);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glReadBuffer(GL_BACK);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+		std::stringstream path;
+		path << m_OutputPrefix << "_" << std::setw(4) << std::setfill('0') << m_Frame << ".png";
+		if (!WritePNG(path.str(), width, height, pixels))
+			std::cout << "Failed to write " << path.str() << "!" << std::endl;
+	}
+
+	// frame to frame, the first frame also pays for startup so it isn't counted
+	double now = glfwGetTime();
+	if (m_LastFrameEnd >= 0.0)
+	{
+		m_FrameTotalMs += (now - m_LastFrameEnd) * 1000.0;
+		++m_FrameSamples;
+	}
+	m_LastFrameEnd = now;
+
+	if (++m_Frame == m_Frames)
+	{
+		PrintReport();
+		glfwSetWindowShouldClose(window, true);
+	}
+}
+
+void Headless::PrintReport() const
+{
+	std::cout << "Pass\t\tAverage (ms)\tMin (ms)\tMax (ms)" << std::endl;
+	for (const Pass& pass : m_Passes)
+	{
+		if (pass.samples == 0)
+			continue;
+		std::cout << std::left << std::setw(16) << pass.name << pass.totalMs / pass.samples << "\t\t" << pass.minMs << "\t\t" << pass.maxMs << std::endl;
+	}
+	if (m_FrameSamples > 0)
+		std::cout << std::left << std::setw(16) << "Frame (CPU)" << m_FrameTotalMs / m_FrameSamples << std::endl;
+}
+
+// Uncompressed PNG: zlib stored blocks, so no deflate implementation is needed
+static unsigned int Crc32(const unsigned char* data, size_t size, unsigned int crc = 0)
+{
+	static unsigned int table[256];
+	static bool tableBuilt = false;
+	if (!tableBuilt)
+	{
+		for (unsigned int i = 0; i < 256; ++i)
+		{
+			unsigned int c = i;
+			for (int k = 0; k < 8; ++k)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+		tableBuilt = true;
+	}
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void PutBigEndian(std::vector<unsigned char>& out, unsigned int value)
+{
+	out.push_back((value >> 24) & 0xFF);
+	out.push_back((value >> 16) & 0xFF);
+	out.push_back((value >> 8) & 0xFF);
+	out.push_back(value & 0xFF);
+}
+
+static void WriteChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data)
+{
+	std::vector<unsigned char> chunk;
+	PutBigEndian(chunk, (unsigned int)data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	PutBigEndian(chunk, Crc32(&chunk[4], chunk.size() - 4));
+	file.write((const char*)&chunk[0], chunk.size());
+}
+
+bool Headless::WritePNG(const std::string& path, unsigned int width, unsigned int height, const std::vector<unsigned char>& rgb) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write((const char*)signature, sizeof(signature));
+
+	std::vector<unsigned char> header;
+	PutBigEndian(header, width);
+	PutBigEndian(header, height);
+	header.push_back(8); // bits per channel
+	header.push_back(2); // RGB
+	header.push_back(0); // deflate
+	header.push_back(0); // adaptive filtering
+	header.push_back(0); // no interlace
+	WriteChunk(file, "IHDR", header);
+
+	// scanlines top to bottom, GL rows come bottom up; each starts with filter type 0
+	std::vector<unsigned char> raw;
+	raw.reserve((width * 3 + 1) * height);
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		const unsigned char* row = &rgb[(height - 1 - y) * width * 3];
+		raw.push_back(0);
+		raw.insert(raw.end(), row, row + width * 3);
+	}
+
+	std::vector<unsigned char> zlib;
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+	const size_t MAX_BLOCK = 65535;
+	for (size_t offset = 0; offset < raw.size(); offset += MAX_BLOCK)
+	{
+		size_t size = std::min(MAX_BLOCK, raw.size() - offset);
+		zlib.push_back(offset + size == raw.size() ? 1 : 0);
+		zlib.push_back(size & 0xFF);
+		zlib.push_back((size >> 8) & 0xFF);
+		zlib.push_back(~size & 0xFF);
+		zlib.push_back((~size >> 8) & 0xFF);
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+	}
+
+	unsigned int a = 1, b = 0;
+	for (unsigned char byte : raw)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	PutBigEndian(zlib, (b << 16) | a);
+	WriteChunk(file, "IDAT", zlib);
+	WriteChunk(file, "IEND", std::vector<unsigned char>());
+
+	return (bool)file;
+}
@@ -0,0 +1,815 @@
+#include "IBLBaker.h"
+#include "stb_image.h"
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <emmintrin.h>
+
+static const float PI = 3.14159265359f;
+static const float BRDF_PI = 3.14156265359f; // BRDF.shader uses this value, kept for matching output
+
+uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t rawExponent = (bits >> 23) & 0xff;
+	uint32_t mantissa = bits & 0x7fffff;
+	int exponent = (int)rawExponent - 127 + 15;
+
+	if (rawExponent == 0xff)
+		return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	if (exponent >= 31)
+		return (uint16_t)(sign | 0x7c00);
+	if (exponent <= 0)
+	{
+		// denormal half, round to nearest even
+		if (exponent < -10)
+			return (uint16_t)sign;
+		mantissa |= 0x800000;
+		uint32_t shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1)))
+			++half;
+		return (uint16_t)(sign | half);
+	}
+
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1fff;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		++half;
+	return (uint16_t)(sign | half);
+}
+
+float HalfToFloat(uint16_t value)
+{
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+
+	uint32_t bits;
+	if (exponent == 0)
+	{
+		float denormal = mantissa / 16777216.0f;
+		return sign ? -denormal : denormal;
+	}
+	else if (exponent == 31)
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	else
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Projects four directions onto the cube, returning face index and [0, 1] face coordinates
+static inline void ProjectToFace4(__m128 x, __m128 y, __m128 z, int face[4], float s[4], float t[4])
+{
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	__m128 ax = _mm_andnot_ps(signMask, x);
+	__m128 ay = _mm_andnot_ps(signMask, y);
+	__m128 az = _mm_andnot_ps(signMask, z);
+
+	__m128 xMajor = _mm_and_ps(_mm_cmpge_ps(ax, ay), _mm_cmpge_ps(ax, az));
+	__m128 yMajor = _mm_andnot_ps(xMajor, _mm_cmpge_ps(ay, az));
+	__m128 zMajor = _mm_andnot_ps(_mm_or_ps(xMajor, yMajor), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+	__m128 negY = _mm_xor_ps(y, signMask);
+	__m128 negZ = _mm_xor_ps(z, signMask);
+
+	// sc: +X -z, -X +z, +-Y x, +Z x, -Z -x    tc: +-X -y, +Y z, -Y -z, +-Z -y
+	__m128 scX = _mm_xor_ps(negZ, _mm_and_ps(x, signMask));
+	__m128 scZ = _mm_xor_ps(x, _mm_and_ps(z, signMask));
+	__m128 tcY = _mm_xor_ps(z, _mm_and_ps(y, signMask));
+
+	__m128 ma = Select(xMajor, ax, Select(yMajor, ay, az));
+	__m128 sc = Select(xMajor, scX, Select(yMajor, x, scZ));
+	__m128 tc = Select(yMajor, tcY, negY);
+
+	__m128 invMa = _mm_div_ps(half, ma);
+	_mm_storeu_ps(s, _mm_add_ps(_mm_mul_ps(sc, invMa), half));
+	_mm_storeu_ps(t, _mm_add_ps(_mm_mul_ps(tc, invMa), half));
+
+	int xm = _mm_movemask_ps(xMajor), ym = _mm_movemask_ps(yMajor);
+	int positive = _mm_movemask_ps(_mm_cmpgt_ps(Select(xMajor, x, Select(yMajor, y, z)), _mm_setzero_ps()));
+	(void)zMajor;
+	for (int i = 0; i < 4; ++i)
+	{
+		int axis = (xm >> i) & 1 ? 0 : ((ym >> i) & 1 ? 1 : 2);
+		face[i] = axis * 2 + (((positive >> i) & 1) ? 0 : 1);
+	}
+}
+
+static inline void SampleFace(const CubeMapLevel& level, int face, float s, float t, float* rgb)
+{
+	int size = (int)level.size;
+	float fx = s * size - 0.5f;
+	float fy = t * size - 0.5f;
+	int x0 = (int)std::floor(fx);
+	int y0 = (int)std::floor(fy);
+	float ax = fx - x0;
+	float ay = fy - y0;
+
+	int x1 = std::min(std::max(x0 + 1, 0), size - 1);
+	int y1 = std::min(std::max(y0 + 1, 0), size - 1);
+	x0 = std::min(std::max(x0, 0), size - 1);
+	y0 = std::min(std::max(y0, 0), size - 1);
+
+	const float* base = &level.data[(size_t)face * size * size * 3];
+	const float* p00 = base + (y0 * size + x0) * 3;
+	const float* p10 = base + (y0 * size + x1) * 3;
+	const float* p01 = base + (y1 * size + x0) * 3;
+	const float* p11 = base + (y1 * size + x1) * 3;
+	for (int c = 0; c < 3; ++c)
+	{
+		float top = p00[c] + (p10[c] - p00[c]) * ax;
+		float bottom = p01[c] + (p11[c] - p01[c]) * ax;
+		rgb[c] = top + (bottom - top) * ay;
+	}
+}
+
+static inline void SampleLod(const CubeMap& cubemap, int face, float s, float t, float lod, float* rgb)
+{
+	float maxLevel = (float)(cubemap.levels.size() - 1);
+	lod = std::min(std::max(lod, 0.0f), maxLevel);
+	int level0 = (int)lod;
+	float blend = lod - level0;
+
+	SampleFace(cubemap.levels[level0], face, s, t, rgb);
+	if (blend > 0.0f)
+	{
+		float upper[3];
+		SampleFace(cubemap.levels[level0 + 1], face, s, t, upper);
+		for (int c = 0; c < 3; ++c)
+			rgb[c] += (upper[c] - rgb[c]) * blend;
+	}
+}
+
+static inline float RadicalInverse_VdC(uint32_t bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return float(bits) * 2.3283064365386963e-10f;
+}
+
+// ImportanceSampleGGX from the shaders, returns the world-space halfway vector around N
+static inline void ImportanceSampleGGX(float xi0, float xi1, const float* N, float roughness, float pi, float* H)
+{
+	float a = roughness * roughness;
+	float phi = 2.0f * pi * xi0;
+	float cosTheta = std::sqrt((1.0f - xi1) / (1.0f + (a * a - 1.0f) * xi1));
+	float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+	float hx = std::cos(phi) * sinTheta;
+	float hy = std::sin(phi) * sinTheta;
+	float hz = cosTheta;
+
+	float up[3] = { 0.0f, 0.0f, 1.0f };
+	if (std::fabs(N[2]) >= 0.999f)
+	{
+		up[0] = 1.0f;
+		up[2] = 0.0f;
+	}
+	float tangent[3] = { up[1] * N[2] - up[2] * N[1], up[2] * N[0] - up[0] * N[2], up[0] * N[1] - up[1] * N[0] };
+	float length = std::sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+	for (int c = 0; c < 3; ++c)
+		tangent[c] /= length;
+	float bitangent[3] = { N[1] * tangent[2] - N[2] * tangent[1], N[2] * tangent[0] - N[0] * tangent[2], N[0] * tangent[1] - N[1] * tangent[0] };
+
+	for (int c = 0; c < 3; ++c)
+		H[c] = tangent[c] * hx + bitangent[c] * hy + N[c] * hz;
+	length = std::sqrt(H[0] * H[0] + H[1] * H[1] + H[2] * H[2]);
+	for (int c = 0; c < 3; ++c)
+		H[c] /= length;
+}
+
+IBLBaker::IBLBaker(ThreadPool& pool) : m_Pool(pool)
+{
+}
+
+bool IBLBaker::LoadEquirectangular(const std::string& hdrPath, EquirectangularMap& map)
+{
+	// same orientation as the GPU path, which uploads the flipped image
+	stbi_set_flip_vertically_on_load(true);
+	int nrComponents;
+	float* data = stbi_loadf(hdrPath.c_str(), &map.width, &map.height, &nrComponents, 3);
+	stbi_set_flip_vertically_on_load(false);
+	if (!data)
+	{
+		std::cout << "Failed to load HDR image: " << hdrPath << std::endl;
+		return false;
+	}
+
+	map.data.assign(data, data + (size_t)map.width * map.height * 3);
+	stbi_image_free(data);
+	return true;
+}
+
+EquirectangularMap IBLBaker::CreateTestEnvironment(int width, int height)
+{
+	// sky gradient with a small bright sun so every product has some high frequency content
+	EquirectangularMap map;
+	map.width = width;
+	map.height = height;
+	map.data.resize((size_t)width * height * 3);
+	for (int y = 0; y < height; ++y)
+	{
+		float v = (y + 0.5f) / height;
+		for (int x = 0; x < width; ++x)
+		{
+			float u = (x + 0.5f) / width;
+			float* texel = &map.data[((size_t)y * width + x) * 3];
+			float sun = std::exp(-((u - 0.3f) * (u - 0.3f) + (v - 0.8f) * (v - 0.8f)) * 4000.0f) * 50.0f;
+			texel[0] = 0.2f + 0.8f * v + sun;
+			texel[1] = 0.3f + 0.6f * v + sun;
+			texel[2] = 0.5f + 0.5f * v + sun * 0.8f;
+		}
+	}
+	return map;
+}
+
+CubeMap IBLBaker::BakeEnvironment(const EquirectangularMap& map, unsigned int size)
+{
+	CubeMap cubemap;
+	cubemap.levels.resize(1);
+	cubemap.levels[0].size = size;
+	cubemap.levels[0].data.resize((size_t)6 * size * size * 3);
+
+	// Cubemap.shader: uv = vec2(atan(v.z, v.x), asin(v.y)) * invAtan + 0.5
+	m_Pool.ParallelFor(6 * size, [&](unsigned int task)
+	{
+		unsigned int face = task / size;
+		unsigned int y = task % size;
+		float* row = &cubemap.levels[0].data[(((size_t)face * size + y) * size) * 3];
+		for (unsigned int x = 0; x < size; ++x)
+		{
+			float dx, dy, dz;
+			CubeFaceDirection(face, (x + 0.5f) / size * 2.0f - 1.0f, (y + 0.5f) / size * 2.0f - 1.0f, dx, dy, dz);
+			float u = std::atan2(dz, dx) * 0.1591f + 0.5f;
+			float v = std::asin(dy) * 0.3183f + 0.5f;
+
+			// bilinear, clamped horizontally and repeating vertically like the hdrTexture wrap modes
+			float fx = u * map.width - 0.5f;
+			float fy = v * map.height - 0.5f;
+			int x0 = (int)std::floor(fx);
+			int y0 = (int)std::floor(fy);
+			float ax = fx - x0;
+			float ay = fy - y0;
+			int x1 = std::min(std::max(x0 + 1, 0), map.width - 1);
+			x0 = std::min(std::max(x0, 0), map.width - 1);
+			int y1 = ((y0 + 1) % map.height + map.height) % map.height;
+			y0 = (y0 % map.height + map.height) % map.height;
+
+			const float* p00 = &map.data[((size_t)y0 * map.width + x0) * 3];
+			const float* p10 = &map.data[((size_t)y0 * map.width + x1) * 3];
+			const float* p01 = &map.data[((size_t)y1 * map.width + x0) * 3];
+			const float* p11 = &map.data[((size_t)y1 * map.width + x1) * 3];
+			for (int c = 0; c < 3; ++c)
+			{
+				float top = p00[c] + (p10[c] - p00[c]) * ax;
+				float bottom = p01[c] + (p11[c] - p01[c]) * ax;
+				row[x * 3 + c] = top + (bottom - top) * ay;
+			}
+		}
+	});
+
+	GenerateMipmaps(cubemap);
+	return cubemap;
+}
+
+void IBLBaker::GenerateMipmaps(CubeMap& cubemap, unsigned int firstLevel)
+{
+	unsigned int levelCount = 1;
+	while ((cubemap.levels[0].size >> levelCount) > 0)
+		++levelCount;
+	cubemap.levels.resize(levelCount);
+
+	for (unsigned int level = firstLevel; level < levelCount; ++level)
+	{
+		const CubeMapLevel& source = cubemap.levels[level - 1];
+		CubeMapLevel& target = cubemap.levels[level];
+		target.size = std::max(source.size / 2, 1u);
+		target.data.resize((size_t)6 * target.size * target.size * 3);
+
+		for (unsigned int face = 0; face < 6; ++face)
+		{
+			const float* src = &source.data[(size_t)face * source.size * source.size * 3];
+			float* dst = &target.data[(size_t)face * target.size * target.size * 3];
+			for (unsigned int y = 0; y < target.size; ++y)
+			{
+				for (unsigned int x = 0; x < target.size; ++x)
+				{
+					unsigned int sx = std::min(x * 2 + 1, source.size - 1);
+					unsigned int sy = std::min(y * 2 + 1, source.size - 1);
+					for (int c = 0; c < 3; ++c)
+					{
+						dst[(y * target.size + x) * 3 + c] = 0.25f * (
+							src[((y * 2) * source.size + x * 2) * 3 + c] + src[((y * 2) * source.size + sx) * 3 + c] +
+							src[(sy * source.size + x * 2) * 3 + c] + src[(sy * source.size + sx) * 3 + c]);
+					}
+				}
+			}
+		}
+	}
+}
+
+CubeMap IBLBaker::BakeIrradiance(const CubeMap& environment, unsigned int size)
+{
+	// The GPU pass samples with implicit derivatives, which at this resolution select
+	// roughly the mip whose texel footprint matches one irradiance texel
+	unsigned int lod = 0;
+	while ((environment.levels[0].size >> (lod + 1)) >= size && lod + 1 < environment.levels.size())
+		++lod;
+	const CubeMapLevel& source = environment.levels[lod];
+
+	// the phi/theta grid of Irradiance.shader, identical for every texel
+	std::vector<float> tx, ty, tz, weight;
+	const float sampleDelta = 0.025f;
+	for (float phi = 0.0f; phi < 2.0f * PI; phi += sampleDelta)
+	{
+		for (float theta = 0.0f; theta < 0.5f * PI; theta += sampleDelta)
+		{
+			tx.push_back(std::sin(theta) * std::cos(phi));
+			ty.push_back(std::sin(theta) * std::sin(phi));
+			tz.push_back(std::cos(theta));
+			weight.push_back(std::cos(theta) * std::sin(theta));
+		}
+	}
+	const float nrSamples = (float)tx.size();
+	while (tx.size() % 4 != 0)
+	{
+		tx.push_back(0.0f);
+		ty.push_back(0.0f);
+		tz.push_back(1.0f);
+		weight.push_back(0.0f);
+	}
+
+	CubeMap irradiance;
+	irradiance.levels.resize(1);
+	irradiance.levels[0].size = size;
+	irradiance.levels[0].data.resize((size_t)6 * size * size * 3);
+
+	m_Pool.ParallelFor(6 * size, [&](unsigned int task)
+	{
+		unsigned int face = task / size;
+		unsigned int y = task % size;
+		float* row = &irradiance.levels[0].data[(((size_t)face * size + y) * size) * 3];
+		for (unsigned int x = 0; x < size; ++x)
+		{
+			float nx, ny, nz;
+			CubeFaceDirection(face, (x + 0.5f) / size * 2.0f - 1.0f, (y + 0.5f) / size * 2.0f - 1.0f, nx, ny, nz);
+
+			// right = cross(up, normal), up = cross(normal, right), unnormalised as in the shader
+			__m128 rx = _mm_set1_ps(nz), rz = _mm_set1_ps(-nx);
+			__m128 ux = _mm_set1_ps(-nx * ny), uy = _mm_set1_ps(nz * nz + nx * nx), uz = _mm_set1_ps(-ny * nz);
+			__m128 vnx = _mm_set1_ps(nx), vny = _mm_set1_ps(ny), vnz = _mm_set1_ps(nz);
+
+			__m128 sumR = _mm_setzero_ps(), sumG = _mm_setzero_ps(), sumB = _mm_setzero_ps();
+			for (size_t i = 0; i < tx.size(); i += 4)
+			{
+				__m128 sx = _mm_loadu_ps(&tx[i]);
+				__m128 sy = _mm_loadu_ps(&ty[i]);
+				__m128 sz = _mm_loadu_ps(&tz[i]);
+				__m128 dx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, rx), _mm_mul_ps(sy, ux)), _mm_mul_ps(sz, vnx));
+				__m128 dy = _mm_add_ps(_mm_mul_ps(sy, uy), _mm_mul_ps(sz, vny));
+				__m128 dz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, rz), _mm_mul_ps(sy, uz)), _mm_mul_ps(sz, vnz));
+
+				int faces[4];
+				float s[4], t[4];
+				ProjectToFace4(dx, dy, dz, faces, s, t);
+
+				float r[4], g[4], b[4];
+				for (int j = 0; j < 4; ++j)
+				{
+					float rgb[3];
+					SampleFace(source, faces[j], s[j], t[j], rgb);
+					r[j] = rgb[0];
+					g[j] = rgb[1];
+					b[j] = rgb[2];
+				}
+
+				__m128 w = _mm_loadu_ps(&weight[i]);
+				sumR = _mm_add_ps(sumR, _mm_mul_ps(_mm_loadu_ps(r), w));
+				sumG = _mm_add_ps(sumG, _mm_mul_ps(_mm_loadu_ps(g), w));
+				sumB = _mm_add_ps(sumB, _mm_mul_ps(_mm_loadu_ps(b), w));
+			}
+
+			float r[4], g[4], b[4];
+			_mm_storeu_ps(r, sumR);
+			_mm_storeu_ps(g, sumG);
+			_mm_storeu_ps(b, sumB);
+			row[x * 3 + 0] = PI * (r[0] + r[1] + r[2] + r[3]) / nrSamples;
+			row[x * 3 + 1] = PI * (g[0] + g[1] + g[2] + g[3]) / nrSamples;
+			row[x * 3 + 2] = PI * (b[0] + b[1] + b[2] + b[3]) / nrSamples;
+		}
+	});
+
+	return irradiance;
+}
+
+CubeMap IBLBaker::BakePrefilter(const CubeMap& environment, unsigned int size, unsigned int mipLevels)
+{
+	const unsigned int SAMPLE_COUNT = 1024;
+	const float resolution = (float)environment.levels[0].size;
+	const float saTexel = 4.0f * PI / (6.0f * resolution * resolution);
+
+	// Per mip sample table in tangent space. With V == R == N the light direction, its
+	// weight and the source mip only depend on the Hammersley index and roughness.
+	struct SampleTable
+	{
+		std::vector<float> lx, ly, lz, weight, lod;
+	};
+	std::vector<SampleTable> tables(mipLevels);
+	const float tangentN[3] = { 0.0f, 0.0f, 1.0f };
+	for (unsigned int mip = 0; mip < mipLevels; ++mip)
+	{
+		float roughness = (float)mip / (float)(mipLevels - 1);
+		SampleTable& table = tables[mip];
+		for (unsigned int i = 0; i < SAMPLE_COUNT; ++i)
+		{
+			float H[3];
+			ImportanceSampleGGX((float)i / (float)SAMPLE_COUNT, RadicalInverse_VdC(i), tangentN, roughness, PI, H);
+
+			// tangent frame of N == (0, 0, 1) swaps the axes, undo it to get (tangent, bitangent, normal) weights
+			float hx = -H[1], hy = H[0], hz = H[2];
+			float lx = 2.0f * hz * hx, ly = 2.0f * hz * hy, lz = 2.0f * hz * hz - 1.0f;
+			if (lz <= 0.0f)
+				continue;
+
+			float a = roughness * roughness;
+			float a2 = a * a;
+			float denom = hz * hz * (a2 - 1.0f) + 1.0f;
+			float D = a2 / (PI * denom * denom);
+			float pdf = D * hz / (4.0f * hz) + 0.0001f;
+			float saSample = 1.0f / ((float)SAMPLE_COUNT * pdf + 0.0001f);
+
+			table.lx.push_back(lx);
+			table.ly.push_back(ly);
+			table.lz.push_back(lz);
+			table.weight.push_back(lz);
+			table.lod.push_back(roughness == 0.0f ? 0.0f : 0.5f * std::log2(saSample / saTexel));
+		}
+		while (table.lx.size() % 4 != 0)
+		{
+			table.lx.push_back(0.0f);
+			table.ly.push_back(0.0f);
+			table.lz.push_back(1.0f);
+			table.weight.push_back(0.0f);
+			table.lod.push_back(0.0f);
+		}
+	}
+
+	CubeMap prefilter;
+	prefilter.levels.resize(mipLevels);
+	for (unsigned int mip = 0; mip < mipLevels; ++mip)
+	{
+		prefilter.levels[mip].size = std::max(size >> mip, 1u);
+		prefilter.levels[mip].data.resize((size_t)6 * prefilter.levels[mip].size * prefilter.levels[mip].size * 3);
+	}
+
+	// one task per (mip, face, row) so the small mips fill in around the large ones
+	std::vector<unsigned int> taskMip, taskRow;
+	for (unsigned int mip = 0; mip < mipLevels; ++mip)
+	{
+		for (unsigned int row = 0; row < 6 * prefilter.levels[mip].size; ++row)
+		{
+			taskMip.push_back(mip);
+			taskRow.push_back(row);
+		}
+	}
+
+	m_Pool.ParallelFor((unsigned int)taskMip.size(), [&](unsigned int task)
+	{
+		unsigned int mip = taskMip[task];
+		CubeMapLevel& level = prefilter.levels[mip];
+		unsigned int face = taskRow[task] / level.size;
+		unsigned int y = taskRow[task] % level.size;
+		const SampleTable& table = tables[mip];
+		float* row = &level.data[(((size_t)face * level.size + y) * level.size) * 3];
+
+		for (unsigned int x = 0; x < level.size; ++x)
+		{
+			float N[3];
+			CubeFaceDirection(face, (x + 0.5f) / level.size * 2.0f - 1.0f, (y + 0.5f) / level.size * 2.0f - 1.0f, N[0], N[1], N[2]);
+
+			float up[3] = { 0.0f, 0.0f, 1.0f };
+			if (std::fabs(N[2]) >= 0.999f)
+			{
+				up[0] = 1.0f;
+				up[2] = 0.0f;
+			}
+			float T[3] = { up[1] * N[2] - up[2] * N[1], up[2] * N[0] - up[0] * N[2], up[0] * N[1] - up[1] * N[0] };
+			float length = std::sqrt(T[0] * T[0] + T[1] * T[1] + T[2] * T[2]);
+			for (int c = 0; c < 3; ++c)
+				T[c] /= length;
+			float B[3] = { N[1] * T[2] - N[2] * T[1], N[2] * T[0] - N[0] * T[2], N[0] * T[1] - N[1] * T[0] };
+
+			__m128 tX = _mm_set1_ps(T[0]), tY = _mm_set1_ps(T[1]), tZ = _mm_set1_ps(T[2]);
+			__m128 bX = _mm_set1_ps(B[0]), bY = _mm_set1_ps(B[1]), bZ = _mm_set1_ps(B[2]);
+			__m128 nX = _mm_set1_ps(N[0]), nY = _mm_set1_ps(N[1]), nZ = _mm_set1_ps(N[2]);
+
+			float color[3] = { 0.0f, 0.0f, 0.0f };
+			float totalWeight = 0.0f;
+			for (size_t i = 0; i < table.lx.size(); i += 4)
+			{
+				__m128 lx = _mm_loadu_ps(&table.lx[i]);
+				__m128 ly = _mm_loadu_ps(&table.ly[i]);
+				__m128 lz = _mm_loadu_ps(&table.lz[i]);
+				__m128 dx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tX, lx), _mm_mul_ps(bX, ly)), _mm_mul_ps(nX, lz));
+				__m128 dy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tY, lx), _mm_mul_ps(bY, ly)), _mm_mul_ps(nY, lz));
+				__m128 dz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tZ, lx), _mm_mul_ps(bZ, ly)), _mm_mul_ps(nZ, lz));
+
+				int faces[4];
+				float s[4], t[4];
+				ProjectToFace4(dx, dy, dz, faces, s, t);
+
+				for (int j = 0; j < 4; ++j)
+				{
+					float w = table.weight[i + j];
+					if (w <= 0.0f)
+						continue;
+					float rgb[3];
+					SampleLod(environment, faces[j], s[j], t[j], table.lod[i + j], rgb);
+					color[0] += rgb[0] * w;
+					color[1] += rgb[1] * w;
+					color[2] += rgb[2] * w;
+					totalWeight += w;
+				}
+			}
+
+			for (int c = 0; c < 3; ++c)
+				row[x * 3 + c] = color[c] / totalWeight;
+		}
+	});
+
+	// the texture keeps a full chain, levels past the prefiltered ones are never sampled
+	GenerateMipmaps(prefilter, mipLevels);
+	return prefilter;
+}
+
+std::vector<float> IBLBaker::BakeBRDF(unsigned int size)
+{
+	const unsigned int SAMPLE_COUNT = 1024;
+	std::vector<float> lut((size_t)size * size * 2);
+
+	m_Pool.ParallelFor(size, [&](unsigned int y)
+	{
+		float roughness = (y + 0.5f) / size;
+		float k = (roughness * roughness) / 2.0f;
+		__m128 vk = _mm_set1_ps(k);
+		__m128 oneMinusK = _mm_set1_ps(1.0f - k);
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 zero = _mm_setzero_ps();
+
+		// halfway vectors only depend on the row
+		const float N[3] = { 0.0f, 0.0f, 1.0f };
+		std::vector<float> hx(SAMPLE_COUNT), hy(SAMPLE_COUNT), hz(SAMPLE_COUNT);
+		for (unsigned int i = 0; i < SAMPLE_COUNT; ++i)
+		{
+			float H[3];
+			ImportanceSampleGGX((float)i / (float)SAMPLE_COUNT, RadicalInverse_VdC(i), N, roughness, BRDF_PI, H);
+			hx[i] = H[0];
+			hy[i] = H[1];
+			hz[i] = H[2];
+		}
+
+		for (unsigned int x = 0; x < size; x += 4)
+		{
+			float ndotv[4], vxs[4];
+			for (int j = 0; j < 4; ++j)
+			{
+				ndotv[j] = (std::min(x + j, size - 1) + 0.5f) / size;
+				vxs[j] = std::sqrt(1.0f - ndotv[j] * ndotv[j]);
+			}
+			__m128 NdotV = _mm_loadu_ps(ndotv);
+			__m128 Vx = _mm_loadu_ps(vxs);
+			__m128 Vz = NdotV;
+			__m128 G1V = _mm_div_ps(NdotV, _mm_add_ps(_mm_mul_ps(NdotV, oneMinusK), vk));
+
+			__m128 A = zero, B = zero;
+			for (unsigned int i = 0; i < SAMPLE_COUNT; ++i)
+			{
+				__m128 Hx = _mm_set1_ps(hx[i]), Hy = _mm_set1_ps(hy[i]), Hz = _mm_set1_ps(hz[i]);
+				__m128 VdotHraw = _mm_add_ps(_mm_mul_ps(Vx, Hx), _mm_mul_ps(Vz, Hz));
+
+				// L = normalize(2 * dot(V, H) * H - V)
+				__m128 twoVdotH = _mm_add_ps(VdotHraw, VdotHraw);
+				__m128 Lx = _mm_sub_ps(_mm_mul_ps(twoVdotH, Hx), Vx);
+				__m128 Ly = _mm_mul_ps(twoVdotH, Hy);
+				__m128 Lz = _mm_sub_ps(_mm_mul_ps(twoVdotH, Hz), Vz);
+				__m128 lengthL = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Lx, Lx), _mm_mul_ps(Ly, Ly)), _mm_mul_ps(Lz, Lz)));
+				__m128 NdotL = _mm_max_ps(_mm_div_ps(Lz, lengthL), zero);
+				__m128 NdotH = _mm_max_ps(Hz, zero);
+				__m128 VdotH = _mm_max_ps(VdotHraw, zero);
+
+				__m128 valid = _mm_cmpgt_ps(NdotL, zero);
+				if (_mm_movemask_ps(valid) == 0)
+					continue;
+
+				__m128 G1L = _mm_div_ps(NdotL, _mm_add_ps(_mm_mul_ps(NdotL, oneMinusK), vk));
+				__m128 G = _mm_mul_ps(G1L, G1V);
+				__m128 G_Vis = _mm_div_ps(_mm_mul_ps(G, VdotH), _mm_mul_ps(NdotH, NdotV));
+				__m128 f = _mm_sub_ps(one, VdotH);
+				__m128 f2 = _mm_mul_ps(f, f);
+				__m128 Fc = _mm_mul_ps(_mm_mul_ps(f2, f2), f);
+
+				A = _mm_add_ps(A, _mm_and_ps(valid, _mm_mul_ps(_mm_sub_ps(one, Fc), G_Vis)));
+				B = _mm_add_ps(B, _mm_and_ps(valid, _mm_mul_ps(Fc, G_Vis)));
+			}
+
+			float a[4], b[4];
+			_mm_storeu_ps(a, _mm_div_ps(A, _mm_set1_ps((float)SAMPLE_COUNT)));
+			_mm_storeu_ps(b, _mm_div_ps(B, _mm_set1_ps((float)SAMPLE_COUNT)));
+			for (unsigned int j = 0; j < 4 && x + j < size; ++j)
+			{
+				lut[((size_t)y * size + x + j) * 2 + 0] = a[j];
+				lut[((size_t)y * size + x + j) * 2 + 1] = b[j];
+			}
+		}
+	});
+
+	return lut;
+}
+
+std::vector<IBLCacheTexture> IBLBaker::BakeAll(const EquirectangularMap& map)
+{
+	CubeMap environment = BakeEnvironment(map, ENVIRONMENT_SIZE);
+	CubeMap irradiance = BakeIrradiance(environment, IRRADIANCE_SIZE);
+	CubeMap prefilter = BakePrefilter(environment, PREFILTER_SIZE, PREFILTER_MIP_LEVELS);
+	std::vector<float> brdf = BakeBRDF(BRDF_LUT_SIZE);
+
+	std::vector<IBLCacheTexture> entries;
+	entries.push_back(ToCacheTexture(environment, GL_LINEAR_MIPMAP_LINEAR));
+	entries.push_back(ToCacheTexture(irradiance, GL_LINEAR));
+	entries.push_back(ToCacheTexture(prefilter, GL_LINEAR_MIPMAP_LINEAR));
+	entries.push_back(ToCacheTexture(brdf, BRDF_LUT_SIZE));
+	return entries;
+}
+
+IBLCacheTexture IBLBaker::ToCacheTexture(const CubeMap& cubemap, GLint minFilter)
+{
+	IBLCacheTexture entry;
+	entry.target = GL_TEXTURE_CUBE_MAP;
+	entry.internalFormat = GL_RGB16F;
+	entry.format = GL_RGB;
+	entry.minFilter = minFilter;
+	entry.size = cubemap.levels[0].size;
+	entry.levels = (minFilter == GL_LINEAR || minFilter == GL_NEAREST) ? 1 : (unsigned int)cubemap.levels.size();
+
+	for (unsigned int level = 0; level < entry.levels; ++level)
+		for (float value : cubemap.levels[level].data)
+			entry.data.push_back(FloatToHalf(value));
+	return entry;
+}
+
+IBLCacheTexture IBLBaker::ToCacheTexture(const std::vector<float>& lut, unsigned int size)
+{
+	IBLCacheTexture entry;
+	entry.target = GL_TEXTURE_2D;
+	entry.internalFormat = GL_RG16F;
+	entry.format = GL_RG;
+	entry.minFilter = GL_LINEAR;
+	entry.size = size;
+	entry.levels = 1;
+
+	entry.data.reserve(lut.size());
+	for (float value : lut)
+		entry.data.push_back(FloatToHalf(value));
+	return entry;
+}
+
+static double ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int RunIBLBake(const std::string& hdrPath)
+{
+	ThreadPool pool;
+	IBLBaker baker(pool);
+
+	EquirectangularMap map;
+	if (!baker.LoadEquirectangular(hdrPath, map))
+		return 1;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<IBLCacheTexture> entries = baker.BakeAll(map);
+	std::cout << "Baked IBL on " << pool.GetThreadCount() << " threads in " << ElapsedMs(start) << " ms" << std::endl;
+
+	IBLCache cache = IBLCache::ForEnvironment(hdrPath);
+	return cache.Save(entries) ? 0 : 1;
+}
+
+int RunIBLBakeCompare(const std::string& hdrPath)
+{
+	// compares against a cache previously written by the GPU precompute
+	IBLCache cache = IBLCache::ForEnvironment(hdrPath);
+	std::vector<IBLCacheTexture> reference;
+	if (!cache.Read(reference))
+	{
+		std::cout << "No GPU IBL cache to compare against, run GLFW_PBR once on a GPU first." << std::endl;
+		return 1;
+	}
+
+	ThreadPool pool;
+	IBLBaker baker(pool);
+	EquirectangularMap map;
+	if (!baker.LoadEquirectangular(hdrPath, map))
+		return 1;
+	std::vector<IBLCacheTexture> baked = baker.BakeAll(map);
+
+	const char* names[] = { "Environment", "Irradiance", "Prefilter", "BRDF LUT" };
+	bool passed = true;
+	for (size_t i = 0; i < baked.size(); ++i)
+	{
+		// compare the levels that are actually sampled
+		unsigned int levels = i == 2 ? PREFILTER_MIP_LEVELS : 1;
+		size_t count = 0;
+		for (unsigned int level = 0; level < levels; ++level)
+			count += IBLCache::GetLevelSize(baked[i], level);
+
+		double errorSum = 0.0, referenceSum = 0.0, maxError = 0.0;
+		for (size_t j = 0; j < count; ++j)
+		{
+			double a = HalfToFloat(baked[i].data[j]);
+			double b = HalfToFloat(reference[i].data[j]);
+			errorSum += std::fabs(a - b);
+			referenceSum += std::fabs(b);
+			maxError = std::max(maxError, std::fabs(a - b));
+		}
+		double meanRelative = referenceSum > 0.0 ? errorSum / referenceSum : errorSum;
+		bool ok = meanRelative <= IBL_BAKER_TOLERANCE;
+		passed = passed && ok;
+		std::cout << names[i] << ": mean relative error " << meanRelative << ", max abs error " << maxError << (ok ? " (ok)" : " (FAILED)") << std::endl;
+	}
+	return passed ? 0 : 1;
+}
+
+int RunIBLBakeBenchmark(const std::string& hdrPath)
+{
+	unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	EquirectangularMap map;
+	CubeMap environment;
+	{
+		ThreadPool pool(maxThreads);
+		IBLBaker baker(pool);
+		if (!baker.LoadEquirectangular(hdrPath, map))
+		{
+			std::cout << "Benchmarking with a synthetic environment instead." << std::endl;
+			map = baker.CreateTestEnvironment(2048, 1024);
+		}
+		environment = baker.BakeEnvironment(map, ENVIRONMENT_SIZE);
+	}
+
+	size_t irradianceTexels = (size_t)6 * IRRADIANCE_SIZE * IRRADIANCE_SIZE;
+	size_t prefilterTexels = 0;
+	for (unsigned int mip = 0; mip < PREFILTER_MIP_LEVELS; ++mip)
+		prefilterTexels += (size_t)6 * (PREFILTER_SIZE >> mip) * (PREFILTER_SIZE >> mip);
+	size_t brdfTexels = (size_t)BRDF_LUT_SIZE * BRDF_LUT_SIZE;
+
+	std::cout << "threads, irradiance texels/s, prefilter texels/s, brdf texels/s" << std::endl;
+	for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads))
+	{
+		ThreadPool pool(threads);
+		IBLBaker baker(pool);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		baker.BakeIrradiance(environment, IRRADIANCE_SIZE);
+		double irradianceMs = ElapsedMs(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		baker.BakePrefilter(environment, PREFILTER_SIZE, PREFILTER_MIP_LEVELS);
+		double prefilterMs = ElapsedMs(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		baker.BakeBRDF(BRDF_LUT_SIZE);
+		double brdfMs = ElapsedMs(start);
+
+		std::cout << threads << ", "
+			<< irradianceTexels / (irradianceMs / 1000.0) << ", "
+			<< prefilterTexels / (prefilterMs / 1000.0) << ", "
+			<< brdfTexels / (brdfMs / 1000.0) << std::endl;
+
+		if (threads == maxThreads)
+			break;
+	}
+	return 0;
+}
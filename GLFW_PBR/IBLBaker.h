@@ -0,0 +1,88 @@
+#pragma once
+
+#include "IBLCache.h"
+#include "ThreadPool.h"
+#include <string>
+#include <vector>
+#include <cmath>
+
+// CPU implementation of the IBL precompute in Cubemap.shader, Irradiance.shader,
+// Prefilter.shader and BRDF.shader, for machines without a usable GPU.
+//
+// The sampling patterns are the same as the shaders (the phi/theta grid of the
+// irradiance convolution, Hammersley + ImportanceSampleGGX for the prefilter and
+// BRDF LUT) so the results match the GPU within IBL_BAKER_TOLERANCE mean relative
+// error. The remaining differences come from filtering: cube lookups clamp at face
+// edges instead of using seamless filtering, the irradiance pass samples a fixed
+// mip instead of one derived from screen-space derivatives, and mips are built
+// with a 2x2 box filter.
+const float IBL_BAKER_TOLERANCE = 0.02f;
+
+// RGB float cubemap, faces stored +X, -X, +Y, -Y, +Z, -Z in each level
+struct CubeMapLevel
+{
+	unsigned int size;
+	std::vector<float> data;
+};
+
+struct CubeMap
+{
+	std::vector<CubeMapLevel> levels;
+};
+
+// Direction through the centre of a cube texel, s and t in [-1, 1] (OpenGL face layout)
+inline void CubeFaceDirection(unsigned int face, float s, float t, float& x, float& y, float& z)
+{
+	switch (face)
+	{
+	case 0: x = 1.0f; y = -t; z = -s; break;
+	case 1: x = -1.0f; y = -t; z = s; break;
+	case 2: x = s; y = 1.0f; z = t; break;
+	case 3: x = s; y = -1.0f; z = -t; break;
+	case 4: x = s; y = -t; z = 1.0f; break;
+	default: x = -s; y = -t; z = -1.0f; break;
+	}
+	float length = std::sqrt(x * x + y * y + z * z);
+	x /= length;
+	y /= length;
+	z /= length;
+}
+
+struct EquirectangularMap
+{
+	int width = 0;
+	int height = 0;
+	std::vector<float> data;
+};
+
+class IBLBaker
+{
+private:
+	ThreadPool& m_Pool;
+
+public:
+	IBLBaker(ThreadPool& pool);
+
+	bool LoadEquirectangular(const std::string& hdrPath, EquirectangularMap& map);
+	EquirectangularMap CreateTestEnvironment(int width, int height);
+
+	CubeMap BakeEnvironment(const EquirectangularMap& map, unsigned int size);
+	CubeMap BakeIrradiance(const CubeMap& environment, unsigned int size);
+	CubeMap BakePrefilter(const CubeMap& environment, unsigned int size, unsigned int mipLevels);
+	std::vector<float> BakeBRDF(unsigned int size);
+
+	// Bakes all four products into the cache format used by the GLFW_PBR startup
+	std::vector<IBLCacheTexture> BakeAll(const EquirectangularMap& map);
+
+	static void GenerateMipmaps(CubeMap& cubemap, unsigned int firstLevel = 1);
+	static IBLCacheTexture ToCacheTexture(const CubeMap& cubemap, GLint minFilter);
+	static IBLCacheTexture ToCacheTexture(const std::vector<float>& lut, unsigned int size);
+};
+
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+// Command-line entry points, run from GLFW_PBR without opening a window
+int RunIBLBake(const std::string& hdrPath);
+int RunIBLBakeCompare(const std::string& hdrPath);
+int RunIBLBakeBenchmark(const std::string& hdrPath);
@@ -0,0 +1,300 @@
+#include "IBLCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+
+static const uint32_t IBL_CACHE_MAGIC = 0x43424949; // "IIBC"
+static const uint32_t IBL_CACHE_VERSION = 1;
+// Past GL's usual texture size limit only a corrupt header asks for more
+static const uint32_t IBL_CACHE_MAX_SIZE = 16384;
+
+IBLCache::IBLCache(const std::string& filepath) : m_FilePath(filepath), m_Hash(14695981039346656037ull)
+{
+	AddValue(IBL_CACHE_VERSION);
+	AddValue(ENVIRONMENT_SIZE);
+	AddValue(IRRADIANCE_SIZE);
+	AddValue(PREFILTER_SIZE);
+	AddValue(PREFILTER_MIP_LEVELS);
+	AddValue(BRDF_LUT_SIZE);
+}
+
+IBLCache IBLCache::ForEnvironment(const std::string& hdrPath)
+{
+	IBLCache cache(hdrPath + ".iblcache");
+	cache.AddFile(hdrPath);
+	cache.AddFile("res/shaders/Cubemap.shader");
+	cache.AddFile("res/shaders/Irradiance.shader");
+	cache.AddFile("res/shaders/Prefilter.shader");
+	cache.AddFile("res/shaders/BRDF.shader");
+	return cache;
+}
+
+void IBLCache::HashBytes(const void* data, size_t size)
+{
+	// 64-bit FNV-1a
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		m_Hash ^= bytes[i];
+		m_Hash *= 1099511628211ull;
+	}
+}
+
+void IBLCache::AddFile(const std::string& filepath)
+{
+	std::ifstream stream(filepath, std::ios::binary);
+	if (!stream)
+	{
+		std::cout << "IBL cache: unable to hash " << filepath << std::endl;
+		AddValue(0);
+		return;
+	}
+
+	std::vector<char> buffer(1 << 20);
+	while (stream)
+	{
+		stream.read(buffer.data(), buffer.size());
+		HashBytes(buffer.data(), (size_t)stream.gcount());
+	}
+}
+
+void IBLCache::AddValue(uint64_t value)
+{
+	HashBytes(&value, sizeof(value));
+}
+
+uint64_t IBLCache::GetHash() const
+{
+	return m_Hash;
+}
+
+unsigned int IBLCache::GetChannels(GLenum format)
+{
+	switch (format)
+	{
+	case GL_RED: return 1;
+	case GL_RG: return 2;
+	case GL_RGB: return 3;
+	default: return 4;
+	}
+}
+
+size_t IBLCache::GetLevelSize(const IBLCacheTexture& entry, unsigned int level)
+{
+	size_t levelSize = std::max(entry.size >> level, 1u);
+	size_t faces = entry.target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+	return levelSize * levelSize * GetChannels(entry.format) * faces;
+}
+
+bool IBLCache::Read(std::vector<IBLCacheTexture>& entries)
+{
+	std::ifstream stream(m_FilePath, std::ios::binary);
+	if (!stream)
+		return false;
+
+	uint32_t magic = 0, version = 0, count = 0;
+	uint64_t hash = 0;
+	stream.read((char*)&magic, sizeof(magic));
+	stream.read((char*)&version, sizeof(version));
+	stream.read((char*)&hash, sizeof(hash));
+	stream.read((char*)&count, sizeof(count));
+	if (!stream || magic != IBL_CACHE_MAGIC || version != IBL_CACHE_VERSION || hash != m_Hash || count != 4)
+	{
+		std::cout << "IBL cache is stale, rebuilding: " << m_FilePath << std::endl;
+		return false;
+	}
+
+	// the bytes left bound what the entries may claim before anything is allocated for them
+	std::streamoff dataStart = stream.tellg();
+	stream.seekg(0, std::ios::end);
+	std::streamoff remaining = stream.tellg() - dataStart;
+	stream.seekg(dataStart);
+
+	entries.resize(count);
+	for (IBLCacheTexture& entry : entries)
+	{
+		uint32_t header[6];
+		uint64_t dataSize = 0;
+		stream.read((char*)header, sizeof(header));
+		stream.read((char*)&dataSize, sizeof(dataSize));
+
+		entry.target = header[0];
+		entry.internalFormat = header[1];
+		entry.format = header[2];
+		entry.minFilter = (GLint)header[3];
+		entry.size = header[4];
+		entry.levels = header[5];
+
+		// a level past the 1x1 one does not exist, and GetLevelSize shifts by the level
+		unsigned int fullChain = 1;
+		while ((entry.size >> fullChain) > 0)
+			++fullChain;
+		if (!stream || entry.size == 0 || entry.size > IBL_CACHE_MAX_SIZE || entry.levels == 0 || entry.levels > fullChain)
+		{
+			std::cout << "IBL cache is corrupt, rebuilding: " << m_FilePath << std::endl;
+			return false;
+		}
+
+		size_t expected = 0;
+		for (unsigned int level = 0; level < entry.levels; ++level)
+			expected += GetLevelSize(entry, level);
+		remaining -= (std::streamoff)(sizeof(header) + sizeof(dataSize));
+		if (dataSize != expected || (std::streamoff)(expected * sizeof(uint16_t)) > remaining)
+		{
+			std::cout << "IBL cache is corrupt, rebuilding: " << m_FilePath << std::endl;
+			return false;
+		}
+
+		remaining -= (std::streamoff)(expected * sizeof(uint16_t));
+		entry.data.resize(expected);
+		stream.read((char*)entry.data.data(), expected * sizeof(uint16_t));
+		if (!stream)
+		{
+			std::cout << "IBL cache is truncated, rebuilding: " << m_FilePath << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool IBLCache::Load(IBLTextures& textures)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<IBLCacheTexture> entries;
+	if (!Read(entries))
+		return false;
+
+	textures.envCubemap = CreateTexture(entries[0]);
+	textures.irradianceMap = CreateTexture(entries[1]);
+	textures.prefilterMap = CreateTexture(entries[2]);
+	textures.brdfLUTTexture = CreateTexture(entries[3]);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "IBL cache loaded in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+	return true;
+}
+
+bool IBLCache::Save(const IBLTextures& textures)
+{
+	std::vector<IBLCacheTexture> entries;
+	entries.push_back(ReadTexture(textures.envCubemap, GL_TEXTURE_CUBE_MAP, GL_RGB16F, GL_RGB, GL_LINEAR_MIPMAP_LINEAR, ENVIRONMENT_SIZE));
+	entries.push_back(ReadTexture(textures.irradianceMap, GL_TEXTURE_CUBE_MAP, GL_RGB16F, GL_RGB, GL_LINEAR, IRRADIANCE_SIZE));
+	entries.push_back(ReadTexture(textures.prefilterMap, GL_TEXTURE_CUBE_MAP, GL_RGB16F, GL_RGB, GL_LINEAR_MIPMAP_LINEAR, PREFILTER_SIZE));
+	entries.push_back(ReadTexture(textures.brdfLUTTexture, GL_TEXTURE_2D, GL_RG16F, GL_RG, GL_LINEAR, BRDF_LUT_SIZE));
+	return Save(entries);
+}
+
+bool IBLCache::Save(const std::vector<IBLCacheTexture>& entries)
+{
+	std::ofstream stream(m_FilePath, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		std::cout << "IBL cache: unable to write " << m_FilePath << std::endl;
+		return false;
+	}
+
+	uint32_t count = (uint32_t)entries.size();
+	stream.write((const char*)&IBL_CACHE_MAGIC, sizeof(IBL_CACHE_MAGIC));
+	stream.write((const char*)&IBL_CACHE_VERSION, sizeof(IBL_CACHE_VERSION));
+	stream.write((const char*)&m_Hash, sizeof(m_Hash));
+	stream.write((const char*)&count, sizeof(count));
+
+	for (const IBLCacheTexture& entry : entries)
+	{
+		uint32_t header[6] = { entry.target, entry.internalFormat, entry.format, (uint32_t)entry.minFilter, entry.size, entry.levels };
+		uint64_t dataSize = entry.data.size();
+		stream.write((const char*)header, sizeof(header));
+		stream.write((const char*)&dataSize, sizeof(dataSize));
+		stream.write((const char*)entry.data.data(), dataSize * sizeof(uint16_t));
+	}
+
+	std::cout << "IBL cache written: " << m_FilePath << std::endl;
+	return (bool)stream;
+}
+
+IBLCacheTexture IBLCache::ReadTexture(unsigned int textureID, GLenum target, GLenum internalFormat, GLenum format, GLint minFilter, unsigned int size)
+{
+	IBLCacheTexture entry;
+	entry.target = target;
+	entry.internalFormat = internalFormat;
+	entry.format = format;
+	entry.minFilter = minFilter;
+	entry.size = size;
+	entry.levels = 1;
+	if (minFilter != GL_LINEAR && minFilter != GL_NEAREST)
+		while ((size >> entry.levels) > 0)
+			++entry.levels;
+
+	size_t total = 0;
+	for (unsigned int level = 0; level < entry.levels; ++level)
+		total += GetLevelSize(entry, level);
+	entry.data.resize(total);
+
+	// half float RGB rows are not 4-byte aligned for the smallest mips
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glBindTexture(target, textureID);
+
+	uint16_t* dst = entry.data.data();
+	for (unsigned int level = 0; level < entry.levels; ++level)
+	{
+		size_t faceSize = GetLevelSize(entry, level) / (target == GL_TEXTURE_CUBE_MAP ? 6 : 1);
+		if (target == GL_TEXTURE_CUBE_MAP)
+		{
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, format, GL_HALF_FLOAT, dst);
+				dst += faceSize;
+			}
+		}
+		else
+		{
+			glGetTexImage(target, level, format, GL_HALF_FLOAT, dst);
+			dst += faceSize;
+		}
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	return entry;
+}
+
+unsigned int IBLCache::CreateTexture(const IBLCacheTexture& entry)
+{
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(entry.target, textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	const uint16_t* src = entry.data.data();
+	for (unsigned int level = 0; level < entry.levels; ++level)
+	{
+		unsigned int levelSize = std::max(entry.size >> level, 1u);
+		size_t faceSize = GetLevelSize(entry, level) / (entry.target == GL_TEXTURE_CUBE_MAP ? 6 : 1);
+		if (entry.target == GL_TEXTURE_CUBE_MAP)
+		{
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, entry.internalFormat, levelSize, levelSize, 0, entry.format, GL_HALF_FLOAT, src);
+				src += faceSize;
+			}
+		}
+		else
+		{
+			glTexImage2D(entry.target, level, entry.internalFormat, levelSize, levelSize, 0, entry.format, GL_HALF_FLOAT, src);
+			src += faceSize;
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glTexParameteri(entry.target, GL_TEXTURE_MAX_LEVEL, entry.levels - 1);
+	glTexParameteri(entry.target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(entry.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	if (entry.target == GL_TEXTURE_CUBE_MAP)
+		glTexParameteri(entry.target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(entry.target, GL_TEXTURE_MIN_FILTER, entry.minFilter);
+	glTexParameteri(entry.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	return textureID;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <GLAD/glad.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Resolution constants shared by the IBL precompute and its cache key
+const unsigned int ENVIRONMENT_SIZE = 512;
+const unsigned int IRRADIANCE_SIZE = 32;
+const unsigned int PREFILTER_SIZE = 128;
+const unsigned int PREFILTER_MIP_LEVELS = 5;
+const unsigned int BRDF_LUT_SIZE = 512;
+
+struct IBLTextures
+{
+	unsigned int envCubemap = 0;
+	unsigned int irradianceMap = 0;
+	unsigned int prefilterMap = 0;
+	unsigned int brdfLUTTexture = 0;
+};
+
+// One texture of the cache with every mip level (and cube face) stored as half floats
+struct IBLCacheTexture
+{
+	GLenum target;
+	GLenum internalFormat;
+	GLenum format;
+	GLint minFilter;
+	unsigned int size;
+	unsigned int levels;
+	std::vector<uint16_t> data;
+};
+
+// Stores the products of the IBL precompute (environment cubemap, irradiance,
+// prefilter and BRDF LUT) with their full mip chains in a single binary file.
+// The file is keyed by a hash of every source file and constant that affects
+// the output, so a stale cache is rejected and rebuilt automatically.
+class IBLCache
+{
+private:
+	std::string m_FilePath;
+	uint64_t m_Hash;
+
+public:
+	IBLCache(const std::string& filepath);
+
+	// Cache next to an HDR environment, keyed by the HDR and the precompute shaders
+	static IBLCache ForEnvironment(const std::string& hdrPath);
+
+	void AddFile(const std::string& filepath);
+	void AddValue(uint64_t value);
+	uint64_t GetHash() const;
+
+	bool Read(std::vector<IBLCacheTexture>& entries);
+	bool Load(IBLTextures& textures);
+	bool Save(const IBLTextures& textures);
+	bool Save(const std::vector<IBLCacheTexture>& entries);
+
+	static unsigned int GetChannels(GLenum format);
+	static size_t GetLevelSize(const IBLCacheTexture& entry, unsigned int level);
+
+private:
+	void HashBytes(const void* data, size_t size);
+	IBLCacheTexture ReadTexture(unsigned int textureID, GLenum target, GLenum internalFormat, GLenum format, GLint minFilter, unsigned int size);
+	unsigned int CreateTexture(const IBLCacheTexture& entry);
+};
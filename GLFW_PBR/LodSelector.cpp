@@ -0,0 +1,55 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <cmath>
+
+LodSelector::LodSelector()
+	: m_Errors(1, 0.0f), m_PixelsPerUnit(1.0f), m_Near(0.1f), m_Threshold(1.0f), m_Hysteresis(0.25f)
+{
+}
+
+void LodSelector::SetErrors(const std::vector<float>& errors)
+{
+	m_Errors = errors;
+	if (m_Errors.empty())
+		m_Errors.push_back(0.0f);
+	for (size_t i = 1; i < m_Errors.size(); ++i)
+		m_Errors[i] = std::max(m_Errors[i], m_Errors[i - 1]);
+}
+
+void LodSelector::SetProjection(float fovy, float viewportHeight, float nearPlane)
+{
+	m_PixelsPerUnit = viewportHeight / (2.0f * std::tan(fovy * 0.5f));
+	m_Near = nearPlane;
+}
+
+void LodSelector::SetThreshold(float pixels, float hysteresis)
+{
+	m_Threshold = pixels;
+	m_Hysteresis = hysteresis;
+}
+
+unsigned int LodSelector::GetLevelCount() const
+{
+	return (unsigned int)m_Errors.size();
+}
+
+float LodSelector::GetProjectedError(unsigned int level, float distance, float radius, float scale) const
+{
+	level = std::min(level, GetLevelCount() - 1);
+	float nearest = std::max(distance - radius * scale, m_Near);
+	return m_Errors[level] * scale * m_PixelsPerUnit / nearest;
+}
+
+unsigned int LodSelector::Select(float distance, float radius, float scale, unsigned int current) const
+{
+	float nearest = std::max(distance - radius * scale, m_Near);
+	float pixelsPerError = scale * m_PixelsPerUnit / nearest;
+	for (unsigned int level = GetLevelCount() - 1; level > 0; --level)
+	{
+		float limit = level > current ? m_Threshold * (1.0f - m_Hysteresis) : m_Threshold;
+		if (m_Errors[level] * pixelsPerError <= limit)
+			return level;
+	}
+	return 0;
+}
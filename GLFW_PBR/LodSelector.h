@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+// Picks a level of detail by the size its error would have on screen. A
+// level's error (model units, see MeshLod) is projected at the distance of
+// the nearest point of the object's bounding sphere, and the coarsest level
+// that stays under the threshold in pixels is drawn. Switching to a coarser
+// level needs the error under threshold * (1 - hysteresis), so an object on
+// the boundary settles on one level instead of popping every frame.
+class LodSelector
+{
+private:
+	std::vector<float> m_Errors; // per level, full detail first, never decreasing
+	float m_PixelsPerUnit;       // at distance 1
+	float m_Near;
+	float m_Threshold;
+	float m_Hysteresis;
+
+public:
+	LodSelector();
+
+	void SetErrors(const std::vector<float>& errors);
+	// Vertical field of view in radians and the viewport height in pixels
+	void SetProjection(float fovy, float viewportHeight, float nearPlane);
+	void SetThreshold(float pixels, float hysteresis);
+
+	unsigned int GetLevelCount() const;
+	// scale is the object's, applied to both the radius and the errors
+	float GetProjectedError(unsigned int level, float distance, float radius, float scale = 1.0f) const;
+	// current is the level drawn last frame
+	unsigned int Select(float distance, float radius, float scale, unsigned int current) const;
+};
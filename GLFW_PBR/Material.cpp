@@ -0,0 +1,219 @@
+#include "Material.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+void Material::SetTexture(const std::string& uniform, unsigned int unit, unsigned int textureID)
+{
+	for (MaterialTexture& texture : textures)
+	{
+		if (texture.uniform == uniform)
+		{
+			texture.unit = unit;
+			texture.textureID = textureID;
+			return;
+		}
+	}
+	textures.push_back({ uniform, unit, textureID });
+}
+
+void Material::SetUniforms() const
+{
+	for (const MaterialTexture& texture : textures)
+		shader->SetUniform1i(texture.uniform, texture.unit);
+	for (const auto& value : ints)
+		shader->SetUniform1i(value.first, value.second);
+	for (const auto& value : floats)
+		shader->SetUniform1f(value.first, value.second);
+	for (const auto& value : vec3s)
+		shader->SetUniform3f(value.first, value.second);
+}
+
+MaterialLibrary::MaterialLibrary(TextureLoader loadTexture) : m_LoadTexture(loadTexture)
+{
+}
+
+MaterialLibrary::~MaterialLibrary()
+{
+	for (const auto& texture : m_Textures)
+		glDeleteTextures(1, &texture.second);
+}
+
+void MaterialLibrary::AddShader(const std::string& name, Shader& shader)
+{
+	m_Shaders[name] = &shader;
+}
+
+bool MaterialLibrary::Load(const std::string& filepath)
+{
+	std::ifstream stream(filepath);
+	if (!stream)
+	{
+		std::cout << "Failed to open material file: " << filepath << std::endl;
+		return false;
+	}
+
+	std::string line;
+	unsigned int lineNumber = 0;
+	Material* material = nullptr;
+	int priority = 0;
+	while (getline(stream, line))
+	{
+		++lineNumber;
+		std::stringstream ss(line);
+		std::string keyword;
+		if (!(ss >> keyword) || keyword[0] == '#')
+			continue;
+
+		if (keyword == "material")
+		{
+			std::string name, shaderName;
+			ss >> name >> shaderName;
+			auto shader = m_Shaders.find(shaderName);
+			if (shader == m_Shaders.end())
+			{
+				std::cout << filepath << "(" << lineNumber << "): unknown shader " << shaderName << std::endl;
+				return false;
+			}
+			material = Add(name, shader->second);
+			priority = 0;
+			continue;
+		}
+
+		if (!material)
+		{
+			std::cout << filepath << "(" << lineNumber << "): " << keyword << " outside of a material" << std::endl;
+			return false;
+		}
+
+		if (keyword == "end")
+			material = nullptr;
+		else if (keyword == "inherit")
+		{
+			std::string baseName;
+			ss >> baseName;
+			Material* base = Get(baseName);
+			if (!base)
+				return false;
+			material->textures = base->textures;
+			material->ints = base->ints;
+			material->floats = base->floats;
+			material->vec3s = base->vec3s;
+		}
+		else if (keyword == "priority")
+			ss >> priority;
+		else if (keyword == "texture")
+		{
+			std::string uniform, path;
+			unsigned int unit;
+			ss >> uniform >> unit >> path;
+			material->SetTexture(uniform, unit, path == "none" ? 0 : LoadTexture(path, priority));
+		}
+		else if (keyword == "int")
+		{
+			std::string uniform;
+			int value;
+			ss >> uniform >> value;
+			material->ints[uniform] = value;
+		}
+		else if (keyword == "float")
+		{
+			std::string uniform;
+			float value;
+			ss >> uniform >> value;
+			material->floats[uniform] = value;
+		}
+		else if (keyword == "vec3")
+		{
+			std::string uniform;
+			glm::vec3 value;
+			ss >> uniform >> value.x >> value.y >> value.z;
+			material->vec3s[uniform] = value;
+		}
+		else
+		{
+			std::cout << filepath << "(" << lineNumber << "): unknown keyword " << keyword << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+std::vector<std::string> MaterialLibrary::ReadTexturePaths(const std::string& filepath)
+{
+	std::vector<std::string> paths;
+	std::ifstream stream(filepath);
+	std::string line;
+	while (getline(stream, line))
+	{
+		std::stringstream ss(line);
+		std::string keyword, uniform, path;
+		unsigned int unit;
+		if (ss >> keyword && keyword == "texture" && ss >> uniform >> unit >> path && path != "none")
+		{
+			if (std::find(paths.begin(), paths.end(), path) == paths.end())
+				paths.push_back(path);
+		}
+	}
+	return paths;
+}
+
+Material* MaterialLibrary::Create(const std::string& name, const std::string& base)
+{
+	Material* source = Get(base);
+	if (!source)
+		return nullptr;
+
+	Material* material = Add(name, source->shader);
+	material->textures = source->textures;
+	material->ints = source->ints;
+	material->floats = source->floats;
+	material->vec3s = source->vec3s;
+	return material;
+}
+
+Material* MaterialLibrary::Get(const std::string& name)
+{
+	auto material = m_MaterialsByName.find(name);
+	if (material == m_MaterialsByName.end())
+	{
+		std::cout << "Material not found: " << name << std::endl;
+		return nullptr;
+	}
+	return material->second;
+}
+
+size_t MaterialLibrary::GetMaterialCount() const
+{
+	return m_Materials.size();
+}
+
+size_t MaterialLibrary::GetTextureCount() const
+{
+	return m_Textures.size();
+}
+
+Material* MaterialLibrary::Add(const std::string& name, Shader* shader)
+{
+	m_Materials.emplace_back(new Material());
+	Material* material = m_Materials.back().get();
+	material->name = name;
+	material->shader = shader;
+	material->id = (unsigned int)m_Materials.size() - 1;
+	m_MaterialsByName[name] = material;
+	return material;
+}
+
+unsigned int MaterialLibrary::LoadTexture(const std::string& path, int priority)
+{
+	// materials sharing a texture file share the GL texture
+	auto texture = m_Textures.find(path);
+	if (texture != m_Textures.end())
+		return texture->second;
+
+	unsigned int textureID = m_LoadTexture(path, true, priority);
+	m_Textures[path] = textureID;
+	return textureID;
+}
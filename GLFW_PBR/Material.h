@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Shader.h"
+#include <GLM/glm.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+
+struct MaterialTexture
+{
+	std::string uniform;
+	unsigned int unit;
+	unsigned int textureID;
+};
+
+// Texture set and scalar uniforms for one surface type
+class Material
+{
+public:
+	std::string name;
+	Shader* shader = nullptr;
+	unsigned int id = 0;
+
+	std::vector<MaterialTexture> textures;
+	std::map<std::string, int> ints;
+	std::map<std::string, float> floats;
+	std::map<std::string, glm::vec3> vec3s;
+
+	void SetTexture(const std::string& uniform, unsigned int unit, unsigned int textureID);
+
+	// Sets sampler units and scalar uniforms on the bound shader, textures are bound by the Renderer
+	void SetUniforms() const;
+};
+
+// Owns every material and the textures they reference. Materials are read from a
+// text file where each block starts with "material <name> <shader>" and ends with
+// "end"; see res/materials/Gallery.material for the syntax.
+class MaterialLibrary
+{
+public:
+	// Returns the texture name for a file, the pixels may arrive later (see TextureBatch)
+	typedef std::function<unsigned int(const std::string& path, bool gammaCorrection, int priority)> TextureLoader;
+
+private:
+	std::vector<std::unique_ptr<Material>> m_Materials;
+	std::unordered_map<std::string, Material*> m_MaterialsByName;
+	std::unordered_map<std::string, Shader*> m_Shaders;
+	std::unordered_map<std::string, unsigned int> m_Textures;
+	TextureLoader m_LoadTexture;
+
+public:
+	MaterialLibrary(TextureLoader loadTexture);
+	~MaterialLibrary();
+
+	void AddShader(const std::string& name, Shader& shader);
+	bool Load(const std::string& filepath);
+
+	// Every texture file a material file references, without loading anything
+	static std::vector<std::string> ReadTexturePaths(const std::string& filepath);
+
+	// New material copying everything from base
+	Material* Create(const std::string& name, const std::string& base);
+	Material* Get(const std::string& name);
+
+	size_t GetMaterialCount() const;
+	size_t GetTextureCount() const;
+
+private:
+	Material* Add(const std::string& name, Shader* shader);
+	unsigned int LoadTexture(const std::string& path, int priority);
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <GLAD/glad.h>
+#include <string>
+#include <cstdint>
+
+// Linked programs saved with glGetProgramBinary, one file per program and set of
+// defines next to its .shader. A binary only suits the driver that produced it,
+// so the file is keyed by a hash of the source as compiled (includes expanded,
+// defines inserted), the defines and the GL vendor, renderer and version strings.
+// A stale key, or a driver that rejects the binary anyway, reads as a miss and the
+// caller compiles from source and saves over the file.
+class ProgramCache
+{
+private:
+	std::string m_FilePath;
+	uint64_t m_Hash;
+
+public:
+	ProgramCache(const std::string& filepath);
+
+	static ProgramCache ForProgram(const std::string& shaderPath, const std::string& defines,
+		const std::string& vertexSource, const std::string& fragmentSource);
+	// Needs the GL 4.1 entry points and a driver offering at least one binary format
+	static bool IsSupported();
+
+	void AddString(const std::string& value);
+	void AddValue(uint64_t value);
+	uint64_t GetHash() const;
+	const std::string& GetFilePath() const;
+
+	// A linked program, 0 when there is no usable binary
+	unsigned int Load();
+	// The program has to have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	bool Save(unsigned int program);
+
+private:
+	void HashBytes(const void* data, size_t size);
+};
@@ -0,0 +1,115 @@
+#include "Renderer.h"
+
+#include <algorithm>
+
+static const unsigned int UNKNOWN_BINDING = ~0u;
+
+Renderer::Renderer(unsigned int firstInstanceLocation) : m_InstanceLocation(firstInstanceLocation)
+{
+	std::fill(m_BoundTextures, m_BoundTextures + MAX_TEXTURE_UNITS, UNKNOWN_BINDING);
+}
+
+void Renderer::BeginFrame()
+{
+	m_Stats = RenderStats();
+}
+
+void Renderer::Submit(const Material& material, const RenderMesh& mesh, const glm::mat4& model)
+{
+	m_Queue.push_back({ &material, &mesh, nullptr, model });
+}
+
+void Renderer::SubmitInstanced(const Material& material, const RenderMesh& mesh, const InstanceBuffer& instances)
+{
+	if (instances.GetCount() > 0)
+		m_Queue.push_back({ &material, &mesh, &instances, glm::mat4(1.0f) });
+}
+
+void Renderer::Flush()
+{
+	std::sort(m_Queue.begin(), m_Queue.end(), [](const DrawCommand& a, const DrawCommand& b)
+	{
+		if (a.material->shader != b.material->shader)
+			return a.material->shader->GetID() < b.material->shader->GetID();
+		if (a.material->id != b.material->id)
+			return a.material->id < b.material->id;
+		return a.mesh->VAO < b.mesh->VAO;
+	});
+
+	// code outside the renderer binds textures too, so nothing is assumed between flushes
+	std::fill(m_BoundTextures, m_BoundTextures + MAX_TEXTURE_UNITS, UNKNOWN_BINDING);
+
+	Shader* currentShader = nullptr;
+	const Material* currentMaterial = nullptr;
+	unsigned int currentVAO = UNKNOWN_BINDING;
+	for (const DrawCommand& command : m_Queue)
+	{
+		if (command.material->shader != currentShader)
+		{
+			currentShader = command.material->shader;
+			currentShader->Bind();
+			currentMaterial = nullptr;
+			++m_Stats.shaderBinds;
+		}
+
+		if (command.material != currentMaterial)
+		{
+			currentMaterial = command.material;
+			for (const MaterialTexture& texture : currentMaterial->textures)
+				BindTexture(texture.unit, texture.textureID);
+			currentMaterial->SetUniforms();
+			++m_Stats.materialBinds;
+		}
+
+		if (command.mesh->VAO != currentVAO)
+		{
+			currentVAO = command.mesh->VAO;
+			glBindVertexArray(currentVAO);
+			++m_Stats.vertexArrayBinds;
+		}
+
+		if (command.instances)
+		{
+			// a VAO can only source one instance buffer, re-point it when another one is drawn
+			unsigned int& attached = m_AttachedInstances[currentVAO];
+			if (attached != command.instances->GetID())
+			{
+				command.instances->Attach(currentVAO, m_InstanceLocation);
+				glBindVertexArray(currentVAO);
+				attached = command.instances->GetID();
+			}
+			glDrawElementsInstanced(command.mesh->mode, command.mesh->indexCount, GL_UNSIGNED_INT, (void*)(command.mesh->firstIndex * sizeof(unsigned int)), command.instances->GetCount());
+			m_Stats.instances += command.instances->GetCount();
+		}
+		else
+		{
+			currentShader->SetUniformMatrix4fv("model", command.model);
+			glDrawElements(command.mesh->mode, command.mesh->indexCount, GL_UNSIGNED_INT, (void*)(command.mesh->firstIndex * sizeof(unsigned int)));
+			++m_Stats.instances;
+		}
+		++m_Stats.drawCalls;
+	}
+
+	glBindVertexArray(0);
+	m_Queue.clear();
+}
+
+const RenderStats& Renderer::GetStats() const
+{
+	return m_Stats;
+}
+
+void Renderer::BindTexture(unsigned int unit, unsigned int textureID)
+{
+	if (unit < MAX_TEXTURE_UNITS && m_BoundTextures[unit] == textureID)
+	{
+		++m_Stats.texturesSkipped;
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	if (unit < MAX_TEXTURE_UNITS)
+		m_BoundTextures[unit] = textureID;
+	++m_Stats.textureBinds;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Material.h"
+#include "InstanceBuffer.h"
+#include <GLAD/glad.h>
+#include <GLM/glm.hpp>
+#include <vector>
+#include <unordered_map>
+
+// Indexed geometry drawn with glDrawElements, GL_UNSIGNED_INT indices from firstIndex on
+struct RenderMesh
+{
+	unsigned int VAO;
+	GLenum mode;
+	unsigned int indexCount;
+	unsigned int firstIndex;
+};
+
+struct RenderStats
+{
+	unsigned int drawCalls = 0;
+	unsigned int shaderBinds = 0;
+	unsigned int materialBinds = 0;
+	unsigned int textureBinds = 0;
+	unsigned int texturesSkipped = 0;
+	unsigned int vertexArrayBinds = 0;
+	unsigned int instances = 0;
+};
+
+// Collects draws for a frame and submits them sorted by shader, then material,
+// then mesh so each program, texture set and VAO is bound once per run of draws.
+class Renderer
+{
+private:
+	struct DrawCommand
+	{
+		const Material* material;
+		const RenderMesh* mesh;
+		const InstanceBuffer* instances;
+		glm::mat4 model;
+	};
+
+	static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+	std::vector<DrawCommand> m_Queue;
+	std::unordered_map<unsigned int, unsigned int> m_AttachedInstances; // VAO -> instance VBO
+	unsigned int m_InstanceLocation;
+	unsigned int m_BoundTextures[MAX_TEXTURE_UNITS];
+	RenderStats m_Stats;
+
+public:
+	// firstInstanceLocation is the first attribute location used for InstanceData
+	Renderer(unsigned int firstInstanceLocation);
+
+	void BeginFrame();
+	void Submit(const Material& material, const RenderMesh& mesh, const glm::mat4& model);
+	void SubmitInstanced(const Material& material, const RenderMesh& mesh, const InstanceBuffer& instances);
+	void Flush();
+
+	const RenderStats& GetStats() const;
+
+private:
+	void BindTexture(unsigned int unit, unsigned int textureID);
+};
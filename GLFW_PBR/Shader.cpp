@@ -1,17 +1,28 @@
 #include "Shader.h"
+#include "ProgramCache.h"
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
 
-Shader::Shader(const std::string& filepath) : m_FilePath(filepath), m_RendererID(0)
+static float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
 {
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+Shader::Shader(const std::string& filepath, const std::string& defines) : m_RendererID(0), m_FilePath(filepath), m_Defines(defines)
+{
+	auto parseStart = std::chrono::high_resolution_clock::now();
 	ShaderProgramSource source = ParseShader(filepath);
+	m_Stats.parseMs = ElapsedMs(parseStart);
 
 	std::cout << "VERTEX" << std::endl << source.VertexSource << std::endl;
 	std::cout << "FRAGMENT" << std::endl << source.FragmentSource << std::endl;
 
-	m_RendererID = CreateShader(source.VertexSource, source.FragmentSource);
+	m_RendererID = BuildProgram(source);
 
 	glUseProgram(m_RendererID);
 }
@@ -28,7 +39,10 @@ struct ShaderProgramSource Shader::ParseShader(const std::string& filepath)
 		NONE = -1, VERTEX = 0, FRAGMENT = 1
 	};
 
+	m_Files.assign(1, filepath);
 	std::ifstream stream(filepath);
+	if (!stream)
+		std::cout << "Failed to open shader " << filepath << "!" << std::endl;
 	std::string line;
 	std::stringstream ss[3];
 	ShaderType type = ShaderType::NONE;
@@ -46,7 +60,60 @@ struct ShaderProgramSource Shader::ParseShader(const std::string& filepath)
 			ss[(int)type] << line << '\n';
 		}
 	}
-	return { ss[0].str(), ss[1].str() };
+	return { InsertDefines(ss[0].str()), InsertDefines(ss[1].str()) };
+}
+
+std::string Shader::InsertDefines(const std::string& source) const
+{
+	if (m_Defines.empty())
+		return source;
+
+	// GLSL wants #version before anything else
+	size_t version = source.find("#version");
+	if (version == std::string::npos)
+		return m_Defines + source;
+	size_t lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos)
+		return source + '\n' + m_Defines;
+	return source.substr(0, lineEnd + 1) + m_Defines + source.substr(lineEnd + 1);
+}
+
+unsigned int Shader::BuildProgram(const ShaderProgramSource& source)
+{
+	auto buildStart = std::chrono::high_resolution_clock::now();
+	m_Stats.compileMs = 0.0f;
+	m_Stats.linkMs = 0.0f;
+
+	ProgramCache cache = ProgramCache::ForProgram(m_FilePath, m_Defines, source.VertexSource, source.FragmentSource);
+	auto binaryStart = std::chrono::high_resolution_clock::now();
+	unsigned int program = cache.Load();
+	m_Stats.binaryMs = ElapsedMs(binaryStart);
+	m_Stats.cached = program != 0;
+	if (program == 0)
+	{
+		program = CreateShader(source.VertexSource, source.FragmentSource);
+		if (program != 0)
+			cache.Save(program);
+	}
+
+#ifdef _DEBUG
+	// validation checks the program against the GL state of the moment, which only helps while debugging
+	if (program != 0)
+	{
+		GLint valid = GL_FALSE;
+		glValidateProgram(program);
+		glGetProgramiv(program, GL_VALIDATE_STATUS, &valid);
+		if (valid != GL_TRUE)
+		{
+			GLchar message[1024] = "";
+			glGetProgramInfoLog(program, sizeof(message), nullptr, message);
+			std::cout << "Program validation failed: " << m_FilePath << std::endl << message << std::endl;
+		}
+	}
+#endif
+
+	m_Stats.totalMs = m_Stats.parseMs + ElapsedMs(buildStart);
+	return program;
 }
 
 unsigned int Shader::CompileShader(unsigned int type, const std::string& source)
@@ -61,11 +128,12 @@ unsigned int Shader::CompileShader(unsigned int type, const std::string& source)
 	std::cout << (type == GL_VERTEX_SHADER ? "Vertex" : "Fragment") << " shader compile status: " << success << std::endl;
 	if (success == GL_FALSE)
 	{
-		int length;
+		int length = 0;
 		glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
-		char* message = (char*)alloca(length * sizeof(char));
-		glGetShaderInfoLog(id, sizeof(message), &length, message);
+		std::string message(std::max(length, 1), '\0');
+		glGetShaderInfoLog(id, (GLsizei)message.size(), &length, &message[0]);
 		std::cout << "Failed to compile " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader!" << std::endl;
+		std::cout << message.c_str() << std::endl;
 		glDeleteShader(id);
 		return 0;
 	}
@@ -74,16 +142,30 @@ unsigned int Shader::CompileShader(unsigned int type, const std::string& source)
 
 unsigned int Shader::CreateShader(const std::string& vertexShader, const std::string& fragmentShader)
 {
-	unsigned int program = glCreateProgram();
+	// the status queries wait for the driver, so the times cover the whole compile and link
+	auto compileStart = std::chrono::high_resolution_clock::now();
 	unsigned int vs = CompileShader(GL_VERTEX_SHADER, vertexShader);
 	unsigned int fs = CompileShader(GL_FRAGMENT_SHADER, fragmentShader);
+	m_Stats.compileMs = ElapsedMs(compileStart);
+	m_Stats.linkMs = 0.0f;
+	if (vs == 0 || fs == 0)
+	{
+		glDeleteShader(vs);
+		glDeleteShader(fs);
+		return 0;
+	}
 
+	auto linkStart = std::chrono::high_resolution_clock::now();
+	unsigned int program = glCreateProgram();
+	if (ProgramCache::IsSupported())
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glAttachShader(program, vs);
 	glAttachShader(program, fs);
 	glLinkProgram(program);
 
 	GLint program_linked;
 	glGetProgramiv(program, GL_LINK_STATUS, &program_linked);
+	m_Stats.linkMs = ElapsedMs(linkStart);
 	std::cout << "Program link status: " << program_linked << std::endl;
 	if (program_linked != GL_TRUE)
 	{
@@ -92,15 +174,73 @@ unsigned int Shader::CreateShader(const std::string& vertexShader, const std::st
 		glGetProgramInfoLog(program, sizeof(message), &log_length, message);
 		std::cout << "Failed to link program!" << std::endl;
 		std::cout << message << std::endl;
+		glDeleteShader(vs);
+		glDeleteShader(fs);
+		glDeleteProgram(program);
+		return 0;
 	}
 
-	glValidateProgram(program);
 	glDeleteShader(vs);
 	glDeleteShader(fs);
 
 	return program;
 }
 
+bool Shader::Reload()
+{
+	auto parseStart = std::chrono::high_resolution_clock::now();
+	ShaderProgramSource source = ParseShader(m_FilePath);
+	m_Stats.parseMs = ElapsedMs(parseStart);
+	m_Stats.reloads++;
+
+	unsigned int program = BuildProgram(source);
+	if (program == 0)
+	{
+		m_Stats.failures++;
+		std::cout << "Shader reload failed, keeping the previous program: " << m_FilePath << std::endl;
+		return false;
+	}
+
+	glDeleteProgram(m_RendererID);
+	m_RendererID = program;
+
+	// locations, values and block bindings all belong to the program, the new one starts without any
+	glUseProgram(m_RendererID);
+	for (auto& block : m_UniformBlocks)
+	{
+		unsigned int index = glGetUniformBlockIndex(m_RendererID, block.first.c_str());
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(m_RendererID, index, block.second);
+	}
+	for (auto& uniform : m_Uniforms)
+	{
+		uniform.second.location = glGetUniformLocation(m_RendererID, uniform.first.c_str());
+		ApplyUniform(uniform.second);
+	}
+
+	std::cout << "Shader reloaded: " << m_FilePath << " (parse " << m_Stats.parseMs << " ms, ";
+	if (m_Stats.cached)
+		std::cout << "binary " << m_Stats.binaryMs << " ms)" << std::endl;
+	else
+		std::cout << "compile " << m_Stats.compileMs << " ms, link " << m_Stats.linkMs << " ms)" << std::endl;
+	return true;
+}
+
+const std::string& Shader::GetFilePath() const
+{
+	return m_FilePath;
+}
+
+const std::vector<std::string>& Shader::GetFiles() const
+{
+	return m_Files;
+}
+
+const ShaderBuildStats& Shader::GetBuildStats() const
+{
+	return m_Stats;
+}
+
 void Shader::Bind() const
 {
 	glUseProgram(m_RendererID);
@@ -118,52 +258,120 @@ int Shader::GetID()
 
 void Shader::SetUniform4f(const std::string& name, float v0, float v1, float v2, float v3)
 {
-	glUniform4f(GetUniformLocation(name), v0, v1, v2, v3);
+	SetUniform4f(name, glm::vec4(v0, v1, v2, v3));
 }
 void Shader::SetUniform4f(const std::string& name, glm::vec4 value)
 {
-	glUniform4f(GetUniformLocation(name), value.x, value.y, value.z, value.w);
+	Uniform& uniform = GetUniform(name);
+	uniform.type = GL_FLOAT_VEC4;
+	std::memcpy(uniform.values, &value[0], sizeof(value));
+	glUniform4f(uniform.location, value.x, value.y, value.z, value.w);
 }
 
 void Shader::SetUniform3f(const std::string& name, float v0, float v1, float v2)
 {
-	glUniform3f(GetUniformLocation(name), v0, v1, v2);
+	SetUniform3f(name, glm::vec3(v0, v1, v2));
 }
 
 void Shader::SetUniform3f(const std::string& name, glm::vec3 value)
 {
-	glUniform3f(GetUniformLocation(name), value.x, value.y, value.z);
+	Uniform& uniform = GetUniform(name);
+	uniform.type = GL_FLOAT_VEC3;
+	std::memcpy(uniform.values, &value[0], sizeof(value));
+	glUniform3f(uniform.location, value.x, value.y, value.z);
 }
 
 void Shader::SetUniform2f(const std::string& name, glm::vec2 value)
 {
-	glUniform2f(GetUniformLocation(name), value.x, value.y);
+	Uniform& uniform = GetUniform(name);
+	uniform.type = GL_FLOAT_VEC2;
+	std::memcpy(uniform.values, &value[0], sizeof(value));
+	glUniform2f(uniform.location, value.x, value.y);
 }
 
 void Shader::SetUniform1f(const std::string& name, float value)
 {
-	glUniform1f(GetUniformLocation(name), value);
+	Uniform& uniform = GetUniform(name);
+	uniform.type = GL_FLOAT;
+	uniform.values[0] = value;
+	glUniform1f(uniform.location, value);
 }
 
 void Shader::SetUniform1i(const std::string& name, int value)
 {
-	glUniform1i(GetUniformLocation(name), value);
+	Uniform& uniform = GetUniform(name);
+	uniform.type = GL_INT;
+	uniform.integer = value;
+	glUniform1i(uniform.location, value);
 }
 
 void Shader::SetUniformMatrix4fv(const std::string &name, const glm::mat4 &mat)
 {
-	glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+	Uniform& uniform = GetUniform(name);
+	uniform.type = GL_FLOAT_MAT4;
+	std::memcpy(uniform.values, &mat[0][0], sizeof(mat));
+	glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
 }
 
-int Shader::GetUniformLocation(const std::string& name)
+void Shader::BindUniformBlock(const std::string& name, unsigned int binding)
 {
-	if (m_UniformLocationCache.find(name) != m_UniformLocationCache.end())
-		return m_UniformLocationCache[name];
+	unsigned int index = glGetUniformBlockIndex(m_RendererID, name.c_str());
+	if (index == GL_INVALID_INDEX)
+	{
+		std::cout << "Warning: uniform block " << name << " doesn't exist!" << std::endl;
+		return;
+	}
+	glUniformBlockBinding(m_RendererID, index, binding);
+	m_UniformBlocks[name] = binding;
+}
 
-	int location = glGetUniformLocation(m_RendererID, name.c_str());
-	if (location == -1)
+Shader::Uniform& Shader::GetUniform(const std::string& name)
+{
+	auto found = m_Uniforms.find(name);
+	if (found != m_Uniforms.end())
+		return found->second;
+
+	Uniform& uniform = m_Uniforms[name];
+	uniform.location = glGetUniformLocation(m_RendererID, name.c_str());
+	if (uniform.location == -1)
 		std::cout << "Warning: uniform " << name << " doesn't exist!" << std::endl;
+	return uniform;
+}
 
-	m_UniformLocationCache[name] = location;
-	return location;
-}
\ No newline at end of file
+void Shader::ApplyUniform(const Uniform& uniform)
+{
+	switch (uniform.type)
+	{
+	case GL_FLOAT: glUniform1f(uniform.location, uniform.values[0]); break;
+	case GL_FLOAT_VEC2: glUniform2fv(uniform.location, 1, uniform.values); break;
+	case GL_FLOAT_VEC3: glUniform3fv(uniform.location, 1, uniform.values); break;
+	case GL_FLOAT_VEC4: glUniform4fv(uniform.location, 1, uniform.values); break;
+	case GL_FLOAT_MAT4: glUniformMatrix4fv(uniform.location, 1, GL_FALSE, uniform.values); break;
+	case GL_INT: glUniform1i(uniform.location, uniform.integer); break;
+	default: break;
+	}
+}
+
+ShaderStartupProfile PrintShaderProfile(const std::vector<const Shader*>& shaders)
+{
+	ShaderStartupProfile profile;
+	for (const Shader* shader : shaders)
+	{
+		const ShaderBuildStats& stats = shader->GetBuildStats();
+		profile.programs++;
+		profile.totalMs += stats.totalMs;
+		if (stats.cached)
+		{
+			profile.cached++;
+			std::cout << "  " << shader->GetFilePath() << ": " << stats.totalMs << " ms warm (binary " << stats.binaryMs << " ms)" << std::endl;
+		}
+		else
+		{
+			std::cout << "  " << shader->GetFilePath() << ": " << stats.totalMs << " ms cold (compile " << stats.compileMs
+				<< " ms, link " << stats.linkMs << " ms)" << std::endl;
+		}
+	}
+	std::cout << "Shader build: " << profile.programs << " programs in " << profile.totalMs << " ms, " << profile.cached
+		<< " from the program binary cache" << std::endl;
+	return profile;
+}
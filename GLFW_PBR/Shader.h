@@ -2,6 +2,7 @@
 
 #include <GLAD/glad.h>
 #include <string>
+#include <vector>
 #include <unordered_map>
 #include <GLM/glm.hpp>
 
@@ -11,15 +12,43 @@ struct ShaderProgramSource
 	std::string FragmentSource;
 };
 
+// How long the current program took to build, from the constructor or the last Reload
+struct ShaderBuildStats
+{
+	bool cached = false; // loaded from the program binary cache rather than compiled
+	float parseMs = 0.0f;
+	float binaryMs = 0.0f; // reading and loading the cached binary, rejected ones included
+	float compileMs = 0.0f; // both stages
+	float linkMs = 0.0f;
+	float totalMs = 0.0f; // parse to usable program, cache writes included
+	unsigned int reloads = 0;
+	unsigned int failures = 0; // reloads that kept the previous program
+};
+
 class Shader
 {
 private:
+	// Location of a uniform and the last value a setter gave it, so a rebuilt
+	// program can be brought back to the state the old one was left in
+	struct Uniform
+	{
+		int location = -1;
+		GLenum type = GL_NONE; // of the last value, GL_NONE before the first
+		float values[16];
+		int integer;
+	};
+
 	unsigned int m_RendererID;
 	std::string m_FilePath;
-	std::unordered_map<std::string, int> m_UniformLocationCache;
+	std::string m_Defines;
+	std::vector<std::string> m_Files; // the .shader file, the one place its source comes from
+	std::unordered_map<std::string, Uniform> m_Uniforms;
+	std::unordered_map<std::string, unsigned int> m_UniformBlocks; // bindings
+	ShaderBuildStats m_Stats;
 
 public:
-	Shader(const std::string &filepath);
+	// defines are lines such as "#define SHADOWS 1\n", put after the #version line of both stages
+	Shader(const std::string &filepath, const std::string& defines = "");
 	~Shader();
 	
 	void Bind() const;
@@ -34,10 +63,37 @@ public:
 	void SetUniform1f(const std::string &name, float value);
 	void SetUniform1i(const std::string &name, int value);
 	void SetUniformMatrix4fv(const std::string& name, const glm::mat4& mat);
+	void BindUniformBlock(const std::string& name, unsigned int binding);
+
+	// Builds the program again from its files, or from the binary cache when they
+	// are unchanged. On success the new program takes the old one's uniform values
+	// and block bindings; on failure the old one stays in use and false is returned.
+	bool Reload();
+
+	const std::string& GetFilePath() const;
+	const std::vector<std::string>& GetFiles() const;
+	const ShaderBuildStats& GetBuildStats() const;
 
 private:
-	int GetUniformLocation(const std::string& name);
+	Uniform& GetUniform(const std::string& name);
+	void ApplyUniform(const Uniform& uniform);
 	struct ShaderProgramSource ParseShader(const std::string& filepath);
+	std::string InsertDefines(const std::string& source) const;
+	// Loads the program from the binary cache, or compiles it and caches it; 0 on failure
+	unsigned int BuildProgram(const ShaderProgramSource& source);
 	unsigned int CompileShader(unsigned int type, const std::string& source);
+	// 0 when a stage does not compile or the program does not link
 	unsigned int CreateShader(const std::string& vertexShader, const std::string& fragmentShader);
-};
\ No newline at end of file
+};
+
+// Build times of a set of shaders, for the startup profile
+struct ShaderStartupProfile
+{
+	unsigned int programs = 0;
+	unsigned int cached = 0; // of those, loaded from the program binary cache
+	float totalMs = 0.0f;
+};
+
+// Prints a line per shader, marked cold when it was compiled from source and
+// warm when it came from the binary cache, followed by the total
+ShaderStartupProfile PrintShaderProfile(const std::vector<const Shader*>& shaders);
@@ -0,0 +1,242 @@
+#include "ShaderWatcher.h"
+#include "Shader.h"
+
+#include <iostream>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// A watched directory, named the way the shaders name it, with a trailing separator
+struct ShaderWatcher::Directory
+{
+	std::string path;
+#ifdef _WIN32
+	HANDLE handle = INVALID_HANDLE_VALUE;
+	OVERLAPPED overlapped = {};
+	DWORD buffer[2048]; // FILE_NOTIFY_INFORMATION records, which have to be DWORD aligned
+#else
+	int watch = -1;
+#endif
+};
+
+static std::string DirectoryOf(const std::string& file)
+{
+	size_t slash = file.find_last_of("/\\");
+	return slash == std::string::npos ? "" : file.substr(0, slash + 1);
+}
+
+ShaderWatcher::ShaderWatcher() : m_Notify(-1)
+{
+#ifndef _WIN32
+	m_Notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_Notify < 0)
+		std::cout << "Shader watcher: inotify unavailable, shaders will not reload" << std::endl;
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+#ifdef _WIN32
+	for (std::unique_ptr<Directory>& directory : m_Directories)
+	{
+		// the pending read writes into the buffer, it has to finish before the buffer goes
+		DWORD bytes;
+		CancelIo(directory->handle);
+		GetOverlappedResult(directory->handle, &directory->overlapped, &bytes, TRUE);
+		CloseHandle(directory->handle);
+		CloseHandle(directory->overlapped.hEvent);
+	}
+#else
+	if (m_Notify >= 0)
+		close(m_Notify);
+#endif
+}
+
+void ShaderWatcher::Add(Shader& shader)
+{
+	m_Shaders.push_back(&shader);
+	WatchFiles(shader);
+}
+
+void ShaderWatcher::WatchFiles(const Shader& shader)
+{
+	for (const std::string& file : shader.GetFiles())
+		WatchDirectory(DirectoryOf(file));
+}
+
+void ShaderWatcher::WatchDirectory(const std::string& path)
+{
+	for (const std::unique_ptr<Directory>& directory : m_Directories)
+	{
+		if (directory->path == path)
+			return;
+	}
+
+	std::unique_ptr<Directory> directory(new Directory());
+	directory->path = path;
+	const char* name = path.empty() ? "." : path.c_str();
+#ifdef _WIN32
+	directory->handle = CreateFileA(name, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+	if (directory->handle == INVALID_HANDLE_VALUE)
+	{
+		std::cout << "Shader watcher: unable to watch " << name << std::endl;
+		return;
+	}
+	directory->overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (!QueueRead(*directory))
+	{
+		std::cout << "Shader watcher: unable to watch " << name << std::endl;
+		CloseHandle(directory->handle);
+		CloseHandle(directory->overlapped.hEvent);
+		return;
+	}
+#else
+	if (m_Notify < 0)
+		return;
+	// the same directory under two names shares one watch descriptor, ReadChanges reports it under both
+	directory->watch = inotify_add_watch(m_Notify, name, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (directory->watch < 0)
+	{
+		std::cout << "Shader watcher: unable to watch " << name << std::endl;
+		return;
+	}
+#endif
+	m_Directories.push_back(std::move(directory));
+}
+
+#ifdef _WIN32
+bool ShaderWatcher::QueueRead(Directory& directory)
+{
+	return ReadDirectoryChangesW(directory.handle, directory.buffer, sizeof(directory.buffer), FALSE,
+		FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE, NULL, &directory.overlapped, NULL) != 0;
+}
+#endif
+
+void ShaderWatcher::ReadChanges(std::vector<std::string>& files)
+{
+	// a queue that overflowed lost which files changed, every watched one counts as changed then
+	bool overflow = false;
+#ifdef _WIN32
+	for (std::unique_ptr<Directory>& directory : m_Directories)
+	{
+		DWORD bytes = 0;
+		if (!GetOverlappedResult(directory->handle, &directory->overlapped, &bytes, FALSE))
+			continue; // still waiting, ERROR_IO_INCOMPLETE
+
+		if (bytes == 0)
+			overflow = true;
+		const unsigned char* record = (const unsigned char*)directory->buffer;
+		while (bytes > 0)
+		{
+			const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)record;
+			int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, (int)(info->FileNameLength / sizeof(WCHAR)), NULL, 0, NULL, NULL);
+			std::string name(length, '\0');
+			WideCharToMultiByte(CP_UTF8, 0, info->FileName, (int)(info->FileNameLength / sizeof(WCHAR)), &name[0], length, NULL, NULL);
+			files.push_back(directory->path + name);
+			if (info->NextEntryOffset == 0)
+				break;
+			record += info->NextEntryOffset;
+		}
+		QueueRead(*directory);
+	}
+#else
+	if (m_Notify < 0)
+		return;
+
+	alignas(struct inotify_event) char buffer[4096];
+	for (;;)
+	{
+		ssize_t length = read(m_Notify, buffer, sizeof(buffer));
+		if (length <= 0)
+			break; // EAGAIN, nothing more queued
+		for (char* record = buffer; record < buffer + length; )
+		{
+			const struct inotify_event* event = (const struct inotify_event*)record;
+			if (event->mask & IN_Q_OVERFLOW)
+				overflow = true;
+			for (const std::unique_ptr<Directory>& directory : m_Directories)
+			{
+				if (event->len > 0 && directory->watch == event->wd)
+					files.push_back(directory->path + event->name);
+			}
+			record += sizeof(struct inotify_event) + event->len;
+		}
+	}
+#endif
+
+	if (overflow)
+	{
+		for (const Shader* shader : m_Shaders)
+			files.insert(files.end(), shader->GetFiles().begin(), shader->GetFiles().end());
+	}
+}
+
+unsigned int ShaderWatcher::Poll()
+{
+	std::vector<std::string> changed;
+	ReadChanges(changed);
+	auto now = std::chrono::steady_clock::now();
+	for (const std::string& file : changed)
+		m_Pending[file] = now;
+
+	std::vector<std::string> settled;
+	for (auto pending = m_Pending.begin(); pending != m_Pending.end(); )
+	{
+		if (now - pending->second >= std::chrono::milliseconds(SHADER_SETTLE_MS))
+		{
+			settled.push_back(pending->first);
+			pending = m_Pending.erase(pending);
+		}
+		else
+		{
+			++pending;
+		}
+	}
+	if (settled.empty())
+		return 0;
+
+	unsigned int reloaded = 0;
+	for (Shader* shader : m_Shaders)
+	{
+		const std::vector<std::string>& files = shader->GetFiles();
+		bool affected = std::any_of(files.begin(), files.end(), [&settled](const std::string& file)
+		{
+			return std::find(settled.begin(), settled.end(), file) != settled.end();
+		});
+		if (!affected)
+			continue;
+
+		bool succeeded = shader->Reload();
+		m_Stats.reloads++;
+		if (!succeeded)
+			m_Stats.failures++;
+		m_Stats.lastShader = shader->GetFilePath();
+		m_Stats.lastSucceeded = succeeded;
+		m_Stats.lastCompileMs = shader->GetBuildStats().compileMs;
+		m_Stats.lastLinkMs = shader->GetBuildStats().linkMs;
+		reloaded++;
+
+		// the edit may have added an include from somewhere new
+		WatchFiles(*shader);
+	}
+	return reloaded;
+}
+
+unsigned int ShaderWatcher::GetShaderCount() const
+{
+	return (unsigned int)m_Shaders.size();
+}
+
+const ShaderReloadStats& ShaderWatcher::GetStats() const
+{
+	return m_Stats;
+}
@@ -6,7 +6,24 @@
 #include "IMGUI/imgui_impl_glfw_gl3.h"
 
 #include "Shader.h"
+#include "ShaderWatcher.h"
 #include "Camera.h"
+#include "Headless.h"
+#include "IBLCache.h"
+#include "IBLBaker.h"
+#include "SphericalHarmonics.h"
+#include "Material.h"
+#include "Renderer.h"
+#include "InstanceBuffer.h"
+#include "UniformBuffer.h"
+#include "TextureBatch.h"
+#include "TextureStreamer.h"
+#include "TextureCompressor.h"
+#include "LodSelector.h"
+#include "SceneBVH.h"
+#include "ThreadPool.h"
+#include "TransformSystem.h"
+#include <chrono>
 
 #include <GLM/glm.hpp>
 #include <GLM/gtc/matrix_transform.hpp>
@@ -14,17 +31,72 @@
 
 #include <iostream>
 #include <map>
+#include <algorithm>
+#include <cstdlib>
 
-const unsigned int SCR_WIDTH = 1200;
-const unsigned int SCR_HEIGHT = 695;
+// window size, --width / --height replace it in headless mode
+unsigned int SCR_WIDTH = 1200;
+unsigned int SCR_HEIGHT = 695;
 
 // Uniforms
 glm::vec3 albedoF(0.5f, 0.0f, 0.0f);
 glm::vec3 lightPos(0.0f, 0.0f, -20.0f);
 float aoF = 1.0f;
+bool useSHIrradiance = false;
+
+// Instancing
+const unsigned int INSTANCE_LOCATION = 3; // first attribute location of InstanceData in PBR.shader
+int stressCount = 0;
+bool stressInstanced = true;
+
+// Sphere levels of detail, the same UV sphere at SPHERE_SEGMENTS and then half the segments each level;
+// a sphere draws the coarsest level whose error stays under lodThreshold pixels, --no-lod keeps full detail
+const unsigned int SPHERE_SEGMENTS = 128;
+const unsigned int SPHERE_LODS = 5;
+bool useLod = true;
+float lodThreshold = 1.0f;
+float lodHysteresis = 0.25f;
+
+// Culling, one BVH over the gallery, grid and stress spheres and only those touching the view frustum
+// are drawn; --cull-benchmark [count] times the BVH alone
+bool useCulling = true;
+
+// Transforms of the grid and stress spheres, the grid hangs off one root turned by gridRotation (degrees)
+// and only what moved is recomputed; --transform-benchmark [count] times the update alone
+float gridRotation = 0.0f;
+
+// Visible instances of a sphere set split by level, one instance buffer per level so each is a plain instanced draw
+struct SphereLodSet
+{
+	std::vector<unsigned int> levels;  // drawn last frame, per instance
+	std::vector<unsigned int> visible; // instances the buffers hold
+	std::vector<InstanceData> buckets[SPHERE_LODS];
+	InstanceBuffer buffers[SPHERE_LODS];
+	bool bucketed = false; // buffers match levels
+};
+
+// Uniform blocks, laid out std140 to match the shaders
+const unsigned int CAMERA_BINDING = 0;
+const unsigned int LIGHTS_BINDING = 1;
+const unsigned int SH_BINDING = 2;
+const unsigned int NR_LIGHTS = 5;
+
+struct CameraUniforms
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 viewPos;
+};
+
+struct LightUniforms
+{
+	glm::vec4 positions[NR_LIGHTS];
+	glm::vec4 colors[NR_LIGHTS];
+};
 
 // Camera
 Camera camera(glm::vec3(0.0f, 0.5f, 5.0f));
+Headless headless;
 float lastX = (float)SCR_WIDTH / 2.0;
 float lastY = (float)SCR_HEIGHT / 2.0;
 bool firstMouse = true;
@@ -33,24 +105,74 @@ bool mouseActive = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// Texture loading, --texture-threads N limits the decode pool (0 uses every hardware thread)
+unsigned int textureThreads = 0;
+// Textures stream in over the first frames, --no-stream loads them all before the first frame (always the case headless)
+bool streamTextures = true;
+int streamBudgetMB = 8;
+
+// Environment
+const std::string hdrPath = "res/skyboxes/Tropical_Beach/Tropical_Beach_3k.hdr";
+//const std::string hdrPath = "res/skyboxes/Shiodome_Stairs/10-Shiodome_Stairs_3k.hdr";
+//const std::string hdrPath = "res/skyboxes/Ridgecrest_Road/Ridgecrest_Road_Ref.hdr";
+//const std::string hdrPath = "res/skyboxes/Barcelona_Rooftops/Barce_Rooftop_C_3k.hdr";
+
+// Textures, --compress-textures [bc1] writes a block-compressed .dds next to each of them
+const std::string materialPath = "res/materials/Gallery.material";
+const std::string sandTextures[] = { "res/textures/sand/albedo.jpg", "res/textures/sand/ao.jpg", "res/textures/sand/normal.jpg" };
+
 GLFWwindow* InitWindow();
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-unsigned int loadTexture(const char* path, bool gammaCorrection);
-void renderSphere();
+void createSphere();
+std::vector<InstanceData> CreateStressInstances(int count);
+unsigned int SelectSphereLod(const LodSelector& selector, const glm::mat4& model, unsigned int current);
+void SelectSphereLods(const LodSelector& selector, const std::vector<InstanceData>& instances, const std::vector<unsigned int>& visible, SphereLodSet& set, bool bucket);
+void renderSphere(unsigned int lod = 0);
 void renderCube();
 void renderQuad();
 void renderQuadNormal();
 
-unsigned int sphereVAO = 0, indexCount;
+RenderMesh sphereLods[SPHERE_LODS] = {};
+float sphereLodErrors[SPHERE_LODS];       // unit sphere, the depth of the widest facet's middle below the surface
+unsigned int sphereLodTriangles[SPHERE_LODS];
 unsigned int cubeVAO = 0, cubeVBO;
 unsigned int quadVAO = 0, quadVBO;
 unsigned int quadNormalVAO = 0, quadNormalVBO;
 
-int main()
+int main(int argc, char** argv)
 {
+	// CPU IBL baking, runs without a window or GL context
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--bake")
+			return RunIBLBake(hdrPath);
+		if (arg == "--bake-compare")
+			return RunIBLBakeCompare(hdrPath);
+		if (arg == "--bake-benchmark")
+			return RunIBLBakeBenchmark(hdrPath);
+		if (arg == "--compress-textures")
+		{
+			std::vector<std::string> paths = MaterialLibrary::ReadTexturePaths(materialPath);
+			paths.insert(paths.end(), std::begin(sandTextures), std::end(sandTextures));
+			return RunTextureCompress(paths, i + 1 < argc && std::string(argv[i + 1]) == "bc1");
+		}
+		if (arg == "--texture-threads" && i + 1 < argc)
+			textureThreads = (unsigned int)std::max(0, std::atoi(argv[++i]));
+		if (arg == "--no-stream")
+			streamTextures = false;
+		if (arg == "--no-lod")
+			useLod = false;
+		if (arg == "--cull-benchmark")
+			return RunCullBenchmark(i + 1 < argc ? (unsigned int)std::max(1, std::atoi(argv[i + 1])) : 100000);
+		if (arg == "--transform-benchmark")
+			return RunTransformBenchmark(i + 1 < argc ? (unsigned int)std::max(1, std::atoi(argv[i + 1])) : 1000000);
+	}
+
+	headless.ParseArguments(argc, argv, SCR_WIDTH, SCR_HEIGHT);
 	GLFWwindow* window = InitWindow();
 	if (!window)
 		return -1;
@@ -62,194 +184,227 @@ int main()
 	Shader prefilterShader("res/shaders/Prefilter.shader");
 	Shader brdfShader("res/shaders/BRDF.shader");
 	Shader backgroundShader("res/shaders/Background.shader");
-
-	// PBR: Setup Framebuffer
-	unsigned int captureFBO, captureRBO;
-	glGenFramebuffers(1, &captureFBO);
-	glGenRenderbuffers(1, &captureRBO);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
-
-	// PBR: Load the HDR environment map
-	stbi_set_flip_vertically_on_load(true);
-	int width, height, nrComponents;
-	float* data = stbi_loadf("res/skyboxes/Tropical_Beach/Tropical_Beach_3k.hdr", &width, &height, &nrComponents, 0);
-	//float* data = stbi_loadf("res/skyboxes/Shiodome_Stairs/10-Shiodome_Stairs_3k.hdr", &width, &height, &nrComponents, 0);
-	//float* data = stbi_loadf("res/skyboxes/Ridgecrest_Road/Ridgecrest_Road_Ref.hdr", &width, &height, &nrComponents, 0);
-	//float* data = stbi_loadf("res/skyboxes/Barcelona_Rooftops/Barce_Rooftop_C_3k.hdr", &width, &height, &nrComponents, 0);
-	unsigned int hdrTexture;
-	if (data)
+	ShaderStartupProfile shaderProfile = PrintShaderProfile({ &shader, &pbrShader, &cubemapShader, &irradianceShader,
+		&prefilterShader, &brdfShader, &backgroundShader });
+
+	// edited shaders are rebuilt at the top of the next frame without touching the IBL textures, a failed
+	// build keeps the last good program; the precompute shaders only run for a bake and are not watched
+	ShaderWatcher shaderWatcher;
+	shaderWatcher.Add(shader);
+	shaderWatcher.Add(pbrShader);
+	shaderWatcher.Add(backgroundShader);
+
+	// PBR: Load the precomputed IBL textures from disk, or run the precompute if the cache is missing or stale
+	IBLCache iblCache = IBLCache::ForEnvironment(hdrPath);
+
+	IBLTextures ibl;
+	unsigned int captureFBO = 0, captureRBO = 0;
+	unsigned int hdrTexture = 0;
+	unsigned int envCubemap, irradianceMap, prefilterMap, brdfLUTTexture;
+	if (iblCache.Load(ibl))
 	{
-		glGenTextures(1, &hdrTexture);
-		glBindTexture(GL_TEXTURE_2D, hdrTexture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
+		envCubemap = ibl.envCubemap;
+		irradianceMap = ibl.irradianceMap;
+		prefilterMap = ibl.prefilterMap;
+		brdfLUTTexture = ibl.brdfLUTTexture;
 	}
 	else
 	{
-		stbi_image_free(data);
-		std::cout << "Failed to load HDR image!" << std::endl;
-	}
+		// PBR: Setup Framebuffer
+		glGenFramebuffers(1, &captureFBO);
+		glGenRenderbuffers(1, &captureRBO);
 
-	// PBR: Setup cubemap to render and attach to framebuffer
-	unsigned int envCubemap;
-	glGenTextures(1, &envCubemap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-	for (unsigned int i = 0; i < 6; ++i)
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// PBR: Setup matrices for capturing data onto the cubemap faces
-	glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-	glm::mat4 captureViews[] =
-	{
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f))
-	};
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, ENVIRONMENT_SIZE, ENVIRONMENT_SIZE);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
+
+		// PBR: Load the HDR environment map
+		stbi_set_flip_vertically_on_load(true);
+		int width, height, nrComponents;
+		float* data = stbi_loadf(hdrPath.c_str(), &width, &height, &nrComponents, 0);
+		if (data)
+		{
+			glGenTextures(1, &hdrTexture);
+			glBindTexture(GL_TEXTURE_2D, hdrTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data);
 
-	// PBR: Convert HDR equirectangular environment map to cubemap equivalent
-	cubemapShader.Bind();
-	cubemapShader.SetUniform1i("equirectangularMap", 0);
-	cubemapShader.SetUniformMatrix4fv("projection", captureProjection);
-	
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, hdrTexture);
-	glViewport(0, 0, 512, 512); // configure viewport to capture dimensions
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-		for (unsigned int i = 0; i < 6; ++i)
+			stbi_image_free(data);
+		}
+		else
 		{
-			cubemapShader.SetUniformMatrix4fv("view", captureViews[i]);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			renderCube();
+			stbi_image_free(data);
+			std::cout << "Failed to load HDR image!" << std::endl;
 		}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// let OpenGL generate mipmaps from first mip face
-	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-	// PBR: Create an irradiance cubemap
-	unsigned int irradianceMap;
-	glGenTextures(1, &irradianceMap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-	for (unsigned int i = 0; i < 6; ++i)
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
-
-	// PBR: Solve diffuse integral by convolution to create an irradiance cubemap
-	irradianceShader.Bind();
-	irradianceShader.SetUniform1i("environmentMap", 0);
-	irradianceShader.SetUniformMatrix4fv("projection", captureProjection);
-	
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-	glViewport(0, 0, 32, 32);
-	
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+
+		// PBR: Setup cubemap to render and attach to framebuffer
+		glGenTextures(1, &envCubemap);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 		for (unsigned int i = 0; i < 6; ++i)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, ENVIRONMENT_SIZE, ENVIRONMENT_SIZE, 0, GL_RGB, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		// PBR: Setup matrices for capturing data onto the cubemap faces
+		glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+		glm::mat4 captureViews[] =
 		{
-			irradianceShader.SetUniformMatrix4fv("view", captureViews[i]);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			renderCube();
-		}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// PBR: Create pre-filter cubemap re-scaling captureFBO to pre-filter scale
-	unsigned int prefilterMap;
-	glGenTextures(1, &prefilterMap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-	for (unsigned int i = 0; i < 6; ++i)
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, nullptr);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-	// PBR: run quasi monte-carlo simulation on environment lighting to create a prefilter cubemap
-	prefilterShader.Bind();
-	prefilterShader.SetUniform1i("environmentMap", 0);
-	prefilterShader.SetUniformMatrix4fv("projection", captureProjection);
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	unsigned int maxMipLevels = 5;
-	for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
-	{
-		// resize framebuffer according to mip-level size
-		unsigned int mipWidth = 128 * std::pow(0.5, mip);
-		unsigned int mipHeight = 128 * std::pow(0.5, mip);
+			glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+			glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+			glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
+			glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
+			glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+			glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f))
+		};
+
+		// PBR: Convert HDR equirectangular environment map to cubemap equivalent
+		cubemapShader.Bind();
+		cubemapShader.SetUniform1i("equirectangularMap", 0);
+		cubemapShader.SetUniformMatrix4fv("projection", captureProjection);
+	
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, hdrTexture);
+		glViewport(0, 0, ENVIRONMENT_SIZE, ENVIRONMENT_SIZE); // configure viewport to capture dimensions
+
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				cubemapShader.SetUniformMatrix4fv("view", captureViews[i]);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				renderCube();
+			}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		// let OpenGL generate mipmaps from first mip face
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+		glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+		// PBR: Create an irradiance cubemap
+		glGenTextures(1, &irradianceMap);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+		for (unsigned int i = 0; i < 6; ++i)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, IRRADIANCE_SIZE, IRRADIANCE_SIZE, 0, GL_RGB, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
 		glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-		glViewport(0, 0,  mipWidth, mipHeight);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, IRRADIANCE_SIZE, IRRADIANCE_SIZE);
 
-		float roughness = (float)mip / (float)(maxMipLevels - 1);
-		prefilterShader.SetUniform1f("roughness", roughness);
+		// PBR: Solve diffuse integral by convolution to create an irradiance cubemap
+		irradianceShader.Bind();
+		irradianceShader.SetUniform1i("environmentMap", 0);
+		irradianceShader.SetUniformMatrix4fv("projection", captureProjection);
+	
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+		glViewport(0, 0, IRRADIANCE_SIZE, IRRADIANCE_SIZE);
+	
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				irradianceShader.SetUniformMatrix4fv("view", captureViews[i]);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				renderCube();
+			}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		// PBR: Create pre-filter cubemap re-scaling captureFBO to pre-filter scale
+		glGenTextures(1, &prefilterMap);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
 		for (unsigned int i = 0; i < 6; ++i)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, PREFILTER_SIZE, PREFILTER_SIZE, 0, GL_RGB, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+		// PBR: run quasi monte-carlo simulation on environment lighting to create a prefilter cubemap
+		prefilterShader.Bind();
+		prefilterShader.SetUniform1i("environmentMap", 0);
+		prefilterShader.SetUniformMatrix4fv("projection", captureProjection);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+		unsigned int maxMipLevels = PREFILTER_MIP_LEVELS;
+		for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
 		{
-			prefilterShader.SetUniformMatrix4fv("view", captureViews[i]);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			renderCube();
+			// resize framebuffer according to mip-level size
+			unsigned int mipWidth = PREFILTER_SIZE * std::pow(0.5, mip);
+			unsigned int mipHeight = PREFILTER_SIZE * std::pow(0.5, mip);
+			glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
+			glViewport(0, 0,  mipWidth, mipHeight);
+
+			float roughness = (float)mip / (float)(maxMipLevels - 1);
+			prefilterShader.SetUniform1f("roughness", roughness);
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				prefilterShader.SetUniformMatrix4fv("view", captureViews[i]);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				renderCube();
+			}
 		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		// PBR: Generate 2D LUT from BRDF equations used
+		glGenTextures(1, &brdfLUTTexture);
+		// pre-allocate enough memory for the LUT texture
+		glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, BRDF_LUT_SIZE, BRDF_LUT_SIZE, 0, GL_RG, GL_FLOAT, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		// re-configure captureFBO and render screen-space quad wth BRDF shader
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, BRDF_LUT_SIZE, BRDF_LUT_SIZE);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
+
+		glViewport(0, 0, BRDF_LUT_SIZE, BRDF_LUT_SIZE);
+		brdfShader.Bind();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		renderQuad();
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		ibl.envCubemap = envCubemap;
+		ibl.irradianceMap = irradianceMap;
+		ibl.prefilterMap = prefilterMap;
+		ibl.brdfLUTTexture = brdfLUTTexture;
+		if (hdrTexture != 0)
+			iblCache.Save(ibl);
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// PBR: Generate 2D LUT from BRDF equations used
-	unsigned int brdfLUTTexture;
-	glGenTextures(1, &brdfLUTTexture);
-	// pre-allocate enough memory for the LUT texture
-	glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 512, 512, 0, GL_RG, GL_FLOAT, 0);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// re-configure captureFBO and render screen-space quad wth BRDF shader
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
-
-	glViewport(0, 0, 512, 512);
-	brdfShader.Bind();
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	renderQuad();
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// PBR: Project the environment onto L2 spherical harmonics and compare them against the irradiance map
+	auto shStart = std::chrono::high_resolution_clock::now();
+	unsigned int shSourceLevel = 0;
+	while ((ENVIRONMENT_SIZE >> (shSourceLevel + 1)) >= SH_SOURCE_SIZE)
+		++shSourceLevel;
+	SHIrradiance shIrradiance = SphericalHarmonics::Project(SphericalHarmonics::ReadCubemap(envCubemap, shSourceLevel));
+	float shProjectMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - shStart).count();
+
+	SHComparison shComparison = SphericalHarmonics::Compare(shIrradiance, SphericalHarmonics::ReadCubemap(irradianceMap, 0));
+	std::cout << "SH irradiance: projected in " << shProjectMs << " ms, mean relative error "
+		<< shComparison.meanRelativeError * 100.0f << "%, max " << shComparison.maxRelativeError * 100.0f << "% vs irradiance map" << std::endl;
 
 	// Load textures
 	stbi_set_flip_vertically_on_load(false);
@@ -259,9 +414,23 @@ int main()
 	shader.SetUniform1i("specularMap", 1);
 	shader.SetUniform1i("normalMap", 2);
 	
-	unsigned int sandAlbedo = loadTexture("res/textures/sand/albedo.jpg", true);
-	unsigned int sandSpecular = loadTexture("res/textures/sand/ao.jpg", true);
-	unsigned int sandNormal = loadTexture("res/textures/sand/normal.jpg", true);
+	// every file is decoded in parallel, the names below are valid straight away. Streamed textures show a
+	// flat placeholder until their mips arrive; captures need final pixels on frame one so they use the batch.
+	if (headless.IsEnabled())
+		streamTextures = false;
+	std::unique_ptr<TextureStreamer> textureStreamer;
+	if (streamTextures)
+		textureStreamer.reset(new TextureStreamer((size_t)streamBudgetMB * 1024 * 1024, textureThreads));
+	TextureBatch textureBatch(textureThreads);
+	auto loadTexture = [&textureStreamer, &textureBatch](const std::string& path, bool gammaCorrection, int priority)
+	{
+		if (textureStreamer)
+			return textureStreamer->Request(path, gammaCorrection, priority);
+		return textureBatch.Add(path, gammaCorrection, priority);
+	};
+	unsigned int sandAlbedo = loadTexture(sandTextures[0], true, 0);
+	unsigned int sandSpecular = loadTexture(sandTextures[1], false, 0);
+	unsigned int sandNormal = loadTexture(sandTextures[2], false, 0);
 	
 	pbrShader.Bind();
 	pbrShader.SetUniform1i("irradianceMap", 0);
@@ -277,97 +446,58 @@ int main()
 	pbrShader.SetUniform3f("albedoF", albedoF);
 	pbrShader.SetUniform1f("aoF", aoF);
 
-	unsigned int goldAlbedo = loadTexture("res/textures/gold/albedo.png", true);
-	unsigned int goldNormal = loadTexture("res/textures/gold/normal.png", true);
-	unsigned int goldMetallic = loadTexture("res/textures/gold/metallic.png", true);
-	unsigned int goldRoughness = loadTexture("res/textures/gold/roughness.png", true);
-
-	unsigned int alienAlbedo = loadTexture("res/textures/alien_metal/albedo.png", true);
-	unsigned int alienNormal = loadTexture("res/textures/alien_metal/normal.png", true);
-	unsigned int alienMetallic = loadTexture("res/textures/alien_metal/metallic.png", true);
-	unsigned int alienRoughness = loadTexture("res/textures/alien_metal/roughness.png", true);
-	unsigned int alienAo = loadTexture("res/textures/alien_metal/ao.png", true);
-
-	unsigned int limestoneAlbedo = loadTexture("res/textures/limestone/albedo.png", true);
-	unsigned int limestoneNormal = loadTexture("res/textures/limestone/normal.png", true);
-	unsigned int limestoneMetallic = loadTexture("res/textures/limestone/metallic.png", true);
-	unsigned int limestoneRoughness = loadTexture("res/textures/limestone/roughness.png", true);
-	unsigned int limestoneAo = loadTexture("res/textures/limestone/ao.png", true);
-
-	unsigned int woodAlbedo = loadTexture("res/textures/wood/albedo.png", true);
-	unsigned int woodNormal = loadTexture("res/textures/wood/normal.png", true);
-	unsigned int woodMetallic = loadTexture("res/textures/wood/metallic.png", true);
-	unsigned int woodRoughness = loadTexture("res/textures/wood/roughness.png", true);
-	unsigned int woodAo = loadTexture("res/textures/wood/ao.png", true);
-
-	unsigned int graniteAlbedo = loadTexture("res/textures/granite/albedo.png", true);
-	unsigned int graniteNormal = loadTexture("res/textures/granite/normal.png", true);
-	unsigned int graniteMetallic = loadTexture("res/textures/granite/metallic.png", true);
-	unsigned int graniteRoughness = loadTexture("res/textures/granite/roughness.png", true);
-	unsigned int graniteAo = loadTexture("res/textures/granite/ao.png", true);
-
-	unsigned int titaniumAlbedo = loadTexture("res/textures/titanium_scuffed/albedo.png", true);
-	unsigned int titaniumNormal = loadTexture("res/textures/titanium_scuffed/normal.png", true);
-	unsigned int titaniumMetallic = loadTexture("res/textures/titanium_scuffed/metallic.png", true);
-	unsigned int titaniumRoughness = loadTexture("res/textures/titanium_scuffed/roughness.png", true);
-
-	unsigned int pirateAlbedo = loadTexture("res/textures/pirate_gold/albedo.png", true);
-	unsigned int pirateNormal = loadTexture("res/textures/pirate_gold/normal.png", true);
-	unsigned int pirateMetallic = loadTexture("res/textures/pirate_gold/metallic.png", true);
-	unsigned int pirateRoughness = loadTexture("res/textures/pirate_gold/roughness.png", true);
-	unsigned int pirateAo = loadTexture("res/textures/pirate_gold/ao.png", true);
-
-	unsigned int brickAlbedo = loadTexture("res/textures/bricks/albedo.png", true);
-	unsigned int brickNormal = loadTexture("res/textures/bricks/normal.png", true);
-	unsigned int brickMetallic = loadTexture("res/textures/bricks/metallic.psd", true);
-	//unsigned int brickRoughness = loadTexture("res/textures/bricks/roughness.png", true);
-	unsigned int brickAo = loadTexture("res/textures/bricks/ao.png", true);
-
-	unsigned int dustyAlbedo = loadTexture("res/textures/dusty/albedo.png", true);
-	unsigned int dustyNormal = loadTexture("res/textures/dusty/normal.png", true);
-	unsigned int dustyMetallic = loadTexture("res/textures/dusty/metallic.png", true);
-	unsigned int dustyRoughness = loadTexture("res/textures/dusty/roughness.png", true);
-	unsigned int dustyAo = loadTexture("res/textures/dusty/ao.png", true);
-
-	unsigned int grassAlbedo = loadTexture("res/textures/grass/albedo.png", true);
-	unsigned int grassNormal = loadTexture("res/textures/grass/normal.png", true);
-	unsigned int grassMetallic = loadTexture("res/textures/grass/metallic.png", true);
-	unsigned int grassRoughness = loadTexture("res/textures/grass/roughness.png", true);
-	unsigned int grassAo = loadTexture("res/textures/grass/ao.png", true);
-
-	unsigned int ironAlbedo = loadTexture("res/textures/iron/albedo.png", true);
-	unsigned int ironNormal = loadTexture("res/textures/iron/normal.png", true);
-	unsigned int ironMetallic = loadTexture("res/textures/iron/metallic.png", true);
-	unsigned int ironRoughness = loadTexture("res/textures/iron/roughness.png", true);
-
-	unsigned int paperAlbedo = loadTexture("res/textures/paper/albedo.png", true);
-	unsigned int paperNormal = loadTexture("res/textures/paper/normal.png", true);
-	unsigned int paperMetallic = loadTexture("res/textures/paper/metallic.psd", true);
-	//unsigned int paperRoughness = loadTexture("res/textures/paper/roughness.png", true);
-	unsigned int paperAo = loadTexture("res/textures/paper/ao.png", true);
-
-	unsigned int shoreAlbedo = loadTexture("res/textures/shoreline/albedo.png", true);
-	unsigned int shoreNormal = loadTexture("res/textures/shoreline/normal.png", true);
-	unsigned int shoreMetallic = loadTexture("res/textures/shoreline/metallic.png", true);
-	unsigned int shoreRoughness = loadTexture("res/textures/shoreline/roughness.png", true);
-	unsigned int shoreAo = loadTexture("res/textures/shoreline/ao.png", true);
-
-	unsigned int steelAlbedo = loadTexture("res/textures/steel/albedo.png", true);
-	unsigned int steelNormal = loadTexture("res/textures/steel/normal.png", true);
-	unsigned int steelMetallic = loadTexture("res/textures/steel/metallic.psd", true);
-	//unsigned int steelRoughness = loadTexture("res/textures/steel/roughness.png", true);
-	unsigned int steelAo = loadTexture("res/textures/steel/ao.png", true);
-
-	unsigned int barkAlbedo = loadTexture("res/textures/bark/albedo.png", true);
-	unsigned int barkNormal = loadTexture("res/textures/bark/normal.png", true);
-	unsigned int barkMetallic = loadTexture("res/textures/bark/metallic.png", true);
-	unsigned int barkRoughness = loadTexture("res/textures/bark/roughness.png", true);
-	unsigned int barkAo = loadTexture("res/textures/bark/ao.png", true);
+	// Materials for the sphere gallery
+	MaterialLibrary materials([&loadTexture](const std::string& path, bool gammaCorrection, int priority)
+	{
+		// only colour maps are sRGB, normal and scalar maps hold linear data (BC4 / BC5 have no sRGB form)
+		bool srgb = gammaCorrection && TextureCompressor::GetRole(path) == TEXTURE_ROLE_COLOR;
+		return loadTexture(path, srgb, priority);
+	});
+	materials.AddShader("pbr", pbrShader);
+	materials.Load(materialPath);
+
+	if (!textureStreamer)
+	{
+		textureBatch.Finish();
+		textureBatch.PrintReport();
+	}
+	const TextureBatchStats& textureStats = textureBatch.GetStats();
+
+	struct GalleryEntry
+	{
+		const char* material;
+		glm::vec3 position;
+	};
+	const GalleryEntry gallery[] = {
+		// left wall
+		{ "gold", glm::vec3(-10.0f, 0.0f, 2.5f) },
+		{ "alien_metal", glm::vec3(-10.0f, 0.0f, 5.0f) },
+		{ "limestone", glm::vec3(-10.0f, 0.0f, 7.5f) },
+		{ "wood", glm::vec3(-10.0f, 0.0f, 10.0f) },
+		{ "granite", glm::vec3(-10.0f, 0.0f, 12.5f) },
+		// back wall
+		{ "titanium", glm::vec3(-5.0f, 0.0f, 15.0f) },
+		{ "pirate_gold", glm::vec3(-2.5f, 0.0f, 15.0f) },
+		{ "bricks", glm::vec3(0.0f, 0.0f, 15.0f) },
+		{ "dusty", glm::vec3(2.5f, 0.0f, 15.0f) },
+		{ "grass", glm::vec3(5.0f, 0.0f, 15.0f) },
+		// right wall
+		{ "iron", glm::vec3(10.0f, 0.0f, 2.5f) },
+		{ "paper", glm::vec3(10.0f, 0.0f, 5.0f) },
+		{ "shoreline", glm::vec3(10.0f, 0.0f, 7.5f) },
+		{ "steel", glm::vec3(10.0f, 0.0f, 10.0f) },
+		{ "bark", glm::vec3(10.0f, 0.0f, 12.5f) }
+	};
+	const unsigned int galleryCount = sizeof(gallery) / sizeof(gallery[0]);
+
+	std::vector<Material*> galleryMaterials;
+	for (unsigned int i = 0; i < galleryCount; ++i)
+		galleryMaterials.push_back(materials.Get(gallery[i].material));
 
 	backgroundShader.Bind();
 	backgroundShader.SetUniform1i("environmentMap", 0);
 
-	glm::vec3 lightPositions[] = {
+	glm::vec3 lightPositions[NR_LIGHTS] = {
 		glm::vec3(-7.5f,  7.5f, 7.5f),
 		glm::vec3(7.5f,  7.5f, 7.5f),
 		glm::vec3(-7.5f, -7.5f, 7.5f),
@@ -375,7 +505,7 @@ int main()
 		glm::vec3(0.0f, 0.0f, -20.0f)
 	};
 
-	glm::vec3 lightColors[] = {
+	glm::vec3 lightColors[NR_LIGHTS] = {
 		glm::vec3(300.0f),
 		glm::vec3(300.0f),
 		glm::vec3(300.0f),
@@ -395,13 +525,79 @@ int main()
 	int nrColumns = 7;
 	float spacing = 2.5;
 
+	// untextured grid drawn as instances, metallic and roughness are per instance
+	Material* gridMaterial = materials.Get("untextured_instanced");
+	Material* stressMaterial = materials.Get("untextured");
+	Material* lightMaterial = materials.Get("light");
+
+	std::vector<InstanceData> instanceData;
+	std::vector<glm::vec3> gridOffsets; // from the grid's center, which sits at gridCenter
+	const glm::vec3 gridCenter(0.0f, 0.0f, -2.0f);
+	for (int row = 0; row < nrRows; ++row)
+	{
+		for (int col = 0; col < nrColumns; ++col)
+		{
+			InstanceData instance;
+			gridOffsets.push_back(glm::vec3(
+				(float)(col - (nrColumns / 2)) * spacing,
+				(float)(row - (nrRows / 2)) * spacing,
+				0.0f
+			));
+			instance.model = glm::translate(glm::mat4(1.0f), gridCenter + gridOffsets.back());
+			instance.params.x = (float)row / (float)nrRows;
+			instance.params.y = glm::clamp((float)col / (float)nrColumns, 0.05f, 1.0f);
+			instanceData.push_back(instance);
+		}
+	}
+	// uploaded split by level of detail, see SelectSphereLods
+	std::vector<InstanceData> gridData = instanceData;
+
+	InstanceBuffer lightInstances;
+	std::vector<InstanceData> stressData;
+	float submitMs = 0.0f;
+
+	// transform 0 is the grid's root, then one per grid sphere relative to it, then the stress spheres
+	ThreadPool workerPool;
+	TransformSystem sphereTransforms(&workerPool);
+	const unsigned int gridRoot = 0;
+	const unsigned int gridTransformBegin = 1, stressTransformBegin = gridTransformBegin + (unsigned int)gridData.size();
+	float appliedGridRotation = gridRotation;
+
+	Renderer renderer(INSTANCE_LOCATION);
+	createSphere();
+	LodSelector sphereLodSelector;
+	sphereLodSelector.SetErrors(std::vector<float>(sphereLodErrors, sphereLodErrors + SPHERE_LODS));
+	std::vector<unsigned int> galleryLods(galleryCount, 0);
+	SphereLodSet gridLods, stressLods;
+	unsigned int lodCounts[SPHERE_LODS] = {};
+	float lodSelectMs = 0.0f;
+
+	// object ids run through the gallery, then the grid, then the stress spheres; every sphere is
+	// a unit sphere moved by its model matrix, moved spheres are refit and only a new stress count rebuilds
+	BoundingBox sphereBox;
+	sphereBox.minimum = glm::vec3(-1.0f);
+	sphereBox.maximum = glm::vec3(1.0f);
+	SceneBVH sceneBVH;
+	std::vector<BoundingBox> sphereBoxes;
+	std::vector<unsigned int> visibleSpheres, galleryVisible, gridVisible, stressVisible;
+
 	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	shader.Bind();
-	shader.SetUniformMatrix4fv("projection", projection);
-	pbrShader.Bind();
-	pbrShader.SetUniformMatrix4fv("projection", projection);
-	backgroundShader.Bind();
-	backgroundShader.SetUniformMatrix4fv("projection", projection);
+
+	UniformBuffer cameraUniforms(sizeof(CameraUniforms), CAMERA_BINDING);
+	shader.BindUniformBlock("Camera", CAMERA_BINDING);
+	pbrShader.BindUniformBlock("Camera", CAMERA_BINDING);
+	backgroundShader.BindUniformBlock("Camera", CAMERA_BINDING);
+
+	UniformBuffer lightUniforms(sizeof(LightUniforms), LIGHTS_BINDING);
+	pbrShader.BindUniformBlock("Lights", LIGHTS_BINDING);
+
+	// the SH coefficients only change with the environment, written once
+	glm::vec4 shCoefficients[9];
+	for (unsigned int i = 0; i < 9; ++i)
+		shCoefficients[i] = glm::vec4(shIrradiance.coefficients[i], 0.0f);
+	UniformBuffer shUniforms(sizeof(shCoefficients), SH_BINDING);
+	shUniforms.SetData(shCoefficients, sizeof(shCoefficients));
+	pbrShader.BindUniformBlock("SHIrradiance", SH_BINDING);
 
 	// Configure  the viewport to the original framebuffer's screen dimensions
 	int scrWidth, scrHeight;
@@ -417,11 +613,16 @@ int main()
 	// Game Loop
 	while (!glfwWindowShouldClose(window))
 	{
-		float currentFrame = glfwGetTime();
+		float currentFrame = headless.GetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		processInput(window);
+		headless.UpdateCamera(camera);
+		shaderWatcher.Poll();
+
+		if (textureStreamer)
+			textureStreamer->Update();
 
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -431,10 +632,15 @@ int main()
 		glm::mat4 view = camera.GetViewMatrix();
 		glm::mat4 model = glm::mat4(1.0f);
 
+		CameraUniforms cameraData;
+		cameraData.projection = projection;
+		cameraData.view = view;
+		cameraData.viewPos = glm::vec4(camera.Position, 1.0f);
+		cameraUniforms.SetData(&cameraData, sizeof(cameraData));
+
 		// 0 - Render floor and point light
+		headless.BeginPass("Floor");
 		shader.Bind();
-		shader.SetUniformMatrix4fv("view", view);
-		shader.SetUniform3f("viewPos", camera.Position);
 		shader.SetUniform3f("lightPos", lightPos);
 
 		glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, sandAlbedo);
@@ -446,256 +652,172 @@ int main()
 		model = glm::scale(model, glm::vec3(200.0f, 200.0f, 200.0f));
 		shader.SetUniformMatrix4fv("model", model);
 		renderQuadNormal();
+		headless.EndPass();
 
 		// 0.5 - Setup uniforms and IBL textures
 		pbrShader.Bind();
-		pbrShader.SetUniformMatrix4fv("view", view);
-		pbrShader.SetUniform3f("viewPos", camera.Position);
 		pbrShader.SetUniform3f("albedoF", albedoF);
 		pbrShader.SetUniform1f("aoF", aoF);
-		pbrShader.SetUniform1i("lightSource", 0);
+		pbrShader.SetUniform1i("shIrradiance", useSHIrradiance);
 
-		glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+		glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_CUBE_MAP, useSHIrradiance ? 0 : irradianceMap);
 		glActiveTexture(GL_TEXTURE1); glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
 		glActiveTexture(GL_TEXTURE2); glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
 
-		// 1.0 - Render textured spheres
-			// left wall
-				// gold
-		pbrShader.SetUniform1i("aoTexture", 0);
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, goldAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, goldNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, goldMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, goldRoughness);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-10.0f, 0.0f, 2.5f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-				// alien metal
-		pbrShader.SetUniform1i("aoTexture", 1);
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, alienAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, alienNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, alienMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, alienRoughness);
-		glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, alienAo);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-10.0f, 0.0f, 5.0f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-				// limestone
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, limestoneAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, limestoneNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, limestoneMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, limestoneRoughness);
-		glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, limestoneAo);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-10.0f, 0.0f, 7.5f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-				// wood
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, woodAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, woodNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, woodMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, woodRoughness);
-		glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, woodAo);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-10.0f, 0.0f, 10.0f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-				// granite
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, graniteAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, graniteNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, graniteMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, graniteRoughness);
-		glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, graniteAo);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-10.0f, 0.0f, 12.5f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-			//back wall
-				// titanium
-		pbrShader.SetUniform1i("aoTexture", 0);
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, titaniumAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, titaniumNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, titaniumMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, titaniumRoughness);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-5.0f, 0.0f, 15.0f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-				// pirate gold
-		pbrShader.SetUniform1i("aoTexture", 1);
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, pirateAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, pirateNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, pirateMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, pirateRoughness);
-		glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, pirateAo);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-2.5f, 0.0f, 15.0f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-				// bricks
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, brickAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, brickNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, brickMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, 0);
-		glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, brickAo);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, 0.0f, 15.0f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-				// dusty
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, dustyAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, dustyNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, dustyMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, dustyRoughness);
-		glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, dustyAo);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(2.5f, 0.0f, 15.0f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-				// grass
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, grassAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, grassNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, grassMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, grassRoughness);
-		glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, grassAo);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(5.0f, 0.0f, 15.0f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-			// right wall
-				// iron
-		pbrShader.SetUniform1i("aoTexture", 0);
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, ironAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, ironNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, ironMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, ironRoughness);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(10.0f, 0.0f, 2.5f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-				// paper
-		pbrShader.SetUniform1i("aoTexture", 1);
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, paperAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, paperNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, paperMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, 0);
-		glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, paperAo);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(10.0f, 0.0f, 5.0f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-				// shore
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, shoreAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, shoreNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, shoreMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, shoreRoughness);
-		glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, shoreAo);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(10.0f, 0.0f, 7.5f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-				// steel
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, steelAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, steelNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, steelMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, 0);
-		glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, steelAo);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(10.0f, 0.0f, 10.0f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-				// bark
-		glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, barkAlbedo);
-		glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, barkNormal);
-		glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, barkMetallic);
-		glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, barkRoughness);
-		glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, barkAo);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(10.0f, 0.0f, 12.5f));
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
-
-		// 2.0 - render rows * columns of spheres
-		pbrShader.SetUniform1i("texture_none", 1);
-		for (int row = 0; row < nrRows; ++row)
-		{	
-			pbrShader.SetUniform1f("metallicF", (float)row / (float)nrRows);
-			for (int col = 0; col < nrColumns; ++col)
-			{
-				pbrShader.SetUniform1f("roughnessF", glm::clamp((float)col / (float)nrColumns, 0.05f, 1.0f));
-
-				model = glm::mat4(1.0f);
-				model = glm::translate(model, glm::vec3(
-					(float)(col - (nrColumns / 2)) * spacing,
-					(float)(row - (nrRows / 2)) * spacing,
-					-2.0f
-				));
-				pbrShader.SetUniformMatrix4fv("model", model);
-				renderSphere();
-			}
-		}
-		pbrShader.SetUniform1i("texture_none", 0);
+		// 1.0 - Update lights before any sphere is shaded
+		auto submitStart = std::chrono::high_resolution_clock::now();
+		renderer.BeginFrame();
 
-		// 3.0 - render light sources
-		pbrShader.SetUniform1i("lightSource", 1);
-		for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+		instanceData.clear();
+		LightUniforms lightData;
+		for (unsigned int i = 0; i < NR_LIGHTS; ++i)
 		{
-			glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
+			glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(currentFrame * 5.0) * 5.0, 0.0, 0.0);
 			newPos = lightPositions[i];
-			pbrShader.SetUniform3f("lightPositions[" + std::to_string(i) + "]", newPos);
-			pbrShader.SetUniform3f("lightColors[" + std::to_string(i) + "]", lightColors[i]);
-
-			model = glm::mat4(1.0f);
-			model = glm::translate(model, newPos);
-			model = glm::scale(model, glm::vec3(0.5f));
-			pbrShader.SetUniformMatrix4fv("model", model);
-			renderSphere();
+			lightData.positions[i] = glm::vec4(newPos, 1.0f);
+			lightData.colors[i] = glm::vec4(lightColors[i], 1.0f);
+
+			InstanceData instance;
+			instance.model = glm::translate(glm::mat4(1.0f), newPos);
+			instance.model = glm::scale(instance.model, glm::vec3(0.5f));
+			instance.color = glm::vec4(lightColors[i], 1.0f);
+			instanceData.push_back(instance);
+		}
+
+		InstanceData lightInstance;
+		lightInstance.model = glm::translate(glm::mat4(1.0f), lightPos);
+		lightInstance.color = glm::vec4(lightColors[0], 1.0f);
+		instanceData.push_back(lightInstance);
+
+		lightUniforms.SetData(&lightData, sizeof(lightData));
+		lightInstances.Upload(instanceData);
+		if (lightMaterial)
+			renderer.SubmitInstanced(*lightMaterial, sphereLods[0], lightInstances);
+
+		// 1.5 - Levels of detail for every sphere below, starting from the level each drew last frame
+		auto lodStart = std::chrono::high_resolution_clock::now();
+		sphereLodSelector.SetProjection(glm::radians(camera.Zoom), (float)SCR_HEIGHT, 0.1f);
+		sphereLodSelector.SetThreshold(lodThreshold, lodHysteresis);
+		bool spheresChanged = stressData.size() != (size_t)stressCount || sceneBVH.GetObjectCount() == 0;
+		if (spheresChanged)
+		{
+			stressData = CreateStressInstances(stressCount);
+			sphereTransforms.Clear();
+			sphereTransforms.Create(gridCenter, glm::angleAxis(glm::radians(gridRotation), glm::vec3(0.0f, 1.0f, 0.0f)));
+			for (const glm::vec3& offset : gridOffsets)
+				sphereTransforms.Create(offset, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f), gridRoot);
+			for (const InstanceData& instance : stressData)
+				sphereTransforms.Create(glm::vec3(instance.model[3]), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.3f));
+			appliedGridRotation = gridRotation;
+		}
+		else if (gridRotation != appliedGridRotation)
+		{
+			sphereTransforms.SetRotation(gridRoot, glm::angleAxis(glm::radians(gridRotation), glm::vec3(0.0f, 1.0f, 0.0f)));
+			appliedGridRotation = gridRotation;
+		}
+		sphereTransforms.Update();
+		if (sphereTransforms.GetStats().updated > 0)
+		{
+			const std::vector<glm::mat4>& worlds = sphereTransforms.GetWorldMatrices();
+			for (unsigned int i = 0; i < gridData.size(); ++i)
+				gridData[i].model = worlds[gridTransformBegin + i];
+			for (unsigned int i = 0; i < stressData.size(); ++i)
+				stressData[i].model = worlds[stressTransformBegin + i];
+			sphereBoxes.clear();
+			for (unsigned int i = 0; i < galleryCount; ++i)
+				sphereBoxes.push_back(TransformBoundingBox(sphereBox, glm::translate(glm::mat4(1.0f), gallery[i].position)));
+			for (const InstanceData& instance : gridData)
+				sphereBoxes.push_back(TransformBoundingBox(sphereBox, instance.model));
+			for (const InstanceData& instance : stressData)
+				sphereBoxes.push_back(TransformBoundingBox(sphereBox, instance.model));
+			if (spheresChanged)
+				sceneBVH.Build(sphereBoxes);
+			else
+				sceneBVH.Refit(sphereBoxes);
+			// the instance buffers hold the old matrices
+			gridLods.bucketed = false;
+			stressLods.bucketed = false;
+		}
+		if (useCulling)
+		{
+			sceneBVH.Cull(ExtractFrustum(projection * view), visibleSpheres);
+		}
+		else
+		{
+			visibleSpheres.resize(sphereBoxes.size());
+			for (unsigned int i = 0; i < sphereBoxes.size(); ++i)
+				visibleSpheres[i] = i;
+		}
+		galleryVisible.clear();
+		gridVisible.clear();
+		stressVisible.clear();
+		unsigned int gridBegin = galleryCount, stressBegin = galleryCount + (unsigned int)gridData.size();
+		for (unsigned int id : visibleSpheres)
+		{
+			if (id < gridBegin)
+				galleryVisible.push_back(id);
+			else if (id < stressBegin)
+				gridVisible.push_back(id - gridBegin);
+			else
+				stressVisible.push_back(id - stressBegin);
+		}
+
+		for (unsigned int i : galleryVisible)
+			galleryLods[i] = SelectSphereLod(sphereLodSelector, glm::translate(glm::mat4(1.0f), gallery[i].position), galleryLods[i]);
+		SelectSphereLods(sphereLodSelector, gridData, gridVisible, gridLods, true);
+		SelectSphereLods(sphereLodSelector, stressData, stressVisible, stressLods, stressInstanced);
+		std::fill(lodCounts, lodCounts + SPHERE_LODS, 0);
+		for (unsigned int i : galleryVisible)
+			++lodCounts[galleryLods[i]];
+		for (unsigned int i : gridVisible)
+			++lodCounts[gridLods.levels[i]];
+		for (unsigned int i : stressVisible)
+			++lodCounts[stressLods.levels[i]];
+		lodSelectMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - lodStart).count();
+
+		// 2.0 - Textured sphere gallery
+		for (unsigned int i : galleryVisible)
+		{
+			if (galleryMaterials[i])
+				renderer.Submit(*galleryMaterials[i], sphereLods[galleryLods[i]], glm::translate(glm::mat4(1.0f), gallery[i].position));
+		}
+
+		// 3.0 - rows * columns of untextured spheres
+		if (gridMaterial)
+		{
+			for (unsigned int lod = 0; lod < SPHERE_LODS; ++lod)
+				renderer.SubmitInstanced(*gridMaterial, sphereLods[lod], gridLods.buffers[lod]);
+		}
+
+		// 3.5 - Stress test, a cube of extra spheres drawn instanced or one draw each
+		if (stressCount > 0)
+		{
+			if (stressInstanced && gridMaterial)
+			{
+				for (unsigned int lod = 0; lod < SPHERE_LODS; ++lod)
+					renderer.SubmitInstanced(*gridMaterial, sphereLods[lod], stressLods.buffers[lod]);
+			}
+			else if (!stressInstanced && stressMaterial)
+			{
+				for (unsigned int i : stressVisible)
+					renderer.Submit(*stressMaterial, sphereLods[stressLods.levels[i]], stressData[i].model);
+			}
 		}
 
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, lightPos);
-		pbrShader.SetUniformMatrix4fv("model", model);
-		renderSphere();
+		headless.BeginPass("Spheres");
+		renderer.Flush();
+		headless.EndPass();
+		submitMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - submitStart).count();
 
 		// 4.0 - render cubemap
+		headless.BeginPass("Background");
 		backgroundShader.Bind();
-		backgroundShader.SetUniformMatrix4fv("view", view);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 		//glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap); // display irradiance map
 		//glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap); // display prefilter map
 		renderCube();
+		headless.EndPass();
 
 		// render BRDF map to screen
 		//brdfShader.Bind();
@@ -708,6 +830,61 @@ int main()
 			{
 				ImGui::SliderFloat3("Albedo", &albedoF.x, 0.0f, 1.0f, "%.1f", 1);
 				ImGui::SliderFloat("AO", &aoF, 0.0f, 1.0f, "%.1f", 1);
+				ImGui::Checkbox("SH Irradiance", &useSHIrradiance);
+				ImGui::Text("SH vs Irradiance Map: mean error %.2f%% / max %.2f%%", shComparison.meanRelativeError * 100.0f, shComparison.maxRelativeError * 100.0f);
+			}
+
+			if (ImGui::CollapsingHeader("Renderer"))
+			{
+				const RenderStats& stats = renderer.GetStats();
+				ImGui::Text("Materials: %d / Textures: %d", (int)materials.GetMaterialCount(), (int)materials.GetTextureCount());
+				ImGui::Text("Draw Calls: %u", stats.drawCalls);
+				ImGui::Text("Shader Binds: %u", stats.shaderBinds);
+				ImGui::Text("Material Binds: %u", stats.materialBinds);
+				ImGui::Text("Texture Binds: %u (%u redundant skipped)", stats.textureBinds, stats.texturesSkipped);
+				ImGui::Text("VAO Binds: %u", stats.vertexArrayBinds);
+				ImGui::Text("Instances: %u", stats.instances);
+				const ShaderReloadStats& reloadStats = shaderWatcher.GetStats();
+				if (reloadStats.reloads > 0)
+					ImGui::Text("Shader Reload: %s %s (compile %.1f ms, link %.1f ms), %u of %u failed", reloadStats.lastShader.c_str(),
+						reloadStats.lastSucceeded ? "rebuilt" : "failed, previous kept", reloadStats.lastCompileMs, reloadStats.lastLinkMs, reloadStats.failures, reloadStats.reloads);
+				else
+					ImGui::Text("Shader Reload: watching %u shaders", shaderWatcher.GetShaderCount());
+				ImGui::NewLine();
+				ImGui::SliderInt("Stress Spheres", &stressCount, 0, 100000);
+				ImGui::Checkbox("Instanced", &stressInstanced);
+				ImGui::Text("CPU Submit: %.3f ms", submitMs);
+				ImGui::SliderFloat("Grid Rotation", &gridRotation, -180.0f, 180.0f);
+				const TransformStats& transformStats = sphereTransforms.GetStats();
+				ImGui::Text("Transforms: %u of %u updated in %.3f ms", transformStats.updated, transformStats.transforms, transformStats.updateMs);
+			}
+
+			if (ImGui::CollapsingHeader("Culling"))
+			{
+				const CullStats& cullStats = sceneBVH.GetStats();
+				ImGui::Checkbox("Frustum Culling", &useCulling);
+				ImGui::Text("Visible: %u of %u spheres", (unsigned int)visibleSpheres.size(), sceneBVH.GetObjectCount());
+				ImGui::Text("Gallery %u, Grid %u, Stress %u", (unsigned int)galleryVisible.size(), (unsigned int)gridVisible.size(), (unsigned int)stressVisible.size());
+				if (useCulling)
+					ImGui::Text("Nodes: %u visited of %u, %u subtrees fully inside", cullStats.nodesVisited, cullStats.nodes, cullStats.fullyInside);
+				ImGui::Text("Build: %.3f ms, Cull: %.3f ms", cullStats.buildMs, useCulling ? cullStats.cullMs : 0.0f);
+			}
+
+			if (ImGui::CollapsingHeader("Level of Detail"))
+			{
+				ImGui::Checkbox("Enabled", &useLod);
+				ImGui::SliderFloat("Threshold (px)", &lodThreshold, 0.25f, 16.0f);
+				ImGui::SliderFloat("Hysteresis", &lodHysteresis, 0.0f, 0.9f);
+
+				unsigned long long triangles = 0, fullTriangles = 0;
+				for (unsigned int lod = 0; lod < SPHERE_LODS; ++lod)
+				{
+					triangles += (unsigned long long)lodCounts[lod] * sphereLodTriangles[lod];
+					fullTriangles += (unsigned long long)lodCounts[lod] * sphereLodTriangles[0];
+					ImGui::Text("LOD %u: %u segments, error %.5f, %u spheres", lod, SPHERE_SEGMENTS >> lod, sphereLodErrors[lod], lodCounts[lod]);
+				}
+				ImGui::Text("Triangles: %.2f M of %.2f M at full detail", triangles / 1000000.0, fullTriangles / 1000000.0);
+				ImGui::Text("Selection: %.3f ms", lodSelectMs);
 			}
 			
 			if (ImGui::CollapsingHeader("Application Info"))
@@ -715,7 +892,24 @@ int main()
 				ImGui::Text("OpenGL Version: %s", glGetString(GL_VERSION));
 				ImGui::Text("Shader Version: %s", glGetString(GL_SHADING_LANGUAGE_VERSION));
 				ImGui::Text("Hardware: %s", glGetString(GL_RENDERER));
+				ImGui::Text("Shader Build: %u programs in %.1f ms, %u from binary cache", shaderProfile.programs, shaderProfile.totalMs, shaderProfile.cached);
 				ImGui::NewLine();
+				if (textureStreamer)
+				{
+					const TextureStreamStats& streamStats = textureStreamer->GetStats();
+					ImGui::Text("Texture Streaming: %u / %u resident, %u decoding, %u failed", streamStats.resident, streamStats.requested, streamStats.decoding, streamStats.failed);
+					ImGui::Text("Uploaded %.2f MB this frame, %.1f MB total (%s PBO ring)", streamStats.frameBytes / (1024.0f * 1024.0f),
+						streamStats.totalBytes / (1024.0f * 1024.0f), streamStats.persistent ? "persistent" : "mapped");
+					ImGui::Text("Update %.3f ms (max %.3f ms), all resident after %.1f ms", streamStats.frameMs, streamStats.maxFrameMs, streamStats.completeMs);
+					if (ImGui::SliderInt("Upload Budget (MB/frame)", &streamBudgetMB, 1, 64))
+						textureStreamer->SetFrameBudget((size_t)streamBudgetMB * 1024 * 1024);
+				}
+				else
+				{
+					ImGui::Text("Texture Load: %u textures in %.1f ms (%u threads)", textureStats.textures, textureStats.totalMs, textureStats.threads);
+					ImGui::Text("Decode %.1f ms / Upload %.1f ms / Mips %.1f ms", textureStats.decodeMs, textureStats.uploadMs, textureStats.mipMs);
+					ImGui::Text("Texture Memory: %.1f MB (%u block-compressed)", textureStats.vramBytes / (1024.0f * 1024.0f), textureStats.compressed);
+				}
 				ImGui::Text("Frametime: %.3f / Framerate: (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 			}
 
@@ -729,7 +923,9 @@ int main()
 		}
 		ImGui::End();
 		ImGui::Render();
-		ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		if (!headless.IsEnabled())
+			ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		headless.EndFrame(window);
 
 		glfwPollEvents();
 		glfwSwapBuffers(window);
@@ -737,7 +933,8 @@ int main()
 	glDeleteFramebuffers(1, &captureFBO);
 	glDeleteRenderbuffers(1, &captureRBO);
 
-	glDeleteVertexArrays(1, &sphereVAO);
+	for (const RenderMesh& lod : sphereLods)
+		glDeleteVertexArrays(1, &lod.VAO);
 	glDeleteVertexArrays(1, &cubeVAO);
 	glDeleteVertexArrays(1, &quadVAO);
 
@@ -746,9 +943,10 @@ int main()
 
 	glDeleteTextures(1, &hdrTexture);
 	glDeleteTextures(1, &envCubemap);
-	glDeleteTextures(1, &envCubemap);
+	glDeleteTextures(1, &irradianceMap);
 	glDeleteTextures(1, &prefilterMap);
 	glDeleteTextures(1, &brdfLUTTexture);
+	textureStreamer.reset();
 
 	ImGui_ImplGlfwGL3_Shutdown();
 	ImGui::DestroyContext();
@@ -767,6 +965,7 @@ GLFWwindow* InitWindow()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	headless.ApplyWindowHints();
 
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "PBR & Speuclar IBL", NULL, NULL);
 	if (window == NULL)
@@ -776,7 +975,7 @@ GLFWwindow* InitWindow()
 		return nullptr;
 	}
 	glfwMakeContextCurrent(window);
-	glfwSwapInterval(1);
+	glfwSwapInterval(headless.IsEnabled() ? 0 : 1);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetWindowPos(window, 100, 100);
 
@@ -865,68 +1064,27 @@ void processInput(GLFWwindow* window)
 	}
 }
 
-unsigned int loadTexture(const char* path, bool gammaCorrection)
+void createSphere()
 {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrChannels;
-	unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-	if (data)
-	{
-		GLenum internalFormat;
-		GLenum dataFormat;
-		if (nrChannels == 1)
-			internalFormat = dataFormat = GL_RED;
-		else if (nrChannels == 3)
-		{
-			internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
-			dataFormat = GL_RGB;
-		}
-		else if (nrChannels == 4)
-		{
-			internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
-			dataFormat = GL_RGBA;
-		}
+	if (sphereLods[0].VAO != 0)
+		return;
 
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	unsigned int vbo, ebo;
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, dataFormat == (GL_RGBA || GL_RGB) ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, dataFormat == (GL_RGBA || GL_RGB) ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uv;
+	std::vector<glm::vec3> normals;
+	std::vector<unsigned int> indices;
 
-		stbi_image_free(data);
-	}
-	else
+	// every level is its own strip in the shared buffers, with indices into its own vertices
+	const float PI = 3.14159265359;
+	for (unsigned int lod = 0; lod < SPHERE_LODS; ++lod)
 	{
-		std::cout << "Failed to load texture: " << path << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;
-}
-
-void renderSphere()
-{
-	if (sphereVAO == 0)
-	{
-		glGenVertexArrays(1, &sphereVAO);
-
-		unsigned int vbo, ebo;
-		glGenBuffers(1, &vbo);
-		glGenBuffers(1, &ebo);
-
-		std::vector<glm::vec3> positions;
-		std::vector<glm::vec2> uv;
-		std::vector<glm::vec3> normals;
-		std::vector<unsigned int> indices;
-
-		const unsigned int X_SEGMENTS = 128;
-		const unsigned int Y_SEGMENTS = 128;
-		const float PI = 3.14159265359;
+		const unsigned int X_SEGMENTS = SPHERE_SEGMENTS >> lod;
+		const unsigned int Y_SEGMENTS = SPHERE_SEGMENTS >> lod;
+		const unsigned int baseVertex = (unsigned int)positions.size();
 		for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
 		{
 			for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
@@ -943,6 +1101,8 @@ void renderSphere()
 			}
 		}
 
+		sphereLods[lod].mode = GL_TRIANGLE_STRIP;
+		sphereLods[lod].firstIndex = (unsigned int)indices.size();
 		bool oddRow = false;
 		for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
 		{
@@ -950,50 +1110,60 @@ void renderSphere()
 			{
 				for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
 				{
-					indices.push_back(y * (X_SEGMENTS + 1) + x);
-					indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
+					indices.push_back(baseVertex + y * (X_SEGMENTS + 1) + x);
+					indices.push_back(baseVertex + (y + 1) * (X_SEGMENTS + 1) + x);
 				}
 			}
 			else
 			{
 				for (int x = X_SEGMENTS; x >= 0; --x)
 				{
-					indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-					indices.push_back(y * (X_SEGMENTS + 1) + x);
+					indices.push_back(baseVertex + (y + 1) * (X_SEGMENTS + 1) + x);
+					indices.push_back(baseVertex + y * (X_SEGMENTS + 1) + x);
 				}
 			}
 			oddRow = !oddRow;
 		}
-		indexCount = indices.size();
+		sphereLods[lod].indexCount = (unsigned int)indices.size() - sphereLods[lod].firstIndex;
 
-		std::vector<float> data;
-		for (unsigned int i = 0; i < positions.size(); ++i)
+		// a facet spans 2 PI / X_SEGMENTS around the equator, its middle sits 1 - cos of half that inside the sphere
+		sphereLodErrors[lod] = 1.0f - std::cos(PI / X_SEGMENTS);
+		sphereLodTriangles[lod] = 2 * X_SEGMENTS * Y_SEGMENTS;
+	}
+
+	std::vector<float> data;
+	for (unsigned int i = 0; i < positions.size(); ++i)
+	{
+		data.push_back(positions[i].x);
+		data.push_back(positions[i].y);
+		data.push_back(positions[i].z);
+		if (uv.size() > 0)
 		{
-			data.push_back(positions[i].x);
-			data.push_back(positions[i].y);
-			data.push_back(positions[i].z);
-			if (uv.size() > 0)
-			{
-				data.push_back(uv[i].x);
-				data.push_back(uv[i].y);
-			}
-			if (normals.size() > 0)
-			{
-				data.push_back(normals[i].x);
-				data.push_back(normals[i].y);
-				data.push_back(normals[i].z);
-			}
+			data.push_back(uv[i].x);
+			data.push_back(uv[i].y);
 		}
+		if (normals.size() > 0)
+		{
+			data.push_back(normals[i].x);
+			data.push_back(normals[i].y);
+			data.push_back(normals[i].z);
+		}
+	}
 
-		glBindVertexArray(sphereVAO);
-		
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	// a VAO per level even though they share the buffers, the Renderer keeps one instance buffer attached per VAO
+	float stride = (3 + 2 + 3) * sizeof(float);
+	for (unsigned int lod = 0; lod < SPHERE_LODS; ++lod)
+	{
+		glGenVertexArrays(1, &sphereLods[lod].VAO);
+		glBindVertexArray(sphereLods[lod].VAO);
 
-		float stride = (3 + 2 + 3) * sizeof(float);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		if (lod == 0)
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
@@ -1003,12 +1173,18 @@ void renderSphere()
 
 		glEnableVertexAttribArray(2);
 		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(5 * sizeof(float)));
-		
-		glBindVertexArray(0);
 	}
+	
+	glBindVertexArray(0);
+}
+
+void renderSphere(unsigned int lod)
+{
+	createSphere();
 
-	glBindVertexArray(sphereVAO);
-	glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
+	const RenderMesh& mesh = sphereLods[std::min(lod, SPHERE_LODS - 1)];
+	glBindVertexArray(mesh.VAO);
+	glDrawElements(GL_TRIANGLE_STRIP, mesh.indexCount, GL_UNSIGNED_INT, (void*)(mesh.firstIndex * sizeof(unsigned int)));
 	glBindVertexArray(0);
 }
 
@@ -1215,4 +1391,60 @@ void renderQuadNormal()
 	glBindVertexArray(quadVAO);
 	glDrawArrays(GL_TRIANGLES, 0, 6);
 	glBindVertexArray(0);
-}
\ No newline at end of file
+}
+
+std::vector<InstanceData> CreateStressInstances(int count)
+{
+	// spheres packed in a cube behind the gallery with random metallic/roughness
+	std::vector<InstanceData> instances(count);
+	int side = (int)std::ceil(std::cbrt((float)count));
+	const float spacing = 1.0f;
+	srand(42);
+	for (int i = 0; i < count; ++i)
+	{
+		int x = i % side;
+		int y = (i / side) % side;
+		int z = i / (side * side);
+		glm::vec3 position((x - side / 2) * spacing, (y - side / 2) * spacing, -20.0f - z * spacing);
+
+		instances[i].model = glm::translate(glm::mat4(1.0f), position);
+		instances[i].model = glm::scale(instances[i].model, glm::vec3(0.3f));
+		instances[i].params.x = (rand() % 100) / 100.0f;
+		instances[i].params.y = glm::clamp((rand() % 100) / 100.0f, 0.05f, 1.0f);
+	}
+	return instances;
+}
+
+unsigned int SelectSphereLod(const LodSelector& selector, const glm::mat4& model, unsigned int current)
+{
+	if (!useLod)
+		return 0;
+	float scale = glm::length(glm::vec3(model[0]));
+	return selector.Select(glm::distance(glm::vec3(model[3]), camera.Position), 1.0f, scale, current);
+}
+
+void SelectSphereLods(const LodSelector& selector, const std::vector<InstanceData>& instances, const std::vector<unsigned int>& visible, SphereLodSet& set, bool bucket)
+{
+	bool changed = set.levels.size() != instances.size() || set.visible != visible;
+	set.levels.resize(instances.size(), 0);
+	for (unsigned int i : visible)
+	{
+		unsigned int lod = SelectSphereLod(selector, instances[i].model, set.levels[i]);
+		changed = changed || lod != set.levels[i];
+		set.levels[i] = lod;
+	}
+
+	// the buffers only change when the visible spheres or their levels did
+	if (!bucket)
+		set.bucketed = false;
+	if (!bucket || (set.bucketed && !changed))
+		return;
+	for (std::vector<InstanceData>& instancesOfLevel : set.buckets)
+		instancesOfLevel.clear();
+	for (unsigned int i : visible)
+		set.buckets[set.levels[i]].push_back(instances[i]);
+	for (unsigned int lod = 0; lod < SPHERE_LODS; ++lod)
+		set.buffers[lod].Upload(set.buckets[lod]);
+	set.visible = visible;
+	set.bucketed = true;
+}
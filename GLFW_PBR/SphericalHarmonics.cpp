@@ -0,0 +1,125 @@
+#include "SphericalHarmonics.h"
+
+#include <algorithm>
+
+static const float PI = 3.14159265359f;
+
+// Real SH basis up to l = 2
+static void EvaluateBasis(glm::vec3 n, float* basis)
+{
+	basis[0] = 0.282095f;
+	basis[1] = 0.488603f * n.y;
+	basis[2] = 0.488603f * n.z;
+	basis[3] = 0.488603f * n.x;
+	basis[4] = 1.092548f * n.x * n.y;
+	basis[5] = 1.092548f * n.y * n.z;
+	basis[6] = 0.315392f * (3.0f * n.z * n.z - 1.0f);
+	basis[7] = 1.092548f * n.x * n.z;
+	basis[8] = 0.546274f * (n.x * n.x - n.y * n.y);
+}
+
+SHIrradiance SphericalHarmonics::Project(const CubeMapLevel& environment)
+{
+	glm::dvec3 sums[9];
+	for (int i = 0; i < 9; ++i)
+		sums[i] = glm::dvec3(0.0);
+	double totalWeight = 0.0;
+
+	unsigned int size = environment.size;
+	for (unsigned int face = 0; face < 6; ++face)
+	{
+		const float* data = &environment.data[(size_t)face * size * size * 3];
+		for (unsigned int y = 0; y < size; ++y)
+		{
+			for (unsigned int x = 0; x < size; ++x)
+			{
+				float s = (x + 0.5f) / size * 2.0f - 1.0f;
+				float t = (y + 0.5f) / size * 2.0f - 1.0f;
+
+				// solid angle of the texel, texels near the face corners cover less of the sphere
+				float distance2 = 1.0f + s * s + t * t;
+				float weight = 4.0f / (size * size * distance2 * std::sqrt(distance2));
+
+				glm::vec3 direction;
+				CubeFaceDirection(face, s, t, direction.x, direction.y, direction.z);
+				float basis[9];
+				EvaluateBasis(direction, basis);
+
+				const float* texel = &data[(y * size + x) * 3];
+				glm::dvec3 radiance(texel[0], texel[1], texel[2]);
+				for (int i = 0; i < 9; ++i)
+					sums[i] += radiance * (double)(basis[i] * weight);
+				totalWeight += weight;
+			}
+		}
+	}
+
+	// renormalise so the weights cover exactly 4 PI, then apply the cosine lobe
+	// (PI, 2PI/3, PI/4 per band) and the 1/PI of the irradiance map
+	const float bandScale[3] = { PI, 2.0f * PI / 3.0f, PI / 4.0f };
+	const int band[9] = { 0, 1, 1, 1, 2, 2, 2, 2, 2 };
+	double normalise = 4.0 * PI / totalWeight;
+
+	SHIrradiance sh;
+	for (int i = 0; i < 9; ++i)
+		sh.coefficients[i] = glm::vec3(sums[i] * normalise) * (bandScale[band[i]] / PI);
+	return sh;
+}
+
+glm::vec3 SphericalHarmonics::Evaluate(const SHIrradiance& sh, glm::vec3 normal)
+{
+	float basis[9];
+	EvaluateBasis(glm::normalize(normal), basis);
+
+	glm::vec3 irradiance(0.0f);
+	for (int i = 0; i < 9; ++i)
+		irradiance += sh.coefficients[i] * basis[i];
+	return glm::max(irradiance, glm::vec3(0.0f));
+}
+
+SHComparison SphericalHarmonics::Compare(const SHIrradiance& sh, const CubeMapLevel& irradiance)
+{
+	SHComparison result;
+	double errorSum = 0.0, referenceSum = 0.0;
+
+	unsigned int size = irradiance.size;
+	for (unsigned int face = 0; face < 6; ++face)
+	{
+		for (unsigned int y = 0; y < size; ++y)
+		{
+			for (unsigned int x = 0; x < size; ++x)
+			{
+				glm::vec3 direction;
+				CubeFaceDirection(face, (x + 0.5f) / size * 2.0f - 1.0f, (y + 0.5f) / size * 2.0f - 1.0f, direction.x, direction.y, direction.z);
+
+				const float* texel = &irradiance.data[(((size_t)face * size + y) * size + x) * 3];
+				glm::vec3 reference(texel[0], texel[1], texel[2]);
+				glm::vec3 error = glm::abs(Evaluate(sh, direction) - reference);
+
+				float errorLength = error.x + error.y + error.z;
+				float referenceLength = reference.x + reference.y + reference.z;
+				errorSum += errorLength;
+				referenceSum += referenceLength;
+				if (referenceLength > 0.0f)
+					result.maxRelativeError = std::max(result.maxRelativeError, errorLength / referenceLength);
+			}
+		}
+	}
+
+	result.meanRelativeError = referenceSum > 0.0 ? (float)(errorSum / referenceSum) : 0.0f;
+	return result;
+}
+
+CubeMapLevel SphericalHarmonics::ReadCubemap(unsigned int textureID, unsigned int level)
+{
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+	GLint size = 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, level, GL_TEXTURE_WIDTH, &size);
+
+	CubeMapLevel result;
+	result.size = (unsigned int)size;
+	result.data.resize((size_t)6 * size * size * 3);
+	for (unsigned int face = 0; face < 6; ++face)
+		glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_FLOAT, &result.data[(size_t)face * size * size * 3]);
+	return result;
+}
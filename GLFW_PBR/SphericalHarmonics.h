@@ -0,0 +1,35 @@
+#pragma once
+
+#include "IBLBaker.h"
+#include <GLM/glm.hpp>
+
+// Environment mip projected onto the SH basis, 64x64 faces are plenty for order 2
+const unsigned int SH_SOURCE_SIZE = 64;
+
+// Diffuse irradiance as 9 L2 spherical harmonic coefficients, already convolved
+// with the clamped cosine lobe and divided by PI so evaluating them gives the same
+// value the irradiance cubemap stores (Ramamoorthi & Hanrahan 2001).
+struct SHIrradiance
+{
+	glm::vec3 coefficients[9];
+};
+
+struct SHComparison
+{
+	float meanRelativeError = 0.0f;
+	float maxRelativeError = 0.0f;
+};
+
+class SphericalHarmonics
+{
+public:
+	// Single reduction over every texel, weighted by its solid angle
+	static SHIrradiance Project(const CubeMapLevel& environment);
+	static glm::vec3 Evaluate(const SHIrradiance& sh, glm::vec3 normal);
+
+	// Compares the SH evaluation against every texel of an irradiance cubemap
+	static SHComparison Compare(const SHIrradiance& sh, const CubeMapLevel& irradiance);
+
+	// Reads one mip level of a GL cubemap back as RGB floats
+	static CubeMapLevel ReadCubemap(unsigned int textureID, unsigned int level);
+};
@@ -0,0 +1,241 @@
+#include "TextureBatch.h"
+#include "ThreadPool.h"
+#include "stb_image.h"
+
+#include <iostream>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+
+TextureBatch::TextureBatch(unsigned int threadCount) : m_ThreadCount(threadCount), m_SupportsS3TC(false), m_SupportsBPTC(false)
+{
+}
+
+unsigned int TextureBatch::Add(const std::string& path, bool gammaCorrection, int priority)
+{
+	Request request;
+	request.path = path;
+	request.gammaCorrection = gammaCorrection;
+	request.priority = priority;
+	request.fileSize = 0;
+
+	struct stat info;
+	if (stat(path.c_str(), &info) == 0)
+		request.fileSize = (uint64_t)info.st_size;
+
+	glGenTextures(1, &request.textureID);
+	m_Requests.push_back(request);
+	return request.textureID;
+}
+
+void TextureBatch::Finish()
+{
+	if (m_Requests.empty())
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// RGTC (BC4, BC5) is core since 3.0, the others depend on the driver
+	m_SupportsS3TC = HasExtension("GL_EXT_texture_compression_s3tc") && HasExtension("GL_EXT_texture_sRGB");
+	m_SupportsBPTC = GLAD_GL_VERSION_4_2 || HasExtension("GL_ARB_texture_compression_bptc");
+
+	std::vector<unsigned int> order(m_Requests.size());
+	for (unsigned int i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b)
+	{
+		if (m_Requests[a].priority != m_Requests[b].priority)
+			return m_Requests[a].priority > m_Requests[b].priority;
+		return m_Requests[a].fileSize > m_Requests[b].fileSize;
+	});
+
+	std::vector<unsigned int> queries(m_Requests.size());
+	glGenQueries((GLsizei)queries.size(), queries.data());
+
+	// declared before the pool so the workers are joined before these go away
+	std::mutex mutex;
+	std::condition_variable decoded;
+	std::deque<Image> images;
+	float decodeMs = 0.0f;
+	{
+		ThreadPool pool(m_ThreadCount);
+		m_Stats.threads = pool.GetThreadCount();
+
+		for (unsigned int index : order)
+		{
+			pool.Enqueue([this, index, &mutex, &decoded, &images, &decodeMs]
+			{
+				auto decodeStart = std::chrono::high_resolution_clock::now();
+				Image image;
+				image.request = index;
+				image.data = nullptr;
+				image.isCompressed = LoadCompressedTexture(m_Requests[index].path, image.compressed) && IsSupported(image.compressed.format);
+				if (!image.isCompressed)
+					image.data = stbi_load(m_Requests[index].path.c_str(), &image.width, &image.height, &image.channels, 0);
+				auto decodeEnd = std::chrono::high_resolution_clock::now();
+
+				std::lock_guard<std::mutex> lock(mutex);
+				images.push_back(std::move(image));
+				decodeMs += std::chrono::duration<float, std::milli>(decodeEnd - decodeStart).count();
+				decoded.notify_one();
+			});
+		}
+
+		// GL calls stay on this thread, it uploads whatever finished decoding first
+		for (size_t uploaded = 0; uploaded < m_Requests.size(); ++uploaded)
+		{
+			Image image;
+			{
+				auto waitStart = std::chrono::high_resolution_clock::now();
+				std::unique_lock<std::mutex> lock(mutex);
+				decoded.wait(lock, [&images] { return !images.empty(); });
+				image = std::move(images.front());
+				images.pop_front();
+				auto waitEnd = std::chrono::high_resolution_clock::now();
+				m_Stats.waitMs += std::chrono::duration<float, std::milli>(waitEnd - waitStart).count();
+			}
+			Upload(m_Requests[image.request], image, queries[image.request]);
+		}
+	}
+
+	for (unsigned int i = 0; i < queries.size(); ++i)
+	{
+		GLuint64 elapsed = 0;
+		if (glIsQuery(queries[i]))
+			glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+		m_Stats.mipMs += elapsed / 1000000.0f;
+	}
+	glDeleteQueries((GLsizei)queries.size(), queries.data());
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_Stats.decodeMs += decodeMs;
+	m_Stats.totalMs += std::chrono::duration<float, std::milli>(end - start).count();
+	m_Requests.clear();
+}
+
+void TextureBatch::Upload(const Request& request, const Image& image, unsigned int query)
+{
+	++m_Stats.textures;
+	if (image.isCompressed)
+	{
+		UploadCompressed(request, image);
+		return;
+	}
+	if (!image.data)
+	{
+		std::cout << "Failed to load texture: " << request.path << std::endl;
+		++m_Stats.failed;
+		return;
+	}
+
+	GLenum internalFormat = GL_RGBA;
+	GLenum dataFormat = GL_RGBA;
+	if (image.channels == 1)
+		internalFormat = dataFormat = GL_RED;
+	else if (image.channels == 2)
+		internalFormat = dataFormat = GL_RG;
+	else if (image.channels == 3)
+	{
+		internalFormat = request.gammaCorrection ? GL_SRGB : GL_RGB;
+		dataFormat = GL_RGB;
+	}
+	else if (image.channels == 4)
+	{
+		internalFormat = request.gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
+		dataFormat = GL_RGBA;
+	}
+
+	auto uploadStart = std::chrono::high_resolution_clock::now();
+	glBindTexture(GL_TEXTURE_2D, request.textureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, dataFormat, GL_UNSIGNED_BYTE, image.data);
+	auto uploadEnd = std::chrono::high_resolution_clock::now();
+	m_Stats.uploadMs += std::chrono::duration<float, std::milli>(uploadEnd - uploadStart).count();
+
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glEndQuery(GL_TIME_ELAPSED);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (dataFormat == GL_RED)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+	}
+
+	m_Stats.bytes += (size_t)image.width * image.height * image.channels;
+	m_Stats.vramBytes += (size_t)image.width * image.height * (image.channels == 3 ? 4 : image.channels) * 4 / 3;
+	stbi_image_free(image.data);
+}
+
+void TextureBatch::UploadCompressed(const Request& request, const Image& image)
+{
+	const DDSTexture& texture = image.compressed;
+	GLenum internalFormat = GetCompressedFormat(texture.format, request.gammaCorrection);
+
+	auto uploadStart = std::chrono::high_resolution_clock::now();
+	glBindTexture(GL_TEXTURE_2D, request.textureID);
+	for (unsigned int level = 0; level < texture.levels.size(); ++level)
+	{
+		GLsizei width = std::max(texture.width >> level, 1u);
+		GLsizei height = std::max(texture.height >> level, 1u);
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, (GLsizei)texture.levels[level].size(), texture.levels[level].data());
+		m_Stats.bytes += texture.levels[level].size();
+		m_Stats.vramBytes += texture.levels[level].size();
+	}
+	auto uploadEnd = std::chrono::high_resolution_clock::now();
+	m_Stats.uploadMs += std::chrono::duration<float, std::milli>(uploadEnd - uploadStart).count();
+
+	// the mips come from the file, a partial chain must not be sampled past its end
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (texture.format == BLOCK_BC4)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+	}
+	++m_Stats.compressed;
+}
+
+bool TextureBatch::IsSupported(BlockFormat format) const
+{
+	if (format == BLOCK_BC1 || format == BLOCK_BC3)
+		return m_SupportsS3TC;
+	if (format == BLOCK_BC7)
+		return m_SupportsBPTC;
+	return true;
+}
+
+bool TextureBatch::HasExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && std::strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+void TextureBatch::PrintReport() const
+{
+	std::cout << "Textures: " << m_Stats.textures << " loaded (" << m_Stats.compressed << " block-compressed, " << m_Stats.failed << " failed) in "
+		<< m_Stats.totalMs << " ms on " << m_Stats.threads << " threads" << std::endl;
+	std::cout << "  uploaded " << m_Stats.bytes / (1024 * 1024) << " MB, resident " << m_Stats.vramBytes / (1024 * 1024) << " MB with mips" << std::endl;
+	std::cout << "  decode " << m_Stats.decodeMs << " ms (summed over threads), upload " << m_Stats.uploadMs
+		<< " ms, mips " << m_Stats.mipMs << " ms (GPU), waiting for decode " << m_Stats.waitMs << " ms" << std::endl;
+}
+
+const TextureBatchStats& TextureBatch::GetStats() const
+{
+	return m_Stats;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "DDSFile.h"
+#include <GLAD/glad.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Load time breakdown, summed over every Finish() of the batch
+struct TextureBatchStats
+{
+	unsigned int textures = 0;
+	unsigned int compressed = 0; // loaded from a .dds next to the image, see DDSFile.h
+	unsigned int failed = 0;
+	unsigned int threads = 0;
+	size_t bytes = 0;      // sent to GL, mip levels included for compressed textures
+	size_t vramBytes = 0;  // resident size with mips, uncompressed RGB counted as 4 bytes a texel
+	float decodeMs = 0.0f; // stbi_load or the .dds read, summed over the workers
+	float uploadMs = 0.0f; // glTexImage2D / glCompressedTexImage2D on the GL thread
+	float mipMs = 0.0f;    // glGenerateMipmap, GPU time
+	float waitMs = 0.0f;   // GL thread idle waiting for the next decode
+	float totalMs = 0.0f;  // wall clock of Finish()
+};
+
+// Loads a set of image files as 2D textures. Add() only reserves the texture
+// name, so callers can hand it out straight away; Finish() decodes every
+// queued file on a thread pool and uploads each image on the calling (GL)
+// thread as soon as its decode is done. Decodes start in priority order,
+// larger files first within a priority so the slowest ones do not end up
+// running alone at the tail. A current block-compressed copy of a file
+// (written by --compress-textures) is uploaded instead of the image, with its
+// prebuilt mips, when the driver supports the format.
+class TextureBatch
+{
+private:
+	struct Request
+	{
+		std::string path;
+		bool gammaCorrection;
+		int priority;
+		uint64_t fileSize;
+		unsigned int textureID;
+	};
+
+	struct Image
+	{
+		unsigned int request;
+		unsigned char* data;
+		int width, height, channels;
+		bool isCompressed;
+		DDSTexture compressed;
+	};
+
+	std::vector<Request> m_Requests;
+	unsigned int m_ThreadCount;
+	bool m_SupportsS3TC;
+	bool m_SupportsBPTC;
+	TextureBatchStats m_Stats;
+
+public:
+	// threadCount 0 uses every hardware thread
+	TextureBatch(unsigned int threadCount = 0);
+
+	unsigned int Add(const std::string& path, bool gammaCorrection, int priority = 0);
+	void Finish();
+
+	void PrintReport() const;
+	const TextureBatchStats& GetStats() const;
+
+private:
+	void Upload(const Request& request, const Image& image, unsigned int query);
+	void UploadCompressed(const Request& request, const Image& image);
+	bool IsSupported(BlockFormat format) const;
+	static bool HasExtension(const char* name);
+};
@@ -0,0 +1,210 @@
+#include "TextureCompressor.h"
+#include "stb_image.h"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+static float SRGBToLinear(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSRGB(float value)
+{
+	return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static uint8_t ToByte(float value)
+{
+	return (uint8_t)std::min(std::max(value * 255.0f + 0.5f, 0.0f), 255.0f);
+}
+
+TextureCompressor::TextureCompressor(ThreadPool& pool, bool useBC1) : m_Pool(pool), m_UseBC1(useBC1)
+{
+}
+
+TextureRole TextureCompressor::GetRole(const std::string& path)
+{
+	std::string name = path.substr(path.find_last_of("/\\") + 1);
+	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+	if (name.find("normal") != std::string::npos)
+		return TEXTURE_ROLE_NORMAL;
+
+	const char* scalars[] = { "metal", "rough", "ao", "occlusion", "height", "spec", "gloss" };
+	for (const char* scalar : scalars)
+		if (name.find(scalar) != std::string::npos)
+			return TEXTURE_ROLE_SCALAR;
+
+	return TEXTURE_ROLE_COLOR;
+}
+
+BlockFormat TextureCompressor::ChooseFormat(TextureRole role, const uint8_t* rgba, size_t pixelCount) const
+{
+	if (role == TEXTURE_ROLE_NORMAL)
+		return BLOCK_BC5;
+	if (role == TEXTURE_ROLE_SCALAR)
+		return BLOCK_BC4;
+	if (!m_UseBC1)
+		return BLOCK_BC7;
+
+	for (size_t i = 0; i < pixelCount; ++i)
+		if (rgba[i * 4 + 3] != 255)
+			return BLOCK_BC3;
+	return BLOCK_BC1;
+}
+
+std::vector<std::vector<uint8_t>> TextureCompressor::BuildMipChain(const uint8_t* rgba, unsigned int width, unsigned int height, TextureRole role)
+{
+	float toLinear[256];
+	for (unsigned int i = 0; i < 256; ++i)
+		toLinear[i] = role == TEXTURE_ROLE_COLOR ? SRGBToLinear(i / 255.0f) : i / 255.0f;
+
+	std::vector<std::vector<uint8_t>> levels;
+	levels.emplace_back(rgba, rgba + (size_t)width * height * 4);
+	while (width > 1 || height > 1)
+	{
+		const std::vector<uint8_t>& source = levels.back();
+		unsigned int nextWidth = std::max(width / 2, 1u);
+		unsigned int nextHeight = std::max(height / 2, 1u);
+		std::vector<uint8_t> next((size_t)nextWidth * nextHeight * 4);
+
+		for (unsigned int y = 0; y < nextHeight; ++y)
+		{
+			for (unsigned int x = 0; x < nextWidth; ++x)
+			{
+				// 2x2 box, the odd last row or column of a level is dropped like glGenerateMipmap does
+				unsigned int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				unsigned int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+				const uint8_t* texels[4] = {
+					&source[((size_t)y0 * width + x0) * 4], &source[((size_t)y0 * width + x1) * 4],
+					&source[((size_t)y1 * width + x0) * 4], &source[((size_t)y1 * width + x1) * 4]
+				};
+				uint8_t* target = &next[((size_t)y * nextWidth + x) * 4];
+
+				if (role == TEXTURE_ROLE_NORMAL)
+				{
+					float n[3] = { 0.0f, 0.0f, 0.0f };
+					for (const uint8_t* texel : texels)
+						for (unsigned int c = 0; c < 3; ++c)
+							n[c] += texel[c] / 127.5f - 1.0f;
+					float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (length < 1e-6f)
+					{
+						n[0] = n[1] = 0.0f;
+						n[2] = length = 1.0f;
+					}
+					for (unsigned int c = 0; c < 3; ++c)
+						target[c] = ToByte((n[c] / length) * 0.5f + 0.5f);
+				}
+				else
+				{
+					for (unsigned int c = 0; c < 3; ++c)
+					{
+						float sum = toLinear[texels[0][c]] + toLinear[texels[1][c]] + toLinear[texels[2][c]] + toLinear[texels[3][c]];
+						target[c] = ToByte(role == TEXTURE_ROLE_COLOR ? LinearToSRGB(sum * 0.25f) : sum * 0.25f);
+					}
+				}
+				target[3] = (uint8_t)((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+			}
+		}
+
+		levels.push_back(std::move(next));
+		width = nextWidth;
+		height = nextHeight;
+	}
+	return levels;
+}
+
+bool TextureCompressor::Compress(const std::string& path, TextureCompressionResult& result)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	int width, height, channels;
+	stbi_set_flip_vertically_on_load(false);
+	uint8_t* rgba = stbi_load(path.c_str(), &width, &height, &channels, 4);
+	if (!rgba)
+	{
+		std::cout << "Failed to load texture: " << path << std::endl;
+		return false;
+	}
+
+	result.path = path;
+	result.role = GetRole(path);
+	result.format = ChooseFormat(result.role, rgba, (size_t)width * height);
+	result.width = width;
+	result.height = height;
+
+	std::vector<std::vector<uint8_t>> mips = BuildMipChain(rgba, width, height, result.role);
+	stbi_image_free(rgba);
+
+	DDSTexture texture;
+	texture.format = result.format;
+	texture.width = width;
+	texture.height = height;
+	result.sourceBytes = 0;
+	result.compressedBytes = 0;
+	for (unsigned int level = 0; level < mips.size(); ++level)
+	{
+		unsigned int levelWidth = std::max((unsigned int)width >> level, 1u);
+		unsigned int levelHeight = std::max((unsigned int)height >> level, 1u);
+		texture.levels.push_back(CompressImage(result.format, mips[level].data(), levelWidth, levelHeight, &m_Pool));
+		result.sourceBytes += (size_t)levelWidth * levelHeight * channels;
+		result.compressedBytes += texture.levels.back().size();
+	}
+	result.levels = (unsigned int)texture.levels.size();
+
+	// quality of the top level, over the channels the shaders actually read
+	std::vector<uint8_t> decoded = DecompressImage(result.format, texture.levels[0].data(), width, height);
+	unsigned int compared = result.role == TEXTURE_ROLE_SCALAR ? 1 : (result.role == TEXTURE_ROLE_NORMAL ? 2 : (result.format == BLOCK_BC1 ? 3 : 4));
+	double error = 0.0;
+	for (size_t i = 0; i < (size_t)width * height; ++i)
+	{
+		for (unsigned int c = 0; c < compared; ++c)
+		{
+			double difference = (double)decoded[i * 4 + c] - mips[0][i * 4 + c];
+			error += difference * difference;
+		}
+	}
+	error /= (double)width * height * compared;
+	result.psnr = error > 0.0 ? (float)(10.0 * std::log10(255.0 * 255.0 / error)) : 99.0f;
+
+	bool saved = SaveCompressedTexture(path, texture);
+	auto end = std::chrono::high_resolution_clock::now();
+	result.ms = std::chrono::duration<float, std::milli>(end - start).count();
+	return saved;
+}
+
+int RunTextureCompress(const std::vector<std::string>& paths, bool useBC1)
+{
+	ThreadPool pool;
+	TextureCompressor compressor(pool, useBC1);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	size_t sourceTotal = 0, compressedTotal = 0;
+	unsigned int failed = 0;
+	for (const std::string& path : paths)
+	{
+		TextureCompressionResult result;
+		if (!compressor.Compress(path, result))
+		{
+			++failed;
+			continue;
+		}
+
+		sourceTotal += result.sourceBytes;
+		compressedTotal += result.compressedBytes;
+		std::cout << std::fixed << std::setprecision(1) << GetBlockFormatName(result.format) << "  " << result.width << "x" << result.height
+			<< "  " << result.sourceBytes / 1024 << " KB -> " << result.compressedBytes / 1024 << " KB  "
+			<< (float)result.sourceBytes / result.compressedBytes << "x  PSNR " << result.psnr << " dB  " << result.ms << " ms  " << path << std::endl;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "Compressed " << paths.size() - failed << " textures on " << pool.GetThreadCount() << " threads in "
+		<< std::chrono::duration<float, std::milli>(end - start).count() << " ms: " << sourceTotal / (1024 * 1024) << " MB -> "
+		<< compressedTotal / (1024 * 1024) << " MB (" << (compressedTotal ? (float)sourceTotal / compressedTotal : 0.0f) << "x)" << std::endl;
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "BlockCompression.h"
+#include "DDSFile.h"
+#include "ThreadPool.h"
+#include <string>
+#include <vector>
+
+// What a map stores decides its block format and how its mips are filtered
+enum TextureRole
+{
+	TEXTURE_ROLE_COLOR,  // sRGB albedo, BC7 (or BC1 / BC3), mips averaged in linear space
+	TEXTURE_ROLE_NORMAL, // tangent-space normal, BC5 holding x and y, mips renormalised
+	TEXTURE_ROLE_SCALAR  // metallic, roughness, ao, height: BC4 from the red channel
+};
+
+struct TextureCompressionResult
+{
+	std::string path;
+	TextureRole role = TEXTURE_ROLE_COLOR;
+	BlockFormat format = BLOCK_BC7;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int levels = 0;
+	size_t sourceBytes = 0;     // the same mip chain uploaded uncompressed, as loadTexture did
+	size_t compressedBytes = 0;
+	float psnr = 0.0f;          // level 0 against the source, over the channels the role keeps
+	float ms = 0.0f;
+};
+
+// CPU converter from image files to block-compressed DDS files with prebuilt
+// mip chains (see DDSFile.h). The role of a map comes from its file name.
+class TextureCompressor
+{
+private:
+	ThreadPool& m_Pool;
+	bool m_UseBC1;
+
+public:
+	// useBC1 trades BC7 for BC1 (BC3 with alpha) on colour maps, half the size at lower quality
+	TextureCompressor(ThreadPool& pool, bool useBC1 = false);
+
+	bool Compress(const std::string& path, TextureCompressionResult& result);
+
+	static TextureRole GetRole(const std::string& path);
+	static std::vector<std::vector<uint8_t>> BuildMipChain(const uint8_t* rgba, unsigned int width, unsigned int height, TextureRole role);
+
+private:
+	BlockFormat ChooseFormat(TextureRole role, const uint8_t* rgba, size_t pixelCount) const;
+};
+
+// Command-line entry point, run from GLFW_PBR without opening a window
+int RunTextureCompress(const std::vector<std::string>& paths, bool useBC1);
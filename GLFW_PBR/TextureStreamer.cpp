@@ -0,0 +1,401 @@
+#include "TextureStreamer.h"
+#include "TextureCompressor.h"
+#include "stb_image.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+static const size_t UPLOAD_ALIGNMENT = 16;
+static const size_t MIN_FRAME_BUDGET = 256 * 1024;
+
+static bool HasExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && std::strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+TextureStreamer::TextureStreamer(size_t frameBudget, unsigned int threadCount)
+	: m_Pool(new ThreadPool(threadCount)), m_InFlight(0), m_PBO(0), m_Mapped(nullptr), m_Slot(0), m_SlotUsed(0),
+	m_FrameBudget(std::max(frameBudget, MIN_FRAME_BUDGET)), m_FirstRequest(0.0)
+{
+	for (unsigned int i = 0; i < SLOT_COUNT; ++i)
+		m_Fences[i] = nullptr;
+
+	m_SupportsS3TC = HasExtension("GL_EXT_texture_compression_s3tc") && HasExtension("GL_EXT_texture_sRGB");
+	m_SupportsBPTC = GLAD_GL_VERSION_4_2 || HasExtension("GL_ARB_texture_compression_bptc");
+
+	glGenBuffers(1, &m_PBO);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_PBO);
+	const GLsizeiptr ringSize = (GLsizeiptr)(SLOT_SIZE * SLOT_COUNT);
+	if (GLAD_GL_VERSION_4_4)
+	{
+		// mapped once for the lifetime of the streamer, the slot fences keep the GPU and CPU apart
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ringSize, nullptr, flags);
+		m_Mapped = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ringSize, flags);
+	}
+	else
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, ringSize, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	m_Stats.persistent = m_Mapped != nullptr;
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// joins the workers before the textures they write into are released
+	m_Pool.reset();
+
+	for (unsigned int i = 0; i < SLOT_COUNT; ++i)
+		if (m_Fences[i])
+			glDeleteSync(m_Fences[i]);
+
+	if (m_Mapped)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_PBO);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &m_PBO);
+}
+
+double TextureStreamer::Now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned int TextureStreamer::Request(const std::string& path, bool gammaCorrection, int priority)
+{
+	if (m_Stats.requested == 0)
+		m_FirstRequest = Now();
+	m_Stats.completeMs = 0.0f;
+	++m_Stats.requested;
+
+	m_Textures.emplace_back(new StreamTexture());
+	StreamTexture* texture = m_Textures.back().get();
+	texture->path = path;
+	texture->gammaCorrection = gammaCorrection;
+	texture->priority = priority;
+
+	// flat stand-in until the first mips land: mid grey, or a straight-up normal
+	bool normalMap = TextureCompressor::GetRole(path) == TEXTURE_ROLE_NORMAL;
+	const uint8_t placeholder[4] = { 128, 128, (uint8_t)(normalMap ? 255 : 128), 255 };
+	glGenTextures(1, &texture->textureID);
+	glBindTexture(GL_TEXTURE_2D, texture->textureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	m_Queued.push_back(texture);
+	Dispatch();
+	return texture->textureID;
+}
+
+void TextureStreamer::Dispatch()
+{
+	// only a few decodes are handed to the pool at a time so a later, more important request can still go first
+	std::stable_sort(m_Queued.begin(), m_Queued.end(), [](const StreamTexture* a, const StreamTexture* b)
+	{
+		return a->priority > b->priority;
+	});
+
+	unsigned int limit = m_Pool->GetThreadCount() * 2;
+	size_t dispatched = 0;
+	while (m_InFlight < limit && dispatched < m_Queued.size())
+	{
+		StreamTexture* texture = m_Queued[dispatched++];
+		texture->dispatched = true;
+		++m_InFlight;
+		m_Pool->Enqueue([this, texture]
+		{
+			Decode(*texture);
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Decoded.push_back(texture);
+		});
+	}
+	m_Queued.erase(m_Queued.begin(), m_Queued.begin() + dispatched);
+	m_Stats.decoding = m_InFlight + (unsigned int)m_Queued.size();
+}
+
+void TextureStreamer::Decode(StreamTexture& texture)
+{
+	DDSTexture compressed;
+	if (LoadCompressedTexture(texture.path, compressed))
+	{
+		bool supported = compressed.format == BLOCK_BC4 || compressed.format == BLOCK_BC5
+			|| ((compressed.format == BLOCK_BC1 || compressed.format == BLOCK_BC3) && m_SupportsS3TC)
+			|| (compressed.format == BLOCK_BC7 && m_SupportsBPTC);
+		if (supported)
+		{
+			texture.isCompressed = true;
+			texture.format = compressed.format;
+			for (unsigned int level = 0; level < compressed.levels.size(); ++level)
+			{
+				StreamLevel streamLevel;
+				streamLevel.width = std::max(compressed.width >> level, 1u);
+				streamLevel.height = std::max(compressed.height >> level, 1u);
+				streamLevel.data = std::move(compressed.levels[level]);
+				texture.levels.push_back(std::move(streamLevel));
+			}
+			return;
+		}
+	}
+
+	int width, height, channels;
+	uint8_t* rgba = stbi_load(texture.path.c_str(), &width, &height, &channels, 4);
+	if (!rgba)
+	{
+		texture.failed = true;
+		return;
+	}
+
+	// the CPU builds the mip chain, glGenerateMipmap would need the whole top level first
+	TextureRole role = TextureCompressor::GetRole(texture.path);
+	if (role == TEXTURE_ROLE_COLOR && !texture.gammaCorrection)
+		role = TEXTURE_ROLE_SCALAR;
+	std::vector<std::vector<uint8_t>> mips = TextureCompressor::BuildMipChain(rgba, width, height, role);
+	stbi_image_free(rgba);
+
+	for (unsigned int level = 0; level < mips.size(); ++level)
+	{
+		StreamLevel streamLevel;
+		streamLevel.width = std::max((unsigned int)width >> level, 1u);
+		streamLevel.height = std::max((unsigned int)height >> level, 1u);
+		streamLevel.data = std::move(mips[level]);
+		texture.levels.push_back(std::move(streamLevel));
+	}
+}
+
+GLenum TextureStreamer::GetInternalFormat(const StreamTexture& texture) const
+{
+	if (texture.isCompressed)
+		return GetCompressedFormat(texture.format, texture.gammaCorrection);
+	return texture.gammaCorrection ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+}
+
+void TextureStreamer::Allocate(StreamTexture& texture)
+{
+	GLenum internalFormat = GetInternalFormat(texture);
+	int levelCount = (int)texture.levels.size();
+
+	glBindTexture(GL_TEXTURE_2D, texture.textureID);
+	for (int level = 0; level < levelCount; ++level)
+	{
+		const StreamLevel& streamLevel = texture.levels[level];
+		if (texture.isCompressed)
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, streamLevel.width, streamLevel.height, 0, (GLsizei)streamLevel.data.size(), nullptr);
+		else
+			glTexImage2D(GL_TEXTURE_2D, level, internalFormat, streamLevel.width, streamLevel.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	// the tail of the chain is tiny, it goes up at once so the placeholder is replaced this frame
+	texture.level = levelCount - 1;
+	while (texture.level >= 0 && texture.levels[texture.level].width * texture.levels[texture.level].height <= IMMEDIATE_TEXELS)
+	{
+		const StreamLevel& streamLevel = texture.levels[texture.level];
+		if (texture.isCompressed)
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, texture.level, 0, 0, streamLevel.width, streamLevel.height, internalFormat, (GLsizei)streamLevel.data.size(), streamLevel.data.data());
+		else
+			glTexSubImage2D(GL_TEXTURE_2D, texture.level, 0, 0, streamLevel.width, streamLevel.height, GL_RGBA, GL_UNSIGNED_BYTE, streamLevel.data.data());
+		m_Stats.frameBytes += streamLevel.data.size();
+		--texture.level;
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.level + 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	if (texture.isCompressed && texture.format == BLOCK_BC4)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+	}
+
+	texture.allocated = true;
+	texture.row = 0;
+	if (texture.level < 0)
+		texture.resident = true;
+}
+
+bool TextureStreamer::AcquireSlot(size_t size, size_t& offset)
+{
+	size = (size + UPLOAD_ALIGNMENT - 1) & ~(UPLOAD_ALIGNMENT - 1);
+	if (m_SlotUsed + size > SLOT_SIZE)
+	{
+		// leaving a slot fences everything read from it, the next slot has to be done with its last use
+		if (m_Fences[m_Slot])
+			glDeleteSync(m_Fences[m_Slot]);
+		m_Fences[m_Slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		unsigned int next = (m_Slot + 1) % SLOT_COUNT;
+		if (m_Fences[next])
+		{
+			GLenum status = glClientWaitSync(m_Fences[next], 0, 0);
+			if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+			{
+				// the GPU is still copying out of it, carry on next frame rather than stall
+				m_SlotUsed = SLOT_SIZE;
+				return false;
+			}
+			glDeleteSync(m_Fences[next]);
+			m_Fences[next] = nullptr;
+		}
+		m_Slot = next;
+		m_SlotUsed = 0;
+	}
+
+	offset = m_Slot * SLOT_SIZE + m_SlotUsed;
+	m_SlotUsed += size;
+	return true;
+}
+
+bool TextureStreamer::UploadRows(StreamTexture& texture, size_t& budget)
+{
+	GLenum internalFormat = GetInternalFormat(texture);
+	glBindTexture(GL_TEXTURE_2D, texture.textureID);
+
+	while (texture.level >= 0)
+	{
+		const StreamLevel& streamLevel = texture.levels[texture.level];
+
+		// compressed levels are copied in rows of 4x4 blocks
+		unsigned int rowHeight = texture.isCompressed ? 4 : 1;
+		unsigned int rowCount = (streamLevel.height + rowHeight - 1) / rowHeight;
+		size_t rowBytes = streamLevel.data.size() / rowCount;
+		size_t rows = std::min((size_t)(rowCount - texture.row), std::min(SLOT_SIZE, budget) / rowBytes);
+		if (rows == 0)
+			return false;
+
+		size_t size = rows * rowBytes;
+		size_t offset;
+		if (!AcquireSlot(size, offset))
+			return false;
+
+		const uint8_t* source = streamLevel.data.data() + texture.row * rowBytes;
+		if (m_Mapped)
+			std::memcpy(m_Mapped + offset, source, size);
+		else
+		{
+			void* target = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			if (!target)
+				return false;
+			std::memcpy(target, source, size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+
+		GLint y = texture.row * rowHeight;
+		GLsizei height = std::min((GLsizei)(rows * rowHeight), (GLsizei)streamLevel.height - y);
+		if (texture.isCompressed)
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, texture.level, 0, y, streamLevel.width, height, internalFormat, (GLsizei)size, (const void*)offset);
+		else
+			glTexSubImage2D(GL_TEXTURE_2D, texture.level, 0, y, streamLevel.width, height, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)offset);
+
+		texture.row += (unsigned int)rows;
+		budget -= size;
+		m_Stats.frameBytes += size;
+
+		if (texture.row == rowCount)
+		{
+			// the level is complete, let sampling reach it
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.level);
+			--texture.level;
+			texture.row = 0;
+		}
+	}
+
+	texture.resident = true;
+	texture.levels.clear();
+	texture.levels.shrink_to_fit();
+	return true;
+}
+
+void TextureStreamer::Update()
+{
+	double start = Now();
+	m_Stats.frameBytes = 0;
+
+	std::vector<StreamTexture*> decoded;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		decoded.swap(m_Decoded);
+	}
+	m_InFlight -= (unsigned int)decoded.size();
+
+	for (StreamTexture* texture : decoded)
+	{
+		if (texture->failed)
+		{
+			std::cout << "Failed to load texture: " << texture->path << std::endl;
+			++m_Stats.failed;
+			continue;
+		}
+		Allocate(*texture);
+		if (texture->resident)
+			++m_Stats.resident;
+		else
+			m_Uploading.push_back(texture);
+	}
+	Dispatch();
+
+	std::stable_sort(m_Uploading.begin(), m_Uploading.end(), [](const StreamTexture* a, const StreamTexture* b)
+	{
+		return a->priority > b->priority;
+	});
+
+	size_t budget = m_FrameBudget;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_PBO);
+	for (StreamTexture* texture : m_Uploading)
+	{
+		if (!UploadRows(*texture, budget))
+			break;
+		++m_Stats.resident;
+	}
+	// client-memory uploads elsewhere must not read from the ring
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	m_Uploading.erase(std::remove_if(m_Uploading.begin(), m_Uploading.end(), [](const StreamTexture* texture)
+	{
+		return texture->resident;
+	}), m_Uploading.end());
+
+	m_Stats.totalBytes += m_Stats.frameBytes;
+	m_Stats.frameMs = (float)((Now() - start) * 1000.0);
+	m_Stats.maxFrameMs = std::max(m_Stats.maxFrameMs, m_Stats.frameMs);
+	if (m_Stats.requested > 0 && m_Stats.completeMs == 0.0f && IsIdle())
+	{
+		m_Stats.completeMs = (float)((Now() - m_FirstRequest) * 1000.0);
+		std::cout << "Texture streaming: " << m_Stats.resident << " textures resident (" << m_Stats.failed << " failed) after " << m_Stats.completeMs
+			<< " ms, " << m_Stats.totalBytes / (1024 * 1024) << " MB uploaded, slowest update " << m_Stats.maxFrameMs << " ms"
+			<< (m_Stats.persistent ? " (persistent PBO ring)" : " (mapped PBO ring)") << std::endl;
+	}
+}
+
+void TextureStreamer::SetFrameBudget(size_t bytes)
+{
+	m_FrameBudget = std::max(bytes, MIN_FRAME_BUDGET);
+}
+
+size_t TextureStreamer::GetFrameBudget() const
+{
+	return m_FrameBudget;
+}
+
+bool TextureStreamer::IsIdle() const
+{
+	return m_Queued.empty() && m_InFlight == 0 && m_Uploading.empty();
+}
+
+const TextureStreamStats& TextureStreamer::GetStats() const
+{
+	return m_Stats;
+}
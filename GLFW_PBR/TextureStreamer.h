@@ -0,0 +1,112 @@
+#pragma once
+
+#include "DDSFile.h"
+#include "ThreadPool.h"
+#include <GLAD/glad.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+struct TextureStreamStats
+{
+	unsigned int requested = 0;
+	unsigned int resident = 0;  // every mip level uploaded
+	unsigned int failed = 0;
+	unsigned int decoding = 0;
+	size_t frameBytes = 0;      // uploaded by the last Update()
+	size_t totalBytes = 0;
+	float frameMs = 0.0f;       // CPU time of the last Update()
+	float maxFrameMs = 0.0f;
+	float completeMs = 0.0f;    // from the first request until everything was resident
+	bool persistent = false;    // PBO ring is persistently mapped (GL 4.4 buffer storage)
+};
+
+// Streams image files into textures over many frames. Request() returns a
+// texture name at once, holding a 1x1 placeholder. Files are decoded (or read
+// from their .dds, see DDSFile.h) on worker threads in priority order, and
+// Update() copies at most the frame budget of pixel data per frame into the
+// textures through a ring of pixel buffer objects. Mips are uploaded smallest
+// first and GL_TEXTURE_BASE_LEVEL follows the finished levels, so a texture
+// sharpens in place and the name never changes.
+class TextureStreamer
+{
+public:
+	static const size_t SLOT_SIZE = 4 * 1024 * 1024;
+	static const unsigned int SLOT_COUNT = 4;
+	// levels up to this many texels are uploaded straight away when a decode lands
+	static const unsigned int IMMEDIATE_TEXELS = 64 * 64;
+
+private:
+	struct StreamLevel
+	{
+		unsigned int width, height;
+		std::vector<uint8_t> data;
+	};
+
+	struct StreamTexture
+	{
+		std::string path;
+		bool gammaCorrection;
+		int priority;
+		unsigned int textureID;
+
+		// written by the worker, read by the GL thread once the texture is in m_Decoded
+		bool failed = false;
+		bool isCompressed = false;
+		BlockFormat format = BLOCK_BC1;
+		std::vector<StreamLevel> levels;
+
+		bool dispatched = false;
+		bool allocated = false;
+		bool resident = false;
+		int level = -1;         // level being uploaded, counts down to 0
+		unsigned int row = 0;   // next pixel row of that level
+	};
+
+	std::unique_ptr<ThreadPool> m_Pool;
+	std::vector<std::unique_ptr<StreamTexture>> m_Textures;
+	std::vector<StreamTexture*> m_Queued;
+	std::vector<StreamTexture*> m_Uploading;
+	unsigned int m_InFlight;
+
+	std::mutex m_Mutex;
+	std::vector<StreamTexture*> m_Decoded;
+
+	unsigned int m_PBO;
+	uint8_t* m_Mapped;
+	GLsync m_Fences[SLOT_COUNT];
+	unsigned int m_Slot;
+	size_t m_SlotUsed;
+
+	size_t m_FrameBudget;
+	bool m_SupportsS3TC;
+	bool m_SupportsBPTC;
+	double m_FirstRequest;
+	TextureStreamStats m_Stats;
+
+public:
+	TextureStreamer(size_t frameBudget = 8 * 1024 * 1024, unsigned int threadCount = 0);
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	unsigned int Request(const std::string& path, bool gammaCorrection, int priority = 0);
+	// Once per frame on the GL thread
+	void Update();
+
+	void SetFrameBudget(size_t bytes);
+	size_t GetFrameBudget() const;
+	bool IsIdle() const;
+	const TextureStreamStats& GetStats() const;
+
+private:
+	void Dispatch();
+	void Decode(StreamTexture& texture);
+	void Allocate(StreamTexture& texture);
+	bool UploadRows(StreamTexture& texture, size_t& budget);
+	bool AcquireSlot(size_t size, size_t& offset);
+	GLenum GetInternalFormat(const StreamTexture& texture) const;
+	static double Now();
+};
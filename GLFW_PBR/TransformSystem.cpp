@@ -0,0 +1,324 @@
+#include "TransformSystem.h"
+#include "ThreadPool.h"
+
+#include <GLM/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <emmintrin.h>
+
+// transforms per job, a multiple of four
+const unsigned int UPDATE_CHUNK = 16384;
+
+static float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// four consecutive components, zero past the end of the array
+static __m128 Load4(const std::vector<float>& values, unsigned int first, unsigned int lanes)
+{
+	if (lanes == 4)
+		return _mm_loadu_ps(&values[first]);
+	float padded[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (unsigned int lane = 0; lane < lanes; ++lane)
+		padded[lane] = values[first + lane];
+	return _mm_loadu_ps(padded);
+}
+
+TransformSystem::TransformSystem(ThreadPool* pool) : m_MaxDepth(0), m_Pool(pool)
+{
+}
+
+unsigned int TransformSystem::Create(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, unsigned int parent)
+{
+	unsigned int transform = (unsigned int)m_Parents.size();
+	m_PositionX.push_back(0.0f);
+	m_PositionY.push_back(0.0f);
+	m_PositionZ.push_back(0.0f);
+	m_RotationX.push_back(0.0f);
+	m_RotationY.push_back(0.0f);
+	m_RotationZ.push_back(0.0f);
+	m_RotationW.push_back(1.0f);
+	m_ScaleX.push_back(1.0f);
+	m_ScaleY.push_back(1.0f);
+	m_ScaleZ.push_back(1.0f);
+	m_Parents.push_back(parent < transform ? parent : NO_PARENT);
+	m_Depths.push_back(parent < transform ? m_Depths[parent] + 1 : 0);
+	m_Dirty.push_back(1);
+	m_World.push_back(glm::mat4(1.0f));
+	m_MaxDepth = std::max(m_MaxDepth, m_Depths.back());
+
+	SetPosition(transform, position);
+	SetRotation(transform, rotation);
+	SetScale(transform, scale);
+	return transform;
+}
+
+void TransformSystem::Clear()
+{
+	for (std::vector<float>* component : { &m_PositionX, &m_PositionY, &m_PositionZ, &m_RotationX, &m_RotationY, &m_RotationZ, &m_RotationW, &m_ScaleX, &m_ScaleY, &m_ScaleZ })
+		component->clear();
+	m_Parents.clear();
+	m_Depths.clear();
+	m_Dirty.clear();
+	m_World.clear();
+	m_MaxDepth = 0;
+	m_Stats = TransformStats();
+}
+
+void TransformSystem::SetPosition(unsigned int transform, const glm::vec3& position)
+{
+	m_PositionX[transform] = position.x;
+	m_PositionY[transform] = position.y;
+	m_PositionZ[transform] = position.z;
+	m_Dirty[transform] = 1;
+}
+
+void TransformSystem::SetRotation(unsigned int transform, const glm::quat& rotation)
+{
+	glm::quat normalized = glm::normalize(rotation);
+	m_RotationX[transform] = normalized.x;
+	m_RotationY[transform] = normalized.y;
+	m_RotationZ[transform] = normalized.z;
+	m_RotationW[transform] = normalized.w;
+	m_Dirty[transform] = 1;
+}
+
+void TransformSystem::SetScale(unsigned int transform, const glm::vec3& scale)
+{
+	m_ScaleX[transform] = scale.x;
+	m_ScaleY[transform] = scale.y;
+	m_ScaleZ[transform] = scale.z;
+	m_Dirty[transform] = 1;
+}
+
+glm::vec3 TransformSystem::GetPosition(unsigned int transform) const
+{
+	return glm::vec3(m_PositionX[transform], m_PositionY[transform], m_PositionZ[transform]);
+}
+
+glm::quat TransformSystem::GetRotation(unsigned int transform) const
+{
+	return glm::quat(m_RotationW[transform], m_RotationX[transform], m_RotationY[transform], m_RotationZ[transform]);
+}
+
+glm::vec3 TransformSystem::GetScale(unsigned int transform) const
+{
+	return glm::vec3(m_ScaleX[transform], m_ScaleY[transform], m_ScaleZ[transform]);
+}
+
+unsigned int TransformSystem::GetParent(unsigned int transform) const
+{
+	return m_Parents[transform];
+}
+
+void TransformSystem::Update()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	unsigned int count = (unsigned int)m_Parents.size();
+
+	// a moved parent moves its children; parents come first, so one pass carries it all the way down
+	unsigned int depths = 1;
+	if (m_MaxDepth > 0)
+	{
+		depths = 0;
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			if (!m_Dirty[i] && m_Parents[i] != NO_PARENT && m_Dirty[m_Parents[i]])
+				m_Dirty[i] = 1;
+			if (m_Dirty[i])
+				depths = std::max(depths, m_Depths[i] + 1);
+		}
+	}
+
+	std::atomic<unsigned int> updated(0);
+	unsigned int chunks = (count + UPDATE_CHUNK - 1) / UPDATE_CHUNK;
+	for (unsigned int depth = 0; depth < depths; ++depth)
+	{
+		auto job = [this, count, depth, &updated](unsigned int chunk)
+		{
+			unsigned int first = chunk * UPDATE_CHUNK;
+			updated += UpdateRange(first, std::min(UPDATE_CHUNK, count - first), depth);
+		};
+		if (m_Pool && chunks > 1)
+			m_Pool->ParallelFor(chunks, job);
+		else
+			for (unsigned int chunk = 0; chunk < chunks; ++chunk)
+				job(chunk);
+	}
+
+	m_Stats.transforms = count;
+	m_Stats.updated = updated;
+	m_Stats.levels = updated > 0 ? depths : 0;
+	m_Stats.updateMs = ElapsedMs(start);
+}
+
+unsigned int TransformSystem::UpdateRange(unsigned int first, unsigned int count, unsigned int depth)
+{
+	const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+	unsigned int updated = 0;
+	for (unsigned int i = first; i < first + count; i += 4)
+	{
+		unsigned int lanes = std::min(4u, first + count - i);
+		unsigned int mask = 0;
+		for (unsigned int lane = 0; lane < lanes; ++lane)
+			if (m_Dirty[i + lane] && m_Depths[i + lane] == depth)
+				mask |= 1 << lane;
+		if (mask == 0)
+			continue;
+
+		// rotation matrix of each quaternion, its columns scaled, for four transforms at once
+		__m128 x = Load4(m_RotationX, i, lanes), y = Load4(m_RotationY, i, lanes), z = Load4(m_RotationZ, i, lanes), w = Load4(m_RotationW, i, lanes);
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+		__m128 scaleX = Load4(m_ScaleX, i, lanes), scaleY = Load4(m_ScaleY, i, lanes), scaleZ = Load4(m_ScaleZ, i, lanes);
+
+		__m128 columns[4][4];
+		columns[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX);
+		columns[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX);
+		columns[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX);
+		columns[0][3] = _mm_setzero_ps();
+		columns[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY);
+		columns[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY);
+		columns[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY);
+		columns[1][3] = _mm_setzero_ps();
+		columns[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ);
+		columns[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ);
+		columns[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ);
+		columns[2][3] = _mm_setzero_ps();
+		columns[3][0] = Load4(m_PositionX, i, lanes);
+		columns[3][1] = Load4(m_PositionY, i, lanes);
+		columns[3][2] = Load4(m_PositionZ, i, lanes);
+		columns[3][3] = one;
+
+		// from one component per register to one transform per register
+		for (unsigned int column = 0; column < 4; ++column)
+			_MM_TRANSPOSE4_PS(columns[column][0], columns[column][1], columns[column][2], columns[column][3]);
+
+		for (unsigned int lane = 0; lane < lanes; ++lane)
+		{
+			if (!(mask & (1 << lane)))
+				continue;
+			float* world = &m_World[i + lane][0][0];
+			unsigned int parent = m_Parents[i + lane];
+			if (parent == NO_PARENT)
+			{
+				for (unsigned int column = 0; column < 4; ++column)
+					_mm_storeu_ps(world + column * 4, columns[column][lane]);
+			}
+			else
+			{
+				// parent world * local, a column at a time
+				const float* parentWorld = &m_World[parent][0][0];
+				__m128 p0 = _mm_loadu_ps(parentWorld), p1 = _mm_loadu_ps(parentWorld + 4), p2 = _mm_loadu_ps(parentWorld + 8), p3 = _mm_loadu_ps(parentWorld + 12);
+				for (unsigned int column = 0; column < 4; ++column)
+				{
+					__m128 local = columns[column][lane];
+					__m128 result = _mm_mul_ps(p0, _mm_shuffle_ps(local, local, _MM_SHUFFLE(0, 0, 0, 0)));
+					result = _mm_add_ps(result, _mm_mul_ps(p1, _mm_shuffle_ps(local, local, _MM_SHUFFLE(1, 1, 1, 1))));
+					result = _mm_add_ps(result, _mm_mul_ps(p2, _mm_shuffle_ps(local, local, _MM_SHUFFLE(2, 2, 2, 2))));
+					result = _mm_add_ps(result, _mm_mul_ps(p3, _mm_shuffle_ps(local, local, _MM_SHUFFLE(3, 3, 3, 3))));
+					_mm_storeu_ps(world + column * 4, result);
+				}
+			}
+			m_Dirty[i + lane] = 0;
+			++updated;
+		}
+	}
+	return updated;
+}
+
+const glm::mat4& TransformSystem::GetWorld(unsigned int transform) const
+{
+	return m_World[transform];
+}
+
+const std::vector<glm::mat4>& TransformSystem::GetWorldMatrices() const
+{
+	return m_World;
+}
+
+unsigned int TransformSystem::GetCount() const
+{
+	return (unsigned int)m_Parents.size();
+}
+
+const TransformStats& TransformSystem::GetStats() const
+{
+	return m_Stats;
+}
+
+int RunTransformBenchmark(unsigned int objectCount)
+{
+	// groups of eight, a root and seven children around it
+	const unsigned int FRAMES = 10;
+	const unsigned int GROUP = 8;
+	std::vector<glm::vec3> positions(objectCount), scales(objectCount);
+	std::vector<glm::quat> rotations(objectCount);
+	std::vector<unsigned int> parents(objectCount);
+	srand(22);
+	for (unsigned int i = 0; i < objectCount; ++i)
+	{
+		positions[i] = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 100.0f - 50.0f;
+		glm::vec3 axis = glm::normalize(glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX + 0.01f);
+		rotations[i] = glm::angleAxis((float)rand() / RAND_MAX * glm::radians(360.0f), axis);
+		scales[i] = glm::vec3(0.5f + (float)rand() / RAND_MAX);
+		parents[i] = (i % GROUP) ? i - i % GROUP : NO_PARENT;
+	}
+
+	// what the demos did: every matrix rebuilt from a translate, rotate and scale chain every frame
+	std::vector<glm::mat4> chained(objectCount);
+	auto chainStart = std::chrono::high_resolution_clock::now();
+	for (unsigned int frame = 0; frame < FRAMES; ++frame)
+	{
+		for (unsigned int i = 0; i < objectCount; ++i)
+		{
+			glm::mat4 local = glm::translate(glm::mat4(1.0f), positions[i]) * glm::mat4_cast(rotations[i]);
+			local = glm::scale(local, scales[i]);
+			chained[i] = parents[i] == NO_PARENT ? local : chained[parents[i]] * local;
+		}
+	}
+	float chainMs = ElapsedMs(chainStart) / FRAMES;
+
+	ThreadPool pool;
+	std::cout << "Transform benchmark: " << objectCount << " transforms in groups of " << GROUP << ", " << FRAMES << " frames, " << pool.GetThreadCount() << " threads" << std::endl;
+	std::cout << "  glm translate/rotate/scale chain: " << chainMs << " ms" << std::endl;
+
+	float maxError = 0.0f;
+	for (ThreadPool* workers : { (ThreadPool*)nullptr, &pool })
+	{
+		TransformSystem transforms(workers);
+		for (unsigned int i = 0; i < objectCount; ++i)
+			transforms.Create(positions[i], rotations[i], scales[i], parents[i]);
+		transforms.Update();
+
+		// every transform moved, then a tenth of them (with whatever hangs off them)
+		for (unsigned int stride : { 1u, 10u })
+		{
+			float updateMs = 0.0f;
+			unsigned int updated = 0;
+			for (unsigned int frame = 0; frame < FRAMES; ++frame)
+			{
+				for (unsigned int i = 0; i < objectCount; i += stride)
+					transforms.SetPosition(i, positions[i]);
+				transforms.Update();
+				updateMs += transforms.GetStats().updateMs;
+				updated = transforms.GetStats().updated;
+			}
+			std::cout << "  TransformSystem, " << (workers ? "pool" : "1 thread") << ", every " << (stride == 1 ? "transform" : "10th transform") << " moved: "
+				<< updateMs / FRAMES << " ms, " << updated << " updated" << std::endl;
+		}
+
+		for (unsigned int i = 0; i < objectCount; ++i)
+			for (int column = 0; column < 4; ++column)
+				for (int row = 0; row < 4; ++row)
+					maxError = std::max(maxError, std::abs(transforms.GetWorld(i)[column][row] - chained[i][column][row]));
+	}
+	std::cout << "  largest difference from the chain: " << maxError << std::endl;
+	return maxError < 1e-3f ? 0 : 1;
+}
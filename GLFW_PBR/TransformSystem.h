@@ -0,0 +1,74 @@
+#pragma once
+
+#include <GLM/glm.hpp>
+#include <GLM/gtc/quaternion.hpp>
+#include <vector>
+
+class ThreadPool;
+
+const unsigned int NO_PARENT = 0xffffffff;
+
+struct TransformStats
+{
+	unsigned int transforms = 0;
+	unsigned int updated = 0; // world matrices recomputed by the last Update
+	unsigned int levels = 0;  // hierarchy depths it went through
+	float updateMs = 0.0f;
+};
+
+// Positions, rotations and scales of every object, one array per component,
+// with their world matrices cached. Setters only mark a transform dirty;
+// Update recomputes the dirty ones and everything below them, four at a time:
+// the translation * rotation * scale matrices come straight out of the
+// component arrays with SSE, then a child is multiplied by its parent's world
+// matrix. A parent is always created before its children, so each hierarchy
+// depth is one pass in index order and the transforms of a pass are split
+// into ranges across the worker pool.
+class TransformSystem
+{
+private:
+	std::vector<float> m_PositionX, m_PositionY, m_PositionZ;
+	std::vector<float> m_RotationX, m_RotationY, m_RotationZ, m_RotationW;
+	std::vector<float> m_ScaleX, m_ScaleY, m_ScaleZ;
+	std::vector<unsigned int> m_Parents;
+	std::vector<unsigned int> m_Depths;
+	std::vector<unsigned char> m_Dirty;
+	std::vector<glm::mat4> m_World;
+	unsigned int m_MaxDepth;
+	ThreadPool* m_Pool;
+	TransformStats m_Stats;
+
+public:
+	// No pool updates on the calling thread
+	TransformSystem(ThreadPool* pool = nullptr);
+
+	// Returns the new transform's index; parent has to exist already
+	unsigned int Create(const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f), unsigned int parent = NO_PARENT);
+	void Clear();
+
+	// Relative to the parent, if any
+	void SetPosition(unsigned int transform, const glm::vec3& position);
+	void SetRotation(unsigned int transform, const glm::quat& rotation);
+	void SetScale(unsigned int transform, const glm::vec3& scale);
+	glm::vec3 GetPosition(unsigned int transform) const;
+	glm::quat GetRotation(unsigned int transform) const;
+	glm::vec3 GetScale(unsigned int transform) const;
+	unsigned int GetParent(unsigned int transform) const;
+
+	void Update();
+
+	// As of the last Update
+	const glm::mat4& GetWorld(unsigned int transform) const;
+	const std::vector<glm::mat4>& GetWorldMatrices() const;
+	unsigned int GetCount() const;
+	const TransformStats& GetStats() const;
+
+private:
+	// Returns how many it recomputed
+	unsigned int UpdateRange(unsigned int first, unsigned int count, unsigned int depth);
+};
+
+// Updates objectCount transforms a frame, every one of them and then a tenth,
+// on one thread and across the pool, against rebuilding each matrix with
+// glm::translate, glm::mat4_cast and glm::scale; prints the timings.
+int RunTransformBenchmark(unsigned int objectCount);
@@ -2,8 +2,12 @@
 #version 330 core
 layout(location = 0) in vec3 aPos;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
 
 out vec3 localPos;
 
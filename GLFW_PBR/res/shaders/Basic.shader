@@ -16,12 +16,15 @@ out VS_OUT
 	vec3 TangentFragPos;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
 uniform mat4 model;
 
 uniform vec3 lightPos;
-uniform vec3 viewPos;
 
 void main()
 {
@@ -60,13 +63,20 @@ uniform sampler2D specularMap;
 uniform sampler2D normalMap;
 
 uniform vec3 lightPos;
-uniform vec3 viewPos;
+
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
 
 void main()
 {
 	vec3 color = texture(diffuseMap, fs_in.TexCoords).rgb;
-	vec3 normal = texture(normalMap, fs_in.TexCoords).rgb;
-	normal = normalize(normal * 2.0 - 1.0);
+	vec3 normal;
+	normal.xy = texture(normalMap, fs_in.TexCoords).rg * 2.0 - 1.0;
+	normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
 
 	vec3 ambient = 0.9 * color;
 	vec3 lighting = ambient;
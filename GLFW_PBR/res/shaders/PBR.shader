@@ -4,24 +4,39 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec2 aTexCoords;
 layout(location = 2) in vec3 aNormal;
 
+// Per-instance data, see InstanceBuffer
+layout(location = 3) in mat4 aInstanceModel;
+layout(location = 7) in vec4 aInstanceParams;
+layout(location = 8) in vec4 aInstanceColor;
+
 out VS_OUT
 {
 	vec2 TexCoords;
 	vec3 WorldPos;
 	vec3 Normal;
+	vec4 InstanceParams;
+	vec3 InstanceColor;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
 uniform mat4 model;
+uniform bool instanced;
 
 void main()
 {
+	mat4 world = (instanced ? aInstanceModel : model);
 	vs_out.TexCoords = aTexCoords;
-	vs_out.WorldPos = vec3(model * vec4(aPos, 1.0));
-	//vs_out.Normal = transpose(inverse(mat3(model))) * aNormal;
-	vs_out.Normal = mat3(model) * aNormal;
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	vs_out.WorldPos = vec3(world * vec4(aPos, 1.0));
+	//vs_out.Normal = transpose(inverse(mat3(world))) * aNormal;
+	vs_out.Normal = mat3(world) * aNormal;
+	vs_out.InstanceParams = aInstanceParams;
+	vs_out.InstanceColor = aInstanceColor.rgb;
+	gl_Position = projection * view * world * vec4(aPos, 1.0);
 };
 
 #shader fragment
@@ -33,6 +48,8 @@ in VS_OUT
 	vec2 TexCoords;
 	vec3 WorldPos;
 	vec3 Normal;
+	vec4 InstanceParams;
+	vec3 InstanceColor;
 } fs_in;
 
 // Material sample textures
@@ -50,16 +67,33 @@ uniform float aoF;
 
 uniform bool aoTexture;
 uniform bool texture_none;
+uniform bool instanced; // metallic/roughness (x/y) and light colour come from the instance
 
 // IBL
 uniform samplerCube irradianceMap;
 uniform samplerCube prefilterMap;
 uniform sampler2D brdfLUT;
 
-// Lights
-uniform vec3 lightPositions[5];
-uniform vec3 lightColors[5];
-uniform vec3 viewPos;
+// Irradiance as L2 spherical harmonics, replaces the irradianceMap lookup when enabled
+uniform bool shIrradiance;
+layout(std140) uniform SHIrradiance
+{
+	vec3 shCoefficients[9];
+};
+
+// Lights, vec3 arrays have a 16 byte stride under std140
+layout(std140) uniform Lights
+{
+	vec3 lightPositions[5];
+	vec3 lightColors[5];
+};
+
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
 uniform bool lightSource;
 
 const float PI = 3.14159265359;
@@ -70,13 +104,14 @@ float GeometrySchlickGGX(float NdotV, float roughness);
 float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness);
 vec3 fresnelSchlick(float cosTheta, vec3 F0);
 vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness);
+vec3 irradianceSH(vec3 n);
 
 void main()
 {
 	// material properties
 	vec3 albedo = (texture_none ? albedoF : pow(texture(albedoMap, fs_in.TexCoords).rgb, vec3(2.2)));
-	float metallic = (texture_none ? metallicF : texture(metallicMap, fs_in.TexCoords).r);
-	float roughness = (texture_none ? roughnessF : texture(roughnessMap, fs_in.TexCoords).r);// (roughnessTexture ? texture(roughnessMap, fs_in.TexCoords).r : roughnessF));
+	float metallic = (texture_none ? (instanced ? fs_in.InstanceParams.x : metallicF) : texture(metallicMap, fs_in.TexCoords).r);
+	float roughness = (texture_none ? (instanced ? fs_in.InstanceParams.y : roughnessF) : texture(roughnessMap, fs_in.TexCoords).r);// (roughnessTexture ? texture(roughnessMap, fs_in.TexCoords).r : roughnessF));
 	float ao = (texture_none ? aoF : (aoTexture ? texture(aoMap, fs_in.TexCoords).r : aoF));
 	
 	vec3 N = (texture_none ? fs_in.Normal : getNormalFromMap()); // Get normals from map
@@ -123,7 +158,7 @@ void main()
 	vec3 kS = F;
 	vec3 kD = 1.0 - kS;
 	kD *= 1.0 - metallic;
-	vec3 irradiance = texture(irradianceMap, N).rgb;
+	vec3 irradiance = (shIrradiance ? irradianceSH(N) : texture(irradianceMap, N).rgb);
 	vec3 diffuse = irradiance * albedo;
 
 	// sample both the prefilter and  the BRDF lut combining them together as per the Split-Sum approximation to get IBL specular part
@@ -139,13 +174,16 @@ void main()
 	color = color / (color + vec3(1.0)); // HDR tonemapping
 	color = pow(color, vec3(1.0 / 2.2)); // gamma correction
 
-	FragColor = (lightSource ? vec4(lightColors[0], 1.0) : vec4(color, 1.0));
+	FragColor = (lightSource ? vec4(instanced ? fs_in.InstanceColor : lightColors[0], 1.0) : vec4(color, 1.0));
 	//FragColor = vec4(color, 1.0);
 };
 
 vec3 getNormalFromMap()
 {
-	vec3 tangentNormal = texture(normalMap, fs_in.TexCoords).xyz * 2.0 - 0.5;
+	// z is rebuilt from x and y so BC5 normal maps (red and green only) work too
+	vec3 tangentNormal;
+	tangentNormal.xy = texture(normalMap, fs_in.TexCoords).rg * 2.0 - 1.0;
+	tangentNormal.z = sqrt(max(1.0 - dot(tangentNormal.xy, tangentNormal.xy), 0.0));
 
 	vec3 Q1 = dFdx(fs_in.WorldPos);
 	vec3 Q2 = dFdy(fs_in.WorldPos);
@@ -203,4 +241,19 @@ vec3 fresnelSchlick(float cosTheta, vec3 F0)
 vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
 {
 	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+vec3 irradianceSH(vec3 n)
+{
+	n = normalize(n);
+	vec3 result = shCoefficients[0] * 0.282095
+		+ shCoefficients[1] * 0.488603 * n.y
+		+ shCoefficients[2] * 0.488603 * n.z
+		+ shCoefficients[3] * 0.488603 * n.x
+		+ shCoefficients[4] * 1.092548 * n.x * n.y
+		+ shCoefficients[5] * 1.092548 * n.y * n.z
+		+ shCoefficients[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+		+ shCoefficients[7] * 1.092548 * n.x * n.z
+		+ shCoefficients[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+	return max(result, vec3(0.0));
 }
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "AssetRegistry.h"
+#include "Model.h"
+#include "TextureBatch.h"
+
+#include <GLAD/glad.h>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <climits>
+
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+{
+	// FNV-1a, 64-bit
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; ++i)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+AssetRegistry::AssetRegistry() : m_Hits(0), m_Misses(0)
+{
+}
+
+AssetRegistry& AssetRegistry::Get()
+{
+	static AssetRegistry registry;
+	return registry;
+}
+
+std::string AssetRegistry::CanonicalPath(const std::string& path)
+{
+	std::string canonical = path;
+#ifdef _WIN32
+	char buffer[_MAX_PATH];
+	if (_fullpath(buffer, path.c_str(), _MAX_PATH))
+		canonical = buffer;
+	std::replace(canonical.begin(), canonical.end(), '\\', '/');
+	std::transform(canonical.begin(), canonical.end(), canonical.begin(), ::tolower);
+#else
+	char buffer[PATH_MAX];
+	if (realpath(path.c_str(), buffer))
+		canonical = buffer;
+#endif
+	return canonical;
+}
+
+std::shared_ptr<TextureAsset> AssetRegistry::AcquireTexture(const std::string& path, bool gammaCorrection, TextureBatch& batch)
+{
+	std::string key = CanonicalPath(path) + (gammaCorrection ? "|srgb" : "|linear");
+	auto found = m_Textures.find(key);
+	if (found != m_Textures.end())
+	{
+		if (std::shared_ptr<TextureAsset> texture = found->second.lock())
+		{
+			++m_Hits;
+			return texture;
+		}
+	}
+
+	++m_Misses;
+	TextureAsset* asset = new TextureAsset();
+	asset->id = batch.Add(path, gammaCorrection);
+	asset->key = key;
+	asset->path = path;
+	std::shared_ptr<TextureAsset> texture(asset, [this](TextureAsset* released)
+	{
+		glDeleteTextures(1, &released->id);
+		auto entry = m_Textures.find(released->key);
+		if (entry != m_Textures.end() && entry->second.expired())
+			m_Textures.erase(entry);
+		delete released;
+	});
+	m_Textures[key] = texture;
+	return texture;
+}
+
+std::string AssetRegistry::MeshKey(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount, const std::vector<Texture>& textures, VertexLayout layout, const VertexBounds* bounds, const std::vector<MeshLod>* lods) const
+{
+	uint64_t hash = 14695981039346656037ull;
+	hash = HashBytes(hash, vertexData, (size_t)vertexCount * sizeof(Vertex));
+	hash = HashBytes(hash, indexData, (size_t)indexCount * sizeof(unsigned int));
+	if (bounds && layout == VERTEX_LAYOUT_QUANTIZED)
+	{
+		hash = HashBytes(hash, &bounds->minimum, sizeof(bounds->minimum));
+		hash = HashBytes(hash, &bounds->maximum, sizeof(bounds->maximum));
+	}
+	if (lods)
+		hash = HashBytes(hash, lods->data(), lods->size() * sizeof(MeshLod));
+
+	// counts and textures stay readable in the key, the hash only has to tell the data apart
+	std::string key = std::to_string(hash) + "|" + std::to_string(vertexCount) + "|" + std::to_string(indexCount) + "|" + std::to_string(layout);
+	for (const Texture& texture : textures)
+		key += "|" + std::to_string(texture.id) + texture.type;
+	return key;
+}
+
+std::shared_ptr<Mesh> AssetRegistry::FindMesh(const std::string& key)
+{
+	auto found = m_Meshes.find(key);
+	if (found == m_Meshes.end())
+		return nullptr;
+	std::shared_ptr<Mesh> mesh = found->second.lock();
+	if (mesh)
+		++m_Hits;
+	return mesh;
+}
+
+std::shared_ptr<Mesh> AssetRegistry::Register(const std::string& key, Mesh* mesh)
+{
+	++m_Misses;
+	std::shared_ptr<Mesh> handle(mesh, [this, key](Mesh* released)
+	{
+		released->Release();
+		auto entry = m_Meshes.find(key);
+		if (entry != m_Meshes.end() && entry->second.expired())
+			m_Meshes.erase(entry);
+		delete released;
+	});
+	m_Meshes[key] = handle;
+	return handle;
+}
+
+std::shared_ptr<Mesh> AssetRegistry::AcquireMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<Texture>& textures, VertexLayout layout, const VertexBounds* bounds, const std::vector<MeshLod>* lods)
+{
+	std::string key = MeshKey(vertices.data(), (unsigned int)vertices.size(), indices.data(), (unsigned int)indices.size(), textures, layout, bounds, lods);
+	if (std::shared_ptr<Mesh> mesh = FindMesh(key))
+	{
+		// the first owner may have come from a mesh cache mapping, whoever writes a cache next needs the data
+		if (mesh->vertices.empty())
+		{
+			mesh->vertices = vertices;
+			mesh->indices = indices;
+		}
+		return mesh;
+	}
+	return Register(key, new Mesh(vertices, indices, textures, layout, bounds, lods));
+}
+
+std::shared_ptr<Mesh> AssetRegistry::AcquireMesh(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount, std::vector<Texture>& textures, VertexLayout layout, const VertexBounds* bounds, const std::vector<MeshLod>* lods)
+{
+	std::string key = MeshKey(vertexData, vertexCount, indexData, indexCount, textures, layout, bounds, lods);
+	if (std::shared_ptr<Mesh> mesh = FindMesh(key))
+		return mesh;
+	return Register(key, new Mesh(vertexData, vertexCount, indexData, indexCount, textures, layout, bounds, lods));
+}
+
+std::shared_ptr<Model> AssetRegistry::AcquireModel(const std::string& path, bool gammaCorrection, VertexLayout layout)
+{
+	std::string key = CanonicalPath(path) + (gammaCorrection ? "|srgb|" : "|linear|") + GetVertexLayoutName(layout);
+	auto found = m_Models.find(key);
+	if (found != m_Models.end())
+	{
+		if (std::shared_ptr<Model> model = found->second.lock())
+		{
+			++m_Hits;
+			return model;
+		}
+	}
+
+	++m_Misses;
+	std::shared_ptr<Model> model(new Model(path, gammaCorrection, layout), [this, key](Model* released)
+	{
+		// the model's own handles go with it, anything it alone used is freed here
+		delete released;
+		auto entry = m_Models.find(key);
+		if (entry != m_Models.end() && entry->second.expired())
+			m_Models.erase(entry);
+	});
+	m_Models[key] = model;
+	return model;
+}
+
+size_t AssetRegistry::GetTextureBytes(unsigned int id)
+{
+	GLint previous = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+	glBindTexture(GL_TEXTURE_2D, id);
+
+	size_t bytes = 0;
+	for (GLint level = 0; level < 16; ++level)
+	{
+		GLint width = 0, height = 0, compressed = GL_FALSE;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+		if (width == 0 || height == 0)
+			break;
+
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+		if (compressed)
+		{
+			GLint size = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+			bytes += size;
+			continue;
+		}
+
+		// drivers pad three channel formats to four, count what GL says it stores
+		GLint bits[4] = { 0, 0, 0, 0 };
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_RED_SIZE, &bits[0]);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_GREEN_SIZE, &bits[1]);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_BLUE_SIZE, &bits[2]);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_ALPHA_SIZE, &bits[3]);
+		bytes += (size_t)width * height * (bits[0] + bits[1] + bits[2] + bits[3]) / 8;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, previous);
+	return bytes;
+}
+
+size_t AssetRegistry::GetMeshBytes(const Mesh& mesh)
+{
+	return (size_t)mesh.vertexCount * GetVertexStride(mesh.layout) + (size_t)mesh.indexCount * (mesh.indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+}
+
+AssetRegistryStats AssetRegistry::GetStats()
+{
+	AssetRegistryStats stats;
+	stats.hits = m_Hits;
+	stats.misses = m_Misses;
+	for (auto& entry : m_Models)
+		if (!entry.second.expired())
+			++stats.liveModels;
+	for (auto& entry : m_Meshes)
+	{
+		if (std::shared_ptr<Mesh> mesh = entry.second.lock())
+		{
+			++stats.liveMeshes;
+			stats.meshBytes += GetMeshBytes(*mesh);
+		}
+	}
+	for (auto& entry : m_Textures)
+	{
+		if (std::shared_ptr<TextureAsset> texture = entry.second.lock())
+		{
+			if (texture->bytes == 0)
+				texture->bytes = GetTextureBytes(texture->id);
+			++stats.liveTextures;
+			stats.textureBytes += texture->bytes;
+		}
+	}
+	return stats;
+}
+
+void AssetRegistry::PrintReport()
+{
+	AssetRegistryStats stats = GetStats();
+	std::cout << "Assets: " << stats.liveModels << " models, " << stats.liveMeshes << " meshes (" << stats.meshBytes / 1024 << " KB), "
+		<< stats.liveTextures << " textures (" << stats.textureBytes / (1024 * 1024) << " MB); " << stats.hits << " shared, " << stats.misses << " loaded" << std::endl;
+
+	// users leaves out the reference this report holds
+	for (auto& entry : m_Models)
+	{
+		std::shared_ptr<Model> model = entry.second.lock();
+		if (!model)
+			continue;
+		size_t meshBytes = 0;
+		for (const std::shared_ptr<Mesh>& mesh : model->meshes)
+			meshBytes += GetMeshBytes(*mesh);
+		size_t textureBytes = 0;
+		for (auto& texture : model->textures_loaded)
+			textureBytes += texture.second->bytes;
+		std::cout << "  model   " << entry.first << ": " << model->meshes.size() << " meshes " << meshBytes / 1024 << " KB, "
+			<< model->textures_loaded.size() << " textures " << textureBytes / (1024 * 1024) << " MB, " << model.use_count() - 1 << " users" << std::endl;
+	}
+
+	std::vector<std::shared_ptr<TextureAsset>> textures;
+	for (auto& entry : m_Textures)
+		if (std::shared_ptr<TextureAsset> texture = entry.second.lock())
+			textures.push_back(texture);
+	std::sort(textures.begin(), textures.end(), [](const std::shared_ptr<TextureAsset>& a, const std::shared_ptr<TextureAsset>& b) { return a->bytes > b->bytes; });
+	for (const std::shared_ptr<TextureAsset>& texture : textures)
+		std::cout << "  texture " << texture->key << ": " << texture->bytes / 1024 << " KB, " << texture.use_count() - 1 << " users" << std::endl;
+}
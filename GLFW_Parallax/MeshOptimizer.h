@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Mesh.h"
+#include <vector>
+#include <cstddef>
+
+// Post-transform cache size AnalyzeVertexCache simulates, a FIFO of this many vertices
+const unsigned int MESH_ANALYZE_CACHE_SIZE = 16;
+
+// ACMR: vertex shader runs per triangle, 0.5 at best on a regular grid and 3 with no reuse.
+// ATVR: vertex shader runs per unique vertex, 1 means every vertex is transformed once.
+struct VertexCacheStats
+{
+	float acmr = 0.0f;
+	float atvr = 0.0f;
+};
+
+struct MeshOptimizeStats
+{
+	unsigned int triangles = 0;
+	unsigned int verticesBefore = 0;
+	unsigned int verticesAfter = 0;
+	VertexCacheStats before;
+	VertexCacheStats after;
+	float ms = 0.0f;
+};
+
+// Import-time reordering of an indexed triangle list. None of these change
+// what is drawn, only the order the GPU sees the triangles and vertices in.
+
+// Merges bitwise identical vertices and drops unreferenced ones, returns the new vertex count
+unsigned int WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+// Reorders triangles for the post-transform vertex cache (Forsyth's linear-speed optimizer)
+void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount);
+// Reorders clusters of an already cache-optimized list so outward facing ones draw first
+// (Sander, Nehab and Barczak), giving up at most threshold times the ACMR
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+// Renumbers vertices in the order the indices first use them
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, unsigned int cacheSize = MESH_ANALYZE_CACHE_SIZE);
+
+// Every stage above in order, with the cache statistics before and after
+MeshOptimizeStats OptimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
@@ -1,48 +1,92 @@
 #include "Mesh.h"
 #include <iostream>
+#include <algorithm>
 
-Mesh::Mesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, std::vector<Texture> &textures)
+Mesh::Mesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, std::vector<Texture> &textures, VertexLayout layout, const VertexBounds* bounds, const std::vector<MeshLod>* lods)
 {
+	this->layout = layout;
 	this->vertices = vertices;
 	this->indices = indices;
 	this->textures = textures;
+	this->indexCount = (unsigned int)indices.size();
 
-	SetUpMesh();
+	SetUpMesh(vertices.data(), (unsigned int)vertices.size(), indices.data(), bounds, lods);
 }
 
-void Mesh::SetUpMesh()
+Mesh::Mesh(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount, std::vector<Texture> &textures, VertexLayout layout, const VertexBounds* bounds, const std::vector<MeshLod>* lods)
 {
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	this->layout = layout;
+	this->textures = textures;
+	this->indexCount = indexCount;
 
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	SetUpMesh(vertexData, vertexCount, indexData, bounds, lods);
+}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+void Mesh::SetUpMesh(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, const VertexBounds* bounds, const std::vector<MeshLod>* lods)
+{
+	this->vertexCount = vertexCount;
+	if (lods && !lods->empty())
+		this->lods = *lods;
+	else
+		this->lods.assign(1, MeshLod{ 0, indexCount, 0.0f });
 
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	const void* gpuVertices = vertexData;
+	QuantizedMesh quantized;
+	bool halfTexCoords = false;
+	positionOffset = glm::vec3(0.0f);
+	positionScale = glm::vec3(1.0f);
+	if (layout == VERTEX_LAYOUT_QUANTIZED)
+	{
+		quantized = bounds ? QuantizeVertices(vertexData, vertexCount, *bounds) : QuantizeVertices(vertexData, vertexCount);
+		gpuVertices = quantized.vertices.data();
+		positionOffset = quantized.positionOffset;
+		positionScale = quantized.positionScale;
+		halfTexCoords = quantized.halfTexCoords;
+		quantizationError = quantized.error;
+	}
 
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+	// half the index bandwidth for meshes of up to 65536 vertices, which is most of them
+	const void* gpuIndices = indexData;
+	std::vector<unsigned short> shortIndices;
+	indexType = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	if (indexType == GL_UNSIGNED_SHORT)
+	{
+		shortIndices.assign(indexData, indexData + indexCount);
+		gpuIndices = shortIndices.data();
+	}
 
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+	arena = &MeshArena::Get(layout, halfTexCoords, indexType);
+	allocation = arena->Allocate(gpuVertices, vertexCount, gpuIndices, indexCount);
+	VAO = arena->GetVAO();
+}
 
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+void Mesh::Release()
+{
+	if (arena)
+		arena->Free(allocation);
+	arena = nullptr;
+	allocation = MeshAllocation();
+	VAO = 0;
+}
 
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+const MeshLod& Mesh::GetLod(unsigned int lod) const
+{
+	return lods[std::min(lod, (unsigned int)lods.size() - 1)];
+}
 
+void const Mesh::Draw(Shader &shader, unsigned int lod)
+{
+	const MeshLod& level = GetLod(lod);
+	BindTextures(shader);
+	SetLayoutUniforms(shader, true);
+	glBindVertexArray(VAO);
+	glDrawElementsBaseVertex(GL_TRIANGLES, level.indexCount, indexType, (void*)((size_t)(allocation.firstIndex + level.firstIndex) * arena->GetIndexSize()), allocation.baseVertex);
 	glBindVertexArray(0);
+	SetLayoutUniforms(shader, false);
+	glActiveTexture(GL_TEXTURE0);
 }
 
-void const Mesh::Draw(Shader &shader)
+void Mesh::BindTextures(Shader &shader)
 {
 	unsigned int diffuseNr = 1;
 	unsigned int specularNr = 1;
@@ -65,8 +109,17 @@ void const Mesh::Draw(Shader &shader)
 		glUniform1i(glGetUniformLocation(shader.GetID(), (name + number).c_str()), i);
 		glBindTexture(GL_TEXTURE_2D, textures[i].id);
 	}
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
-	glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::SetLayoutUniforms(Shader &shader, bool enabled)
+{
+	// float meshes leave the shader's default, quantized ones switch it on around their draw
+	if (layout != VERTEX_LAYOUT_QUANTIZED)
+		return;
+	glUniform1i(glGetUniformLocation(shader.GetID(), "quantized"), enabled);
+	if (enabled)
+	{
+		glUniform3fv(glGetUniformLocation(shader.GetID(), "positionOffset"), 1, &positionOffset[0]);
+		glUniform3fv(glGetUniformLocation(shader.GetID(), "positionScale"), 1, &positionScale[0]);
+	}
 }
\ No newline at end of file
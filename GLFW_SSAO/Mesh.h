@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Shader.h"
+#include "VertexFormat.h"
+#include "MeshArena.h"
 #include <GLM/glm.hpp>
 #include <vector>
 #include <string>
@@ -14,6 +16,15 @@ struct Vertex
 	glm::vec3 Bitangent;
 };
 
+// One level of detail: a range of the mesh's indices, all levels share its vertices.
+// error bounds how far the level strays from the full mesh, in model units.
+struct MeshLod
+{
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	float error;
+};
+
 struct Texture
 {
 	unsigned int id;
@@ -24,15 +35,34 @@ struct Texture
 class Mesh
 {
 public:
+	// CPU copies, left empty when the mesh is uploaded straight from a MeshCache mapping
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
-	unsigned int VAO;
+	unsigned int VAO; // the arena's, shared by every mesh of the same format
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int indexType; // GL_UNSIGNED_SHORT when every vertex fits in 16 bits
+	VertexLayout layout;
+	glm::vec3 positionOffset; // dequantizes VERTEX_LAYOUT_QUANTIZED positions, see VertexFormat.h
+	glm::vec3 positionScale;
+	VertexQuantizationError quantizationError;
+	MeshArena* arena; // the megabuffer the vertices and indices were suballocated from
+	MeshAllocation allocation;
+	std::vector<MeshLod> lods; // full detail first, indexCount covers every level
 
-	Mesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, std::vector<Texture> &textures);
-	void const Draw(Shader &shader);
+	// Without lods the whole index range is the only level
+	Mesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, std::vector<Texture> &textures, VertexLayout layout = VERTEX_LAYOUT_FLOAT, const VertexBounds* bounds = nullptr, const std::vector<MeshLod>* lods = nullptr);
+	Mesh(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount, std::vector<Texture> &textures, VertexLayout layout = VERTEX_LAYOUT_FLOAT, const VertexBounds* bounds = nullptr, const std::vector<MeshLod>* lods = nullptr);
+	void const Draw(Shader &shader, unsigned int lod = 0);
+	// Past the coarsest level clamps to it
+	const MeshLod& GetLod(unsigned int lod) const;
+	// Returns the mesh's ranges to its arena, the mesh must not be drawn afterwards
+	void Release();
+	// Material and quantization state of a draw, Model sets them once for a batch of meshes sharing them
+	void BindTextures(Shader &shader);
+	void SetLayoutUniforms(Shader &shader, bool enabled);
 
 private:
-	unsigned int VBO, EBO;
-	void SetUpMesh();
+	void SetUpMesh(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, const VertexBounds* bounds, const std::vector<MeshLod>* lods);
 };
\ No newline at end of file
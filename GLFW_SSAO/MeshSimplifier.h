@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Mesh.h"
+#include <vector>
+
+// Levels BuildLodChain aims for, full detail included
+const unsigned int MESH_MAX_LODS = 5;
+
+struct MeshSimplifyResult
+{
+	std::vector<unsigned int> indices;
+	float error = 0.0f; // bound on the distance from the original surface, model units
+};
+
+// Quadric error metric simplification (Garland and Heckbert) by edge collapse.
+// A vertex is only ever collapsed onto one of its neighbours, never moved, so
+// every level indexes the same vertex buffer as the full mesh. Vertices on a
+// border or a seam (one position, several vertices: UV or normal splits) stay
+// put so the silhouette and texture layout hold together. The error is the
+// square root of the largest area weighted quadric cost of any collapse made.
+MeshSimplifyResult SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int targetIndexCount);
+
+// Appends up to levelCount - 1 coarser levels to indices, each about half the
+// triangles of the one before and cache optimized, and returns their ranges
+// with level 0 being the original indices. Stops early once a level no longer
+// removes at least a quarter of the triangles.
+std::vector<MeshLod> BuildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, unsigned int levelCount = MESH_MAX_LODS);
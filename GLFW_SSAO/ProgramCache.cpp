@@ -0,0 +1,166 @@
+#include "ProgramCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+static const uint32_t PROGRAM_CACHE_MAGIC = 0x43425047; // "GPBC"
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+// Drivers produce binaries of a few hundred KB at most, anything past this is a corrupt length
+static const uint64_t PROGRAM_CACHE_MAX_BINARY = 64ull << 20;
+
+ProgramCache::ProgramCache(const std::string& filepath) : m_FilePath(filepath), m_Hash(14695981039346656037ull)
+{
+	AddValue(PROGRAM_CACHE_VERSION);
+}
+
+ProgramCache ProgramCache::ForProgram(const std::string& shaderPath, const std::string& defines,
+	const std::string& vertexSource, const std::string& fragmentSource)
+{
+	// every permutation of a shader gets a file of its own, so switching between them does not thrash one
+	std::string filepath = shaderPath;
+	if (!defines.empty())
+	{
+		ProgramCache permutation("");
+		permutation.AddString(defines);
+		std::stringstream name;
+		name << shaderPath << "." << std::hex << permutation.GetHash();
+		filepath = name.str();
+	}
+
+	ProgramCache cache(filepath + ".programcache");
+	cache.AddString(vertexSource);
+	cache.AddString(fragmentSource);
+	cache.AddString(defines);
+	cache.AddString((const char*)glGetString(GL_VENDOR));
+	cache.AddString((const char*)glGetString(GL_RENDERER));
+	cache.AddString((const char*)glGetString(GL_VERSION));
+	return cache;
+}
+
+bool ProgramCache::IsSupported()
+{
+	if (!GLAD_GL_VERSION_4_1)
+		return false;
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+void ProgramCache::HashBytes(const void* data, size_t size)
+{
+	// 64-bit FNV-1a
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		m_Hash ^= bytes[i];
+		m_Hash *= 1099511628211ull;
+	}
+}
+
+void ProgramCache::AddString(const std::string& value)
+{
+	// the length keeps "ab" + "c" apart from "a" + "bc"
+	AddValue(value.size());
+	HashBytes(value.data(), value.size());
+}
+
+void ProgramCache::AddValue(uint64_t value)
+{
+	HashBytes(&value, sizeof(value));
+}
+
+uint64_t ProgramCache::GetHash() const
+{
+	return m_Hash;
+}
+
+const std::string& ProgramCache::GetFilePath() const
+{
+	return m_FilePath;
+}
+
+unsigned int ProgramCache::Load()
+{
+	if (!IsSupported())
+		return 0;
+
+	std::ifstream stream(m_FilePath, std::ios::binary);
+	if (!stream)
+		return 0;
+
+	uint32_t magic = 0, version = 0, format = 0;
+	uint64_t hash = 0, length = 0;
+	stream.read((char*)&magic, sizeof(magic));
+	stream.read((char*)&version, sizeof(version));
+	stream.read((char*)&hash, sizeof(hash));
+	stream.read((char*)&format, sizeof(format));
+	stream.read((char*)&length, sizeof(length));
+	if (!stream || magic != PROGRAM_CACHE_MAGIC || version != PROGRAM_CACHE_VERSION || hash != m_Hash)
+	{
+		std::cout << "Program cache is stale, compiling from source: " << m_FilePath << std::endl;
+		return 0;
+	}
+
+	std::vector<char> binary(length <= PROGRAM_CACHE_MAX_BINARY ? (size_t)length : 0);
+	stream.read(binary.data(), binary.size());
+	if (!stream || binary.empty())
+	{
+		std::cout << "Program cache is corrupt, compiling from source: " << m_FilePath << std::endl;
+		return 0;
+	}
+
+	unsigned int program = glCreateProgram();
+	glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+
+	// a driver update can keep the version string and still turn old binaries down
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE)
+	{
+		glGetError(); // an unknown format also raises GL_INVALID_ENUM, the miss is handled here
+		glDeleteProgram(program);
+		std::cout << "Program cache rejected by the driver, compiling from source: " << m_FilePath << std::endl;
+		return 0;
+	}
+	return program;
+}
+
+bool ProgramCache::Save(unsigned int program)
+{
+	if (!IsSupported())
+		return false;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	{
+		std::cout << "Program cache: driver returned no binary for " << m_FilePath << std::endl;
+		return false;
+	}
+
+	std::vector<char> binary(length);
+	GLenum format = GL_NONE;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+
+	std::ofstream stream(m_FilePath, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		std::cout << "Program cache: unable to write " << m_FilePath << std::endl;
+		return false;
+	}
+
+	uint32_t binaryFormat = format;
+	uint64_t binaryLength = (uint64_t)length;
+	stream.write((const char*)&PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+	stream.write((const char*)&PROGRAM_CACHE_VERSION, sizeof(PROGRAM_CACHE_VERSION));
+	stream.write((const char*)&m_Hash, sizeof(m_Hash));
+	stream.write((const char*)&binaryFormat, sizeof(binaryFormat));
+	stream.write((const char*)&binaryLength, sizeof(binaryLength));
+	stream.write(binary.data(), length);
+
+	std::cout << "Program cache written: " << m_FilePath << std::endl;
+	return (bool)stream;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <chrono>
+
+class Shader;
+
+// How long a changed file has to stay quiet before its shaders are rebuilt
+const unsigned int SHADER_SETTLE_MS = 100;
+
+struct ShaderReloadStats
+{
+	unsigned int reloads = 0;  // programs rebuilt since the watcher started
+	unsigned int failures = 0; // of those, the ones that kept their previous program
+	std::string lastShader;
+	bool lastSucceeded = true;
+	float lastCompileMs = 0.0f;
+	float lastLinkMs = 0.0f;
+};
+
+// Watches the directories of a set of shaders' files, with inotify on Linux and
+// ReadDirectoryChangesW on Windows, and rebuilds only the shaders one of whose
+// files (the .shader or anything it includes) was written. Nothing blocks:
+// Poll reads whatever changes the system has queued and reloads on the calling
+// thread, which has to be the one that owns the GL context. Editors often write
+// a file in more than one step, so a change is picked up once the file has been
+// quiet for SHADER_SETTLE_MS.
+class ShaderWatcher
+{
+private:
+	struct Directory; // platform handles, see ShaderWatcher.cpp
+
+	std::vector<Shader*> m_Shaders;
+	std::vector<std::unique_ptr<Directory>> m_Directories;
+	std::unordered_map<std::string, std::chrono::steady_clock::time_point> m_Pending; // changed file, last write
+	int m_Notify; // inotify instance, unused on Windows
+	ShaderReloadStats m_Stats;
+
+public:
+	ShaderWatcher();
+	~ShaderWatcher();
+
+	ShaderWatcher(const ShaderWatcher&) = delete;
+	ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+	// The shader has to outlive the watcher
+	void Add(Shader& shader);
+	// Returns how many shaders it rebuilt, failed builds included
+	unsigned int Poll();
+
+	unsigned int GetShaderCount() const;
+	const ShaderReloadStats& GetStats() const;
+
+private:
+	void WatchFiles(const Shader& shader);
+	void WatchDirectory(const std::string& path);
+#ifdef _WIN32
+	// Queues the directory's next batch of changes
+	bool QueueRead(Directory& directory);
+#endif
+	// Appends the files written since the last call, as the shaders name them
+	void ReadChanges(std::vector<std::string>& files);
+};
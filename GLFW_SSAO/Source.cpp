@@ -6,8 +6,12 @@
 #include "IMGUI/imgui_impl_glfw_gl3.h"
 
 #include "Shader.h"
+#include "ShaderWatcher.h"
 #include "Camera.h"
+#include "Headless.h"
 #include "Model.h"
+#include "UniformBuffer.h"
+#include "GBuffer.h"
 
 #include <GLM/glm.hpp>
 #include <GLM/gtc/matrix_transform.hpp>
@@ -15,16 +19,43 @@
 
 #include <iostream>
 #include <random>
+#include <chrono>
 
-const unsigned int SCR_WIDTH = 1000;
-const unsigned int SCR_HEIGHT = 800;
+// window size, --width / --height replace it in headless mode
+unsigned int SCR_WIDTH = 1000;
+unsigned int SCR_HEIGHT = 800;
 
 float kernelSize = 64.0f;
 float radius = 0.5f;
 float bias = 0.025f;
 float power = 1.0f;
 
+// G-Buffer layout, packed rebuilds position from depth and stores octahedral normals
+bool packedGBuffer = false;
+
+// Uniform blocks, laid out std140 to match the shaders
+const unsigned int CAMERA_BINDING = 0;
+const unsigned int LIGHTS_BINDING = 1;
+const unsigned int SSAO_KERNEL_BINDING = 2;
+
+struct CameraUniforms
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 viewPos;
+};
+
+struct LightUniform
+{
+	glm::vec3 position;
+	float linear;
+	glm::vec3 color;
+	float quadratic;
+};
+static_assert(sizeof(LightUniform) == 32, "LightUniform must match the std140 Light struct");
+
 Camera camera(glm::vec3(0.0f, 0.0f, 5.0f));
+Headless headless;
 float lastX = (float)SCR_WIDTH / 2.0;
 float lastY = (float)SCR_HEIGHT / 2.0;
 bool firstMouse = true;
@@ -50,8 +81,10 @@ float lerp(float a, float b, float f)
 unsigned int quadVAO = 0, quadVBO;
 unsigned int cubeVAO = 0, cubeVBO;
 
-int main()
+int main(int argc, char** argv)
 {
+	headless.ParseArguments(argc, argv, SCR_WIDTH, SCR_HEIGHT);
+
 	GLFWwindow* window = InitWindow();
 	if (!window)
 		return -1;
@@ -61,50 +94,21 @@ int main()
 	Shader shaderSSAO("res/shaders/SSAO.shader");
 	Shader shaderSSAOBlur("res/shaders/SSAO_Blur.shader");
 	Shader shaderLightBox("res/shaders/LightBox.shader");
+	ShaderStartupProfile shaderProfile = PrintShaderProfile({ &shaderGeometryPass, &shaderLightingPass, &shaderSSAO, &shaderSSAOBlur, &shaderLightBox });
 
-	Model backpack("res/models/backpack/backpack.obj");
-
-	// Configure G-Buffer Framebuffer
-	unsigned int gBuffer;
-	glGenFramebuffers(1, &gBuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-
-	unsigned int gPosition, gNormal, gAlbedoSpec;
-
-	glGenTextures(1, &gPosition);
-	glBindTexture(GL_TEXTURE_2D, gPosition);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
-
-	glGenTextures(1, &gNormal);
-	glBindTexture(GL_TEXTURE_2D, gNormal);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
-
-	glGenTextures(1, &gAlbedoSpec);
-	glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedoSpec, 0);
+	// edited shaders are rebuilt at the top of the next frame, a failed build keeps the last good program
+	ShaderWatcher shaderWatcher;
+	shaderWatcher.Add(shaderGeometryPass);
+	shaderWatcher.Add(shaderLightingPass);
+	shaderWatcher.Add(shaderSSAO);
+	shaderWatcher.Add(shaderSSAOBlur);
+	shaderWatcher.Add(shaderLightBox);
 
-	unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-	glDrawBuffers(3, attachments);
+	std::shared_ptr<Model> backpack = AssetRegistry::Get().AcquireModel("res/models/backpack/backpack.obj");
+	AssetRegistry::Get().PrintReport();
 
-	unsigned int rboDepth;
-	glGenRenderbuffers(1, &rboDepth);
-	glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "Framebuffer not complete!" << std::endl;
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	// Configure G-Buffer Framebuffer
+	GBuffer gBuffer(SCR_WIDTH, SCR_HEIGHT, packedGBuffer);
 
 	// Configure SSAO Framebuffer
 	unsigned int ssaoFBO;
@@ -145,7 +149,7 @@ int main()
 	// Generate Sampler Kernel
 	std::uniform_real_distribution<float> randomFloats(0.0, 1.0);
 	std::default_random_engine generator;
-	std::vector<glm::vec3> ssaoKernel;
+	std::vector<glm::vec4> ssaoKernel; // vec4 for the std140 array stride
 	for (unsigned int i = 0; i < 64; ++i)
 	{
 		glm::vec3 sample(
@@ -157,9 +161,13 @@ int main()
 		scale = lerp(0.1f, 1.0f, scale * scale);
 		sample *= scale;
 
-		ssaoKernel.push_back(sample);
+		ssaoKernel.push_back(glm::vec4(sample, 0.0f));
 	}
 
+	UniformBuffer kernelUniforms((unsigned int)(ssaoKernel.size() * sizeof(glm::vec4)), SSAO_KERNEL_BINDING);
+	kernelUniforms.SetData(&ssaoKernel[0], (unsigned int)(ssaoKernel.size() * sizeof(glm::vec4)));
+	shaderSSAO.BindUniformBlock("SSAOKernel", SSAO_KERNEL_BINDING);
+
 	// Create random rotations around z-axis
 	std::vector<glm::vec3> ssaoNoise;
 	for (unsigned int i = 0; i < 16; i++)
@@ -185,6 +193,21 @@ int main()
 	glm::vec3 lightPos = glm::vec3(2.0f, 2.0f, -2.0f);
 	glm::vec3 lightColor = glm::vec3(0.2f, 0.2f, 0.7f);
 
+	UniformBuffer cameraUniforms(sizeof(CameraUniforms), CAMERA_BINDING);
+	shaderGeometryPass.BindUniformBlock("Camera", CAMERA_BINDING);
+	shaderSSAO.BindUniformBlock("Camera", CAMERA_BINDING);
+	shaderLightBox.BindUniformBlock("Camera", CAMERA_BINDING);
+
+	UniformBuffer lightUniforms(sizeof(LightUniform), LIGHTS_BINDING);
+	shaderLightingPass.BindUniformBlock("Lights", LIGHTS_BINDING);
+	float uniformMs = 0.0f;
+
+	// geometry, SSAO and lighting passes GPU time, read back a frame late so it never stalls
+	unsigned int passQueries[2];
+	glGenQueries(2, passQueries);
+	unsigned int frameIndex = 0;
+	float passMs = 0.0f;
+
 	shaderGeometryPass.Bind();
 	shaderGeometryPass.SetUniform1i("texture_diffuse1", 0);
 	shaderGeometryPass.SetUniform1i("texture_specular1", 1);
@@ -193,12 +216,14 @@ int main()
 	shaderLightingPass.SetUniform1i("gPosition", 0);
 	shaderLightingPass.SetUniform1i("gNormal", 1);
 	shaderLightingPass.SetUniform1i("gAlbedoSpec", 2);
-	shaderLightingPass.SetUniform1i("ssao", 3);
+	shaderLightingPass.SetUniform1i("gDepth", 3);
+	shaderLightingPass.SetUniform1i("ssao", 4);
 
 	shaderSSAO.Bind();
 	shaderSSAO.SetUniform1i("gPosition", 0);
 	shaderSSAO.SetUniform1i("gNormal", 1);
-	shaderSSAO.SetUniform1i("texNoise", 2);
+	shaderSSAO.SetUniform1i("gDepth", 3);
+	shaderSSAO.SetUniform1i("texNoise", 4);
 
 	shaderSSAOBlur.Bind();
 	shaderSSAOBlur.SetUniform1i("ssaoInput", 0);
@@ -212,14 +237,16 @@ int main()
 	// Game Loop
 	while (!glfwWindowShouldClose(window))
 	{
-		float currentFrame = glfwGetTime();
+		float currentFrame = headless.GetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		processInput(window);
+		headless.UpdateCamera(camera);
+		shaderWatcher.Poll();
 
-		lightPos.x = sin(glfwGetTime()) * 2.0;
-		lightPos.z = cos(glfwGetTime()) * 2.0;
+		lightPos.x = sin(currentFrame) * 2.0;
+		lightPos.z = cos(currentFrame) * 2.0;
 
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -227,16 +254,35 @@ int main()
 		ImGui_ImplGlfwGL3_NewFrame();
 
 		// 1 - Geometry Pass
-		glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+		gBuffer.Resize(SCR_WIDTH, SCR_HEIGHT, packedGBuffer);
+		glBeginQuery(GL_TIME_ELAPSED, passQueries[frameIndex % 2]);
+		headless.BeginPass("Geometry");
+		glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.GetID());
 
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 			glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 			glm::mat4 view = camera.GetViewMatrix();
+			glm::mat4 gBufferInverse = glm::inverse(projection); // positions are stored in view space
+
+			// one write per block per frame, the kernel block never changes
+			auto uniformStart = std::chrono::high_resolution_clock::now();
+			CameraUniforms cameraData;
+			cameraData.projection = projection;
+			cameraData.view = view;
+			cameraData.viewPos = glm::vec4(camera.Position, 1.0f);
+			cameraUniforms.SetData(&cameraData, sizeof(cameraData));
+
+			LightUniform light;
+			light.position = glm::vec3(view * glm::vec4(lightPos, 1.0));
+			light.color = lightColor;
+			light.linear = 0.09f;
+			light.quadratic = 0.032f;
+			lightUniforms.SetData(&light, sizeof(light));
+			uniformMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - uniformStart).count();
 
 			shaderGeometryPass.Bind();
-			shaderGeometryPass.SetUniformMatrix4fv("projection", projection);
-			shaderGeometryPass.SetUniformMatrix4fv("view", view);
+			shaderGeometryPass.SetUniform1i("packedGBuffer", gBuffer.IsPacked());
 
 			glm::mat4 model = glm::mat4(1.0f);
 			model = glm::translate(model, glm::vec3(0.0f, 7.0f, 0.0f));
@@ -253,35 +299,35 @@ int main()
 			model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 			model = glm::scale(model, glm::vec3(1.0f));
 			shaderGeometryPass.SetUniformMatrix4fv("model", model);
-			backpack.Draw(shaderGeometryPass);
+			backpack->Draw(shaderGeometryPass);
 		
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		headless.EndPass();
 
 		// 2 - Generate SSAO Texture
+		headless.BeginPass("SSAO");
 		glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
 		
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 			shaderSSAO.Bind();
-			for (unsigned int i = 0; i < 64; ++i)
-				shaderSSAO.SetUniform3f("samples[" + std::to_string(i) + "]", ssaoKernel[i]);
-			shaderSSAO.SetUniformMatrix4fv("projection", projection);
 			shaderSSAO.SetUniform1f("kernelSize", kernelSize);
 			shaderSSAO.SetUniform1f("radius", radius);
 			shaderSSAO.SetUniform1f("bias", bias);
 			shaderSSAO.SetUniform1f("power", power);
+			shaderSSAO.SetUniform1i("packedGBuffer", gBuffer.IsPacked());
+			shaderSSAO.SetUniformMatrix4fv("gBufferInverse", gBufferInverse);
 		
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, gPosition);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, gNormal);
-			glActiveTexture(GL_TEXTURE2);
+			gBuffer.BindTextures(0);
+			glActiveTexture(GL_TEXTURE4);
 			glBindTexture(GL_TEXTURE_2D, noiseTexture);
 			renderQuad();
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		headless.EndPass();
 
 		// 3 - Blur SSAO texture to remove noise
+		headless.BeginPass("SSAO Blur");
 		glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO);
 		
 			glClear(GL_COLOR_BUFFER_BIT);
@@ -292,39 +338,38 @@ int main()
 			renderQuad();
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		headless.EndPass();
 
 		// 4 - Lighting Pass
+		headless.BeginPass("Lighting");
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		
 		shaderLightingPass.Bind();
-		glm::vec3 lightPosView = glm::vec3(camera.GetViewMatrix() * glm::vec4(lightPos, 1.0));
-		shaderLightingPass.SetUniform3f("light.Position", lightPosView);
-		shaderLightingPass.SetUniform3f("light.Color", lightColor);
-
-		const float linear = 0.09f;
-		const float quadratic = 0.032f;
-		shaderLightingPass.SetUniform1f("light.Linear", linear);
-		shaderLightingPass.SetUniform1f("light.Quadratic", quadratic);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, gPosition);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, gNormal);
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-		glActiveTexture(GL_TEXTURE3);
+		shaderLightingPass.SetUniform1i("packedGBuffer", gBuffer.IsPacked());
+		shaderLightingPass.SetUniformMatrix4fv("gBufferInverse", gBufferInverse);
+		gBuffer.BindTextures(0);
+		glActiveTexture(GL_TEXTURE4);
 		glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
 		renderQuad();
+		headless.EndPass();
+		glEndQuery(GL_TIME_ELAPSED);
+
+		if (frameIndex > 0)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(passQueries[(frameIndex + 1) % 2], GL_QUERY_RESULT, &elapsed);
+			passMs = elapsed / 1000000.0f;
+		}
+		++frameIndex;
 
 		// 4.5 - Copy content of geometry's depth buffer to default framebuffer's depth buffer
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer.GetID());
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 		glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 		// 5 - Render Lights
 		shaderLightBox.Bind();
-		shaderLightBox.SetUniformMatrix4fv("projection", projection);
-		shaderLightBox.SetUniformMatrix4fv("view", view);
 		model = glm::mat4(1.0f);
 		model = glm::translate(model, glm::vec3(lightPos));
 		model = glm::scale(model, glm::vec3(0.125f));
@@ -340,24 +385,34 @@ int main()
 			ImGui::SliderFloat("Bias", &bias, 0.0f, 0.1f, "%.005f");
 			ImGui::SliderFloat("Strength", &power, 0.0f, 10.0f, "%1.f");
 
+			ImGui::Checkbox("Packed G-Buffer", &packedGBuffer);
+			ImGui::Text("G-Buffer: %u bytes/pixel (%.1f MB)", gBuffer.GetBytesPerPixel(), gBuffer.GetBytesPerPixel() * gBuffer.GetWidth() * gBuffer.GetHeight() / (1024.0f * 1024.0f));
+			ImGui::Text("Geometry + SSAO + Lighting (GPU): %.3f ms", passMs);
+
+			ImGui::Text("CPU Uniform Update: %.3f ms", uniformMs);
+			const ShaderReloadStats& reloadStats = shaderWatcher.GetStats();
+			if (reloadStats.reloads > 0)
+				ImGui::Text("Shader Reload: %s %s (compile %.1f ms, link %.1f ms), %u of %u failed", reloadStats.lastShader.c_str(),
+					reloadStats.lastSucceeded ? "rebuilt" : "failed, previous kept", reloadStats.lastCompileMs, reloadStats.lastLinkMs, reloadStats.failures, reloadStats.reloads);
+			else
+				ImGui::Text("Shader Reload: watching %u shaders", shaderWatcher.GetShaderCount());
+			ImGui::Text("Shader Build: %u programs in %.1f ms, %u from binary cache", shaderProfile.programs, shaderProfile.totalMs, shaderProfile.cached);
+			ImGui::Text("Model Load: %.1f ms, %s (geometry %.1f ms, textures %.1f ms)", backpack->loadStats.totalMs, backpack->loadStats.fromCache ? "mesh cache" : "Assimp import", backpack->loadStats.geometryMs, backpack->loadStats.textureMs);
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 		}
 		ImGui::End();
 		ImGui::Render();
-		ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		if (!headless.IsEnabled())
+			ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		headless.EndFrame(window);
 
 		glfwPollEvents();
 		glfwSwapBuffers(window);
 	}
-	glDeleteFramebuffers(1, &gBuffer);
+	glDeleteQueries(2, passQueries);
 	glDeleteFramebuffers(1, &ssaoFBO);
 	glDeleteFramebuffers(1, &ssaoBlurFBO);
 
-	glDeleteRenderbuffers(1, &rboDepth);
-
-	glDeleteTextures(1, &gPosition);
-	glDeleteTextures(1, &gNormal);
-	glDeleteTextures(1, &gAlbedoSpec);
 	glDeleteTextures(1, &ssaoColorBuffer);
 	glDeleteTextures(1, &ssaoColorBufferBlur);
 	glDeleteTextures(1, &noiseTexture);
@@ -368,6 +423,10 @@ int main()
 	glDeleteBuffers(1, &quadVBO);
 	glDeleteBuffers(1, &cubeVBO);
 
+	// last handle, the registry frees the model's meshes and textures while the context is alive, then the arenas go
+	backpack.reset();
+	MeshArena::ReleaseAll();
+
 	ImGui_ImplGlfwGL3_Shutdown();
 	ImGui::DestroyContext();
 	glfwTerminate();
@@ -385,6 +444,7 @@ GLFWwindow* InitWindow()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	headless.ApplyWindowHints();
 
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "GLFW Project", NULL, NULL);
 	if (window == NULL)
@@ -394,7 +454,7 @@ GLFWwindow* InitWindow()
 		return nullptr;
 	}
 	glfwMakeContextCurrent(window);
-	glfwSwapInterval(1);
+	glfwSwapInterval(headless.IsEnabled() ? 0 : 1);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetWindowPos(window, 100, 100);
 
@@ -0,0 +1,88 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount) : m_ActiveJobs(0), m_Stop(false)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (unsigned int i = 0; i < threadCount; ++i)
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_JobAvailable.notify_all();
+
+	for (std::thread& worker : m_Workers)
+		worker.join();
+}
+
+void ThreadPool::Enqueue(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Jobs.push(std::move(job));
+	}
+	m_JobAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_JobsFinished.wait(lock, [this] { return m_Jobs.empty() && m_ActiveJobs == 0; });
+}
+
+void ThreadPool::ParallelFor(unsigned int count, const std::function<void(unsigned int)>& func)
+{
+	// every worker pulls indices from a shared counter so uneven jobs balance themselves
+	std::atomic<unsigned int> next(0);
+	unsigned int workers = std::min((unsigned int)m_Workers.size(), count);
+	for (unsigned int i = 0; i < workers; ++i)
+	{
+		Enqueue([&next, count, &func]
+		{
+			for (unsigned int index = next++; index < count; index = next++)
+				func(index);
+		});
+	}
+	Wait();
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+	return (unsigned int)m_Workers.size();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_JobAvailable.wait(lock, [this] { return m_Stop || !m_Jobs.empty(); });
+			if (m_Stop && m_Jobs.empty())
+				return;
+
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop();
+			++m_ActiveJobs;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			--m_ActiveJobs;
+			if (m_Jobs.empty() && m_ActiveJobs == 0)
+				m_JobsFinished.notify_all();
+		}
+	}
+}
@@ -13,13 +13,21 @@ out VS_OUT
 
 uniform bool invertedNormals;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
 uniform mat4 model;
+uniform bool quantized; // VERTEX_LAYOUT_QUANTIZED mesh, positions are unorm16 within its bounds
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
 void main()
 {
-	vec4 viewPos = view * model * vec4(aPos, 1.0);
+	vec3 position = quantized ? positionOffset + aPos * positionScale : aPos;
+	vec4 viewPos = view * model * vec4(position, 1.0);
 	vs_out.FragPos = viewPos.xyz;
 	vs_out.TexCoords = aTexCoords;
 	vs_out.Normal = mat3(transpose(inverse(view * model))) * (invertedNormals ? -aNormal : aNormal);
@@ -28,9 +36,9 @@ void main()
 
 #shader fragment
 #version 330 core
-layout(location = 0) out vec3 gPosition;
-layout(location = 1) out vec3 gNormal;
-layout(location = 2) out vec4 gAlbedoSpec;
+layout(location = 0) out vec3 outPosition;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec4 outAlbedoSpec;
 
 in VS_OUT
 {
@@ -43,10 +51,12 @@ uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
 uniform bool renderTexture;
 
+#include "GBuffer.glsl"
+
 void main()
 {
-	gPosition = fs_in.FragPos;
-	gNormal = normalize(fs_in.Normal);
-	gAlbedoSpec.rgb = (renderTexture ? texture(texture_diffuse1, fs_in.TexCoords).rgb : vec3(0.95));
-	gAlbedoSpec.a = (renderTexture ? texture(texture_specular1, fs_in.TexCoords).r : 0.0);
+	outPosition = fs_in.FragPos;
+	outNormal = encodeNormal(normalize(fs_in.Normal));
+	outAlbedoSpec.rgb = (renderTexture ? texture(texture_diffuse1, fs_in.TexCoords).rgb : vec3(0.95));
+	outAlbedoSpec.a = (renderTexture ? texture(texture_specular1, fs_in.TexCoords).r : 0.0);
 };
\ No newline at end of file
@@ -17,29 +17,30 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
-uniform sampler2D gAlbedoSpec;
+#include "GBuffer.glsl"
 uniform sampler2D ssao;
 
+// std140, mirrored by LightUniform in Source.cpp
 struct Light
 {
 	vec3 Position;
-	vec3 Color;
-
 	float Linear;
+	vec3 Color;
 	float Quadratic;
 };
 
-uniform Light light;
+layout(std140) uniform Lights
+{
+	Light light;
+};
 
 void main()
 {
 	// Get data from gBuffer
-	vec3 FragPos = texture(gPosition, TexCoords).rgb;
-	vec3 Normal = texture(gNormal, TexCoords).rgb;
-	vec3 Diffuse = texture(gAlbedoSpec, TexCoords).rgb;
-	float Specular = texture(gAlbedoSpec, TexCoords).a;
+	vec3 FragPos = gBufferPosition(TexCoords);
+	vec3 Normal = gBufferNormal(TexCoords);
+	vec3 Diffuse = gBufferAlbedo(TexCoords);
+	float Specular = gBufferSpecular(TexCoords);
 	float AmbientOcclusion = texture(ssao, TexCoords).r;
 
 	// calculate lighting as normal
@@ -17,12 +17,21 @@ out float FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
+#include "GBuffer.glsl"
 uniform sampler2D texNoise;
 
-uniform vec3 samples[64];
-uniform mat4 projection;
+// hemisphere samples, written once at startup
+layout(std140) uniform SSAOKernel
+{
+	vec4 samples[64];
+};
+
+layout(std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
 
 uniform float kernelSize;
 uniform float radius;
@@ -33,8 +42,8 @@ const vec2 noiseScale = vec2(1000.0 / 4.0, 800.0 / 4.0);
 
 void main()
 {
-	vec3 fragPos = texture(gPosition, TexCoords).xyz;
-	vec3 normal = texture(gNormal, TexCoords).rgb;
+	vec3 fragPos = gBufferPosition(TexCoords);
+	vec3 normal = gBufferNormal(TexCoords);
 	vec3 randomVec = texture(texNoise, TexCoords * noiseScale).xyz;
 
 	vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -45,7 +54,7 @@ void main()
 	for (int i = 0; i < kernelSize; ++i)
 	{
 		// get sample position
-		vec3 sample = TBN * samples[i]; // tangent to view-space
+		vec3 sample = TBN * samples[i].xyz; // tangent to view-space
 		sample = fragPos + sample * radius;
 
 		vec4 offset = vec4(sample, 1.0);
@@ -53,7 +62,7 @@ void main()
 		offset.xyz /= offset.w; // perspective divide
 		offset.xyz = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0
 
-		float sampleDepth = texture(gPosition, offset.xy).z;
+		float sampleDepth = gBufferPosition(offset.xy).z;
 		float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
 		occlusion += (sampleDepth >= sample.z + bias ? 1.0 : 0.0) * rangeCheck;
 	}
@@ -0,0 +1,317 @@
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+// rows each rasterization job owns, none of them share a pixel
+const unsigned int BAND_ROWS = 8;
+
+static float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static unsigned int RoundUpToPowerOfTwo(unsigned int value)
+{
+	// at least 8 so a row is whole groups of four and the mips have a level to build
+	unsigned int power = 8;
+	while (power < value)
+		power <<= 1;
+	return power;
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height, ThreadPool* pool)
+	: m_Width(RoundUpToPowerOfTwo(width)), m_Height(RoundUpToPowerOfTwo(height)), m_ViewProjection(1.0f), m_Pool(pool)
+{
+	// halving down to a single row or column
+	for (unsigned int w = m_Width, h = m_Height; ; w >>= 1, h >>= 1)
+	{
+		m_Mips.push_back(std::vector<float>((size_t)w * h, 1.0f));
+		if (w == 1 || h == 1)
+			break;
+	}
+}
+
+void OcclusionCuller::Begin(const glm::mat4& viewProjection)
+{
+	m_ViewProjection = viewProjection;
+	std::fill(m_Mips[0].begin(), m_Mips[0].end(), 1.0f);
+	m_Occluders.clear();
+	m_Stats = OcclusionStats();
+}
+
+void OcclusionCuller::AddOccluder(const glm::vec3* positions, const unsigned int* indices, unsigned int indexCount, const glm::mat4& model)
+{
+	Occluder occluder;
+	occluder.positions = positions;
+	occluder.indices = indices;
+	occluder.indexCount = indexCount;
+	occluder.model = model;
+	m_Occluders.push_back(occluder);
+}
+
+void OcclusionCuller::Rasterize()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	auto run = [this](unsigned int count, const std::function<void(unsigned int)>& job)
+	{
+		if (m_Pool)
+			m_Pool->ParallelFor(count, job);
+		else
+			for (unsigned int i = 0; i < count; ++i)
+				job(i);
+	};
+
+	m_Triangles.resize(m_Occluders.size());
+	run((unsigned int)m_Occluders.size(), [this](unsigned int occluder) { SetUpTriangles(occluder); });
+	m_Stats.occluders = (unsigned int)m_Occluders.size();
+	for (unsigned int i = 0; i < m_Occluders.size(); ++i)
+		m_Stats.triangles += (unsigned int)m_Triangles[i].size();
+
+	unsigned int bands = (m_Height + BAND_ROWS - 1) / BAND_ROWS;
+	run(bands, [this](unsigned int band) { RasterizeRows(band * BAND_ROWS, std::min(BAND_ROWS, m_Height - band * BAND_ROWS)); });
+	m_Stats.rasterizeMs = ElapsedMs(start);
+
+	auto mipStart = std::chrono::high_resolution_clock::now();
+	BuildMips();
+	m_Stats.mipMs = ElapsedMs(mipStart);
+}
+
+void OcclusionCuller::SetUpTriangles(unsigned int occluderIndex)
+{
+	const Occluder& occluder = m_Occluders[occluderIndex];
+	std::vector<ScreenTriangle>& triangles = m_Triangles[occluderIndex];
+	triangles.clear();
+
+	glm::mat4 transform = m_ViewProjection * occluder.model;
+	for (unsigned int i = 0; i + 2 < occluder.indexCount; i += 3)
+	{
+		glm::vec4 clip[3];
+		for (unsigned int k = 0; k < 3; ++k)
+			clip[k] = transform * glm::vec4(occluder.positions[occluder.indices[i + k]], 1.0f);
+
+		// all three corners past the same side or far plane, nothing to draw
+		bool outside = false;
+		for (int axis = 0; axis < 3 && !outside; ++axis)
+		{
+			bool allBelow = true, allAbove = true;
+			for (unsigned int k = 0; k < 3; ++k)
+			{
+				allBelow = allBelow && axis < 2 && clip[k][axis] < -clip[k].w;
+				allAbove = allAbove && clip[k][axis] > clip[k].w;
+			}
+			outside = allBelow || allAbove;
+		}
+		if (outside)
+			continue;
+
+		// clipped against the near plane (z >= -w) into a triangle or a quad
+		glm::vec4 polygon[4];
+		unsigned int count = 0;
+		for (unsigned int k = 0; k < 3; ++k)
+		{
+			const glm::vec4& a = clip[k];
+			const glm::vec4& b = clip[(k + 1) % 3];
+			float da = a.z + a.w, db = b.z + b.w;
+			if (da >= 0.0f)
+				polygon[count++] = a;
+			if ((da >= 0.0f) != (db >= 0.0f))
+				polygon[count++] = a + (b - a) * (da / (da - db));
+		}
+		if (count < 3)
+			continue;
+
+		glm::vec3 screen[4];
+		for (unsigned int k = 0; k < count; ++k)
+		{
+			glm::vec3 ndc = glm::vec3(polygon[k]) / polygon[k].w;
+			screen[k] = glm::vec3((ndc.x * 0.5f + 0.5f) * m_Width, (ndc.y * 0.5f + 0.5f) * m_Height, ndc.z * 0.5f + 0.5f);
+		}
+
+		// both windings are drawn, each triangle is turned counter-clockwise
+		for (unsigned int k = 1; k + 1 < count; ++k)
+		{
+			glm::vec3 v[3] = { screen[0], screen[k], screen[k + 1] };
+			float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+			if (std::abs(area) < 1e-6f)
+				continue;
+			if (area < 0.0f)
+			{
+				std::swap(v[1], v[2]);
+				area = -area;
+			}
+
+			ScreenTriangle triangle;
+			triangle.y0 = std::max((int)std::ceil(std::min(v[0].y, std::min(v[1].y, v[2].y)) - 0.5f), 0);
+			triangle.y1 = std::min((int)std::floor(std::max(v[0].y, std::max(v[1].y, v[2].y)) - 0.5f), (int)m_Height - 1);
+			triangle.x0 = std::max((int)std::ceil(std::min(v[0].x, std::min(v[1].x, v[2].x)) - 0.5f), 0);
+			triangle.x1 = std::min((int)std::floor(std::max(v[0].x, std::max(v[1].x, v[2].x)) - 0.5f), (int)m_Width - 1);
+			if (triangle.y0 > triangle.y1 || triangle.x0 > triangle.x1)
+				continue;
+
+			for (int edge = 0; edge < 3; ++edge)
+			{
+				const glm::vec3& from = v[edge];
+				const glm::vec3& to = v[(edge + 1) % 3];
+				triangle.a[edge] = from.y - to.y;
+				triangle.b[edge] = to.x - from.x;
+				triangle.c[edge] = -(triangle.a[edge] * from.x + triangle.b[edge] * from.y);
+			}
+			triangle.depthX = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) / area;
+			triangle.depthY = ((v[2].z - v[0].z) * (v[1].x - v[0].x) - (v[1].z - v[0].z) * (v[2].x - v[0].x)) / area;
+			triangle.depth = v[0].z - triangle.depthX * v[0].x - triangle.depthY * v[0].y;
+			triangles.push_back(triangle);
+		}
+	}
+}
+
+void OcclusionCuller::RasterizeRows(unsigned int firstRow, unsigned int rowCount)
+{
+	float* depth = m_Mips[0].data();
+	const int rowEnd = (int)(firstRow + rowCount);
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (const std::vector<ScreenTriangle>& triangles : m_Triangles)
+	{
+		for (const ScreenTriangle& triangle : triangles)
+		{
+			int y0 = std::max(triangle.y0, (int)firstRow);
+			int y1 = std::min(triangle.y1, rowEnd - 1);
+			if (y0 > y1)
+				continue;
+			int x0 = triangle.x0 & ~3, x1 = triangle.x1;
+			const float* a = triangle.a;
+			const float* b = triangle.b;
+			const float* c = triangle.c;
+
+			__m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]), depthX = _mm_set1_ps(triangle.depthX);
+			for (int y = y0; y <= y1; ++y)
+			{
+				float py = y + 0.5f;
+				__m128 row0 = _mm_set1_ps(b[0] * py + c[0]), row1 = _mm_set1_ps(b[1] * py + c[1]), row2 = _mm_set1_ps(b[2] * py + c[2]);
+				__m128 rowDepth = _mm_set1_ps(triangle.depthY * py + triangle.depth);
+				float* pixels = depth + (size_t)y * m_Width;
+				for (int x = x0; x <= x1; x += 4)
+				{
+					__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+					__m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), row0), zero), _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), row1), zero));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), row2), zero));
+					if (_mm_movemask_ps(inside) == 0)
+						continue;
+
+					__m128 current = _mm_loadu_ps(pixels + x);
+					__m128 nearer = _mm_min_ps(current, _mm_add_ps(_mm_mul_ps(depthX, px), rowDepth));
+					_mm_storeu_ps(pixels + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+				}
+			}
+		}
+	}
+}
+
+void OcclusionCuller::BuildMips()
+{
+	for (size_t level = 1; level < m_Mips.size(); ++level)
+	{
+		unsigned int sourceWidth = m_Width >> (level - 1);
+		unsigned int width = m_Width >> level, height = m_Height >> level;
+		const float* source = m_Mips[level - 1].data();
+		float* destination = m_Mips[level].data();
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			const float* top = source + (size_t)2 * y * sourceWidth;
+			const float* bottom = top + sourceWidth;
+			float* row = destination + (size_t)y * width;
+
+			// eight texels of two rows make four, the farther of each 2x2
+			unsigned int x = 0;
+			for (; x + 4 <= width; x += 4)
+			{
+				__m128 left = _mm_max_ps(_mm_loadu_ps(top + 2 * x), _mm_loadu_ps(bottom + 2 * x));
+				__m128 right = _mm_max_ps(_mm_loadu_ps(top + 2 * x + 4), _mm_loadu_ps(bottom + 2 * x + 4));
+				__m128 even = _mm_shuffle_ps(left, right, _MM_SHUFFLE(2, 0, 2, 0));
+				__m128 odd = _mm_shuffle_ps(left, right, _MM_SHUFFLE(3, 1, 3, 1));
+				_mm_storeu_ps(row + x, _mm_max_ps(even, odd));
+			}
+			for (; x < width; ++x)
+				row[x] = std::max(std::max(top[2 * x], top[2 * x + 1]), std::max(bottom[2 * x], bottom[2 * x + 1]));
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const glm::vec3& minimum, const glm::vec3& maximum)
+{
+	++m_Stats.tested;
+
+	glm::vec2 low(1e30f), high(-1e30f);
+	float nearest = 1e30f;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::vec3 position(corner & 1 ? maximum.x : minimum.x, corner & 2 ? maximum.y : minimum.y, corner & 4 ? maximum.z : minimum.z);
+		glm::vec4 clip = m_ViewProjection * glm::vec4(position, 1.0f);
+		if (clip.w <= 1e-5f)
+			return true;
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		low = glm::min(low, glm::vec2(ndc));
+		high = glm::max(high, glm::vec2(ndc));
+		nearest = std::min(nearest, ndc.z);
+	}
+	if (high.x < -1.0f || low.x > 1.0f || high.y < -1.0f || low.y > 1.0f)
+		return true;
+	float depth = nearest * 0.5f + 0.5f;
+	if (depth <= 0.0f)
+		return true;
+
+	int x0 = std::max((int)((low.x * 0.5f + 0.5f) * m_Width), 0);
+	int x1 = std::min((int)((high.x * 0.5f + 0.5f) * m_Width), (int)m_Width - 1);
+	int y0 = std::max((int)((low.y * 0.5f + 0.5f) * m_Height), 0);
+	int y1 = std::min((int)((high.y * 0.5f + 0.5f) * m_Height), (int)m_Height - 1);
+
+	// the finest level where the rectangle spans at most 4x4 texels
+	unsigned int level = 0;
+	while (level + 1 < m_Mips.size() && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+		++level;
+
+	const std::vector<float>& mip = m_Mips[level];
+	unsigned int width = m_Width >> level;
+	for (int y = y0 >> level; y <= (y1 >> level); ++y)
+		for (int x = x0 >> level; x <= (x1 >> level); ++x)
+			if (mip[(size_t)y * width + x] >= depth)
+				return true;
+
+	++m_Stats.occluded;
+	return false;
+}
+
+void OcclusionCuller::RemoveOccluded(std::vector<unsigned int>& ids, const std::function<void(unsigned int, glm::vec3&, glm::vec3&)>& getBox)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	size_t kept = 0;
+	for (unsigned int id : ids)
+	{
+		glm::vec3 minimum, maximum;
+		getBox(id, minimum, maximum);
+		if (IsVisible(minimum, maximum))
+			ids[kept++] = id;
+	}
+	ids.resize(kept);
+	m_Stats.testMs += ElapsedMs(start);
+}
+
+unsigned int OcclusionCuller::GetWidth() const
+{
+	return m_Width;
+}
+
+unsigned int OcclusionCuller::GetHeight() const
+{
+	return m_Height;
+}
+
+const OcclusionStats& OcclusionCuller::GetStats() const
+{
+	return m_Stats;
+}
@@ -7,17 +7,23 @@
 
 #include "Shader.h"
 #include "Camera.h"
+#include "Headless.h"
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
 
 #include <GLM/glm.hpp>
 #include <GLM/gtc/matrix_transform.hpp>
 #include <GLM/gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <chrono>
 
-const unsigned int SCR_WIDTH = 1200;
-const unsigned int SCR_HEIGHT = 695;
+// window size, --width / --height replace it in headless mode
+unsigned int SCR_WIDTH = 1200;
+unsigned int SCR_HEIGHT = 695;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+Headless headless;
 float lastX = (float)SCR_WIDTH / 2.0;
 float lastY = (float)SCR_HEIGHT / 2.0;
 bool firstMouse = true;
@@ -32,13 +38,40 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 unsigned int loadTexture(char const* path);
-void renderScene(Shader& shader);
 void renderCube();
 void renderQuad();
 
 bool shadows = true;
 bool shadowsKeyPressed = false;
 
+// Crates, the first INSIDE_CRATES are the ones in the room and the rest stand around it outside the walls
+struct SceneCrate
+{
+	glm::mat4 model;
+	unsigned int texture;
+	glm::vec3 minimum, maximum; // world space box
+};
+const unsigned int INSIDE_CRATES = 5;
+int outsideCrateCount = 500;
+
+// Occlusion culling, the room's walls and the crates inside are rasterized into a small CPU depth buffer and
+// every crate is tested against it before the scene pass draws it; the walls hide everything outside
+bool useOcclusion = true;
+
+// The unit cube renderCube draws, as corners and triangles for the occlusion rasterizer
+const glm::vec3 CUBE_CORNERS[8] = {
+	glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(1.0f, -1.0f, -1.0f), glm::vec3(-1.0f, 1.0f, -1.0f), glm::vec3(1.0f, 1.0f, -1.0f),
+	glm::vec3(-1.0f, -1.0f, 1.0f), glm::vec3(1.0f, -1.0f, 1.0f), glm::vec3(-1.0f, 1.0f, 1.0f), glm::vec3(1.0f, 1.0f, 1.0f)
+};
+const unsigned int CUBE_INDICES[36] = {
+	0, 1, 3, 0, 3, 2,  4, 6, 7, 4, 7, 5,  0, 4, 5, 0, 5, 1,
+	2, 3, 7, 2, 7, 6,  0, 2, 6, 0, 6, 4,  1, 5, 7, 1, 7, 3
+};
+
+std::vector<SceneCrate> CreateCrates(int outsideCount);
+// Draws the room, the crates listed in drawn (every crate without it) and the light
+void renderScene(Shader& shader, const std::vector<SceneCrate>& crates, const std::vector<unsigned int>* drawn = nullptr);
+
 unsigned int planeVAO = 0, planeVBO;
 unsigned int cubeVAO = 0, cubeVBO;
 unsigned int quadVAO = 0, quadVBO;
@@ -47,8 +80,10 @@ glm::vec3 lightPos(0.0f, 0.0f, 0.0f);
 
 unsigned int woodTexture, boxTexture, stoneTexture, jumpBoxTexture, bounceBoxTexture, tntTexture, portalTexture;
 
-int main()
+int main(int argc, char** argv)
 {
+	headless.ParseArguments(argc, argv, SCR_WIDTH, SCR_HEIGHT);
+
 	GLFWwindow* window = InitWindow();
 	if (!window)
 		return -1;
@@ -131,16 +166,32 @@ int main()
 
 	glUseProgram(0);
 
+	std::vector<SceneCrate> crates;
+	std::vector<unsigned int> drawnCrates;
+	ThreadPool occlusionPool;
+	OcclusionCuller occlusionCuller(256, 128, &occlusionPool);
+
+	// scene pass GPU time, read back a frame late so it never stalls, as last measured without and with occlusion culling
+	unsigned int sceneQueries[2];
+	glGenQueries(2, sceneQueries);
+	bool sceneQueryOcclusion[2] = { false, false };
+	unsigned int frameIndex = 0;
+	float sceneMs = 0.0f;
+	float sceneMsByOcclusion[2] = { 0.0f, 0.0f };
+
 	// Game Loop
 	while (!glfwWindowShouldClose(window))
 	{
-		float currentFrame = glfwGetTime();
+		float currentFrame = headless.GetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		processInput(window);
+		headless.UpdateCamera(camera);
 
-		lightPos.z = sin(glfwGetTime() * 0.5) * 3.0;
+		lightPos.z = sin(currentFrame * 0.5) * 3.0;
+		if (crates.size() != INSIDE_CRATES + outsideCrateCount)
+			crates = CreateCrates(outsideCrateCount);
 
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -159,6 +210,7 @@ int main()
 		shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0, 0.0)));
 
 		// 1 - Render scene to depth cubemap
+		headless.BeginPass("Shadow Cubemap");
 		glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
 		glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
 		glClear(GL_DEPTH_BUFFER_BIT);
@@ -168,8 +220,9 @@ int main()
 			depthShader.SetUniformMatrix4fv("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
 		depthShader.SetUniform1f("far_plane", far_plane);
 		depthShader.SetUniform3f("lightPos", lightPos);
-		renderScene(depthShader);
+		renderScene(depthShader, crates);
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		headless.EndPass();
 
 		glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -177,6 +230,28 @@ int main()
 		// 2 - Render scene using the depth/shadow map
 		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 		glm::mat4 view = camera.GetViewMatrix();
+
+		// 2.1 - Crates hidden behind the walls or each other are left out of the scene pass
+		drawnCrates.resize(crates.size());
+		for (unsigned int i = 0; i < crates.size(); ++i)
+			drawnCrates[i] = i;
+		if (useOcclusion)
+		{
+			occlusionCuller.Begin(projection * view);
+			occlusionCuller.AddOccluder(CUBE_CORNERS, CUBE_INDICES, 36, glm::scale(glm::mat4(1.0f), glm::vec3(5.0f)));
+			for (unsigned int i = 0; i < INSIDE_CRATES; ++i)
+				occlusionCuller.AddOccluder(CUBE_CORNERS, CUBE_INDICES, 36, crates[i].model);
+			occlusionCuller.Rasterize();
+			occlusionCuller.RemoveOccluded(drawnCrates, [&crates](unsigned int i, glm::vec3& minimum, glm::vec3& maximum)
+			{
+				minimum = crates[i].minimum;
+				maximum = crates[i].maximum;
+			});
+		}
+
+		headless.BeginPass("Scene");
+		glBeginQuery(GL_TIME_ELAPSED, sceneQueries[frameIndex % 2]);
+		sceneQueryOcclusion[frameIndex % 2] = useOcclusion;
 		
 		shadowShader.Bind();
 		shadowShader.SetUniformMatrix4fv("projection", projection);
@@ -192,7 +267,18 @@ int main()
 		glBindTexture(GL_TEXTURE_2D, stoneTexture);
 		glActiveTexture(GL_TEXTURE1);
 		glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
-		renderScene(shadowShader);
+		renderScene(shadowShader, crates, &drawnCrates);
+		glEndQuery(GL_TIME_ELAPSED);
+		headless.EndPass();
+
+		if (frameIndex > 0)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(sceneQueries[(frameIndex + 1) % 2], GL_QUERY_RESULT, &elapsed);
+			sceneMs = elapsed / 1000000.0f;
+			sceneMsByOcclusion[sceneQueryOcclusion[(frameIndex + 1) % 2]] = sceneMs;
+		}
+		++frameIndex;
 
 		// 3 - Render depth map to quad
 		/*quadShader.Bind();
@@ -218,11 +304,26 @@ int main()
 			if (ImGui::RadioButton("Disable", &shadowInt, 1))
 				shadows = false;
 
+			ImGui::NewLine();
+			ImGui::Checkbox("Occlusion Culling", &useOcclusion);
+			ImGui::SliderInt("Crates Outside", &outsideCrateCount, 0, 10000);
+			ImGui::Text("Drawn: %u of %u crates", (unsigned int)drawnCrates.size(), (unsigned int)crates.size());
+			if (useOcclusion)
+			{
+				const OcclusionStats& occlusionStats = occlusionCuller.GetStats();
+				ImGui::Text("Occluded: %u, depth buffer %ux%u, %u triangles", occlusionStats.occluded, occlusionCuller.GetWidth(), occlusionCuller.GetHeight(), occlusionStats.triangles);
+				ImGui::Text("CPU: rasterize %.3f ms (%u threads), mips %.3f ms, test %.3f ms", occlusionStats.rasterizeMs, occlusionPool.GetThreadCount(),
+					occlusionStats.mipMs, occlusionStats.testMs);
+			}
+			ImGui::Text("Scene Pass GPU: %.3f ms with occlusion culling, %.3f ms without", sceneMsByOcclusion[1], sceneMsByOcclusion[0]);
+
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 		}
 		ImGui::End();
 		ImGui::Render();
-		ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		if (!headless.IsEnabled())
+			ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
+		headless.EndFrame(window);
 
 		glfwPollEvents();
 		glfwSwapBuffers(window);
@@ -235,6 +336,7 @@ int main()
 	glDeleteBuffers(1, &cubeVBO);
 	glDeleteBuffers(1, &quadVBO);
 
+	glDeleteQueries(2, sceneQueries);
 	glDeleteFramebuffers(1, &depthMapFBO);
 	glDeleteTextures(1, &depthCubeMap);
 
@@ -258,6 +360,7 @@ GLFWwindow* InitWindow()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	headless.ApplyWindowHints();
 
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "GLFW Project", NULL, NULL);
 	if (window == NULL)
@@ -267,7 +370,7 @@ GLFWwindow* InitWindow()
 		return nullptr;
 	}
 	glfwMakeContextCurrent(window);
-	glfwSwapInterval(1);
+	glfwSwapInterval(headless.IsEnabled() ? 0 : 1);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetWindowPos(window, 100, 100);
 
@@ -407,7 +510,53 @@ unsigned int loadTexture(char const* path)
 	return textureID;
 }
 
-void renderScene(Shader &shader)
+std::vector<SceneCrate> CreateCrates(int outsideCount)
+{
+	std::vector<SceneCrate> crates(INSIDE_CRATES + outsideCount);
+	crates[0].model = glm::translate(glm::mat4(1.0f), glm::vec3(4.0f, -3.5f, 0.0f));
+	crates[0].model = glm::scale(crates[0].model, glm::vec3(0.5f));
+	crates[0].texture = boxTexture;
+	crates[1].model = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 3.0f, 1.0f));
+	crates[1].model = glm::scale(crates[1].model, glm::vec3(0.75f));
+	crates[1].texture = jumpBoxTexture;
+	crates[2].model = glm::translate(glm::mat4(1.0f), glm::vec3(-3.0f, -1.0f, 0.0f));
+	crates[2].model = glm::scale(crates[2].model, glm::vec3(0.5f));
+	crates[2].texture = bounceBoxTexture;
+	crates[3].model = glm::translate(glm::mat4(1.0f), glm::vec3(-1.5f, 1.0f, 1.5f));
+	crates[3].model = glm::scale(crates[3].model, glm::vec3(0.5f));
+	crates[3].texture = tntTexture;
+	crates[4].model = glm::translate(glm::mat4(1.0f), glm::vec3(-1.5f, 2.0f, -3.0f));
+	crates[4].model = glm::rotate(crates[4].model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
+	crates[4].model = glm::scale(crates[4].model, glm::vec3(0.75f));
+	crates[4].texture = boxTexture;
+
+	// a ring around the room, 7 to 15 units out
+	srand(7);
+	for (unsigned int i = INSIDE_CRATES; i < crates.size(); ++i)
+	{
+		float angle = (rand() % 1000) / 1000.0f * glm::two_pi<float>();
+		float distance = 7.0f + (rand() % 1000) / 1000.0f * 8.0f;
+		float height = (rand() % 1000) / 1000.0f * 8.0f - 4.0f;
+		crates[i].model = glm::translate(glm::mat4(1.0f), glm::vec3(std::cos(angle) * distance, height, std::sin(angle) * distance));
+		crates[i].model = glm::scale(crates[i].model, glm::vec3(0.5f));
+		crates[i].texture = (i % 2) ? boxTexture : tntTexture;
+	}
+
+	for (SceneCrate& crate : crates)
+	{
+		crate.minimum = glm::vec3(1e30f);
+		crate.maximum = glm::vec3(-1e30f);
+		for (const glm::vec3& corner : CUBE_CORNERS)
+		{
+			glm::vec3 position = glm::vec3(crate.model * glm::vec4(corner, 1.0f));
+			crate.minimum = glm::min(crate.minimum, position);
+			crate.maximum = glm::max(crate.maximum, position);
+		}
+	}
+	return crates;
+}
+
+void renderScene(Shader &shader, const std::vector<SceneCrate>& crates, const std::vector<unsigned int>* drawn)
 {
 	//glActiveTexture(GL_TEXTURE0);
 	//glBindTexture(GL_TEXTURE_2D, stoneTexture);
@@ -427,47 +576,16 @@ void renderScene(Shader &shader)
 	shader.SetUniform1i("reverse_normals", 0);
 	glEnable(GL_CULL_FACE);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, boxTexture);
 	// Cubes
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(4.0f, -3.5f, 0.0f));
-	model = glm::scale(model, glm::vec3(0.5f));
-	shader.SetUniformMatrix4fv("model", model);
-	renderCube();
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, jumpBoxTexture);
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(2.0f, 3.0f, 1.0f));
-	model = glm::scale(model, glm::vec3(0.75f));
-	shader.SetUniformMatrix4fv("model", model);
-	renderCube();
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, bounceBoxTexture);
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(-3.0f, -1.0f, 0.0f));
-	model = glm::scale(model, glm::vec3(0.5f));
-	shader.SetUniformMatrix4fv("model", model);
-	renderCube();
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, tntTexture);
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(-1.5f, 1.0f, 1.5f));
-	model = glm::scale(model, glm::vec3(0.5f));
-	shader.SetUniformMatrix4fv("model", model);
-	renderCube();
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, boxTexture);
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(-1.5f, 2.0f, -3.0f));
-	model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
-	model = glm::scale(model, glm::vec3(0.75f));
-	shader.SetUniformMatrix4fv("model", model);
-	renderCube();
+	unsigned int count = drawn ? (unsigned int)drawn->size() : (unsigned int)crates.size();
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const SceneCrate& crate = crates[drawn ? (*drawn)[i] : i];
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, crate.texture);
+		shader.SetUniformMatrix4fv("model", crate.model);
+		renderCube();
+	}
 
 	// Light Cube
 	shader.SetUniform1i("lightCube", 1);